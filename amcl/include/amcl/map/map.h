@@ -28,6 +28,7 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -48,9 +49,6 @@ typedef struct
   // Occupancy state (-1 = free, 0 = unknown, +1 = occ)
   int occ_state;
 
-  // Distance to the nearest occupied cell
-  double occ_dist;
-
   // Wifi levels
   //int wifi_levels[MAP_WIFI_MAX_LEVELS];
 
@@ -75,9 +73,52 @@ typedef struct
   // Max distance at which we care about obstacles, for constructing
   // likelihood field
   double max_occ_dist;
+
+  // The likelihood field: the distance from each cell to the nearest
+  // occupied cell, stored as an index into occ_dist_table.  This keeps the
+  // raster read by the laser models at 2 bytes per cell.
+  uint16_t *occ_dist_field;
+
+  // The distance for each value of occ_dist_field; the last entry is
+  // max_occ_dist, for the cells further than that from any obstacle
+  double *occ_dist_table;
+  int occ_dist_table_size;
+
+  // The file mapping that holds occ_dist_field when it was loaded by
+  // map_load_cspace(), NULL when the field is allocated with malloc
+  void *occ_dist_mapping;
+  size_t occ_dist_mapping_size;
+
+  // The range field: for each cell, the chessboard distance in cells to the
+  // nearest cell that stops a ray, capped at MAP_RANGE_FIELD_MAX.  It is 0
+  // for the cells that are not free, and the cells beyond the edge of the
+  // map stop rays too.
+  uint8_t *range_field;
+
+  // The file mapping that holds range_field when it was loaded by
+  // map_load_range_field(), NULL when the field is allocated with malloc
+  void *range_field_mapping;
+  size_t range_field_mapping_size;
+
+  // The cells that poses are sampled from, see map_update_sample_cells():
+  // a bitmap of the cells, the number of cells before each 64 bit word of
+  // it, the word holding every MAP_SAMPLE_SELECT_CELLS-th cell and, for
+  // weighted sampling, the total weight of the cells before each word
+  uint64_t *sample_bits;
+  uint32_t *sample_rank;
+  uint32_t *sample_select;
+  double *sample_weight;
+  size_t sample_word_count;
+  int sample_cell_count;
   
 } map_t;
 
+// The spacing of the cells whose words are kept in sample_select
+#define MAP_SAMPLE_SELECT_CELLS 512
+
+// The largest distance kept in the range field
+#define MAP_RANGE_FIELD_MAX 255
+
 
 
 /**************************************************************************
@@ -99,9 +140,21 @@ int map_load_occ(map_t *map, const char *filename, double scale, int negate);
 // Load a wifi signal strength map
 //int map_load_wifi(map_t *map, const char *filename, int index);
 
-// Update the cspace distances
+// Update the cspace distances (the likelihood field)
 void map_update_cspace(map_t *map, double max_occ_dist);
 
+// Release the cspace distances
+void map_free_cspace(map_t *map);
+
+// Load the cspace distances from a file written by map_save_cspace().
+// Fails unless the file was saved for a map of the same size and scale,
+// with the same max_occ_dist and key.  The key identifies the content of
+// the map, and is chosen by the caller.  Returns 0 on success.
+int map_load_cspace(map_t *map, const char *filename, double max_occ_dist, uint64_t key);
+
+// Save the cspace distances to a file.  Returns 0 on success.
+int map_save_cspace(map_t *map, const char *filename, uint64_t key);
+
 
 /**************************************************************************
  * Range functions
@@ -110,6 +163,47 @@ void map_update_cspace(map_t *map, double max_occ_dist);
 // Extract a single range reading from the map
 double map_calc_range(map_t *map, double ox, double oy, double oa, double max_range);
 
+// Compute the range field, for map_lookup_range().  It takes one byte per
+// cell.
+void map_update_range_field(map_t *map);
+
+// Release the range field
+void map_free_range_field(map_t *map);
+
+// Load the range field from a file written by map_save_range_field().
+// Fails unless the file was saved for a map of the same size and scale,
+// with the same free cells and key.  Returns 0 on success.
+int map_load_range_field(map_t *map, const char *filename, uint64_t key);
+
+// Save the range field to a file.  Returns 0 on success.
+int map_save_range_field(map_t *map, const char *filename, uint64_t key);
+
+// Extract a single range reading from the map using the range field.  This
+// gives exactly the range of map_calc_range(), but skips over the free
+// cells around the ray instead of visiting them one by one.  It is not a
+// constant-time lookup: near walls the skips are short, and a ray that runs
+// along a wall still takes a step per cell.
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range);
+
+
+/**************************************************************************
+ * Sampling functions
+ **************************************************************************/
+
+// Build the set of cells to sample poses from: the free cells whose centers
+// are inside the polygon of polygon_count (x, y) points, or all the free
+// cells if there are fewer than 3 points.  If weighted is set and the
+// cspace has been computed, each cell is weighted by its distance to the
+// nearest occupied cell.
+void map_update_sample_cells(map_t *map, const double *polygon, int polygon_count, int weighted);
+
+// Release the set of cells to sample poses from
+void map_free_sample_cells(map_t *map);
+
+// Draw n cells from the set of cells to sample from, one for each of the
+// uniform numbers u in [0, 1).  The cells are -1 if the set is empty.
+void map_sample_cells(map_t *map, const double *u, int *cells, int n);
+
 
 /**************************************************************************
  * GUI/diagnostic functions
@@ -143,6 +237,9 @@ void map_draw_wifi(map_t *map, struct _rtk_fig_t *fig, int index);
 // Compute the cell index for the given map coords.
 #define MAP_INDEX(map, i, j) ((i) + (j) * map->size_x)
 
+// Distance from the cell at the given index to the nearest occupied cell
+#define MAP_OCC_DIST(map, index) (map->occ_dist_table[map->occ_dist_field[index]])
+
 #ifdef __cplusplus
 }
 #endif
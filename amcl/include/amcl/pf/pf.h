@@ -30,6 +30,7 @@
 
 #include "pf_vector.h"
 #include "pf_kdtree.h"
+#include "pf_rng.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,8 +42,14 @@ struct _rtk_fig_t;
 struct _pf_sample_set_t;
 
 // Function prototype for the initialization model; generates a sample pose from
-// an appropriate distribution.
-typedef pf_vector_t (*pf_init_model_fn_t) (void *init_data);
+// an appropriate distribution, drawing from the random number generator of
+// the filter.
+typedef pf_vector_t (*pf_init_model_fn_t) (void *init_data, pf_rng_t *rng);
+
+// Function prototype for a batch initialization model; generates count
+// sample poses at once, as arrays of x, y and angle.
+typedef void (*pf_init_batch_fn_t) (void *init_data, pf_rng_t *rng,
+                                    double *x, double *y, double *a, int count);
 
 // Function prototype for the action model; generates a sample pose from
 // an appropriate distribution
@@ -93,6 +100,11 @@ typedef struct _pf_sample_set_t
   int sample_count;
   pf_sample_t *samples;
 
+  // The sample poses as separate arrays of x, y and angle, for the updates
+  // that go over all the samples at once.  They are only valid between
+  // pf_sample_set_to_soa() and pf_sample_set_from_soa().
+  double *pose_x, *pose_y, *pose_a;
+
   // A kdtree encoding the histogram
   pf_kdtree_t *kdtree;
 
@@ -140,6 +152,15 @@ typedef struct _pf_t
 
   // boolean parameter to enamble/diable selective resampling
   int selective_resampling;
+
+  // The seconds that the last pf_update_resample() spent in
+  // pf_cluster_stats(), to profile the two apart
+  double cluster_time;
+
+  // Random number generator of the filter, for the initialization, action
+  // and resampling steps.  It is seeded from the time by pf_alloc(); seed
+  // it with pf_rng_seed() for repeatable runs.
+  pf_rng_t rng;
 } pf_t;
 
 
@@ -157,6 +178,9 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov);
 // Initialize the filter using some model
 void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data);
 
+// Initialize the filter using some batch model
+void pf_init_model_batch(pf_t *pf, pf_init_batch_fn_t init_fn, void *init_data);
+
 // Update the filter with some new action
 void pf_update_action(pf_t *pf, pf_action_model_fn_t action_fn, void *action_data);
 
@@ -180,6 +204,12 @@ int pf_get_cluster_stats(pf_t *pf, int cluster, double *weight,
 // Re-compute the cluster statistics for a sample set
 void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set);
 
+// Copy the sample poses to the pose_x, pose_y and pose_a arrays of the set
+void pf_sample_set_to_soa(pf_sample_set_t *set);
+
+// Copy the pose_x, pose_y and pose_a arrays of the set back to the samples
+void pf_sample_set_from_soa(pf_sample_set_t *set);
+
 
 // Display the sample set
 void pf_draw_samples(pf_t *pf, struct _rtk_fig_t *fig, int max_samples);
@@ -32,52 +32,52 @@
 #include "rtk.h"
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The histogram of the samples, used for the adaptive sample count and
+// for clustering.  It was a kd-tree; it is now a hash table of the bins,
+// which finds the bin of a pose in constant time, but it keeps the names of
+// the kd-tree.
 
-// Info for a node in the tree
+// Info for a bin of the histogram
 typedef struct pf_kdtree_node
 {
-  // Depth in the tree
-  int leaf, depth;
-
-  // Pivot dimension and value
-  int pivot_dim;
-  double pivot_value;
-
-  // The key for this node
+  // The key for this bin
   int key[3];
 
-  // The value for this node
+  // The value for this bin
   double value;
 
-  // The cluster label (leaf nodes)
+  // The cluster label
   int cluster;
 
-  // Child nodes
-  struct pf_kdtree_node *children[2];
-
 } pf_kdtree_node_t;
 
 
-// A kd tree
+// A histogram
 typedef struct
 {
   // Cell size
   double size[3];
 
-  // The root node of the tree
-  pf_kdtree_node_t *root;
-
-  // The number of nodes in the tree
+  // The bins, in the order they were created
   int node_count, node_max_count;
   pf_kdtree_node_t *nodes;
 
-  // The number of leaf nodes in the tree
+  // Open addressing hash table of the bins: the index of a bin in nodes, or
+  // -1 for an empty slot.  The size is a power of two.
+  int *table;
+  int table_mask;
+
+  // The number of bins
   int leaf_count;
 
 } pf_kdtree_t;
 
 
-// Create a tree
+// Create a tree with room for max_size bins
 extern pf_kdtree_t *pf_kdtree_alloc(int max_size);
 
 // Destroy a tree
@@ -106,4 +106,8 @@ extern void pf_kdtree_draw(pf_kdtree_t *self, rtk_fig_t *fig);
 
 #endif
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
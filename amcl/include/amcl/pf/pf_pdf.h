@@ -29,6 +29,7 @@
 #define PF_PDF_H
 
 #include "pf_vector.h"
+#include "pf_rng.h"
 
 //#include <gsl/gsl_rng.h>
 //#include <gsl/gsl_randist.h>
@@ -73,10 +74,10 @@ void pf_pdf_gaussian_free(pf_pdf_gaussian_t *pdf);
 // deviation sigma.
 // We use the polar form of the Box-Muller transformation, explained here:
 //   http://www.taygeta.com/random/gaussian.html
-double pf_ran_gaussian(double sigma);
+double pf_ran_gaussian(pf_rng_t *rng, double sigma);
 
 // Generate a sample from the pdf.
-pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf);
+pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf, pf_rng_t *rng);
 
 #ifdef __cplusplus
 }
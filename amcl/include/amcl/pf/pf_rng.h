@@ -0,0 +1,63 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Counter-based random number generator
+ *************************************************************************/
+
+#ifndef PF_RNG_H
+#define PF_RNG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A counter-based random number generator: the i-th number is a hash of
+// the seed and i, so that the numbers can be generated in any order, and
+// a whole array of them at once.  The same seed always gives the same
+// numbers.
+typedef struct
+{
+  uint64_t seed;
+
+  // The index of the next number
+  uint64_t counter;
+
+} pf_rng_t;
+
+// Seed the generator, and restart its sequence
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed);
+
+// Draw a number uniformly from [0, 1)
+double pf_rng_draw(pf_rng_t *rng);
+
+// Draw n numbers uniformly from [0, 1)
+void pf_rng_uniform(pf_rng_t *rng, double *u, int n);
+
+// Draw n numbers from a zero-mean Gaussian distribution with unit
+// standard deviation
+void pf_rng_gaussian(pf_rng_t *rng, double *z, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -29,7 +29,11 @@
 #ifndef AMCL_LASER_H
 #define AMCL_LASER_H
 
+#include <vector>
+#include <boost/function.hpp>
+
 #include "amcl_sensor.h"
+#include "../thread_pool.h"
 #include "../map/map.h"
 
 namespace amcl
@@ -94,6 +98,11 @@ class AMCLLaser : public AMCLSensor
   public: void SetLaserPose(pf_vector_t& laser_pose) 
           {this->laser_pose = laser_pose;}
 
+  // Set the threads used to weight the samples, NULL to weight them on the
+  // calling thread.  The pool is not owned by the laser.
+  public: void SetThreadPool(ThreadPool* thread_pool)
+          {this->thread_pool = thread_pool;}
+
   // Determine the probability for the given pose
   private: static double BeamModel(AMCLLaserData *data, 
                                    pf_sample_set_t* set);
@@ -105,6 +114,26 @@ class AMCLLaser : public AMCLSensor
   private: static double LikelihoodFieldModelProb(AMCLLaserData *data, 
 					     pf_sample_set_t* set);
 
+  // Weight the samples in [begin, end) with the matching model
+  private: static void BeamModelSamples(AMCLLaserData *data,
+                                        pf_sample_set_t* set, int begin, int end);
+  private: static void LikelihoodFieldModelSamples(AMCLLaserData *data,
+                                                   pf_sample_set_t* set, int begin, int end);
+  private: static void LikelihoodFieldModelProbSamples(AMCLLaserData *data,
+                                                       pf_sample_set_t* set, int begin, int end,
+                                                       int step, bool do_beamskip,
+                                                       int *chunk_obs_count, int chunk);
+
+  // The number of chunks to split the sample set into, 1 when weighting serially
+  private: int SampleChunkCount(int sample_count) const;
+
+  // Call fn(chunk, begin, end) for each chunk of the sample set, on the thread pool
+  private: void ForEachSampleChunk(int sample_count, int chunk_count,
+                                   const boost::function<void(int, int, int)>& fn);
+
+  // Precompute hit_probs for the likelihood field of the map
+  private: void UpdateHitProbs();
+
   private: void reallocTempData(int max_samples, int max_obs);
 
   private: laser_model_t model_type;
@@ -117,6 +146,9 @@ class AMCLLaser : public AMCLSensor
 
   // Laser offset relative to robot
   private: pf_vector_t laser_pose;
+
+  // Threads used to weight the samples
+  private: ThreadPool *thread_pool;
   
   // Max beams to consider
   private: int max_beams;
@@ -144,6 +176,9 @@ class AMCLLaser : public AMCLSensor
   //
   // Stddev of Gaussian model for laser hits.
   private: double sigma_hit;
+  // The z_hit part of the likelihood field models for each distance of the
+  // map's likelihood field (map_t::occ_dist_table)
+  private: std::vector<double> hit_probs;
   // Decay rate of exponential model for short readings.
   private: double lambda_short;
   // Threshold for outlier rejection (unused)
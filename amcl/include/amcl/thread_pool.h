@@ -0,0 +1,76 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Worker threads for AMCL
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef AMCL_THREAD_POOL_H
+#define AMCL_THREAD_POOL_H
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace amcl
+{
+
+// A fixed set of worker threads that runs batches of independent tasks.
+// The threads are created once and sleep between batches, so handing a
+// batch to the pool on every scan does not create any threads.
+class ThreadPool
+{
+  // Create the pool.  num_threads counts the thread calling Run() as well,
+  // so a value of 1 runs everything on the calling thread.
+  public: explicit ThreadPool(int num_threads);
+
+  // Stop and join the worker threads
+  public: ~ThreadPool();
+
+  // Call task(i) for every i in [0, num_tasks) and return once all of them
+  // have completed.  The calling thread takes part in the work, and the
+  // order in which the tasks run is unspecified.
+  public: void Run(int num_tasks, const boost::function<void(int)>& task);
+
+  public: int GetNumThreads() const {return num_threads;}
+
+  private: void WorkerLoop();
+
+  // Take tasks of the current batch until there are none left; the lock is
+  // held again when this returns
+  private: void RunTasks(boost::unique_lock<boost::mutex>& lock);
+
+  private: ThreadPool(const ThreadPool&);
+  private: ThreadPool& operator=(const ThreadPool&);
+
+  private: int num_threads;
+  private: boost::thread_group workers;
+
+  private: boost::mutex mutex;
+  private: boost::condition_variable work_cv, done_cv;
+  private: const boost::function<void(int)>* task;
+  private: int num_tasks, next_task, unfinished_tasks;
+  private: unsigned long batch;
+  private: bool shutdown;
+};
+
+}
+
+#endif
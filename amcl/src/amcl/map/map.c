@@ -31,6 +31,10 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifdef HAVE_UNISTD_H
+#include <sys/mman.h>
+#endif
+
 #include "amcl/map/map.h"
 
 
@@ -52,6 +56,27 @@ map_t *map_alloc(void)
   
   // Allocate storage for main map
   map->cells = (map_cell_t*) NULL;
+
+  // The likelihood field is computed by map_update_cspace()
+  map->max_occ_dist = 0;
+  map->occ_dist_field = (uint16_t*) NULL;
+  map->occ_dist_table = (double*) NULL;
+  map->occ_dist_table_size = 0;
+  map->occ_dist_mapping = NULL;
+  map->occ_dist_mapping_size = 0;
+
+  // The range field is computed by map_update_range_field()
+  map->range_field = (uint8_t*) NULL;
+  map->range_field_mapping = NULL;
+  map->range_field_mapping_size = 0;
+
+  // The cells to sample poses from are found by map_update_sample_cells()
+  map->sample_bits = (uint64_t*) NULL;
+  map->sample_rank = (uint32_t*) NULL;
+  map->sample_select = (uint32_t*) NULL;
+  map->sample_weight = (double*) NULL;
+  map->sample_word_count = 0;
+  map->sample_cell_count = 0;
   
   return map;
 }
@@ -61,11 +86,47 @@ map_t *map_alloc(void)
 void map_free(map_t *map)
 {
   free(map->cells);
+  map_free_cspace(map);
+  map_free_range_field(map);
+  map_free_sample_cells(map);
   free(map);
   return;
 }
 
 
+// Release the cspace distances
+void map_free_cspace(map_t *map)
+{
+#ifdef HAVE_UNISTD_H
+  if (map->occ_dist_mapping != NULL)
+    munmap(map->occ_dist_mapping, map->occ_dist_mapping_size);
+  else
+#endif
+    free(map->occ_dist_field);
+  free(map->occ_dist_table);
+  map->occ_dist_mapping = NULL;
+  map->occ_dist_mapping_size = 0;
+  map->occ_dist_field = NULL;
+  map->occ_dist_table = NULL;
+  map->occ_dist_table_size = 0;
+}
+
+
+// Release the range field
+void map_free_range_field(map_t *map)
+{
+#ifdef HAVE_UNISTD_H
+  if (map->range_field_mapping != NULL)
+    munmap(map->range_field_mapping, map->range_field_mapping_size);
+  else
+#endif
+    free(map->range_field);
+  map->range_field_mapping = NULL;
+  map->range_field_mapping_size = 0;
+  map->range_field = NULL;
+}
+
+
 // Get the cell at the given point
 map_cell_t *map_get_cell(map_t *map, double ox, double oy, double oa)
 {
@@ -19,158 +19,214 @@
  *
  */
 
-#include <queue>
+#include <algorithm>
+#include <vector>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include "amcl/map/map.h"
+#include "amcl/thread_pool.h"
+
+// The cspace distances are an exact Euclidean distance transform of the
+// occupied cells (Felzenszwalb & Huttenlocher, "Distance Transforms of
+// Sampled Functions").  A pass over the columns finds the distance to the
+// nearest occupied cell in the same column, and a pass over the rows then
+// takes the lower envelope of the parabolas rooted at each cell of the row.
+// Both passes are split into stripes that run on a pool of threads, which
+// is created on the first update and kept for the later ones.
+
+// Build the table of distances for map_t::occ_dist_table, and the code of
+// each squared distance in cells up to cell_radius^2.  A code is the rank
+// of the squared distance among all the squared distances within the
+// radius, which keeps the distances exact up to a radius of about 500
+// cells.  Beyond that, the nearest distances keep their own codes and the
+// farthest ones share theirs with their neighbours; each code stands for the
+// smallest of its distances.
+static void build_occ_dist_table(map_t *map, int cell_radius, std::vector<uint16_t>& codes)
+{
+  int max_sq = cell_radius * cell_radius;
+  std::vector<char> is_sum(max_sq + 1, 0);
+  for(int i=0; i<=cell_radius; i++)
+    for(int j=i; j<=cell_radius && i*i + j*j <= max_sq; j++)
+      is_sum[i*i + j*j] = 1;
+  std::vector<int> squares;
+  for(int sq=0; sq<=max_sq; sq++)
+    if(is_sum[sq])
+      squares.push_back(sq);
+
+  int count = squares.size();
+  int max_codes = 65535;
+  int table_size = std::min(count, max_codes) + 1;
+
+  // The table is allocated with malloc, as it is released by map_free()
+  map->occ_dist_table_size = table_size;
+  map->occ_dist_table = (double*) realloc(map->occ_dist_table, sizeof(double) * table_size);
+
+  // The ranks below exact are their own code, the others are spread evenly
+  // over the codes that are left
+  int exact = std::max(max_codes / 2, 2 * max_codes - count);
+  codes.assign(max_sq + 1, table_size - 1);
+  for(int r=count-1; r>=0; r--)
+  {
+    int code = r;
+    if(r >= exact)
+      code = exact + (long)(r - exact) * (table_size - 1 - exact) / (count - exact);
+    codes[squares[r]] = code;
+    map->occ_dist_table[code] = sqrt(squares[r]) * map->scale;
+  }
+  map->occ_dist_table[table_size-1] = map->max_occ_dist;
+}
 
-class CellData
+// For the columns in [begin, end), the distance to the nearest occupied cell
+// in the same column, capped at cap
+static void column_distances(const map_t *map, int cap, int *column_dist,
+                             int begin, int end)
 {
-  public:
-    map_t* map_;
-    unsigned int i_, j_;
-    unsigned int src_i_, src_j_;
-};
+  int size_x = map->size_x;
+
+  // Downwards, then upwards, one row at a time to stay in the cache
+  for(int i=begin; i<end; i++)
+    column_dist[i] = (map->cells[i].occ_state == +1) ? 0 : cap;
+  for(int j=1; j<map->size_y; j++)
+  {
+    const map_cell_t *cells = map->cells + j * size_x;
+    int *dist = column_dist + j * size_x;
+    const int *prev = dist - size_x;
+    for(int i=begin; i<end; i++)
+      dist[i] = (cells[i].occ_state == +1) ? 0 : std::min(prev[i] + 1, cap);
+  }
+  for(int j=map->size_y-2; j>=0; j--)
+  {
+    int *dist = column_dist + j * size_x;
+    const int *next = dist + size_x;
+    for(int i=begin; i<end; i++)
+      dist[i] = std::min(dist[i], next[i] + 1);
+  }
+}
 
-class CachedDistanceMap
+// For the rows in [begin, end), the code of the squared distance to the
+// nearest occupied cell, from the column distances
+static void row_distances(map_t *map, int cap, const int *column_dist,
+                          const std::vector<uint16_t>* codes, int begin, int end)
 {
-  public:
-    CachedDistanceMap(double scale, double max_dist) : 
-      distances_(NULL), scale_(scale), max_dist_(max_dist) 
+  int size_x = map->size_x;
+  int max_sq = codes->size() - 1;
+  uint16_t max_code = map->occ_dist_table_size - 1;
+
+  // The lower envelope: parabola k is rooted at column v[k] and is the lowest
+  // one between z[k] and z[k+1]
+  std::vector<int> v(size_x);
+  std::vector<double> z(size_x + 1);
+
+  for(int j=begin; j<end; j++)
+  {
+    const int *f = column_dist + j * size_x;
+    uint16_t *field = map->occ_dist_field + j * size_x;
+
+    // Columns at the cap have no occupied cell within the radius; they can
+    // only give distances beyond it, so they are left out of the envelope
+    int k = -1;
+    for(int q=0; q<size_x; q++)
     {
-      cell_radius_ = max_dist / scale;
-      distances_ = new double *[cell_radius_+2];
-      for(int i=0; i<=cell_radius_+1; i++)
+      if(f[q] >= cap)
+        continue;
+      double fq = (double)f[q] * f[q] + (double)q * q;
+      while(k >= 0)
       {
-	distances_[i] = new double[cell_radius_+2];
-        for(int j=0; j<=cell_radius_+1; j++)
-	{
-	  distances_[i][j] = sqrt(i*i + j*j);
-	}
+        double s = (fq - ((double)f[v[k]] * f[v[k]] + (double)v[k] * v[k])) / (2.0 * (q - v[k]));
+        if(s > z[k])
+        {
+          k++;
+          v[k] = q;
+          z[k] = s;
+          break;
+        }
+        k--;
       }
-    }
-    ~CachedDistanceMap()
-    {
-      if(distances_)
+      if(k < 0)
       {
-	for(int i=0; i<=cell_radius_+1; i++)
-	  delete[] distances_[i];
-	delete[] distances_;
+        k = 0;
+        v[0] = q;
+        z[0] = -HUGE_VAL;
       }
+      z[k+1] = HUGE_VAL;
     }
-    double** distances_;
-    double scale_;
-    double max_dist_;
-    int cell_radius_;
-};
 
+    if(k < 0)
+    {
+      for(int q=0; q<size_x; q++)
+        field[q] = max_code;
+      continue;
+    }
 
-bool operator<(const CellData& a, const CellData& b)
-{
-  return a.map_->cells[MAP_INDEX(a.map_, a.i_, a.j_)].occ_dist > a.map_->cells[MAP_INDEX(b.map_, b.i_, b.j_)].occ_dist;
+    int n = 0;
+    for(int q=0; q<size_x; q++)
+    {
+      while(z[n+1] < q)
+        n++;
+      long dx = q - v[n];
+      long sq = dx * dx + (long)f[v[n]] * f[v[n]];
+      field[q] = (sq <= max_sq) ? (*codes)[sq] : max_code;
+    }
+  }
 }
 
-CachedDistanceMap*
-get_distance_map(double scale, double max_dist)
+// The pool shared by all the updates, which take turns using it
+static boost::mutex cspace_thread_pool_mutex;
+static amcl::ThreadPool& cspace_thread_pool()
 {
-  static CachedDistanceMap* cdm = NULL;
-
-  if(!cdm || (cdm->scale_ != scale) || (cdm->max_dist_ != max_dist))
-  {
-    if(cdm)
-      delete cdm;
-    cdm = new CachedDistanceMap(scale, max_dist);
-  }
-
-  return cdm;
+  static amcl::ThreadPool pool(boost::thread::hardware_concurrency());
+  return pool;
 }
 
-void enqueue(map_t* map, int i, int j,
-	     int src_i, int src_j,
-	     std::priority_queue<CellData>& Q,
-	     CachedDistanceMap* cdm,
-	     unsigned char* marked)
+// The column distances of the stripe-th of stripes parts of the columns
+static void column_stripe(const map_t *map, int cap, int *column_dist, int stripes, int stripe)
 {
-  if(marked[MAP_INDEX(map, i, j)])
-    return;
-
-  int di = abs(i - src_i);
-  int dj = abs(j - src_j);
-  double distance = cdm->distances_[di][dj];
-
-  if(distance > cdm->cell_radius_)
-    return;
-
-  map->cells[MAP_INDEX(map, i, j)].occ_dist = distance * map->scale;
-
-  CellData cell;
-  cell.map_ = map;
-  cell.i_ = i;
-  cell.j_ = j;
-  cell.src_i_ = src_i;
-  cell.src_j_ = src_j;
-
-  Q.push(cell);
+  column_distances(map, cap, column_dist, (long)map->size_x * stripe / stripes,
+                   (long)map->size_x * (stripe + 1) / stripes);
+}
 
-  marked[MAP_INDEX(map, i, j)] = 1;
+// The row distances of the stripe-th of stripes parts of the rows
+static void row_stripe(map_t *map, int cap, const int *column_dist, const std::vector<uint16_t>* codes,
+                       int stripes, int stripe)
+{
+  row_distances(map, cap, column_dist, codes, (long)map->size_y * stripe / stripes,
+                (long)map->size_y * (stripe + 1) / stripes);
 }
 
 // Update the cspace distance values
 void map_update_cspace(map_t *map, double max_occ_dist)
 {
-  unsigned char* marked;
-  std::priority_queue<CellData> Q;
-
-  marked = new unsigned char[map->size_x*map->size_y];
-  memset(marked, 0, sizeof(unsigned char) * map->size_x*map->size_y);
+  // A field loaded by map_load_cspace() is read-only
+  if(map->occ_dist_mapping != NULL)
+    map_free_cspace(map);
 
   map->max_occ_dist = max_occ_dist;
 
-  CachedDistanceMap* cdm = get_distance_map(map->scale, map->max_occ_dist);
+  int cell_radius = max_occ_dist / map->scale;
+  std::vector<uint16_t> codes;
+  build_occ_dist_table(map, cell_radius, codes);
 
-  // Enqueue all the obstacle cells
-  CellData cell;
-  cell.map_ = map;
-  for(int i=0; i<map->size_x; i++)
-  {
-    cell.src_i_ = cell.i_ = i;
-    for(int j=0; j<map->size_y; j++)
-    {
-      if(map->cells[MAP_INDEX(map, i, j)].occ_state == +1)
-      {
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = 0.0;
-	cell.src_j_ = cell.j_ = j;
-	marked[MAP_INDEX(map, i, j)] = 1;
-	Q.push(cell);
-      }
-      else
-	map->cells[MAP_INDEX(map, i, j)].occ_dist = max_occ_dist;
-    }
-  }
+  // The field is allocated with malloc, as it is released by map_free()
+  int cell_count = map->size_x * map->size_y;
+  map->occ_dist_field = (uint16_t*) realloc(map->occ_dist_field,
+                                            sizeof(uint16_t) * cell_count);
+  if(cell_count == 0)
+    return;
 
-  while(!Q.empty())
-  {
-    CellData current_cell = Q.top();
-    if(current_cell.i_ > 0)
-      enqueue(map, current_cell.i_-1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if(current_cell.j_ > 0)
-      enqueue(map, current_cell.i_, current_cell.j_-1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.i_ < map->size_x - 1)
-      enqueue(map, current_cell.i_+1, current_cell.j_, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-    if((int)current_cell.j_ < map->size_y - 1)
-      enqueue(map, current_cell.i_, current_cell.j_+1, 
-	      current_cell.src_i_, current_cell.src_j_,
-	      Q, cdm, marked);
-
-    Q.pop();
-  }
+  // Column distances beyond the radius do not matter, capping them keeps
+  // the squares small
+  int cap = cell_radius + 1;
+  std::vector<int> column_dist(cell_count);
+
+  boost::mutex::scoped_lock lock(cspace_thread_pool_mutex);
+  amcl::ThreadPool& pool = cspace_thread_pool();
+  int stripes = pool.GetNumThreads();
+  stripes = std::min(stripes, std::max(1, std::min(map->size_x, map->size_y) / 64));
 
-  delete[] marked;
+  pool.Run(stripes, boost::bind(&column_stripe, map, cap, &column_dist[0], stripes, _1));
+  pool.Run(stripes, boost::bind(&row_stripe, map, cap, &column_dist[0], &codes, stripes, _1));
 }
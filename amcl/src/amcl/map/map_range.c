@@ -118,3 +118,145 @@ double map_calc_range(map_t *map, double ox, double oy, double oa, double max_ra
   }
   return max_range;
 }
+
+static int min_int(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+// The range field at cell (i, j), which is 0 beyond the edge of the map
+static int range_field_at(map_t *map, int i, int j)
+{
+  if(!MAP_VALID(map, i, j))
+    return 0;
+  return map->range_field[MAP_INDEX(map, i, j)];
+}
+
+// Update the range field.  Two passes over the map find the chessboard
+// distance to the nearest cell that stops a ray: the first through the
+// neighbors below and to the left of each cell, the second through those
+// above and to the right.
+void map_update_range_field(map_t *map)
+{
+  int i, j, d;
+  uint8_t *field;
+
+  map_free_range_field(map);
+  map->range_field = (uint8_t*) malloc((size_t) map->size_x * map->size_y);
+  field = map->range_field;
+
+  for(j = 0; j < map->size_y; j++)
+  {
+    for(i = 0; i < map->size_x; i++)
+    {
+      if(map->cells[MAP_INDEX(map, i, j)].occ_state > -1)
+      {
+        field[MAP_INDEX(map, i, j)] = 0;
+        continue;
+      }
+      d = range_field_at(map, i - 1, j);
+      d = min_int(d, range_field_at(map, i - 1, j - 1));
+      d = min_int(d, range_field_at(map, i, j - 1));
+      d = min_int(d, range_field_at(map, i + 1, j - 1));
+      field[MAP_INDEX(map, i, j)] = (uint8_t) min_int(d + 1, MAP_RANGE_FIELD_MAX);
+    }
+  }
+
+  for(j = map->size_y - 1; j >= 0; j--)
+  {
+    for(i = map->size_x - 1; i >= 0; i--)
+    {
+      d = field[MAP_INDEX(map, i, j)];
+      if(d == 0)
+        continue;
+      d = min_int(d, range_field_at(map, i + 1, j) + 1);
+      d = min_int(d, range_field_at(map, i + 1, j + 1) + 1);
+      d = min_int(d, range_field_at(map, i, j + 1) + 1);
+      d = min_int(d, range_field_at(map, i - 1, j + 1) + 1);
+      field[MAP_INDEX(map, i, j)] = (uint8_t) d;
+    }
+  }
+}
+
+// Extract a single range reading from the map using the range field.  The
+// ray visits the cells of map_calc_range(), whose k-th cell is k cells along
+// the major axis and floor((2 k deltay + deltax) / (2 deltax)) along the
+// minor one.  It is also k cells away in chessboard distance, so a cell at
+// distance d from anything that stops the ray is followed by at least d - 1
+// free cells, which are skipped.  The cost is still one step per skip, and
+// the skips shrink to a cell as the ray nears a wall or runs along one.
+double map_lookup_range(map_t *map, double ox, double oy, double oa, double max_range)
+{
+  int x0,x1,y0,y1;
+  int x,y;
+  int xstep, ystep;
+  char steep;
+  int tmp, d, jump;
+  long deltax, deltay, error, ysteps, k;
+
+  x0 = MAP_GXWX(map,ox);
+  y0 = MAP_GYWY(map,oy);
+
+  x1 = MAP_GXWX(map,ox + max_range * cos(oa));
+  y1 = MAP_GYWY(map,oy + max_range * sin(oa));
+
+  if(abs(y1-y0) > abs(x1-x0))
+    steep = 1;
+  else
+    steep = 0;
+
+  if(steep)
+  {
+    tmp = x0;
+    x0 = y0;
+    y0 = tmp;
+
+    tmp = x1;
+    x1 = y1;
+    y1 = tmp;
+  }
+
+  deltax = abs(x1-x0);
+  deltay = abs(y1-y0);
+
+  // A ray within one cell takes a sideways step in map_calc_range()
+  if(deltax == 0)
+    return map_calc_range(map, ox, oy, oa, max_range);
+
+  if(x0 < x1)
+    xstep = 1;
+  else
+    xstep = -1;
+  if(y0 < y1)
+    ystep = 1;
+  else
+    ystep = -1;
+
+  // Like map_calc_range(), check one cell past the end of the ray.  The
+  // error is 2 k deltay + deltax, less 2 deltax for each step along y.
+  x = x0;
+  y = y0;
+  k = 0;
+  error = deltax;
+  while(k <= deltax + 1)
+  {
+    if(steep)
+      d = range_field_at(map, y, x);
+    else
+      d = range_field_at(map, x, y);
+    if(d == 0)
+      return sqrt((x-x0)*(x-x0) + (y-y0)*(y-y0)) * map->scale;
+
+    jump = (d > 1) ? d - 1 : 1;
+    k += jump;
+    x += xstep * jump;
+    error += 2 * jump * deltay;
+    if(error >= 2 * deltax)
+    {
+      ysteps = error / (2 * deltax);
+      y += ystep * (int) ysteps;
+      error -= ysteps * 2 * deltax;
+    }
+  }
+  return max_range;
+}
@@ -0,0 +1,286 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Sampling poses from the free cells of a map
+ *************************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "amcl/map/map.h"
+
+// The cells to sample from are a bitmap with one bit per cell, in the order
+// of the cells of the map.  With the number of cells before each 64 bit word
+// of the bitmap, the k-th cell is found with a binary search over the words
+// and a search within one word, which takes 1.5 bits per cell instead of the
+// 32 or 64 bits of a list of the cells.  The binary search is narrowed down
+// to the words between those of every MAP_SAMPLE_SELECT_CELLS-th cell, which
+// keeps it within a cache line or two of ranks on most maps.  Weighted
+// sampling adds the total weight of the cells before each word, and finds
+// the cell within its word by adding up the weights of the cells of the
+// word.
+
+#define MAP_SAMPLE_WORD_BITS 64
+
+// The number of set bits in a word
+static int map_sample_count_bits(uint64_t word)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(word);
+#else
+  int count = 0;
+  for (; word != 0; word &= word - 1)
+    count++;
+  return count;
+#endif
+}
+
+// The position of the k-th set bit of a word, counting from 0
+static int map_sample_select_bit(uint64_t word, int k)
+{
+  int bit;
+
+  for (; k > 0; k--)
+    word &= word - 1;
+  for (bit = 0; (word & 1) == 0; bit++)
+    word >>= 1;
+  return bit;
+}
+
+// The weight of a cell for weighted sampling: its distance to the nearest
+// occupied cell
+static double map_sample_weight(map_t *map, int cell)
+{
+  return MAP_OCC_DIST(map, cell);
+}
+
+// Limit the cells of row j to the parts of the row inside the polygon.  The
+// cells whose centers are between each pair of crossings of the row by the
+// edges of the polygon are kept; the others are cleared from the bitmap.
+static void map_sample_clip_row(map_t *map, int j, const double *polygon,
+                                int polygon_count, double *crossings)
+{
+  int a, b, k, n, i, begin, end;
+  double y, xa, ya, xb, yb, tmp;
+  size_t cell;
+  uint64_t *bits;
+
+  y = MAP_WYGY(map, j);
+  n = 0;
+  for (a = 0; a < polygon_count; a++)
+  {
+    b = (a + 1) % polygon_count;
+    xa = polygon[2 * a];
+    ya = polygon[2 * a + 1];
+    xb = polygon[2 * b];
+    yb = polygon[2 * b + 1];
+    // Half-open in y, so that a vertex on the row is counted once
+    if ((ya <= y && y < yb) || (yb <= y && y < ya))
+    {
+      crossings[n] = xa + (y - ya) * (xb - xa) / (yb - ya);
+      // Insertion sort; polygons have few edges
+      for (k = n; k > 0 && crossings[k - 1] > crossings[k]; k--)
+      {
+        tmp = crossings[k];
+        crossings[k] = crossings[k - 1];
+        crossings[k - 1] = tmp;
+      }
+      n++;
+    }
+  }
+
+  // Clear the cells outside the intervals [crossings[2k], crossings[2k+1]).
+  // A closed polygon always crosses the row an even number of times.
+  n &= ~1;
+  bits = map->sample_bits;
+  i = 0;
+  for (k = 0; k <= n; k += 2)
+  {
+    if (k < n)
+    {
+      begin = (int) ceil((crossings[k] - map->origin_x) / map->scale + map->size_x / 2);
+      begin = begin < 0 ? 0 : (begin > map->size_x ? map->size_x : begin);
+    }
+    else
+      begin = map->size_x;
+    for (; i < begin; i++)
+    {
+      cell = (size_t) MAP_INDEX(map, i, j);
+      bits[cell / MAP_SAMPLE_WORD_BITS] &= ~((uint64_t) 1 << (cell % MAP_SAMPLE_WORD_BITS));
+    }
+    if (k < n)
+    {
+      end = (int) ceil((crossings[k + 1] - map->origin_x) / map->scale + map->size_x / 2);
+      i = end < begin ? begin : (end > map->size_x ? map->size_x : end);
+    }
+  }
+}
+
+// Build the set of cells to sample from
+void map_update_sample_cells(map_t *map, const double *polygon, int polygon_count, int weighted)
+{
+  size_t cell_count, word_count, cell, w;
+  int j, bit;
+  uint32_t k;
+  uint64_t word;
+  double *crossings;
+
+  map_free_sample_cells(map);
+
+  cell_count = (size_t) map->size_x * map->size_y;
+  word_count = (cell_count + MAP_SAMPLE_WORD_BITS - 1) / MAP_SAMPLE_WORD_BITS;
+  map->sample_bits = calloc(word_count + 1, sizeof(uint64_t));
+  map->sample_rank = malloc((word_count + 1) * sizeof(uint32_t));
+
+  // The free cells
+  for (cell = 0; cell < cell_count; cell++)
+    if (map->cells[cell].occ_state == -1)
+      map->sample_bits[cell / MAP_SAMPLE_WORD_BITS] |= (uint64_t) 1 << (cell % MAP_SAMPLE_WORD_BITS);
+
+  // Inside the polygon
+  if (polygon_count >= 3)
+  {
+    crossings = malloc(polygon_count * sizeof(double));
+    for (j = 0; j < map->size_y; j++)
+      map_sample_clip_row(map, j, polygon, polygon_count, crossings);
+    free(crossings);
+  }
+
+  map->sample_rank[0] = 0;
+  for (w = 0; w < word_count; w++)
+    map->sample_rank[w + 1] = map->sample_rank[w] + map_sample_count_bits(map->sample_bits[w]);
+  map->sample_cell_count = map->sample_rank[word_count];
+  map->sample_word_count = word_count;
+
+  // The word of every MAP_SAMPLE_SELECT_CELLS-th cell, and the end of the
+  // words after the last one
+  map->sample_select = malloc((map->sample_cell_count / MAP_SAMPLE_SELECT_CELLS + 2) * sizeof(uint32_t));
+  k = 0;
+  for (w = 0; w < word_count; w++)
+    for (; k * MAP_SAMPLE_SELECT_CELLS < map->sample_rank[w + 1]; k++)
+      map->sample_select[k] = w;
+  map->sample_select[k] = word_count;
+
+  if (weighted && map->occ_dist_field != NULL)
+  {
+    map->sample_weight = malloc((word_count + 1) * sizeof(double));
+    map->sample_weight[0] = 0.0;
+    for (w = 0; w < word_count; w++)
+    {
+      map->sample_weight[w + 1] = map->sample_weight[w];
+      for (word = map->sample_bits[w]; word != 0; word &= word - 1)
+      {
+        bit = map_sample_select_bit(word, 0);
+        map->sample_weight[w + 1] += map_sample_weight(map, w * MAP_SAMPLE_WORD_BITS + bit);
+      }
+    }
+    // Sample uniformly if there is no weight to sample by
+    if (!(map->sample_weight[word_count] > 0.0))
+    {
+      free(map->sample_weight);
+      map->sample_weight = NULL;
+    }
+  }
+}
+
+// Release the set of cells to sample from
+void map_free_sample_cells(map_t *map)
+{
+  free(map->sample_bits);
+  free(map->sample_rank);
+  free(map->sample_select);
+  free(map->sample_weight);
+  map->sample_bits = NULL;
+  map->sample_rank = NULL;
+  map->sample_select = NULL;
+  map->sample_weight = NULL;
+  map->sample_cell_count = 0;
+  map->sample_word_count = 0;
+}
+
+// Draw cells from the set of cells to sample from
+void map_sample_cells(map_t *map, const double *u, int *cells, int n)
+{
+  int i, bit;
+  size_t lo, hi, mid;
+  double target, total;
+  uint64_t word;
+  uint32_t k;
+
+  for (i = 0; i < n; i++)
+  {
+    if (map->sample_cell_count == 0)
+    {
+      cells[i] = -1;
+      continue;
+    }
+
+    // The word of the drawn cell, or of the drawn weight: the last one whose
+    // cells start at or before it, which is never an empty word
+    lo = 0;
+    hi = map->sample_word_count;
+    if (map->sample_weight == NULL)
+    {
+      k = (uint32_t) (u[i] * map->sample_cell_count);
+      if (k >= (uint32_t) map->sample_cell_count)
+        k = map->sample_cell_count - 1;
+      lo = map->sample_select[k / MAP_SAMPLE_SELECT_CELLS];
+      hi = map->sample_select[k / MAP_SAMPLE_SELECT_CELLS + 1] + 1;
+      if (hi > map->sample_word_count)
+        hi = map->sample_word_count;
+      while (hi - lo > 1)
+      {
+        mid = (lo + hi) / 2;
+        if (map->sample_rank[mid] <= k)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      bit = map_sample_select_bit(map->sample_bits[lo], k - map->sample_rank[lo]);
+    }
+    else
+    {
+      total = map->sample_weight[map->sample_word_count];
+      target = u[i] * total;
+      while (hi - lo > 1)
+      {
+        mid = (lo + hi) / 2;
+        if (map->sample_weight[mid] <= target)
+          lo = mid;
+        else
+          hi = mid;
+      }
+
+      // The cell of the word under the drawn weight, or the last cell of the
+      // word if rounding leaves the weight beyond it
+      target -= map->sample_weight[lo];
+      bit = 0;
+      for (word = map->sample_bits[lo]; word != 0; word &= word - 1)
+      {
+        bit = map_sample_select_bit(word, 0);
+        target -= map_sample_weight(map, lo * MAP_SAMPLE_WORD_BITS + bit);
+        if (target < 0)
+          break;
+      }
+    }
+    cells[i] = lo * MAP_SAMPLE_WORD_BITS + bit;
+  }
+}
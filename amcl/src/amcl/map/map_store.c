@@ -30,6 +30,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "amcl/map/map.h"
 
@@ -212,4 +218,283 @@ int map_load_wifi(map_t *map, const char *filename, int index)
 */
 
 
+////////////////////////////////////////////////////////////////////////////
+// Read the block of size bytes at the end of a file of file_size bytes,
+// which must be the next thing in the file.  The file is mapped rather than
+// read where possible, so that only the pages that are used get read; the
+// mapping is returned in mapping, or NULL when the block was read with
+// malloc.  Returns the block, or NULL on failure.
+static void *load_block(FILE *file, size_t file_size, size_t size,
+                        void **mapping, size_t *mapping_size)
+{
+  void *block;
+
+  *mapping = NULL;
+  *mapping_size = 0;
+
+#ifdef HAVE_UNISTD_H
+  {
+    struct stat st;
+    void *region;
+    if (fstat(fileno(file), &st) != 0 || (size_t) st.st_size != file_size)
+      return NULL;
+    region = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (region == MAP_FAILED)
+      return NULL;
+    *mapping = region;
+    *mapping_size = file_size;
+    block = (char*) region + file_size - size;
+  }
+#else
+  (void) file_size;
+  block = malloc(size);
+  if (fread(block, 1, size, file) != size)
+  {
+    free(block);
+    return NULL;
+  }
+#endif
+
+  return block;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Write the given blocks to a file.  The blocks are written to a temporary
+// file first, so that a reader never sees half a file.  Returns 0 on success.
+static int save_blocks(const char *filename, int count, const void **blocks, const size_t *sizes)
+{
+  FILE *file;
+  char *tmp_filename;
+  int i, ok;
+
+  tmp_filename = malloc(strlen(filename) + 16);
+#ifdef HAVE_UNISTD_H
+  sprintf(tmp_filename, "%s.tmp%d", filename, (int) getpid());
+#else
+  sprintf(tmp_filename, "%s.tmp", filename);
+#endif
+  file = fopen(tmp_filename, "wb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), tmp_filename);
+    free(tmp_filename);
+    return -1;
+  }
+
+  ok = 1;
+  for (i = 0; i < count && ok; i++)
+    ok = fwrite(blocks[i], 1, sizes[i], file) == sizes[i];
+  ok = (fclose(file) == 0) && ok;
 
+  if (!ok || rename(tmp_filename, filename) != 0)
+  {
+    fprintf(stderr, "%s: %s\n", strerror(errno), filename);
+    remove(tmp_filename);
+    free(tmp_filename);
+    return -1;
+  }
+
+  free(tmp_filename);
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// The header of a saved cspace, followed by the distance table and the field
+typedef struct
+{
+  char magic[8];
+  uint64_t key;
+  int32_t size_x, size_y;
+  double scale;
+  double max_occ_dist;
+  int32_t table_size, reserved;
+} map_cspace_header_t;
+
+static const char map_cspace_magic[8] = {'A', 'M', 'C', 'L', 'C', 'S', 'P', '1'};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Load the cspace distances saved by map_save_cspace()
+int map_load_cspace(map_t *map, const char *filename, double max_occ_dist, uint64_t key)
+{
+  FILE *file;
+  map_cspace_header_t header;
+  size_t field_size, file_size, mapping_size;
+  double *table;
+  void *field, *mapping;
+
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    return -1;
+
+  // The file must have been saved for this map and these parameters
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, map_cspace_magic, sizeof(header.magic)) != 0 ||
+      header.key != key ||
+      header.size_x != map->size_x || header.size_y != map->size_y ||
+      header.scale != map->scale || header.max_occ_dist != max_occ_dist ||
+      header.table_size < 1 || header.table_size > 65536)
+  {
+    fclose(file);
+    return -1;
+  }
+
+  table = malloc(sizeof(double) * header.table_size);
+  if (fread(table, sizeof(double), header.table_size, file) != (size_t) header.table_size)
+  {
+    free(table);
+    fclose(file);
+    return -1;
+  }
+
+  field_size = sizeof(uint16_t) * map->size_x * map->size_y;
+  file_size = sizeof(header) + sizeof(double) * header.table_size + field_size;
+  field = load_block(file, file_size, field_size, &mapping, &mapping_size);
+  fclose(file);
+  if (field == NULL)
+  {
+    free(table);
+    return -1;
+  }
+
+  map_free_cspace(map);
+  map->occ_dist_mapping = mapping;
+  map->occ_dist_mapping_size = mapping_size;
+  map->occ_dist_field = field;
+  map->occ_dist_table = table;
+  map->occ_dist_table_size = header.table_size;
+  map->max_occ_dist = max_occ_dist;
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Save the cspace distances
+int map_save_cspace(map_t *map, const char *filename, uint64_t key)
+{
+  map_cspace_header_t header;
+  const void *blocks[3];
+  size_t sizes[3];
+
+  if (map->occ_dist_field == NULL)
+    return -1;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_cspace_magic, sizeof(header.magic));
+  header.key = key;
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+  header.max_occ_dist = map->max_occ_dist;
+  header.table_size = map->occ_dist_table_size;
+
+  blocks[0] = &header;
+  sizes[0] = sizeof(header);
+  blocks[1] = map->occ_dist_table;
+  sizes[1] = sizeof(double) * header.table_size;
+  blocks[2] = map->occ_dist_field;
+  sizes[2] = sizeof(uint16_t) * map->size_x * map->size_y;
+  return save_blocks(filename, 3, blocks, sizes);
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// The header of a saved range field, followed by the field
+typedef struct
+{
+  char magic[8];
+  uint64_t key;
+  int32_t size_x, size_y;
+  double scale;
+} map_range_field_header_t;
+
+static const char map_range_field_magic[8] = {'A', 'M', 'C', 'L', 'R', 'N', 'G', '2'};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Load the range field saved by map_save_range_field()
+int map_load_range_field(map_t *map, const char *filename, uint64_t key)
+{
+  FILE *file;
+  map_range_field_header_t header;
+  size_t field_size, mapping_size;
+  uint8_t *field;
+  void *mapping;
+  int i, cell_count;
+
+  file = fopen(filename, "rb");
+  if (file == NULL)
+    return -1;
+
+  // The file must have been saved for this map
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, map_range_field_magic, sizeof(header.magic)) != 0 ||
+      header.key != key ||
+      header.size_x != map->size_x || header.size_y != map->size_y ||
+      header.scale != map->scale)
+  {
+    fclose(file);
+    return -1;
+  }
+
+  cell_count = map->size_x * map->size_y;
+  field_size = (size_t) cell_count;
+  field = load_block(file, sizeof(header) + field_size, field_size, &mapping, &mapping_size);
+  fclose(file);
+  if (field == NULL)
+    return -1;
+
+  // map_lookup_range() stops rays on the cells where the field is 0, so
+  // those must be the cells that are not free
+  for (i = 0; i < cell_count; i++)
+  {
+    if ((field[i] == 0) != (map->cells[i].occ_state > -1))
+      break;
+  }
+  if (i < cell_count)
+  {
+#ifdef HAVE_UNISTD_H
+    if (mapping != NULL)
+      munmap(mapping, mapping_size);
+    else
+#endif
+      free(field);
+    return -1;
+  }
+
+  map_free_range_field(map);
+  map->range_field_mapping = mapping;
+  map->range_field_mapping_size = mapping_size;
+  map->range_field = field;
+
+  return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Save the range field
+int map_save_range_field(map_t *map, const char *filename, uint64_t key)
+{
+  map_range_field_header_t header;
+  const void *blocks[2];
+  size_t sizes[2];
+
+  if (map->range_field == NULL)
+    return -1;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, map_range_field_magic, sizeof(header.magic));
+  header.key = key;
+  header.size_x = map->size_x;
+  header.size_y = map->size_y;
+  header.scale = map->scale;
+
+  blocks[0] = &header;
+  sizes[0] = sizeof(header);
+  blocks[1] = map->range_field;
+  sizes[1] = (size_t) map->size_x * map->size_y;
+  return save_blocks(filename, 2, blocks, sizes);
+}
@@ -33,13 +33,15 @@
 #include "amcl/pf/pf.h"
 #include "amcl/pf/pf_pdf.h"
 #include "amcl/pf/pf_kdtree.h"
-#include "portable_utils.hpp"
 
 
 // Compute the required number of samples, given that there are k bins
 // with samples in them.
 static int pf_resample_limit(pf_t *pf, int k);
 
+// The time in seconds on a monotonic clock
+static double pf_clock(void);
+
 
 
 // Create a new filter
@@ -52,9 +54,8 @@ pf_t *pf_alloc(int min_samples, int max_samples,
   pf_sample_set_t *set;
   pf_sample_t *sample;
   
-  srand48(time(NULL));
-
   pf = calloc(1, sizeof(pf_t));
+  pf_rng_seed(&pf->rng, time(NULL));
 
   pf->random_pose_fn = random_pose_fn;
   pf->random_pose_data = random_pose_data;
@@ -81,6 +82,9 @@ pf_t *pf_alloc(int min_samples, int max_samples,
       
     set->sample_count = max_samples;
     set->samples = calloc(max_samples, sizeof(pf_sample_t));
+    set->pose_x = calloc(max_samples, sizeof(double));
+    set->pose_y = calloc(max_samples, sizeof(double));
+    set->pose_a = calloc(max_samples, sizeof(double));
 
     for (i = 0; i < set->sample_count; i++)
     {
@@ -126,6 +130,9 @@ void pf_free(pf_t *pf)
     free(pf->sets[i].clusters);
     pf_kdtree_free(pf->sets[i].kdtree);
     free(pf->sets[i].samples);
+    free(pf->sets[i].pose_x);
+    free(pf->sets[i].pose_y);
+    free(pf->sets[i].pose_a);
   }
   free(pf);
   
@@ -154,7 +161,7 @@ void pf_init(pf_t *pf, pf_vector_t mean, pf_matrix_t cov)
   {
     sample = set->samples + i;
     sample->weight = 1.0 / pf->max_samples;
-    sample->pose = pf_pdf_gaussian_sample(pdf);
+    sample->pose = pf_pdf_gaussian_sample(pdf, &pf->rng);
 
     // Add sample to histogram
     pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
@@ -193,7 +200,46 @@ void pf_init_model(pf_t *pf, pf_init_model_fn_t init_fn, void *init_data)
   {
     sample = set->samples + i;
     sample->weight = 1.0 / pf->max_samples;
-    sample->pose = (*init_fn) (init_data);
+    sample->pose = (*init_fn) (init_data, &pf->rng);
+
+    // Add sample to histogram
+    pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
+  }
+
+  pf->w_slow = pf->w_fast = 0.0;
+
+  // Re-compute cluster statistics
+  pf_cluster_stats(pf, set);
+  
+  //set converged to 0
+  pf_init_converged(pf);
+
+  return;
+}
+
+
+// Initialize the filter using some batch model
+void pf_init_model_batch(pf_t *pf, pf_init_batch_fn_t init_fn, void *init_data)
+{
+  int i;
+  pf_sample_set_t *set;
+  pf_sample_t *sample;
+
+  set = pf->sets + pf->current_set;
+
+  // Create the kd tree for adaptive sampling
+  pf_kdtree_clear(set->kdtree);
+
+  set->sample_count = pf->max_samples;
+
+  // Compute the new sample poses, all at once
+  (*init_fn) (init_data, &pf->rng, set->pose_x, set->pose_y, set->pose_a, set->sample_count);
+  pf_sample_set_from_soa(set);
+
+  for (i = 0; i < set->sample_count; i++)
+  {
+    sample = set->samples + i;
+    sample->weight = 1.0 / pf->max_samples;
 
     // Add sample to histogram
     pf_kdtree_insert(set->kdtree, sample->pose, sample->weight);
@@ -359,18 +405,22 @@ void copy_set(pf_sample_set_t* set_a, pf_sample_set_t* set_b)
   set_b->converged = set_a->converged;
 }
 
-// Resample the distribution
+// Resample the distribution.  The samples are drawn with the low-variance
+// (systematic) resampler of Probabilistic Robotics, p110: max_samples
+// evenly spaced points, with a random offset, are matched against the
+// cumulative weights in one pass.  The KLD adaptive sampling may stop
+// before all of them are used, so they are taken in a random order; every
+// sample drawn this way is still distributed according to the weights.
 void pf_update_resample(pf_t *pf)
 {
-  int i;
+  int i, j, k, m;
   double total;
   pf_sample_set_t *set_a, *set_b;
   pf_sample_t *sample_a, *sample_b;
 
-  //double r,c,U;
-  //int m;
-  //double count_inv;
-  double* c;
+  double c, u, step;
+  int *drawn, *order;
+  double start;
 
   double w_diff;
 
@@ -385,7 +435,9 @@ void pf_update_resample(pf_t *pf)
       copy_set(set_a,set_b);
 
       // Re-compute cluster statistics
+      start = pf_clock();
       pf_cluster_stats(pf, set_b);
+      pf->cluster_time = pf_clock() - start;
 
       // Use the newly created sample set
       pf->current_set = (pf->current_set + 1) % 2;
@@ -393,13 +445,25 @@ void pf_update_resample(pf_t *pf)
     }
   }
 
-  // Build up cumulative probability table for resampling.
-  // TODO: Replace this with a more efficient procedure
-  // (e.g., http://www.network-theory.co.uk/docs/gslref/GeneralDiscreteDistributions.html)
-  c = (double*)malloc(sizeof(double)*(set_a->sample_count+1));
-  c[0] = 0.0;
-  for(i=0;i<set_a->sample_count;i++)
-    c[i+1] = c[i]+set_a->samples[i].weight;
+  // Low-variance resampler: the sample of set a under each of the points
+  // (r + m) / max_samples of the cumulative weights
+  drawn = (int*)malloc(sizeof(int)*pf->max_samples);
+  order = (int*)malloc(sizeof(int)*pf->max_samples);
+  total = 0.0;
+  for (i = 0; i < set_a->sample_count; i++)
+    total += set_a->samples[i].weight;
+  step = total / pf->max_samples;
+  u = pf_rng_draw(&pf->rng) * step;
+  c = set_a->samples[0].weight;
+  i = 0;
+  for (m = 0; m < pf->max_samples; m++)
+  {
+    while (u >= c && i < set_a->sample_count - 1)
+      c += set_a->samples[++i].weight;
+    drawn[m] = i;
+    order[m] = m;
+    u += step;
+  }
 
   // Create the kd tree for adaptive sampling
   pf_kdtree_clear(set_b->kdtree);
@@ -413,59 +477,22 @@ void pf_update_resample(pf_t *pf)
     w_diff = 0.0;
   //printf("w_diff: %9.6f\n", w_diff);
 
-  // Can't (easily) combine low-variance sampler with KLD adaptive
-  // sampling, so we'll take the more traditional route.
-  /*
-  // Low-variance resampler, taken from Probabilistic Robotics, p110
-  count_inv = 1.0/set_a->sample_count;
-  r = drand48() * count_inv;
-  c = set_a->samples[0].weight;
-  i = 0;
-  m = 0;
-  */
+  j = 0;
   while(set_b->sample_count < pf->max_samples)
   {
     sample_b = set_b->samples + set_b->sample_count++;
 
-    if(drand48() < w_diff)
-      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data);
+    if(pf_rng_draw(&pf->rng) < w_diff)
+      sample_b->pose = (pf->random_pose_fn)(pf->random_pose_data, &pf->rng);
     else
     {
-      // Can't (easily) combine low-variance sampler with KLD adaptive
-      // sampling, so we'll take the more traditional route.
-      /*
-      // Low-variance resampler, taken from Probabilistic Robotics, p110
-      U = r + m * count_inv;
-      while(U>c)
-      {
-        i++;
-        // Handle wrap-around by resetting counters and picking a new random
-        // number
-        if(i >= set_a->sample_count)
-        {
-          r = drand48() * count_inv;
-          c = set_a->samples[0].weight;
-          i = 0;
-          m = 0;
-          U = r + m * count_inv;
-          continue;
-        }
-        c += set_a->samples[i].weight;
-      }
-      m++;
-      */
-
-      // Naive discrete event sampler
-      double r;
-      r = drand48();
-      for(i=0;i<set_a->sample_count;i++)
-      {
-        if((c[i] <= r) && (r < c[i+1]))
-          break;
-      }
-      assert(i<set_a->sample_count);
+      // The next point in a random order, shuffled as it is needed
+      k = j + (int)(pf_rng_draw(&pf->rng) * (pf->max_samples - j));
+      m = order[k];
+      order[k] = order[j];
+      order[j++] = m;
 
-      sample_a = set_a->samples + i;
+      sample_a = set_a->samples + drawn[m];
 
       assert(sample_a->weight > 0);
 
@@ -498,14 +525,17 @@ void pf_update_resample(pf_t *pf)
   }
   
   // Re-compute cluster statistics
+  start = pf_clock();
   pf_cluster_stats(pf, set_b);
+  pf->cluster_time = pf_clock() - start;
 
   // Use the newly created sample set
   pf->current_set = (pf->current_set + 1) % 2; 
 
   pf_update_converged(pf);
 
-  free(c);
+  free(drawn);
+  free(order);
   return;
 }
 
@@ -555,6 +585,15 @@ int pf_resample_limit(pf_t *pf, int k)
 }
 
 
+// The time in seconds on a monotonic clock
+double pf_clock(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
+
 // Re-compute the cluster statistics for a sample set
 void pf_cluster_stats(pf_t *pf, pf_sample_set_t *set)
 {
@@ -691,6 +730,32 @@ void pf_set_selective_resampling(pf_t *pf, int selective_resampling)
   pf->selective_resampling = selective_resampling;
 }
 
+// Copy the sample poses to the arrays of the set
+void pf_sample_set_to_soa(pf_sample_set_t *set)
+{
+  int i;
+
+  for (i = 0; i < set->sample_count; i++)
+  {
+    set->pose_x[i] = set->samples[i].pose.v[0];
+    set->pose_y[i] = set->samples[i].pose.v[1];
+    set->pose_a[i] = set->samples[i].pose.v[2];
+  }
+}
+
+// Copy the arrays of the set back to the sample poses
+void pf_sample_set_from_soa(pf_sample_set_t *set)
+{
+  int i;
+
+  for (i = 0; i < set->sample_count; i++)
+  {
+    set->samples[i].pose.v[0] = set->pose_x[i];
+    set->samples[i].pose.v[1] = set->pose_y[i];
+    set->samples[i].pose.v[2] = set->pose_a[i];
+  }
+}
+
 // Compute the CEP statistics (mean and variance).
 void pf_get_cep_stats(pf_t *pf, pf_vector_t *mean, double *var)
 {
@@ -33,10 +33,6 @@
 //#include <gsl/gsl_randist.h>
 
 #include "amcl/pf/pf_pdf.h"
-#include "portable_utils.hpp"
-
-// Random number generator seed value
-static unsigned int pf_pdf_seed;
 
 
 /**************************************************************************
@@ -62,11 +58,6 @@ pf_pdf_gaussian_t *pf_pdf_gaussian_alloc(pf_vector_t x, pf_matrix_t cx)
   pdf->cd.v[1] = sqrt(cd.m[1][1]);
   pdf->cd.v[2] = sqrt(cd.m[2][2]);
 
-  // Initialize the random number generator
-  //pdf->rng = gsl_rng_alloc(gsl_rng_taus);
-  //gsl_rng_set(pdf->rng, ++pf_pdf_seed);
-  srand48(++pf_pdf_seed);
-
   return pdf;
 }
 
@@ -103,7 +94,7 @@ double pf_pdf_gaussian_value(pf_pdf_gaussian_t *pdf, pf_vector_t x)
 
 
 // Generate a sample from the pdf.
-pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
+pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf, pf_rng_t *rng)
 {
   int i, j;
   pf_vector_t r;
@@ -113,7 +104,7 @@ pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
   for (i = 0; i < 3; i++)
   {
     //r.v[i] = gsl_ran_gaussian(pdf->rng, pdf->cd.v[i]);
-    r.v[i] = pf_ran_gaussian(pdf->cd.v[i]);
+    r.v[i] = pf_ran_gaussian(rng, pdf->cd.v[i]);
   }
 
   for (i = 0; i < 3; i++)
@@ -130,15 +121,15 @@ pf_vector_t pf_pdf_gaussian_sample(pf_pdf_gaussian_t *pdf)
 // deviation sigma.
 // We use the polar form of the Box-Muller transformation, explained here:
 //   http://www.taygeta.com/random/gaussian.html
-double pf_ran_gaussian(double sigma)
+double pf_ran_gaussian(pf_rng_t *rng, double sigma)
 {
   double x1, x2, w, r;
 
   do
   {
-    do { r = drand48(); } while (r==0.0);
+    do { r = pf_rng_draw(rng); } while (r==0.0);
     x1 = 2.0 * r - 1.0;
-    do { r = drand48(); } while (r==0.0);
+    do { r = pf_rng_draw(rng); } while (r==0.0);
     x2 = 2.0 * r - 1.0;
     w = x1*x1 + x2*x2;
   } while(w > 1.0 || w==0.0);
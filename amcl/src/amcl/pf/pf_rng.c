@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+/**************************************************************************
+ * Desc: Counter-based random number generator
+ *************************************************************************/
+
+#include <math.h>
+
+#include "amcl/pf/pf_rng.h"
+
+// The finalizer of SplitMix64, which turns a counter into a well mixed
+// 64 bit number.  It has no branches and no state, so the loops that call
+// it can be vectorized.
+static inline uint64_t pf_rng_hash(uint64_t seed, uint64_t counter)
+{
+  uint64_t z = seed + counter * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Seed the generator
+void pf_rng_seed(pf_rng_t *rng, uint64_t seed)
+{
+  rng->seed = seed;
+  rng->counter = 0;
+}
+
+// Draw a uniform number, from the top 53 bits of the hash
+double pf_rng_draw(pf_rng_t *rng)
+{
+  return (pf_rng_hash(rng->seed, rng->counter++) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Draw uniform numbers
+void pf_rng_uniform(pf_rng_t *rng, double *u, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    u[i] = (pf_rng_hash(rng->seed, rng->counter + i) >> 11) * (1.0 / 9007199254740992.0);
+  rng->counter += n;
+}
+
+// Draw Gaussian numbers.  This uses the basic form of the Box-Muller
+// transform, which turns each pair of uniform numbers into a pair of
+// Gaussian numbers; unlike the polar form, it never rejects a pair.
+static inline void pf_rng_box_muller(uint64_t seed, uint64_t counter, double *z0, double *z1)
+{
+  // u1 is in (0, 1], so that its log is finite
+  double u1 = ((pf_rng_hash(seed, counter) >> 11) + 1) * (1.0 / 9007199254740992.0);
+  double u2 = (pf_rng_hash(seed, counter + 1) >> 11) * (1.0 / 9007199254740992.0);
+  double r = sqrt(-2.0 * log(u1));
+  *z0 = r * cos(2 * M_PI * u2);
+  *z1 = r * sin(2 * M_PI * u2);
+}
+
+void pf_rng_gaussian(pf_rng_t *rng, double *z, int n)
+{
+  int i;
+  double unused;
+
+  for (i = 0; i + 1 < n; i += 2)
+    pf_rng_box_muller(rng->seed, rng->counter + i, z + i, z + i + 1);
+  if (i < n)
+    pf_rng_box_muller(rng->seed, rng->counter + i, z + i, &unused);
+  rng->counter += n + (n & 1);
+}
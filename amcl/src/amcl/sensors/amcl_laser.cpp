@@ -35,6 +35,9 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <boost/bind.hpp>
+
 #include "amcl/sensors/amcl_laser.h"
 
 using namespace amcl;
@@ -42,6 +45,7 @@ using namespace amcl;
 ////////////////////////////////////////////////////////////////////////////////
 // Default constructor
 AMCLLaser::AMCLLaser(size_t max_beams, map_t* map) : AMCLSensor(), 
+						     thread_pool(NULL),
 						     max_samples(0), max_obs(0), 
 						     temp_obs(NULL)
 {
@@ -93,7 +97,11 @@ AMCLLaser::SetModelLikelihoodField(double z_hit,
   this->z_rand = z_rand;
   this->sigma_hit = sigma_hit;
 
-  map_update_cspace(this->map, max_occ_dist);
+  // The field only depends on the map, which does not change, so a field
+  // computed for a previous laser or loaded from a file is kept
+  if(this->map->occ_dist_field == NULL || this->map->max_occ_dist != max_occ_dist)
+    map_update_cspace(this->map, max_occ_dist);
+  this->UpdateHitProbs();
 }
 
 void 
@@ -114,7 +122,26 @@ AMCLLaser::SetModelLikelihoodFieldProb(double z_hit,
   this->beam_skip_distance = beam_skip_distance;
   this->beam_skip_threshold = beam_skip_threshold;
   this->beam_skip_error_threshold = beam_skip_error_threshold;
-  map_update_cspace(this->map, max_occ_dist);
+  // The field only depends on the map, which does not change, so a field
+  // computed for a previous laser or loaded from a file is kept
+  if(this->map->occ_dist_field == NULL || this->map->max_occ_dist != max_occ_dist)
+    map_update_cspace(this->map, max_occ_dist);
+  this->UpdateHitProbs();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Precompute the z_hit part of the likelihood field models for each distance
+// of the map's likelihood field
+void AMCLLaser::UpdateHitProbs()
+{
+  double z_hit_denom = 2 * this->sigma_hit * this->sigma_hit;
+
+  this->hit_probs.resize(this->map->occ_dist_table_size);
+  for (int c = 0; c < this->map->occ_dist_table_size; c++)
+  {
+    double z = this->map->occ_dist_table[c];
+    this->hit_probs[c] = this->z_hit * exp(-(z * z) / z_hit_denom);
+  }
 }
 
 
@@ -139,9 +166,65 @@ bool AMCLLaser::UpdateSensor(pf_t *pf, AMCLSensorData *data)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Split the sample set into chunks and weight them on the thread pool.  Each
+// sample is weighted exactly as it would be serially, so the result does not
+// depend on the number of threads.
+int AMCLLaser::SampleChunkCount(int sample_count) const
+{
+  // Below this many samples per chunk, handing the work to the threads costs
+  // more than it saves
+  const int min_chunk_size = 64;
+
+  if (this->thread_pool == NULL || this->thread_pool->GetNumThreads() < 2)
+    return 1;
+  int chunks = 4 * this->thread_pool->GetNumThreads();
+  chunks = std::min(chunks, sample_count / min_chunk_size);
+  return std::max(chunks, 1);
+}
+
+static void RunSampleChunk(const boost::function<void(int, int, int)>* fn,
+                           int sample_count, int chunk_count, int chunk)
+{
+  int begin = (int)((long)sample_count * chunk / chunk_count);
+  int end = (int)((long)sample_count * (chunk + 1) / chunk_count);
+  (*fn)(chunk, begin, end);
+}
+
+void AMCLLaser::ForEachSampleChunk(int sample_count, int chunk_count,
+                                   const boost::function<void(int, int, int)>& fn)
+{
+  if (chunk_count <= 1)
+    fn(0, 0, sample_count);
+  else
+    this->thread_pool->Run(chunk_count, boost::bind(&RunSampleChunk, &fn, sample_count,
+                                                    chunk_count, _1));
+}
+
+// Sum the sample weights in order, so that the total does not depend on how
+// the samples were split between the threads
+static double TotalWeight(pf_sample_set_t* set)
+{
+  double total_weight = 0.0;
+  for (int j = 0; j < set->sample_count; j++)
+    total_weight += set->samples[j].weight;
+  return total_weight;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Determine the probability for the given pose
 double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  AMCLLaser *self = (AMCLLaser*) data->sensor;
+
+  self->ForEachSampleChunk(set->sample_count, self->SampleChunkCount(set->sample_count),
+                           boost::bind(&AMCLLaser::BeamModelSamples, data, set, _2, _3));
+
+  return(TotalWeight(set));
+}
+
+void AMCLLaser::BeamModelSamples(AMCLLaserData *data, pf_sample_set_t* set,
+                                 int begin, int end)
 {
   AMCLLaser *self;
   int i, j, step;
@@ -149,16 +232,13 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
   double p;
   double map_range;
   double obs_range, obs_bearing;
-  double total_weight;
   pf_sample_t *sample;
   pf_vector_t pose;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
-
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  for (j = begin; j < end; j++)
   {
     sample = set->samples + j;
     pose = sample->pose;
@@ -174,9 +254,14 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
       obs_range = data->ranges[i][0];
       obs_bearing = data->ranges[i][1];
 
-      // Compute the range according to the map
-      map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
-                                 pose.v[2] + obs_bearing, data->range_max);
+      // Compute the range according to the map, through the range field
+      // when the map has one
+      if(self->map->range_field != NULL)
+        map_range = map_lookup_range(self->map, pose.v[0], pose.v[1],
+                                     pose.v[2] + obs_bearing, data->range_max);
+      else
+        map_range = map_calc_range(self->map, pose.v[0], pose.v[1],
+                                   pose.v[2] + obs_bearing, data->range_max);
       pz = 0.0;
 
       // Part 1: good, but noisy, hit
@@ -206,30 +291,35 @@ double AMCLLaser::BeamModel(AMCLLaserData *data, pf_sample_set_t* set)
     }
 
     sample->weight *= p;
-    total_weight += sample->weight;
   }
-
-  return(total_weight);
 }
 
 double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set)
+{
+  AMCLLaser *self = (AMCLLaser*) data->sensor;
+
+  self->ForEachSampleChunk(set->sample_count, self->SampleChunkCount(set->sample_count),
+                           boost::bind(&AMCLLaser::LikelihoodFieldModelSamples, data, set, _2, _3));
+
+  return(TotalWeight(set));
+}
+
+void AMCLLaser::LikelihoodFieldModelSamples(AMCLLaserData *data, pf_sample_set_t* set,
+                                            int begin, int end)
 {
   AMCLLaser *self;
   int i, j, step;
-  double z, pz;
+  double pz;
   double p;
   double obs_range, obs_bearing;
-  double total_weight;
   pf_sample_t *sample;
   pf_vector_t pose;
   pf_vector_t hit;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
-
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  for (j = begin; j < end; j++)
   {
     sample = set->samples + j;
     pose = sample->pose;
@@ -240,8 +330,8 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
     p = 1.0;
 
     // Pre-compute a couple of things
-    double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
     double z_rand_mult = 1.0/data->range_max;
+    int max_dist_code = self->map->occ_dist_table_size - 1;
 
     step = (data->range_count - 1) / (self->max_beams - 1);
 
@@ -275,13 +365,14 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
       
       // Part 1: Get distance from the hit to closest obstacle.
       // Off-map penalized as max distance
+      int code;
       if(!MAP_VALID(self->map, mi, mj))
-        z = self->map->max_occ_dist;
+        code = max_dist_code;
       else
-        z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
-      // Gaussian model
+        code = self->map->occ_dist_field[MAP_INDEX(self->map,mi,mj)];
+      // Gaussian model, precomputed for each distance
       // NOTE: this should have a normalization of 1/(sqrt(2pi)*sigma)
-      pz += self->z_hit * exp(-(z * z) / z_hit_denom);
+      pz += self->hit_probs[code];
       // Part 2: random measurements
       pz += self->z_rand * z_rand_mult;
 
@@ -296,54 +387,39 @@ double AMCLLaser::LikelihoodFieldModel(AMCLLaserData *data, pf_sample_set_t* set
     }
 
     sample->weight *= p;
-    total_weight += sample->weight;
   }
-
-  return(total_weight);
 }
 
 double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t* set)
 {
   AMCLLaser *self;
-  int i, j, step;
-  double z, pz;
+  int j, step;
   double log_p;
-  double obs_range, obs_bearing;
-  double total_weight;
   pf_sample_t *sample;
-  pf_vector_t pose;
-  pf_vector_t hit;
 
   self = (AMCLLaser*) data->sensor;
 
-  total_weight = 0.0;
-
   step = ceil((data->range_count) / static_cast<double>(self->max_beams)); 
   
   // Step size must be at least 1
   if(step < 1)
     step = 1;
 
-  // Pre-compute a couple of things
-  double z_hit_denom = 2 * self->sigma_hit * self->sigma_hit;
-  double z_rand_mult = 1.0/data->range_max;
-
-  double max_dist_prob = exp(-(self->map->max_occ_dist * self->map->max_occ_dist) / z_hit_denom);
-
   //Beam skipping - ignores beams for which a majoirty of particles do not agree with the map
   //prevents correct particles from getting down weighted because of unexpected obstacles 
   //such as humans 
 
   bool do_beamskip = self->do_beamskip;
-  double beam_skip_distance = self->beam_skip_distance;
-  double beam_skip_threshold = self->beam_skip_threshold;
   
   //we only do beam skipping if the filter has converged 
   if(do_beamskip && !set->converged){
     do_beamskip = false;
   }
 
-  //we need a count the no of particles for which the beam agreed with the map 
+  //we need a count the no of particles for which the beam agreed with the map;
+  //every chunk of samples counts into its own row, which are added up afterwards
+  int chunk_count = self->SampleChunkCount(set->sample_count);
+  int *chunk_obs_count = new int[chunk_count * self->max_beams]();
   int *obs_count = new int[self->max_beams]();
 
   //we also need a mask of which observations to integrate (to decide which beams to integrate to all particles) 
@@ -370,7 +446,87 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
   }
 
   // Compute the sample weights
-  for (j = 0; j < set->sample_count; j++)
+  self->ForEachSampleChunk(set->sample_count, chunk_count,
+                           boost::bind(&AMCLLaser::LikelihoodFieldModelProbSamples, data, set,
+                                       _2, _3, step, do_beamskip, chunk_obs_count, _1));
+
+  for (int chunk = 0; chunk < chunk_count; chunk++)
+    for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++)
+      obs_count[beam_ind] += chunk_obs_count[chunk * self->max_beams + beam_ind];
+  
+  if(do_beamskip){
+    int skipped_beam_count = 0; 
+    for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
+      if((obs_count[beam_ind] / static_cast<double>(set->sample_count)) > self->beam_skip_threshold){
+	obs_mask[beam_ind] = true;
+      }
+      else{
+	obs_mask[beam_ind] = false;
+	skipped_beam_count++; 
+      }
+    }
+
+    //we check if there is at least a critical number of beams that agreed with the map 
+    //otherwise it probably indicates that the filter converged to a wrong solution
+    //if that's the case we integrate all the beams and hope the filter might converge to 
+    //the right solution
+    bool error = false; 
+
+    if(skipped_beam_count >= (beam_ind * self->beam_skip_error_threshold)){
+      fprintf(stderr, "Over %f%% of the observations were not in the map - pf may have converged to wrong pose - integrating all observations\n", (100 * self->beam_skip_error_threshold));
+      error = true; 
+    }
+
+    for (j = 0; j < set->sample_count; j++)
+      {
+	sample = set->samples + j;
+
+	log_p = 0;
+
+	for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
+	  if(error || obs_mask[beam_ind]){
+	    log_p += log(self->temp_obs[j][beam_ind]);
+	  }
+	}
+	
+	sample->weight *= exp(log_p);
+      }      
+  }
+
+  delete [] chunk_obs_count;
+  delete [] obs_count; 
+  delete [] obs_mask;
+  return(TotalWeight(set));
+}
+
+void AMCLLaser::LikelihoodFieldModelProbSamples(AMCLLaserData *data, pf_sample_set_t* set,
+                                                int begin, int end, int step, bool do_beamskip,
+                                                int *chunk_obs_count, int chunk)
+{
+  AMCLLaser *self;
+  int i, j;
+  double z, pz;
+  double log_p;
+  double obs_range, obs_bearing;
+  pf_sample_t *sample;
+  pf_vector_t pose;
+  pf_vector_t hit;
+
+  self = (AMCLLaser*) data->sensor;
+
+  // Pre-compute a couple of things
+  double z_rand_mult = 1.0/data->range_max;
+
+  // The z_hit part for off-map hits, which are penalized as max distance
+  double max_dist_hit_prob = self->hit_probs[self->map->occ_dist_table_size - 1];
+
+  double beam_skip_distance = self->beam_skip_distance;
+
+  int *obs_count = chunk_obs_count + chunk * self->max_beams;
+
+  int beam_ind = 0;
+
+  for (j = begin; j < end; j++)
   {
     sample = set->samples + j;
     pose = sample->pose;
@@ -412,14 +568,15 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
       // Off-map penalized as max distance
       
       if(!MAP_VALID(self->map, mi, mj)){
-	pz += self->z_hit * max_dist_prob;
+	pz += max_dist_hit_prob;
       }
       else{
-	z = self->map->cells[MAP_INDEX(self->map,mi,mj)].occ_dist;
+	int code = self->map->occ_dist_field[MAP_INDEX(self->map,mi,mj)];
+	z = self->map->occ_dist_table[code];
 	if(z < beam_skip_distance){
 	  obs_count[beam_ind] += 1;
 	}
-	pz += self->z_hit * exp(-(z * z) / z_hit_denom);
+	pz += self->hit_probs[code];
       }
        
       // Gaussian model
@@ -442,55 +599,8 @@ double AMCLLaser::LikelihoodFieldModelProb(AMCLLaserData *data, pf_sample_set_t*
     }
     if(!do_beamskip){
       sample->weight *= exp(log_p);
-      total_weight += sample->weight;
-    }
-  }
-  
-  if(do_beamskip){
-    int skipped_beam_count = 0; 
-    for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
-      if((obs_count[beam_ind] / static_cast<double>(set->sample_count)) > beam_skip_threshold){
-	obs_mask[beam_ind] = true;
-      }
-      else{
-	obs_mask[beam_ind] = false;
-	skipped_beam_count++; 
-      }
-    }
-
-    //we check if there is at least a critical number of beams that agreed with the map 
-    //otherwise it probably indicates that the filter converged to a wrong solution
-    //if that's the case we integrate all the beams and hope the filter might converge to 
-    //the right solution
-    bool error = false; 
-
-    if(skipped_beam_count >= (beam_ind * self->beam_skip_error_threshold)){
-      fprintf(stderr, "Over %f%% of the observations were not in the map - pf may have converged to wrong pose - integrating all observations\n", (100 * self->beam_skip_error_threshold));
-      error = true; 
     }
-
-    for (j = 0; j < set->sample_count; j++)
-      {
-	sample = set->samples + j;
-	pose = sample->pose;
-
-	log_p = 0;
-
-	for (beam_ind = 0; beam_ind < self->max_beams; beam_ind++){
-	  if(error || obs_mask[beam_ind]){
-	    log_p += log(self->temp_obs[j][beam_ind]);
-	  }
-	}
-	
-	sample->weight *= exp(log_p);
-	
-	total_weight += sample->weight;
-      }      
   }
-
-  delete [] obs_count; 
-  delete [] obs_mask;
-  return(total_weight);
 }
 
 void AMCLLaser::reallocTempData(int new_max_samples, int new_max_obs){
@@ -0,0 +1,105 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+///////////////////////////////////////////////////////////////////////////
+//
+// Desc: Worker threads for AMCL
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <boost/bind.hpp>
+
+#include "amcl/thread_pool.h"
+
+using namespace amcl;
+
+ThreadPool::ThreadPool(int num_threads) : num_threads(std::max(1, num_threads)),
+                                          task(NULL), num_tasks(0), next_task(0),
+                                          unfinished_tasks(0), batch(0), shutdown(false)
+{
+  for (int i = 1; i < this->num_threads; i++)
+    this->workers.create_thread(boost::bind(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    boost::unique_lock<boost::mutex> lock(this->mutex);
+    this->shutdown = true;
+  }
+  this->work_cv.notify_all();
+  this->workers.join_all();
+}
+
+void ThreadPool::Run(int num_tasks, const boost::function<void(int)>& task)
+{
+  if (num_tasks <= 0)
+    return;
+
+  if (this->num_threads == 1 || num_tasks == 1)
+  {
+    for (int i = 0; i < num_tasks; i++)
+      task(i);
+    return;
+  }
+
+  boost::unique_lock<boost::mutex> lock(this->mutex);
+  this->task = &task;
+  this->num_tasks = num_tasks;
+  this->next_task = 0;
+  this->unfinished_tasks = num_tasks;
+  this->batch++;
+  this->work_cv.notify_all();
+
+  this->RunTasks(lock);
+
+  while (this->unfinished_tasks > 0)
+    this->done_cv.wait(lock);
+  this->task = NULL;
+}
+
+void ThreadPool::WorkerLoop()
+{
+  boost::unique_lock<boost::mutex> lock(this->mutex);
+  unsigned long last_batch = this->batch;
+  while (true)
+  {
+    while (!this->shutdown && this->batch == last_batch)
+      this->work_cv.wait(lock);
+    if (this->shutdown)
+      return;
+    last_batch = this->batch;
+    this->RunTasks(lock);
+  }
+}
+
+void ThreadPool::RunTasks(boost::unique_lock<boost::mutex>& lock)
+{
+  while (this->next_task < this->num_tasks)
+  {
+    int i = this->next_task++;
+    const boost::function<void(int)>& task = *this->task;
+    lock.unlock();
+    task(i);
+    lock.lock();
+    if (--this->unfinished_tasks == 0)
+      this->done_cv.notify_all();
+  }
+}
@@ -24,9 +24,13 @@
 #include <vector>
 #include <map>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
 
 #include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/thread/mutex.hpp>
 
 // Signal handling
@@ -36,7 +40,6 @@
 #include "amcl/pf/pf.h"
 #include "amcl/sensors/amcl_odom.h"
 #include "amcl/sensors/amcl_laser.h"
-#include "portable_utils.hpp"
 
 #include "ros/assert.h"
 
@@ -76,8 +79,6 @@
 // For monitoring the estimator
 #include <diagnostic_updater/diagnostic_updater.h>
 
-#define NEW_UNIFORM_SAMPLING 1
-
 using namespace amcl;
 
 // Pose hypothesis
@@ -140,8 +141,13 @@ class AmclNode
      * @param in_bag_fn input bagfile
      * @param trigger_global_localization whether to trigger global localization
      * before starting to process the bagfile
+     * @param report_fn if not empty, file to write a JSON report of the time
+     * spent in each stage of the filter and of the final pose to
+     * @param expected if not NULL, the map->odom transform (x, y, yaw)
+     * expected at the end of the bag, to report the error of the final one
      */
-    void runFromBag(const std::string &in_bag_fn, bool trigger_global_localization = false);
+    void runFromBag(const std::string &in_bag_fn, bool trigger_global_localization = false,
+                    const std::string &report_fn = "", const double* expected = NULL);
 
     int process();
     void savePoseToServer();
@@ -158,10 +164,11 @@ class AmclNode
 
     // Pose-generating function used to uniformly distribute particles over
     // the map
-    static pf_vector_t uniformPoseGenerator(void* arg);
-#if NEW_UNIFORM_SAMPLING
-    static std::vector<std::pair<int,int> > free_space_indices;
-#endif
+    static pf_vector_t uniformPoseGenerator(void* arg, pf_rng_t* rng);
+    // Same, filling a whole sample set at once
+    static void uniformPoseBatchGenerator(void* arg, pf_rng_t* rng,
+                                          double* x, double* y, double* a,
+                                          int count);
     // Callbacks
     bool globalLocalizationCallback(std_srvs::Empty::Request& req,
                                     std_srvs::Empty::Response& res);
@@ -178,6 +185,10 @@ class AmclNode
     void handleMapMessage(const nav_msgs::OccupancyGrid& msg);
     void freeMapDependentMemory();
     map_t* convertMap( const nav_msgs::OccupancyGrid& map_msg );
+    void loadCachedLikelihoodField();
+    void updateRangeField();
+    void updateSampleCells();
+    std::string cacheFilename(uint64_t key, const char* extension);
     void updatePoseFromServer();
     void applyInitialPose();
 
@@ -201,6 +212,8 @@ class AmclNode
     geometry_msgs::PoseWithCovarianceStamped last_published_pose;
 
     map_t* map_;
+    uint64_t map_hash_;
+    std::string likelihood_field_cache_dir_;
     char* mapdata;
     int sx, sy;
     double resolution;
@@ -228,6 +241,8 @@ class AmclNode
 
     AMCLOdom* odom_;
     AMCLLaser* laser_;
+    int laser_threads_;
+    boost::shared_ptr<ThreadPool> laser_thread_pool_;
 
     ros::Duration cloud_pub_interval;
     ros::Time last_cloud_pub_time;
@@ -235,6 +250,29 @@ class AmclNode
     // For slowing play-back when reading directly from a bag file
     ros::WallDuration bag_scan_period_;
 
+    // Time spent in each stage of the filter, for the report of runFromBag
+    struct StageTiming
+    {
+      StageTiming() : count(0), total(0.0), max(0.0) {}
+      void add(const ros::WallTime& start)
+      {
+        add((ros::WallTime::now() - start).toSec());
+      }
+      void add(double t)
+      {
+        count++;
+        total += t;
+        max = std::max(max, t);
+      }
+      int count;
+      double total, max;
+    };
+    StageTiming motion_timing_, sensor_timing_, resample_timing_, cluster_timing_;
+    // The particles weighted by the sensor updates
+    double sensor_particles_;
+    void writeBagReport(const std::string& report_fn, const std::string& in_bag_fn,
+                        int scan_count, double runtime, const double* expected);
+
     void requestMap();
 
     // Helper to get odometric pose from transform system
@@ -279,12 +317,16 @@ class AmclNode
     bool do_beamskip_;
     double beam_skip_distance_, beam_skip_threshold_, beam_skip_error_threshold_;
     double laser_likelihood_max_dist_;
+    bool laser_range_field_;
     odom_model_t odom_model_type_;
     double init_pose_[3];
     double init_cov_[3];
     laser_model_t laser_model_type_;
     bool tf_broadcast_;
     bool selective_resampling_;
+    int random_seed_;
+    std::vector<double> global_localization_region_;
+    bool global_localization_weighted_;
 
     void reconfigureCB(amcl::AMCLConfig &config, uint32_t level);
 
@@ -293,12 +335,70 @@ class AmclNode
     void checkLaserReceived(const ros::TimerEvent& event);
 };
 
-std::vector<std::pair<int,int> > AmclNode::free_space_indices;
-
 #define USAGE "USAGE: amcl"
 
 boost::shared_ptr<AmclNode> amcl_node_ptr;
 
+// A hash in the style of FNV-1a, but mixing in 8 byte words rather than
+// single bytes, which is fast enough to hash large maps on every map
+// message.  It is not FNV-1a, and only serves to tell maps apart.
+static uint64_t
+hashBytes(uint64_t hash, const void* data, size_t size)
+{
+  const uint64_t prime = 0x100000001b3ULL;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  size_t i = 0;
+  for(; i + 8 <= size; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for(; i < size; i++)
+    hash = (hash ^ bytes[i]) * prime;
+  return hash;
+}
+
+static uint64_t
+hashCombine(uint64_t hash, double value)
+{
+  return hashBytes(hash, &value, sizeof(value));
+}
+
+static uint64_t
+hashMapData(const nav_msgs::OccupancyGrid& map_msg)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  uint32_t size[2] = { map_msg.info.width, map_msg.info.height };
+  hash = hashBytes(hash, size, sizeof(size));
+  return hashBytes(hash, map_msg.data.data(), map_msg.data.size());
+}
+
+// A string as a JSON string literal, quoted and escaped
+static std::string
+jsonString(const std::string& value)
+{
+  std::string quoted = "\"";
+  for(size_t i = 0; i < value.size(); i++)
+  {
+    unsigned char c = value[i];
+    if(c == '"' || c == '\\')
+    {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if(c < 0x20)
+    {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      quoted += escape;
+    }
+    else
+      quoted += c;
+  }
+  return quoted + "\"";
+}
+
 void sigintHandler(int sig)
 {
   // Save latest pose as we're shutting down.
@@ -325,14 +425,32 @@ main(int argc, char** argv)
   }
   else if ((argc >= 3) && (std::string(argv[1]) == "--run-from-bag"))
   {
-    if (argc == 3)
-    {
-      amcl_node_ptr->runFromBag(argv[2]);
-    }
-    else if ((argc == 4) && (std::string(argv[3]) == "--global-localization"))
+    bool global_localization = false;
+    std::string report_fn;
+    double expected[3];
+    bool have_expected = false;
+    bool valid = true;
+    for (int i = 3; i < argc && valid; i++)
     {
-      amcl_node_ptr->runFromBag(argv[2], true);
+      std::string option(argv[i]);
+      if (option == "--global-localization")
+        global_localization = true;
+      else if (option == "--report" && i + 1 < argc)
+        report_fn = argv[++i];
+      else if (option == "--expected" && i + 3 < argc)
+      {
+        for (int k = 0; k < 3; k++)
+          expected[k] = atof(argv[++i]);
+        have_expected = true;
+      }
+      else
+        valid = false;
     }
+    if (valid)
+      amcl_node_ptr->runFromBag(argv[2], global_localization, report_fn, have_expected ? expected : NULL);
+    else
+      ROS_ERROR("%s --run-from-bag <bag> [--global-localization] [--report <file>] [--expected <x> <y> <yaw>]",
+                USAGE);
   }
 
   // Without this, our boost locks are not shut down nicely
@@ -346,8 +464,10 @@ AmclNode::AmclNode() :
         sent_first_transform_(false),
         latest_tf_valid_(false),
         map_(NULL),
+        map_hash_(0),
         pf_(NULL),
         resample_count_(0),
+        sensor_particles_(0.0),
         odom_(NULL),
         laser_(NULL),
 	      private_nh_("~"),
@@ -370,6 +490,8 @@ AmclNode::AmclNode() :
   private_nh_.param("laser_min_range", laser_min_range_, -1.0);
   private_nh_.param("laser_max_range", laser_max_range_, -1.0);
   private_nh_.param("laser_max_beams", max_beams_, 30);
+  private_nh_.param("laser_threads", laser_threads_, 1);
+  laser_thread_pool_.reset(new ThreadPool(laser_threads_));
   private_nh_.param("min_particles", min_particles_, 100);
   private_nh_.param("max_particles", max_particles_, 5000);
   private_nh_.param("kld_err", pf_err_, 0.01);
@@ -399,6 +521,9 @@ AmclNode::AmclNode() :
   private_nh_.param("laser_sigma_hit", sigma_hit_, 0.2);
   private_nh_.param("laser_lambda_short", lambda_short_, 0.1);
   private_nh_.param("laser_likelihood_max_dist", laser_likelihood_max_dist_, 2.0);
+  // Also holds the range field of the beam model
+  private_nh_.param("likelihood_field_cache_dir", likelihood_field_cache_dir_, std::string(""));
+  private_nh_.param("laser_range_field", laser_range_field_, false);
   std::string tmp_model_type;
   private_nh_.param("laser_model_type", tmp_model_type, std::string("likelihood_field"));
   if(tmp_model_type == "beam")
@@ -438,6 +563,38 @@ AmclNode::AmclNode() :
   private_nh_.param("global_frame_id", global_frame_id_, std::string("map"));
   private_nh_.param("resample_interval", resample_interval_, 2);
   private_nh_.param("selective_resampling", selective_resampling_, false);
+  // A negative seed seeds the particle filter from the time
+  private_nh_.param("random_seed", random_seed_, -1);
+  // Global localization only spreads particles over the free cells inside
+  // this polygon of [x, y] points in the global frame, if it is given
+  XmlRpc::XmlRpcValue region;
+  if(private_nh_.getParam("global_localization_region", region))
+  {
+    if(region.getType() == XmlRpc::XmlRpcValue::TypeArray && region.size() >= 3)
+    {
+      for(int i = 0; i < region.size(); i++)
+      {
+        XmlRpc::XmlRpcValue& point = region[i];
+        if(point.getType() != XmlRpc::XmlRpcValue::TypeArray || point.size() != 2)
+        {
+          ROS_WARN("Each point of global_localization_region must be [x, y]; ignoring the region");
+          global_localization_region_.clear();
+          break;
+        }
+        for(int k = 0; k < 2; k++)
+        {
+          if(point[k].getType() == XmlRpc::XmlRpcValue::TypeInt)
+            global_localization_region_.push_back((int)point[k]);
+          else
+            global_localization_region_.push_back((double)point[k]);
+        }
+      }
+    }
+    else
+      ROS_WARN("global_localization_region must be a list of at least 3 [x, y] points; ignoring it");
+  }
+  // Weight the global localization samples by their distance to obstacles
+  private_nh_.param("global_localization_weighted", global_localization_weighted_, false);
   double tmp_tol;
   private_nh_.param("transform_tolerance", tmp_tol, 0.1);
   private_nh_.param("recovery_alpha_slow", alpha_slow_, 0.001);
@@ -554,6 +711,7 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   sigma_hit_ = config.laser_sigma_hit;
   lambda_short_ = config.laser_lambda_short;
   laser_likelihood_max_dist_ = config.laser_likelihood_max_dist;
+  laser_range_field_ = config.laser_range_field;
 
   if(config.laser_model_type == "beam")
     laser_model_type_ = LASER_MODEL_BEAM;
@@ -592,6 +750,12 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   lasers_update_.clear();
   frame_to_laser_.clear();
 
+  if(config.laser_threads != laser_threads_)
+  {
+    laser_threads_ = config.laser_threads;
+    laser_thread_pool_.reset(new ThreadPool(laser_threads_));
+  }
+
   if( pf_ != NULL )
   {
     pf_free( pf_ );
@@ -601,6 +765,8 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
                  alpha_slow_, alpha_fast_,
                  (pf_init_model_fn_t)AmclNode::uniformPoseGenerator,
                  (void *)map_);
+  if(random_seed_ >= 0)
+    pf_rng_seed(&pf_->rng, random_seed_);
   pf_set_selective_resampling(pf_, selective_resampling_);
   pf_err_ = config.kld_err; 
   pf_z_ = config.kld_z; 
@@ -626,9 +792,12 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
   ROS_ASSERT(odom_);
   odom_->SetModel( odom_model_type_, alpha1_, alpha2_, alpha3_, alpha4_, alpha5_ );
   // Laser
+  loadCachedLikelihoodField();
+  updateRangeField();
   delete laser_;
   laser_ = new AMCLLaser(max_beams_, map_);
   ROS_ASSERT(laser_);
+  laser_->SetThreadPool(laser_thread_pool_.get());
   if(laser_model_type_ == LASER_MODEL_BEAM)
     laser_->SetModelBeam(z_hit_, z_short_, z_max_, z_rand_,
                          sigma_hit_, lambda_short_, 0.0);
@@ -646,6 +815,9 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
                                     laser_likelihood_max_dist_);
     ROS_INFO("Done initializing likelihood field model.");
   }
+  // The weights follow the likelihood field's maximum distance
+  if(global_localization_weighted_)
+    updateSampleCells();
 
   odom_frame_id_ = stripSlash(config.odom_frame_id);
   base_frame_id_ = stripSlash(config.base_frame_id);
@@ -665,7 +837,8 @@ void AmclNode::reconfigureCB(AMCLConfig &config, uint32_t level)
 }
 
 
-void AmclNode::runFromBag(const std::string &in_bag_fn, bool trigger_global_localization)
+void AmclNode::runFromBag(const std::string &in_bag_fn, bool trigger_global_localization,
+                          const std::string &report_fn, const double* expected)
 {
   rosbag::Bag bag;
   bag.open(in_bag_fn, rosbag::bagmode::Read);
@@ -681,8 +854,6 @@ void AmclNode::runFromBag(const std::string &in_bag_fn, bool trigger_global_loca
   // Sleep for a second to let all subscribers connect
   ros::WallDuration(1.0).sleep();
 
-  ros::WallTime start(ros::WallTime::now());
-
   // Wait for map
   while (ros::ok())
   {
@@ -704,6 +875,10 @@ void AmclNode::runFromBag(const std::string &in_bag_fn, bool trigger_global_loca
     globalLocalizationCallback(empty_srv.request, empty_srv.response);
   }
 
+  // Time the replay itself, not the wait for the map
+  ros::WallTime start(ros::WallTime::now());
+  int scan_count = 0;
+
   BOOST_FOREACH(rosbag::MessageInstance const msg, view)
   {
     if (!ros::ok())
@@ -730,6 +905,7 @@ void AmclNode::runFromBag(const std::string &in_bag_fn, bool trigger_global_loca
     {
       laser_pub.publish(msg);
       laser_scan_filter_->add(base_scan);
+      scan_count++;
       if (bag_scan_period_ > ros::WallDuration(0))
       {
         bag_scan_period_.sleep();
@@ -742,6 +918,9 @@ void AmclNode::runFromBag(const std::string &in_bag_fn, bool trigger_global_loca
 
   bag.close();
 
+  // The scans still waiting in the filter
+  ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration());
+
   double runtime = (ros::WallTime::now() - start).toSec();
   ROS_INFO("Bag complete, took %.1f seconds to process, shutting down", runtime);
 
@@ -754,9 +933,63 @@ void AmclNode::runFromBag(const std::string &in_bag_fn, bool trigger_global_loca
             yaw, last_published_pose.header.stamp.toSec()
             );
 
+  if (!report_fn.empty())
+    writeBagReport(report_fn, in_bag_fn, scan_count, runtime, expected);
+
   ros::shutdown();
 }
 
+/**
+ * Write the report of a run from a bag: the time spent in each stage of the
+ * filter, the particles weighted per second and the final map->odom
+ * transform, as one JSON object.  The cluster stage is the clustering of
+ * the new set at the end of each resampling, which the resample stage
+ * leaves out.  The particles per second are those of the sensor stage.
+ */
+void AmclNode::writeBagReport(const std::string& report_fn, const std::string& in_bag_fn,
+                              int scan_count, double runtime, const double* expected)
+{
+  FILE* file = fopen(report_fn.c_str(), "w");
+  if (file == NULL)
+  {
+    ROS_ERROR("Could not write the report to %s", report_fn.c_str());
+    return;
+  }
+
+  fprintf(file, "{\n  \"bag\": %s,\n", jsonString(in_bag_fn).c_str());
+  fprintf(file, "  \"scans\": %d,\n  \"runtime_s\": %.3f,\n", scan_count, runtime);
+  const char* names[4] = { "motion", "sensor", "resample", "cluster" };
+  const StageTiming* stages[4] = { &motion_timing_, &sensor_timing_, &resample_timing_, &cluster_timing_ };
+  fprintf(file, "  \"stages\": {\n");
+  for (int i = 0; i < 4; i++)
+  {
+    const StageTiming& stage = *stages[i];
+    fprintf(file, "    \"%s\": {\"count\": %d, \"total_ms\": %.3f, \"mean_ms\": %.4f, \"max_ms\": %.3f}%s\n",
+            names[i], stage.count, 1e3 * stage.total, stage.count ? 1e3 * stage.total / stage.count : 0.0,
+            1e3 * stage.max, i < 3 ? "," : "");
+  }
+  fprintf(file, "  },\n");
+  fprintf(file, "  \"particles_per_s\": %.0f,\n",
+          sensor_timing_.total > 0.0 ? sensor_particles_ / sensor_timing_.total : 0.0);
+
+  const geometry_msgs::Pose& pose = last_published_pose.pose.pose;
+  fprintf(file, "  \"final_pose\": {\"x\": %.4f, \"y\": %.4f, \"yaw\": %.4f}",
+          pose.position.x, pose.position.y, tf2::getYaw(pose.orientation));
+  if (latest_tf_valid_)
+  {
+    tf2::Transform map_to_odom = latest_tf_.inverse();
+    double x = map_to_odom.getOrigin().x(), y = map_to_odom.getOrigin().y();
+    double yaw = tf2::getYaw(map_to_odom.getRotation());
+    fprintf(file, ",\n  \"map_to_odom\": {\"x\": %.4f, \"y\": %.4f, \"yaw\": %.4f}", x, y, yaw);
+    if (expected != NULL)
+      fprintf(file, ",\n  \"error\": {\"x\": %.4f, \"y\": %.4f, \"yaw\": %.4f}",
+              fabs(x - expected[0]), fabs(y - expected[1]), fabs(angle_diff(yaw, expected[2])));
+  }
+  fprintf(file, "\n}\n");
+  fclose(file);
+  ROS_INFO("Wrote the report to %s", report_fn.c_str());
+}
+
 
 void AmclNode::savePoseToServer()
 {
@@ -889,20 +1122,15 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
   frame_to_laser_.clear();
 
   map_ = convertMap(msg);
+  map_hash_ = hashMapData(msg);
 
-#if NEW_UNIFORM_SAMPLING
-  // Index of free space
-  free_space_indices.resize(0);
-  for(int i = 0; i < map_->size_x; i++)
-    for(int j = 0; j < map_->size_y; j++)
-      if(map_->cells[MAP_INDEX(map_,i,j)].occ_state == -1)
-        free_space_indices.push_back(std::make_pair(i,j));
-#endif
   // Create the particle filter
   pf_ = pf_alloc(min_particles_, max_particles_,
                  alpha_slow_, alpha_fast_,
                  (pf_init_model_fn_t)AmclNode::uniformPoseGenerator,
                  (void *)map_);
+  if(random_seed_ >= 0)
+    pf_rng_seed(&pf_->rng, random_seed_);
   pf_set_selective_resampling(pf_, selective_resampling_);
   pf_->pop_err = pf_err_;
   pf_->pop_z = pf_z_;
@@ -927,9 +1155,12 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
   ROS_ASSERT(odom_);
   odom_->SetModel( odom_model_type_, alpha1_, alpha2_, alpha3_, alpha4_, alpha5_ );
   // Laser
+  loadCachedLikelihoodField();
+  updateRangeField();
   delete laser_;
   laser_ = new AMCLLaser(max_beams_, map_);
   ROS_ASSERT(laser_);
+  laser_->SetThreadPool(laser_thread_pool_.get());
   if(laser_model_type_ == LASER_MODEL_BEAM)
     laser_->SetModelBeam(z_hit_, z_short_, z_max_, z_rand_,
                          sigma_hit_, lambda_short_, 0.0);
@@ -948,6 +1179,7 @@ AmclNode::handleMapMessage(const nav_msgs::OccupancyGrid& msg)
                                     laser_likelihood_max_dist_);
     ROS_INFO("Done initializing likelihood field model.");
   }
+  updateSampleCells();
 
   // In case the initial pose message arrived before the first map,
   // try to apply the initial pose now that the map has arrived.
@@ -1003,6 +1235,116 @@ AmclNode::convertMap( const nav_msgs::OccupancyGrid& map_msg )
   return map;
 }
 
+/**
+ * Load the likelihood field of the map from the cache directory, or compute
+ * it and save it there when it is not in the cache yet.
+ */
+void
+AmclNode::loadCachedLikelihoodField()
+{
+  if(likelihood_field_cache_dir_.empty() || laser_model_type_ == LASER_MODEL_BEAM || map_ == NULL)
+    return;
+  if(map_->occ_dist_field != NULL && map_->max_occ_dist == laser_likelihood_max_dist_)
+    return;
+
+  // The field depends on the occupied cells, the resolution and the max distance
+  uint64_t key = hashCombine(map_hash_, map_->scale);
+  key = hashCombine(key, laser_likelihood_max_dist_);
+  std::string filename = cacheFilename(key, "cspace");
+
+  if(map_load_cspace(map_, filename.c_str(), laser_likelihood_max_dist_, key) == 0)
+  {
+    ROS_INFO("Loaded the likelihood field from %s", filename.c_str());
+    return;
+  }
+
+  ROS_INFO("The likelihood field is not in the cache, computing it...");
+  map_update_cspace(map_, laser_likelihood_max_dist_);
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(likelihood_field_cache_dir_, error);
+  if(error || map_save_cspace(map_, filename.c_str(), key) != 0)
+    ROS_WARN("Could not save the likelihood field to %s", filename.c_str());
+  else
+    ROS_INFO("Saved the likelihood field to %s", filename.c_str());
+}
+
+/**
+ * Build the set of free cells that global localization spreads particles
+ * over: those inside global_localization_region, weighted by their distance
+ * to obstacles if global_localization_weighted is set.
+ */
+void
+AmclNode::updateSampleCells()
+{
+  if(map_ == NULL)
+    return;
+  // The beam model does not need the likelihood field, so it is only
+  // computed here for the weights
+  if(global_localization_weighted_ && map_->occ_dist_field == NULL)
+    map_update_cspace(map_, laser_likelihood_max_dist_);
+
+  int polygon_count = global_localization_region_.size() / 2;
+  map_update_sample_cells(map_,
+                          polygon_count ? &global_localization_region_[0] : NULL,
+                          polygon_count, global_localization_weighted_);
+  if(map_->sample_cell_count == 0)
+    ROS_WARN("There are no free cells to spread particles over for global localization");
+  else
+    ROS_DEBUG("Global localization samples from %d free cells", map_->sample_cell_count);
+}
+
+/**
+ * Build the range field of the beam model, or load it from the cache
+ * directory when it is there.
+ */
+void
+AmclNode::updateRangeField()
+{
+  if(map_ == NULL)
+    return;
+  if(laser_model_type_ != LASER_MODEL_BEAM || !laser_range_field_)
+  {
+    map_free_range_field(map_);
+    return;
+  }
+  if(map_->range_field != NULL)
+    return;
+
+  // The field depends on the free cells and the resolution
+  uint64_t key = hashCombine(map_hash_, map_->scale);
+  std::string filename;
+  if(!likelihood_field_cache_dir_.empty())
+  {
+    filename = cacheFilename(key, "ranges");
+    if(map_load_range_field(map_, filename.c_str(), key) == 0)
+    {
+      ROS_INFO("Loaded the range field from %s", filename.c_str());
+      return;
+    }
+  }
+
+  map_update_range_field(map_);
+  ROS_INFO("Computed the range field, %.1f MB", map_->size_x * (double)map_->size_y / 1e6);
+
+  if(filename.empty())
+    return;
+  boost::system::error_code error;
+  boost::filesystem::create_directories(likelihood_field_cache_dir_, error);
+  if(error || map_save_range_field(map_, filename.c_str(), key) != 0)
+    ROS_WARN("Could not save the range field to %s", filename.c_str());
+  else
+    ROS_INFO("Saved the range field to %s", filename.c_str());
+}
+
+std::string
+AmclNode::cacheFilename(uint64_t key, const char* extension)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "%016llx.%s", (unsigned long long)key, extension);
+  return (boost::filesystem::path(likelihood_field_cache_dir_) / name).string();
+}
+
 AmclNode::~AmclNode()
 {
   delete dsrv_;
@@ -1040,43 +1382,59 @@ AmclNode::getOdomPose(geometry_msgs::PoseStamped& odom_pose,
 
 
 pf_vector_t
-AmclNode::uniformPoseGenerator(void* arg)
+AmclNode::uniformPoseGenerator(void* arg, pf_rng_t* rng)
 {
   map_t* map = (map_t*)arg;
-#if NEW_UNIFORM_SAMPLING
-  unsigned int rand_index = drand48() * free_space_indices.size();
-  std::pair<int,int> free_point = free_space_indices[rand_index];
-  pf_vector_t p;
-  p.v[0] = MAP_WXGX(map, free_point.first);
-  p.v[1] = MAP_WYGY(map, free_point.second);
-  p.v[2] = drand48() * 2 * M_PI - M_PI;
-#else
-  double min_x, max_x, min_y, max_y;
-
-  min_x = (map->size_x * map->scale)/2.0 - map->origin_x;
-  max_x = (map->size_x * map->scale)/2.0 + map->origin_x;
-  min_y = (map->size_y * map->scale)/2.0 - map->origin_y;
-  max_y = (map->size_y * map->scale)/2.0 + map->origin_y;
+  double u = pf_rng_draw(rng);
+  int cell;
+  map_sample_cells(map, &u, &cell, 1);
 
   pf_vector_t p;
-
-  ROS_DEBUG("Generating new uniform sample");
-  for(;;)
+  if(cell < 0)
   {
-    p.v[0] = min_x + drand48() * (max_x - min_x);
-    p.v[1] = min_y + drand48() * (max_y - min_y);
-    p.v[2] = drand48() * 2 * M_PI - M_PI;
-    // Check that it's a free cell
-    int i,j;
-    i = MAP_GXWX(map, p.v[0]);
-    j = MAP_GYWY(map, p.v[1]);
-    if(MAP_VALID(map,i,j) && (map->cells[MAP_INDEX(map,i,j)].occ_state == -1))
-      break;
+    // Nothing to sample from; fall back to the middle of the map
+    p.v[0] = map->origin_x;
+    p.v[1] = map->origin_y;
   }
-#endif
+  else
+  {
+    p.v[0] = MAP_WXGX(map, cell % map->size_x);
+    p.v[1] = MAP_WYGY(map, cell / map->size_x);
+  }
+  p.v[2] = pf_rng_draw(rng) * 2 * M_PI - M_PI;
   return p;
 }
 
+void
+AmclNode::uniformPoseBatchGenerator(void* arg, pf_rng_t* rng,
+                                    double* x, double* y, double* a,
+                                    int count)
+{
+  map_t* map = (map_t*)arg;
+  std::vector<int> cells(count);
+
+  // The angles are used as scratch space for the cell draws
+  pf_rng_uniform(rng, a, count);
+  map_sample_cells(map, a, &cells[0], count);
+  for(int i = 0; i < count; i++)
+  {
+    if(cells[i] < 0)
+    {
+      x[i] = map->origin_x;
+      y[i] = map->origin_y;
+    }
+    else
+    {
+      x[i] = MAP_WXGX(map, cells[i] % map->size_x);
+      y[i] = MAP_WYGY(map, cells[i] / map->size_x);
+    }
+  }
+
+  pf_rng_uniform(rng, a, count);
+  for(int i = 0; i < count; i++)
+    a[i] = a[i] * 2 * M_PI - M_PI;
+}
+
 bool
 AmclNode::globalLocalizationCallback(std_srvs::Empty::Request& req,
                                      std_srvs::Empty::Response& res)
@@ -1086,8 +1444,8 @@ AmclNode::globalLocalizationCallback(std_srvs::Empty::Request& req,
   }
   boost::recursive_mutex::scoped_lock gl(configuration_mutex_);
   ROS_INFO("Initializing with uniform distribution");
-  pf_init_model(pf_, (pf_init_model_fn_t)AmclNode::uniformPoseGenerator,
-                (void *)map_);
+  pf_init_model_batch(pf_, (pf_init_batch_fn_t)AmclNode::uniformPoseBatchGenerator,
+                      (void *)map_);
   ROS_INFO("Global initialisation done!");
   pf_init_ = false;
   return true;
@@ -1232,7 +1590,9 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
     odata.delta = delta;
 
     // Use the action data to update the filter
+    ros::WallTime motion_start = ros::WallTime::now();
     odom_->UpdateAction(pf_, (AMCLSensorData*)&odata);
+    motion_timing_.add(motion_start);
 
     // Pose at last filter update
     //this->pf_odom_pose = pose;
@@ -1306,7 +1666,10 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
               (i * angle_increment);
     }
 
+    ros::WallTime sensor_start = ros::WallTime::now();
     lasers_[laser_index]->UpdateSensor(pf_, (AMCLSensorData*)&ldata);
+    sensor_timing_.add(sensor_start);
+    sensor_particles_ += pf_->sets[pf_->current_set].sample_count;
 
     lasers_update_[laser_index] = false;
 
@@ -1315,7 +1678,12 @@ AmclNode::laserReceived(const sensor_msgs::LaserScanConstPtr& laser_scan)
     // Resample the particles
     if(!(++resample_count_ % resample_interval_))
     {
+      ros::WallTime resample_start = ros::WallTime::now();
       pf_update_resample(pf_);
+      // The clustering of the new set is timed on its own
+      double resample_time = (ros::WallTime::now() - resample_start).toSec();
+      resample_timing_.add(std::max(0.0, resample_time - pf_->cluster_time));
+      cluster_timing_.add(pf_->cluster_time);
       resampled = true;
     }
 
@@ -0,0 +1,185 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Benchmark of map_update_cspace against the priority queue wavefront it
+ * replaced, which is the AMCL startup cost of a map.  Both run on the same
+ * map and the distances are compared; the wavefront only approximates the
+ * Euclidean distance, so it can be larger than the exact distance in a few
+ * cells.
+ *
+ * Usage: cspace_benchmark [map.pgm|-] [scale] [max_occ_dist] [iterations]
+ * Without a map, a synthetic 8000x6000 map is used.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+#include "amcl/map/map.h"
+
+struct CellData
+{
+  double distance;
+  int i, j;
+  int src_i, src_j;
+
+  bool operator<(const CellData& other) const
+  {
+    return distance > other.distance;
+  }
+};
+
+// The previous algorithm: a wavefront from the occupied cells, ordered by a
+// priority queue on the distance to the source of each cell
+std::vector<double> referenceCspace(map_t* map, double max_occ_dist)
+{
+  int cell_radius = max_occ_dist / map->scale;
+  std::vector<double> occ_dist(map->size_x * map->size_y, max_occ_dist);
+  std::vector<unsigned char> marked(map->size_x * map->size_y, 0);
+  std::priority_queue<CellData> queue;
+
+  for (int i = 0; i < map->size_x; i++)
+  {
+    for (int j = 0; j < map->size_y; j++)
+    {
+      if (map->cells[MAP_INDEX(map, i, j)].occ_state == +1)
+      {
+        CellData cell = { 0.0, i, j, i, j };
+        occ_dist[MAP_INDEX(map, i, j)] = 0.0;
+        marked[MAP_INDEX(map, i, j)] = 1;
+        queue.push(cell);
+      }
+    }
+  }
+
+  const int ni[4] = { -1, 0, 1, 0 };
+  const int nj[4] = { 0, -1, 0, 1 };
+  while (!queue.empty())
+  {
+    // popping after the neighbours are pushed, as the previous code did
+    CellData current = queue.top();
+    for (int n = 0; n < 4; n++)
+    {
+      int i = current.i + ni[n], j = current.j + nj[n];
+      if (!MAP_VALID(map, i, j) || marked[MAP_INDEX(map, i, j)])
+        continue;
+      int di = i - current.src_i, dj = j - current.src_j;
+      double distance = sqrt(di * di + dj * dj);
+      if (distance > cell_radius)
+        continue;
+      occ_dist[MAP_INDEX(map, i, j)] = distance * map->scale;
+      marked[MAP_INDEX(map, i, j)] = 1;
+      CellData cell = { distance, i, j, current.src_i, current.src_j };
+      queue.push(cell);
+    }
+    queue.pop();
+  }
+  return occ_dist;
+}
+
+// Walls every 5 m with doors in them, and scattered obstacles, which is
+// roughly what a warehouse map looks like
+map_t* syntheticMap(int size_x, int size_y, double scale)
+{
+  map_t* map = map_alloc();
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->scale = scale;
+  map->cells = (map_cell_t*) calloc(size_x * size_y, sizeof(map_cell_t));
+  srand(42);
+  for (int j = 0; j < size_y; j++)
+  {
+    for (int i = 0; i < size_x; i++)
+    {
+      bool wall = (i % 100 == 0 && (j / 40) % 4 != 0) || (j % 100 == 0 && (i / 40) % 4 != 0);
+      bool clutter = rand() % 1000 == 0;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = (wall || clutter) ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+  const char* filename = argc > 1 ? argv[1] : "-";
+  double scale = argc > 2 ? atof(argv[2]) : 0.05;
+  double max_occ_dist = argc > 3 ? atof(argv[3]) : 2.0;
+  int iterations = argc > 4 ? atoi(argv[4]) : 3;
+
+  map_t* map;
+  if (strcmp(filename, "-") == 0)
+  {
+    map = syntheticMap(8000, 6000, scale);
+  }
+  else
+  {
+    map = map_alloc();
+    if (map_load_occ(map, filename, scale, 0) != 0)
+      return 1;
+  }
+  printf("map: %d x %d cells at %.3f m, max_occ_dist %.2f m\n",
+         map->size_x, map->size_y, scale, max_occ_dist);
+
+  double edt_time = 0.0, reference_time = 0.0;
+  std::vector<double> reference;
+  for (int it = 0; it < iterations; it++)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    map_update_cspace(map, max_occ_dist);
+    edt_time += elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    reference = referenceCspace(map, max_occ_dist);
+    reference_time += elapsedMs(start);
+  }
+
+  int larger = 0, smaller = 0;
+  double max_difference = 0.0;
+  for (int index = 0; index < map->size_x * map->size_y; index++)
+  {
+    double difference = reference[index] - MAP_OCC_DIST(map, index);
+    if (difference > 1e-9)
+      larger++;
+    else if (difference < -1e-9)
+      smaller++;
+    max_difference = std::max(max_difference, fabs(difference));
+  }
+
+  printf("distance transform: %8.1f ms\n", edt_time / iterations);
+  printf("wavefront:          %8.1f ms\n", reference_time / iterations);
+  printf("speedup:            %8.2fx\n", reference_time / edt_time);
+  printf("cells where the wavefront is larger: %d (max %.4f m), smaller: %d\n",
+         larger, max_difference, smaller);
+
+  map_free(map);
+
+  // The wavefront can overestimate, but never underestimate, the distance
+  return smaller == 0 ? 0 : 1;
+}
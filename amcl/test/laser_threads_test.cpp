@@ -0,0 +1,162 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks that weighting the samples on a thread pool gives exactly the
+ * weights of the serial laser models.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "amcl/map/map.h"
+#include "amcl/pf/pf.h"
+#include "amcl/sensors/amcl_laser.h"
+#include "amcl/thread_pool.h"
+
+using namespace amcl;
+
+// A 10 x 8 m room with some clutter
+static map_t* makeMap()
+{
+  map_t* map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = 200;
+  map->size_y = 160;
+  map->origin_x = 5.0;
+  map->origin_y = 4.0;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * map->size_x * map->size_y);
+
+  srand(11);
+  for (int j = 0; j < map->size_y; j++)
+  {
+    for (int i = 0; i < map->size_x; i++)
+    {
+      bool wall = i < 2 || j < 2 || i >= map->size_x - 2 || j >= map->size_y - 2;
+      bool clutter = rand() % 300 == 0;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = (wall || clutter) ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+// A scan from the given laser pose, with some of the readings at max range
+static void makeScan(map_t* map, pf_vector_t pose, AMCLLaserData* data)
+{
+  data->range_count = 180;
+  data->range_max = 8.0;
+  data->ranges = new double[data->range_count][2];
+  for (int i = 0; i < data->range_count; i++)
+  {
+    double bearing = -M_PI / 2 + M_PI * i / data->range_count;
+    double range = map_calc_range(map, pose.v[0], pose.v[1], pose.v[2] + bearing, data->range_max);
+    data->ranges[i][0] = i % 17 == 0 ? data->range_max : range;
+    data->ranges[i][1] = bearing;
+  }
+}
+
+enum Model { BEAM, LIKELIHOOD_FIELD, LIKELIHOOD_FIELD_PROB };
+
+static void setModel(AMCLLaser* laser, Model model)
+{
+  if (model == BEAM)
+    laser->SetModelBeam(0.5, 0.05, 0.05, 0.5, 0.2, 0.1, 0.0);
+  else if (model == LIKELIHOOD_FIELD)
+    laser->SetModelLikelihoodField(0.5, 0.5, 0.2, 2.0);
+  else
+    laser->SetModelLikelihoodFieldProb(0.5, 0.5, 0.2, 2.0, true, 0.5, 0.3, 0.9);
+}
+
+// Weight the same samples serially and on the pool and compare the weights
+static void compareWeights(Model model)
+{
+  map_t* map = makeMap();
+  pf_t* serial_pf = pf_alloc(500, 3000, 0.0, 0.0, NULL, NULL);
+  pf_t* threaded_pf = pf_alloc(500, 3000, 0.0, 0.0, NULL, NULL);
+  pf_rng_seed(&serial_pf->rng, 3);
+
+  pf_vector_t mean = pf_vector_zero();
+  mean.v[0] = 0.5;
+  mean.v[1] = -0.5;
+  mean.v[2] = 0.3;
+  pf_matrix_t cov = pf_matrix_zero();
+  cov.m[0][0] = 0.5;
+  cov.m[1][1] = 0.5;
+  cov.m[2][2] = 0.2;
+  pf_init(serial_pf, mean, cov);
+  pf_init(threaded_pf, mean, cov);
+
+  pf_sample_set_t* serial_set = serial_pf->sets + serial_pf->current_set;
+  pf_sample_set_t* threaded_set = threaded_pf->sets + threaded_pf->current_set;
+  ASSERT_EQ(serial_set->sample_count, threaded_set->sample_count);
+  memcpy(threaded_set->samples, serial_set->samples, sizeof(pf_sample_t) * serial_set->sample_count);
+
+  AMCLLaser serial_laser(60, map), threaded_laser(60, map);
+  pf_vector_t laser_pose = pf_vector_zero();
+  laser_pose.v[0] = 0.1;
+  serial_laser.SetLaserPose(laser_pose);
+  threaded_laser.SetLaserPose(laser_pose);
+  setModel(&serial_laser, model);
+  setModel(&threaded_laser, model);
+  ThreadPool pool(4);
+  threaded_laser.SetThreadPool(&pool);
+
+  AMCLLaserData serial_data, threaded_data;
+  serial_data.sensor = &serial_laser;
+  threaded_data.sensor = &threaded_laser;
+  makeScan(map, pf_vector_add(mean, laser_pose), &serial_data);
+  makeScan(map, pf_vector_add(mean, laser_pose), &threaded_data);
+
+  ASSERT_TRUE(serial_laser.UpdateSensor(serial_pf, &serial_data));
+  ASSERT_TRUE(threaded_laser.UpdateSensor(threaded_pf, &threaded_data));
+
+  for (int i = 0; i < serial_set->sample_count; i++)
+    ASSERT_EQ(serial_set->samples[i].weight, threaded_set->samples[i].weight) << "sample " << i;
+  EXPECT_EQ(serial_pf->w_slow, threaded_pf->w_slow);
+  EXPECT_EQ(serial_pf->w_fast, threaded_pf->w_fast);
+
+  pf_free(serial_pf);
+  pf_free(threaded_pf);
+  map_free(map);
+}
+
+TEST(LaserThreads, BeamModel)
+{
+  compareWeights(BEAM);
+}
+
+TEST(LaserThreads, LikelihoodFieldModel)
+{
+  compareWeights(LIKELIHOOD_FIELD);
+}
+
+TEST(LaserThreads, LikelihoodFieldProbModel)
+{
+  compareWeights(LIKELIHOOD_FIELD_PROB);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
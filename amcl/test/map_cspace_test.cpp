@@ -0,0 +1,158 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks the likelihood field of map_update_cspace against a brute force
+ * distance to every occupied cell.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "amcl/map/map.h"
+
+// A map with a few walls and scattered occupied cells; large enough to be
+// split into several stripes
+static map_t* makeMap(int size_x, int size_y, double scale, int clutter, unsigned int seed)
+{
+  map_t* map = map_alloc();
+  map->scale = scale;
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * size_x * size_y);
+
+  srand(seed);
+  for (int j = 0; j < size_y; j++)
+  {
+    for (int i = 0; i < size_x; i++)
+    {
+      bool wall = (i == size_x / 3 && j < size_y / 2) || (j == 2 * size_y / 3 && i > size_x / 4);
+      map->cells[MAP_INDEX(map, i, j)].occ_state = (wall || rand() % clutter == 0) ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+// The exact distance from each cell to its nearest occupied cell, in cells
+static std::vector<double> bruteForceDistances(map_t* map)
+{
+  std::vector<int> occupied;
+  for (int c = 0; c < map->size_x * map->size_y; c++)
+    if (map->cells[c].occ_state == +1)
+      occupied.push_back(c);
+
+  std::vector<double> distances(map->size_x * map->size_y, HUGE_VAL);
+  for (int j = 0; j < map->size_y; j++)
+  {
+    for (int i = 0; i < map->size_x; i++)
+    {
+      long best = -1;
+      for (size_t o = 0; o < occupied.size(); o++)
+      {
+        long dx = i - occupied[o] % map->size_x, dy = j - occupied[o] / map->size_x;
+        long sq = dx * dx + dy * dy;
+        if (best < 0 || sq < best)
+          best = sq;
+      }
+      if (best >= 0)
+        distances[MAP_INDEX(map, i, j)] = sqrt((double)best);
+    }
+  }
+  return distances;
+}
+
+// Within 500 cells every squared distance has its own code, so the field is exact
+TEST(MapCspace, ExactWithinRadius)
+{
+  map_t* map = makeMap(300, 200, 0.05, 2000, 1);
+  double max_occ_dist = 2.0;
+  map_update_cspace(map, max_occ_dist);
+  std::vector<double> expected = bruteForceDistances(map);
+
+  ASSERT_DOUBLE_EQ(max_occ_dist, map->occ_dist_table[map->occ_dist_table_size - 1]);
+  for (int c = 0; c < map->size_x * map->size_y; c++)
+  {
+    double d = expected[c] * map->scale;
+    double field = map->occ_dist_table[map->occ_dist_field[c]];
+    if (d > max_occ_dist)
+      ASSERT_DOUBLE_EQ(max_occ_dist, field) << "cell " << c;
+    else
+      ASSERT_DOUBLE_EQ(d, field) << "cell " << c;
+  }
+  map_free(map);
+}
+
+// Beyond that, the farthest squared distances share a code, whose distance
+// is the smallest of them, and the near ones stay exact
+TEST(MapCspace, SharedCodesBeyond500Cells)
+{
+  map_t* map = makeMap(700, 500, 0.05, 40000, 2);
+  double max_occ_dist = 35.0;
+  map_update_cspace(map, max_occ_dist);
+  std::vector<double> expected = bruteForceDistances(map);
+
+  ASSERT_EQ(65536, map->occ_dist_table_size);
+  for (int i = 1; i < map->occ_dist_table_size - 1; i++)
+    ASSERT_LT(map->occ_dist_table[i - 1], map->occ_dist_table[i]);
+
+  for (int c = 0; c < map->size_x * map->size_y; c++)
+  {
+    double d = expected[c] * map->scale;
+    double field = map->occ_dist_table[map->occ_dist_field[c]];
+    if (d > max_occ_dist)
+    {
+      ASSERT_DOUBLE_EQ(max_occ_dist, field) << "cell " << c;
+      continue;
+    }
+    if (expected[c] <= 200)
+    {
+      ASSERT_DOUBLE_EQ(d, field) << "cell " << c;
+    }
+    ASSERT_LE(field, d + 1e-9) << "cell " << c;
+    ASSERT_LT(d - field, 0.05 * map->scale) << "cell " << c;
+  }
+  map_free(map);
+}
+
+// A second update, with another radius, replaces the first one
+TEST(MapCspace, Update)
+{
+  map_t* map = makeMap(130, 140, 0.1, 500, 3);
+  map_update_cspace(map, 3.0);
+  map_update_cspace(map, 1.0);
+  std::vector<double> expected = bruteForceDistances(map);
+
+  for (int c = 0; c < map->size_x * map->size_y; c++)
+  {
+    double d = std::min(expected[c] * map->scale, 1.0);
+    ASSERT_DOUBLE_EQ(d, map->occ_dist_table[map->occ_dist_field[c]]) << "cell " << c;
+  }
+  map_free(map);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,185 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks the range field against a brute force chessboard distance, and
+ * that map_lookup_range gives exactly the ranges of map_calc_range, also
+ * with a field loaded from a file.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "amcl/map/map.h"
+
+// A room with a wall, scattered occupied and unknown cells, and an opening
+// in its outer wall so that some rays leave the map
+static map_t* makeMap(int size_x, int size_y, int clutter, unsigned int seed)
+{
+  map_t* map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->origin_x = 1.0;
+  map->origin_y = -2.0;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * size_x * size_y);
+
+  srand(seed);
+  for (int j = 0; j < size_y; j++)
+  {
+    for (int i = 0; i < size_x; i++)
+    {
+      bool wall = (i == 0 || j == 0 || i == size_x - 1 || j == size_y - 1) && j < size_y / 2;
+      wall = wall || (i == size_x / 2 && j > size_y / 4);
+      int r = rand() % clutter;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = (wall || r == 0) ? +1 : (r == 1 ? 0 : -1);
+    }
+  }
+  return map;
+}
+
+// The chessboard distance from each cell to the nearest cell that is not
+// free or beyond the edge of the map
+static int bruteForceDistance(map_t* map, int i, int j)
+{
+  int best = std::min(std::min(i + 1, map->size_x - i), std::min(j + 1, map->size_y - j));
+  for (int n = 0; n < map->size_y; n++)
+  {
+    for (int m = 0; m < map->size_x; m++)
+    {
+      if (map->cells[MAP_INDEX(map, m, n)].occ_state > -1)
+        best = std::min(best, std::max(abs(m - i), abs(n - j)));
+    }
+  }
+  return std::min(best, MAP_RANGE_FIELD_MAX);
+}
+
+// Compare the ranges of both functions for random poses, also outside of
+// the map and in cells that are not free, and random directions
+static void compareRanges(map_t* map, int count, unsigned int seed)
+{
+  srand(seed);
+  double width = map->size_x * map->scale, height = map->size_y * map->scale;
+  double max_ranges[] = { 0.01, 0.07, 1.0, 8.0, 100.0 };
+  for (int k = 0; k < count; k++)
+  {
+    double x = map->origin_x + (rand() / (double)RAND_MAX - 0.5) * 1.1 * width;
+    double y = map->origin_y + (rand() / (double)RAND_MAX - 0.5) * 1.1 * height;
+    double a = (rand() / (double)RAND_MAX * 2 - 1) * 4 * M_PI;
+    double max_range = max_ranges[k % 5];
+    ASSERT_EQ(map_calc_range(map, x, y, a, max_range), map_lookup_range(map, x, y, a, max_range))
+        << "pose " << x << ", " << y << ", " << a << " max_range " << max_range;
+  }
+}
+
+TEST(MapRange, FieldIsChessboardDistance)
+{
+  map_t* map = makeMap(90, 70, 150, 1);
+  map_update_range_field(map);
+  ASSERT_TRUE(map->range_field != NULL);
+  for (int j = 0; j < map->size_y; j++)
+  {
+    for (int i = 0; i < map->size_x; i++)
+    {
+      int expected = map->cells[MAP_INDEX(map, i, j)].occ_state > -1 ? 0 : bruteForceDistance(map, i, j);
+      ASSERT_EQ(expected, map->range_field[MAP_INDEX(map, i, j)]) << "cell " << i << ", " << j;
+    }
+  }
+  map_free(map);
+}
+
+TEST(MapRange, LookupMatchesCalc)
+{
+  map_t* map = makeMap(300, 200, 400, 2);
+  map_update_range_field(map);
+  compareRanges(map, 200000, 3);
+  map_free(map);
+}
+
+// Large free areas, where the field is capped and the rays take the
+// longest jumps
+TEST(MapRange, LookupMatchesCalcInOpenSpace)
+{
+  map_t* map = makeMap(1200, 700, 1000000, 4);
+  map_update_range_field(map);
+  int far = 0;
+  for (int c = 0; c < map->size_x * map->size_y; c++)
+    if (map->range_field[c] == MAP_RANGE_FIELD_MAX)
+      far++;
+  EXPECT_GT(far, 0);
+  compareRanges(map, 100000, 5);
+  map_free(map);
+}
+
+// The beam model traces from the particles in every direction; check the
+// rays from cell centers along every one of 360 directions
+TEST(MapRange, LookupMatchesCalcFromCellCenters)
+{
+  map_t* map = makeMap(160, 120, 300, 6);
+  map_update_range_field(map);
+  for (int j = 0; j < map->size_y; j += 3)
+  {
+    for (int i = 0; i < map->size_x; i += 3)
+    {
+      double x = MAP_WXGX(map, i), y = MAP_WYGY(map, j);
+      for (int a = 0; a < 360; a++)
+      {
+        double oa = a * M_PI / 180;
+        ASSERT_EQ(map_calc_range(map, x, y, oa, 10.0), map_lookup_range(map, x, y, oa, 10.0))
+            << "cell " << i << ", " << j << " angle " << a;
+      }
+    }
+  }
+  map_free(map);
+}
+
+TEST(MapRange, LookupAfterLoad)
+{
+  char name[] = "/tmp/amcl_map_range_testXXXXXX";
+  int fd = mkstemp(name);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  map_t* map = makeMap(200, 150, 300, 7);
+  map_update_range_field(map);
+  ASSERT_EQ(0, map_save_range_field(map, name, 11));
+  map_free(map);
+
+  map_t* loaded = makeMap(200, 150, 300, 7);
+  ASSERT_EQ(0, map_load_range_field(loaded, name, 11));
+  compareRanges(loaded, 50000, 8);
+
+  // a computed field replaces the loaded one
+  map_update_range_field(loaded);
+  compareRanges(loaded, 10000, 9);
+  map_free(loaded);
+  remove(name);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,275 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks the cells that global localization samples from against a brute
+ * force list of the free cells inside the region: that the k-th cell of the
+ * list is drawn for the k-th slice of [0, 1), and with weights that each
+ * cell is drawn for its own slice of the total weight, also with long runs
+ * of words without any cell.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "amcl/map/map.h"
+
+// Free space with scattered obstacles and unknown cells; rows from
+// empty_begin to empty_end are all occupied, for runs of empty words
+static map_t* makeMap(int size_x, int size_y, int empty_begin, int empty_end, unsigned int seed)
+{
+  map_t* map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->origin_x = 1.3;
+  map->origin_y = -0.7;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * size_x * size_y);
+
+  srand(seed);
+  for (int j = 0; j < size_y; j++)
+  {
+    for (int i = 0; i < size_x; i++)
+    {
+      int r = rand() % 20;
+      int state = r == 0 ? +1 : (r == 1 ? 0 : -1);
+      if (j >= empty_begin && j < empty_end)
+        state = +1;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = state;
+    }
+  }
+  return map;
+}
+
+// Whether the point is inside the polygon, by the parity of the edges that
+// cross its row at or before it.  Like the sampler, an edge covers the rows
+// from its lower end up to but not including its upper end.
+static bool insidePolygon(const std::vector<double>& polygon, double x, double y)
+{
+  int count = polygon.size() / 2;
+  bool inside = false;
+  for (int a = 0; a < count; a++)
+  {
+    int b = (a + 1) % count;
+    double xa = polygon[2 * a], ya = polygon[2 * a + 1];
+    double xb = polygon[2 * b], yb = polygon[2 * b + 1];
+    if ((ya <= y && y < yb) || (yb <= y && y < ya))
+    {
+      if (xa + (y - ya) * (xb - xa) / (yb - ya) <= x)
+        inside = !inside;
+    }
+  }
+  return inside;
+}
+
+// The free cells inside the polygon, in the order of the map
+static std::vector<int> bruteForceCells(map_t* map, const std::vector<double>& polygon)
+{
+  std::vector<int> cells;
+  for (int j = 0; j < map->size_y; j++)
+  {
+    for (int i = 0; i < map->size_x; i++)
+    {
+      int cell = MAP_INDEX(map, i, j);
+      if (map->cells[cell].occ_state != -1)
+        continue;
+      if (polygon.size() >= 6 && !insidePolygon(polygon, MAP_WXGX(map, i), MAP_WYGY(map, j)))
+        continue;
+      cells.push_back(cell);
+    }
+  }
+  return cells;
+}
+
+// Draw the middle of the slice of each cell and compare with the list
+static void checkUniform(map_t* map, const std::vector<double>& polygon)
+{
+  map_update_sample_cells(map, polygon.empty() ? NULL : &polygon[0], polygon.size() / 2, 0);
+  std::vector<int> expected = bruteForceCells(map, polygon);
+  ASSERT_EQ((int)expected.size(), map->sample_cell_count);
+  ASSERT_GT(expected.size(), 0u);
+
+  int n = expected.size();
+  std::vector<double> u(n);
+  for (int k = 0; k < n; k++)
+    u[k] = (k + 0.5) / n;
+  std::vector<int> cells(n);
+  map_sample_cells(map, &u[0], &cells[0], n);
+  for (int k = 0; k < n; k++)
+    ASSERT_EQ(expected[k], cells[k]) << "cell " << k << " of " << n;
+
+  // The ends of [0, 1)
+  double ends[2] = { 0.0, 1.0 - 1e-12 };
+  int end_cells[2];
+  map_sample_cells(map, ends, end_cells, 2);
+  EXPECT_EQ(expected.front(), end_cells[0]);
+  EXPECT_EQ(expected.back(), end_cells[1]);
+}
+
+// A polygon of count vertices at random radii around a center, which is
+// concave for most draws
+static std::vector<double> makePolygon(double cx, double cy, double radius, int count)
+{
+  std::vector<double> polygon;
+  for (int k = 0; k < count; k++)
+  {
+    double a = 2 * M_PI * k / count;
+    double r = radius * (0.3 + 0.7 * rand() / (double)RAND_MAX);
+    polygon.push_back(cx + r * cos(a));
+    polygon.push_back(cy + r * sin(a));
+  }
+  return polygon;
+}
+
+TEST(MapSample, AllFreeCells)
+{
+  // Sizes that do not fill the last word, and more cells than are kept
+  // between the selected words
+  map_t* map = makeMap(333, 217, 0, 0, 1);
+  checkUniform(map, std::vector<double>());
+  map_free(map);
+}
+
+TEST(MapSample, RunsOfEmptyWords)
+{
+  map_t* map = makeMap(200, 300, 20, 280, 2);
+  checkUniform(map, std::vector<double>());
+  map_free(map);
+}
+
+TEST(MapSample, PolygonRegion)
+{
+  map_t* map = makeMap(300, 240, 100, 130, 3);
+  double width = map->size_x * map->scale, height = map->size_y * map->scale;
+  srand(4);
+  for (int k = 0; k < 20; k++)
+  {
+    // Some of the polygons reach beyond the map
+    std::vector<double> polygon = makePolygon(map->origin_x + (rand() / (double)RAND_MAX - 0.5) * width,
+                                              map->origin_y + (rand() / (double)RAND_MAX - 0.5) * height,
+                                              0.5 * width, 3 + k % 8);
+    checkUniform(map, polygon);
+  }
+  map_free(map);
+}
+
+// Vertices and horizontal edges on the rows of the cell centers, and
+// vertical edges on the columns
+TEST(MapSample, PolygonOnCellCenters)
+{
+  map_t* map = makeMap(100, 80, 0, 0, 5);
+  double x0 = MAP_WXGX(map, 10), x1 = MAP_WXGX(map, 60), x2 = MAP_WXGX(map, 90);
+  double y0 = MAP_WYGY(map, 5), y1 = MAP_WYGY(map, 40), y2 = MAP_WYGY(map, 70);
+  double points[] = { x0, y0, x2, y0, x2, y1, x1, y1, x1, y2, x0, y2 };
+  std::vector<double> polygon(points, points + 12);
+  checkUniform(map, polygon);
+  map_free(map);
+
+  // A diamond with its corners on cell centers
+  map = makeMap(100, 80, 0, 0, 6);
+  double diamond[] = { MAP_WXGX(map, 50), MAP_WYGY(map, 2), MAP_WXGX(map, 90), MAP_WYGY(map, 40),
+                       MAP_WXGX(map, 50), MAP_WYGY(map, 78), MAP_WXGX(map, 10), MAP_WYGY(map, 40) };
+  checkUniform(map, std::vector<double>(diamond, diamond + 8));
+  map_free(map);
+}
+
+TEST(MapSample, NoCells)
+{
+  map_t* map = makeMap(50, 40, 0, 40, 7);
+  map_update_sample_cells(map, NULL, 0, 0);
+  EXPECT_EQ(0, map->sample_cell_count);
+  double u[3] = { 0.0, 0.5, 0.99 };
+  int cells[3];
+  map_sample_cells(map, u, cells, 3);
+  for (int k = 0; k < 3; k++)
+    EXPECT_EQ(-1, cells[k]);
+
+  // A region outside the map
+  map_free(map);
+  map = makeMap(50, 40, 0, 0, 7);
+  double far[] = { 100.0, 100.0, 101.0, 100.0, 101.0, 101.0 };
+  map_update_sample_cells(map, far, 3, 0);
+  EXPECT_EQ(0, map->sample_cell_count);
+  map_free(map);
+}
+
+// Each cell is drawn for the middle of its own share of the total weight,
+// in the order of the map, with and without a region
+TEST(MapSample, WeightedByDistance)
+{
+  map_t* map = makeMap(260, 300, 60, 250, 8);
+  map_update_cspace(map, 0.5);
+  srand(9);
+  std::vector<double> region = makePolygon(map->origin_x, map->origin_y - 5.5, 4.0, 7);
+  for (int r = 0; r < 2; r++)
+  {
+    std::vector<double> polygon = r == 0 ? std::vector<double>() : region;
+    map_update_sample_cells(map, polygon.empty() ? NULL : &polygon[0], polygon.size() / 2, 1);
+    ASSERT_TRUE(map->sample_weight != NULL) << "region " << r;
+
+    std::vector<int> expected = bruteForceCells(map, polygon);
+    ASSERT_EQ((int)expected.size(), map->sample_cell_count);
+    double total = 0.0;
+    for (size_t k = 0; k < expected.size(); k++)
+      total += MAP_OCC_DIST(map, expected[k]);
+
+    std::vector<double> u;
+    std::vector<int> drawn;
+    double before = 0.0;
+    for (size_t k = 0; k < expected.size(); k++)
+    {
+      double weight = MAP_OCC_DIST(map, expected[k]);
+      ASSERT_GT(weight, 0.0);
+      u.push_back((before + 0.5 * weight) / total);
+      drawn.push_back(expected[k]);
+      before += weight;
+    }
+    std::vector<int> cells(u.size());
+    map_sample_cells(map, &u[0], &cells[0], u.size());
+    for (size_t k = 0; k < u.size(); k++)
+      ASSERT_EQ(drawn[k], cells[k]) << "cell " << k << " of " << u.size();
+
+    double ends[2] = { 0.0, 1.0 - 1e-12 };
+    int end_cells[2];
+    map_sample_cells(map, ends, end_cells, 2);
+    EXPECT_EQ(expected.front(), end_cells[0]);
+    EXPECT_EQ(expected.back(), end_cells[1]);
+  }
+  map_free(map);
+}
+
+// Without the likelihood field there are no weights to sample by
+TEST(MapSample, WeightedWithoutField)
+{
+  map_t* map = makeMap(100, 80, 0, 0, 10);
+  map_update_sample_cells(map, NULL, 0, 1);
+  EXPECT_TRUE(map->sample_weight == NULL);
+  checkUniform(map, std::vector<double>());
+  map_free(map);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,178 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks that the cspace and range field caches of map_store.c load what
+ * was saved, and reject files saved for another map or other parameters.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "amcl/map/map.h"
+
+static map_t* makeMap(int size_x, int size_y, unsigned int seed)
+{
+  map_t* map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * size_x * size_y);
+
+  srand(seed);
+  for (int j = 0; j < size_y; j++)
+  {
+    for (int i = 0; i < size_x; i++)
+    {
+      bool wall = i == 0 || j == 0 || i == size_x - 1 || j == size_y - 1;
+      int r = rand() % 100;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = (wall || r == 0) ? +1 : (r == 1 ? 0 : -1);
+    }
+  }
+  return map;
+}
+
+// A file name that is removed with the fixture
+class MapStore : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char name[] = "/tmp/amcl_map_store_testXXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    filename = name;
+  }
+
+  virtual void TearDown()
+  {
+    remove(filename.c_str());
+  }
+
+  std::string filename;
+};
+
+TEST_F(MapStore, CspaceRoundTrip)
+{
+  map_t* map = makeMap(120, 90, 1);
+  map_update_cspace(map, 1.0);
+  ASSERT_EQ(0, map_save_cspace(map, filename.c_str(), 42));
+
+  map_t* loaded = makeMap(120, 90, 1);
+  ASSERT_EQ(0, map_load_cspace(loaded, filename.c_str(), 1.0, 42));
+  ASSERT_EQ(map->occ_dist_table_size, loaded->occ_dist_table_size);
+  EXPECT_EQ(map->max_occ_dist, loaded->max_occ_dist);
+  EXPECT_EQ(0, memcmp(map->occ_dist_table, loaded->occ_dist_table, sizeof(double) * map->occ_dist_table_size));
+  EXPECT_EQ(0, memcmp(map->occ_dist_field, loaded->occ_dist_field, sizeof(uint16_t) * map->size_x * map->size_y));
+
+  // a loaded field is replaced by a computed one on the next update
+  map_update_cspace(loaded, 1.0);
+  EXPECT_EQ(0, memcmp(map->occ_dist_field, loaded->occ_dist_field, sizeof(uint16_t) * map->size_x * map->size_y));
+
+  map_free(map);
+  map_free(loaded);
+}
+
+TEST_F(MapStore, CspaceRejectsMismatches)
+{
+  map_t* map = makeMap(120, 90, 1);
+  map_update_cspace(map, 1.0);
+  ASSERT_EQ(0, map_save_cspace(map, filename.c_str(), 42));
+
+  map_t* other = makeMap(120, 90, 1);
+  EXPECT_NE(0, map_load_cspace(other, filename.c_str(), 1.0, 43));
+  EXPECT_NE(0, map_load_cspace(other, filename.c_str(), 2.0, 42));
+  EXPECT_EQ(NULL, other->occ_dist_field);
+  map_free(other);
+
+  map_t* larger = makeMap(121, 90, 1);
+  EXPECT_NE(0, map_load_cspace(larger, filename.c_str(), 1.0, 42));
+  map_free(larger);
+
+  map_t* finer = makeMap(120, 90, 1);
+  finer->scale = 0.025;
+  EXPECT_NE(0, map_load_cspace(finer, filename.c_str(), 1.0, 42));
+  map_free(finer);
+
+  // a truncated file is rejected too
+  ASSERT_EQ(0, truncate(filename.c_str(), 1000));
+  map_t* truncated = makeMap(120, 90, 1);
+  EXPECT_NE(0, map_load_cspace(truncated, filename.c_str(), 1.0, 42));
+  map_free(truncated);
+
+  EXPECT_NE(0, map_load_cspace(map, "/nonexistent/amcl_cspace", 1.0, 42));
+  map_free(map);
+}
+
+TEST_F(MapStore, RangeFieldRoundTrip)
+{
+  map_t* map = makeMap(100, 80, 2);
+  map_update_range_field(map);
+  ASSERT_TRUE(map->range_field != NULL);
+  ASSERT_EQ(0, map_save_range_field(map, filename.c_str(), 7));
+
+  map_t* loaded = makeMap(100, 80, 2);
+  ASSERT_EQ(0, map_load_range_field(loaded, filename.c_str(), 7));
+  EXPECT_EQ(0, memcmp(map->range_field, loaded->range_field, map->size_x * map->size_y));
+
+  map_free(map);
+  map_free(loaded);
+}
+
+TEST_F(MapStore, RangeFieldRejectsMismatches)
+{
+  map_t* map = makeMap(100, 80, 2);
+  map_update_range_field(map);
+  ASSERT_EQ(0, map_save_range_field(map, filename.c_str(), 7));
+
+  map_t* other = makeMap(100, 80, 2);
+  EXPECT_NE(0, map_load_range_field(other, filename.c_str(), 8));
+  EXPECT_EQ(NULL, other->range_field);
+  map_free(other);
+
+  // the same size and key, but another set of free cells
+  map_t* changed = makeMap(100, 80, 3);
+  EXPECT_NE(0, map_load_range_field(changed, filename.c_str(), 7));
+  EXPECT_EQ(NULL, changed->range_field);
+  map_free(changed);
+
+  map_t* larger = makeMap(100, 81, 2);
+  EXPECT_NE(0, map_load_range_field(larger, filename.c_str(), 7));
+  map_free(larger);
+
+  ASSERT_EQ(0, truncate(filename.c_str(), 100));
+  map_t* truncated = makeMap(100, 80, 2);
+  EXPECT_NE(0, map_load_range_field(truncated, filename.c_str(), 7));
+  map_free(truncated);
+
+  map_free(map);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,249 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks that the batched odometry models move the samples like the
+ * per-sample models they replaced: the mean and standard deviation of the
+ * updated poses must agree with those of a copy of the old code, for every
+ * model and a few kinds of motion.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "amcl/pf/pf.h"
+#include "amcl/pf/pf_pdf.h"
+#include "amcl/sensors/amcl_odom.h"
+
+using namespace amcl;
+
+static const int SAMPLES = 200000;
+static const double ALPHA[5] = { 0.2, 0.15, 0.25, 0.1, 0.3 };
+
+static double normalize(double z)
+{
+  return atan2(sin(z), cos(z));
+}
+
+static double angle_diff(double a, double b)
+{
+  double d1, d2;
+  a = normalize(a);
+  b = normalize(b);
+  d1 = a - b;
+  d2 = 2 * M_PI - fabs(d1);
+  if (d1 > 0)
+    d2 *= -1.0;
+  if (fabs(d1) < fabs(d2))
+    return d1;
+  else
+    return d2;
+}
+
+// The old AMCLOdom::UpdateAction(), which drew the noise of each sample
+// with pf_ran_gaussian() as it went
+static void referenceUpdate(odom_model_t model, pf_vector_t pose, pf_vector_t delta,
+                            pf_rng_t* rng, std::vector<pf_vector_t>& poses)
+{
+  double alpha1 = ALPHA[0], alpha2 = ALPHA[1], alpha3 = ALPHA[2], alpha4 = ALPHA[3], alpha5 = ALPHA[4];
+  pf_vector_t old_pose = pf_vector_sub(pose, delta);
+
+  if (model == ODOM_MODEL_OMNI || model == ODOM_MODEL_OMNI_CORRECTED)
+  {
+    double delta_trans = sqrt(delta.v[0] * delta.v[0] + delta.v[1] * delta.v[1]);
+    double delta_rot = delta.v[2];
+    double trans_hat_stddev, rot_hat_stddev, strafe_hat_stddev;
+    if (model == ODOM_MODEL_OMNI)
+    {
+      trans_hat_stddev = (alpha3 * (delta_trans * delta_trans) + alpha1 * (delta_rot * delta_rot));
+      rot_hat_stddev = (alpha4 * (delta_rot * delta_rot) + alpha2 * (delta_trans * delta_trans));
+      strafe_hat_stddev = (alpha1 * (delta_rot * delta_rot) + alpha5 * (delta_trans * delta_trans));
+    }
+    else
+    {
+      trans_hat_stddev = sqrt(alpha3 * (delta_trans * delta_trans) + alpha4 * (delta_rot * delta_rot));
+      rot_hat_stddev = sqrt(alpha1 * (delta_rot * delta_rot) + alpha2 * (delta_trans * delta_trans));
+      strafe_hat_stddev = sqrt(alpha4 * (delta_rot * delta_rot) + alpha5 * (delta_trans * delta_trans));
+    }
+
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+      double delta_bearing = angle_diff(atan2(delta.v[1], delta.v[0]), old_pose.v[2]) + poses[i].v[2];
+      double cs_bearing = cos(delta_bearing);
+      double sn_bearing = sin(delta_bearing);
+
+      double delta_trans_hat = delta_trans + pf_ran_gaussian(rng, trans_hat_stddev);
+      double delta_rot_hat = delta_rot + pf_ran_gaussian(rng, rot_hat_stddev);
+      double delta_strafe_hat = 0 + pf_ran_gaussian(rng, strafe_hat_stddev);
+      poses[i].v[0] += (delta_trans_hat * cs_bearing + delta_strafe_hat * sn_bearing);
+      poses[i].v[1] += (delta_trans_hat * sn_bearing - delta_strafe_hat * cs_bearing);
+      poses[i].v[2] += delta_rot_hat;
+    }
+    return;
+  }
+
+  double delta_rot1;
+  if (sqrt(delta.v[1] * delta.v[1] + delta.v[0] * delta.v[0]) < 0.01)
+    delta_rot1 = 0.0;
+  else
+    delta_rot1 = angle_diff(atan2(delta.v[1], delta.v[0]), old_pose.v[2]);
+  double delta_trans = sqrt(delta.v[0] * delta.v[0] + delta.v[1] * delta.v[1]);
+  double delta_rot2 = angle_diff(delta.v[2], delta_rot1);
+
+  double delta_rot1_noise = std::min(fabs(angle_diff(delta_rot1, 0.0)), fabs(angle_diff(delta_rot1, M_PI)));
+  double delta_rot2_noise = std::min(fabs(angle_diff(delta_rot2, 0.0)), fabs(angle_diff(delta_rot2, M_PI)));
+
+  double rot1_sigma = alpha1 * delta_rot1_noise * delta_rot1_noise + alpha2 * delta_trans * delta_trans;
+  double trans_sigma = alpha3 * delta_trans * delta_trans + alpha4 * delta_rot1_noise * delta_rot1_noise +
+                       alpha4 * delta_rot2_noise * delta_rot2_noise;
+  double rot2_sigma = alpha1 * delta_rot2_noise * delta_rot2_noise + alpha2 * delta_trans * delta_trans;
+  if (model == ODOM_MODEL_DIFF_CORRECTED)
+  {
+    rot1_sigma = sqrt(rot1_sigma);
+    trans_sigma = sqrt(trans_sigma);
+    rot2_sigma = sqrt(rot2_sigma);
+  }
+
+  for (size_t i = 0; i < poses.size(); i++)
+  {
+    double delta_rot1_hat = angle_diff(delta_rot1, pf_ran_gaussian(rng, rot1_sigma));
+    double delta_trans_hat = delta_trans - pf_ran_gaussian(rng, trans_sigma);
+    double delta_rot2_hat = angle_diff(delta_rot2, pf_ran_gaussian(rng, rot2_sigma));
+
+    poses[i].v[0] += delta_trans_hat * cos(poses[i].v[2] + delta_rot1_hat);
+    poses[i].v[1] += delta_trans_hat * sin(poses[i].v[2] + delta_rot1_hat);
+    poses[i].v[2] += delta_rot1_hat + delta_rot2_hat;
+  }
+}
+
+// The mean and standard deviation of x, y and the angle, which is taken
+// relative to a heading so that it does not wrap
+static void statistics(const std::vector<pf_vector_t>& poses, double heading, double mean[3], double stddev[3])
+{
+  for (int k = 0; k < 3; k++)
+  {
+    double sum = 0.0, sum_sq = 0.0;
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+      double v = k < 2 ? poses[i].v[k] : normalize(poses[i].v[2] - heading);
+      sum += v;
+      sum_sq += v * v;
+    }
+    mean[k] = sum / poses.size();
+    stddev[k] = sqrt(std::max(0.0, sum_sq / poses.size() - mean[k] * mean[k]));
+  }
+}
+
+// Move the same cloud of samples with both models and compare the poses
+static void compareModels(odom_model_t model, double dx, double dy, double da)
+{
+  pf_t* pf = pf_alloc(SAMPLES, SAMPLES, 0.0, 0.0, NULL, NULL);
+  pf_rng_seed(&pf->rng, 5);
+  pf_rng_t reference_rng;
+  pf_rng_seed(&reference_rng, 6);
+
+  // A cloud of samples around the odometric pose before the motion
+  pf_vector_t old_pose = pf_vector_zero();
+  old_pose.v[0] = 1.0;
+  old_pose.v[1] = 2.0;
+  old_pose.v[2] = 0.5;
+  pf_sample_set_t* set = pf->sets + pf->current_set;
+  std::vector<pf_vector_t> reference(SAMPLES);
+  std::vector<double> z(3 * SAMPLES);
+  pf_rng_gaussian(&reference_rng, &z[0], 3 * SAMPLES);
+  for (int i = 0; i < SAMPLES; i++)
+  {
+    set->samples[i].pose.v[0] = old_pose.v[0] + 0.2 * z[3 * i];
+    set->samples[i].pose.v[1] = old_pose.v[1] + 0.2 * z[3 * i + 1];
+    set->samples[i].pose.v[2] = old_pose.v[2] + 0.3 * z[3 * i + 2];
+    reference[i] = set->samples[i].pose;
+  }
+
+  // The motion is given in the odometric frame
+  AMCLOdomData data;
+  data.delta = pf_vector_zero();
+  data.delta.v[0] = dx * cos(old_pose.v[2]) - dy * sin(old_pose.v[2]);
+  data.delta.v[1] = dx * sin(old_pose.v[2]) + dy * cos(old_pose.v[2]);
+  data.delta.v[2] = da;
+  data.pose = pf_vector_add(old_pose, data.delta);
+
+  AMCLOdom odom;
+  odom.SetModel(model, ALPHA[0], ALPHA[1], ALPHA[2], ALPHA[3], ALPHA[4]);
+  ASSERT_TRUE(odom.UpdateAction(pf, &data));
+  referenceUpdate(model, data.pose, data.delta, &reference_rng, reference);
+
+  std::vector<pf_vector_t> updated(SAMPLES);
+  for (int i = 0; i < SAMPLES; i++)
+    updated[i] = set->samples[i].pose;
+
+  double heading = data.pose.v[2];
+  double mean[3], stddev[3], reference_mean[3], reference_stddev[3];
+  statistics(updated, heading, mean, stddev);
+  statistics(reference, heading, reference_mean, reference_stddev);
+  for (int k = 0; k < 3; k++)
+  {
+    // five standard errors of the difference of the means, and of the
+    // standard deviations allowing for the heavy tails of the products of
+    // Gaussian numbers
+    double tolerance = 5 * sqrt(2.0 / SAMPLES) * std::max(stddev[k], reference_stddev[k]);
+    EXPECT_NEAR(reference_mean[k], mean[k], tolerance) << "coordinate " << k;
+    EXPECT_NEAR(reference_stddev[k], stddev[k], 0.03 * reference_stddev[k]) << "coordinate " << k;
+  }
+
+  pf_free(pf);
+}
+
+// Forward, backward, turning in place and sideways
+static void compareMotions(odom_model_t model)
+{
+  compareModels(model, 0.4, 0.0, 0.05);
+  compareModels(model, -0.3, 0.02, -0.1);
+  compareModels(model, 0.001, 0.0, 0.8);
+  compareModels(model, 0.0, 0.2, 0.0);
+}
+
+TEST(OdomModel, Diff)
+{
+  compareMotions(ODOM_MODEL_DIFF);
+}
+
+TEST(OdomModel, Omni)
+{
+  compareMotions(ODOM_MODEL_OMNI);
+}
+
+TEST(OdomModel, DiffCorrected)
+{
+  compareMotions(ODOM_MODEL_DIFF_CORRECTED);
+}
+
+TEST(OdomModel, OmniCorrected)
+{
+  compareMotions(ODOM_MODEL_OMNI_CORRECTED);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,213 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks that two filters seeded alike, the way the node does for its
+ * random_seed parameter, go through the same particles bit for bit: over
+ * odometry and laser updates, resampling with random poses injected, and
+ * weighting on a thread pool.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include "amcl/map/map.h"
+#include "amcl/pf/pf.h"
+#include "amcl/sensors/amcl_laser.h"
+#include "amcl/sensors/amcl_odom.h"
+#include "amcl/thread_pool.h"
+
+using namespace amcl;
+
+// A 10 x 8 m room with some clutter
+static map_t* makeMap()
+{
+  map_t* map = map_alloc();
+  map->scale = 0.05;
+  map->size_x = 200;
+  map->size_y = 160;
+  map->cells = (map_cell_t*)malloc(sizeof(map_cell_t) * map->size_x * map->size_y);
+
+  srand(13);
+  for (int j = 0; j < map->size_y; j++)
+  {
+    for (int i = 0; i < map->size_x; i++)
+    {
+      bool wall = i < 2 || j < 2 || i >= map->size_x - 2 || j >= map->size_y - 2;
+      bool clutter = rand() % 200 == 0;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = (wall || clutter) ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+// A pose anywhere in the room, drawn from the filter's generator
+static pf_vector_t randomPose(void* data, pf_rng_t* rng)
+{
+  map_t* map = (map_t*)data;
+  pf_vector_t pose = pf_vector_zero();
+  pose.v[0] = (pf_rng_draw(rng) - 0.5) * map->size_x * map->scale;
+  pose.v[1] = (pf_rng_draw(rng) - 0.5) * map->size_y * map->scale;
+  pose.v[2] = (pf_rng_draw(rng) * 2 - 1) * M_PI;
+  return pose;
+}
+
+// A filter with its sensors, as the node sets them up
+struct Filter
+{
+  Filter(map_t* map, int seed, ThreadPool* pool) : laser(60, map)
+  {
+    pf = pf_alloc(500, 5000, 0.001, 0.5, randomPose, map);
+    pf_rng_seed(&pf->rng, seed);
+    odom.SetModel(ODOM_MODEL_DIFF_CORRECTED, 0.2, 0.2, 0.2, 0.2, 0.2);
+    laser.SetModelLikelihoodField(0.9, 0.1, 0.2, 2.0);
+    laser.SetThreadPool(pool);
+  }
+
+  ~Filter()
+  {
+    pf_free(pf);
+  }
+
+  pf_t* pf;
+  AMCLOdom odom;
+  AMCLLaser laser;
+};
+
+// A scan from the given laser pose
+static void makeScan(map_t* map, pf_vector_t pose, AMCLLaserData* data)
+{
+  data->range_count = 180;
+  data->range_max = 8.0;
+  data->ranges = new double[data->range_count][2];
+  for (int i = 0; i < data->range_count; i++)
+  {
+    double bearing = -M_PI / 2 + M_PI * i / data->range_count;
+    data->ranges[i][0] = map_calc_range(map, pose.v[0], pose.v[1], pose.v[2] + bearing, data->range_max);
+    data->ranges[i][1] = bearing;
+  }
+}
+
+// Move both filters along the same path, with the same readings, and
+// return whether their particles stayed identical.  injected tells whether
+// the first filter drew random poses while resampling.
+static bool runFilters(map_t* map, int seed_a, int seed_b, ThreadPool* pool_b, bool* injected)
+{
+  Filter a(map, seed_a, NULL), b(map, seed_b, pool_b);
+  map_update_cspace(map, 2.0);
+
+  pf_vector_t pose = pf_vector_zero();
+  pose.v[0] = -2.0;
+  pose.v[1] = -1.0;
+  pf_matrix_t cov = pf_matrix_zero();
+  cov.m[0][0] = 0.25;
+  cov.m[1][1] = 0.25;
+  cov.m[2][2] = 0.07;
+  pf_init(a.pf, pose, cov);
+  pf_init(b.pf, pose, cov);
+
+  bool identical = true;
+  *injected = false;
+  for (int step = 0; step < 30 && identical; step++)
+  {
+    AMCLOdomData odom_data;
+    odom_data.delta = pf_vector_zero();
+    odom_data.delta.v[0] = 0.15 * cos(pose.v[2]);
+    odom_data.delta.v[1] = 0.15 * sin(pose.v[2]);
+    odom_data.delta.v[2] = 0.05;
+    pose = pf_vector_add(pose, odom_data.delta);
+    odom_data.pose = pose;
+    a.odom.UpdateAction(a.pf, &odom_data);
+    b.odom.UpdateAction(b.pf, &odom_data);
+
+    // The robot is kidnapped after a while, so that the weights drop and
+    // the filters inject random poses
+    pf_vector_t scan_pose = pose;
+    if (step >= 15)
+    {
+      scan_pose.v[0] += 3.0;
+      scan_pose.v[1] += 2.0;
+    }
+    AMCLLaserData data_a, data_b;
+    data_a.sensor = &a.laser;
+    data_b.sensor = &b.laser;
+    makeScan(map, scan_pose, &data_a);
+    makeScan(map, scan_pose, &data_b);
+    a.laser.UpdateSensor(a.pf, &data_a);
+    b.laser.UpdateSensor(b.pf, &data_b);
+
+    if (a.pf->w_fast < a.pf->w_slow)
+      *injected = true;
+    pf_update_resample(a.pf);
+    pf_update_resample(b.pf);
+
+    pf_sample_set_t* set_a = a.pf->sets + a.pf->current_set;
+    pf_sample_set_t* set_b = b.pf->sets + b.pf->current_set;
+    identical = set_a->sample_count == set_b->sample_count &&
+                memcmp(set_a->samples, set_b->samples, sizeof(pf_sample_t) * set_a->sample_count) == 0 &&
+                set_a->cluster_count == set_b->cluster_count &&
+                memcmp(&set_a->mean, &set_b->mean, sizeof(set_a->mean)) == 0 &&
+                a.pf->w_slow == b.pf->w_slow && a.pf->w_fast == b.pf->w_fast;
+  }
+
+  // Global localization draws from the generator too
+  pf_init_model(a.pf, randomPose, map);
+  pf_init_model(b.pf, randomPose, map);
+  pf_sample_set_t* set_a = a.pf->sets + a.pf->current_set;
+  pf_sample_set_t* set_b = b.pf->sets + b.pf->current_set;
+  identical = identical && set_a->sample_count == set_b->sample_count &&
+              memcmp(set_a->samples, set_b->samples, sizeof(pf_sample_t) * set_a->sample_count) == 0;
+  return identical;
+}
+
+TEST(PfDeterminism, SameSeedSameParticles)
+{
+  map_t* map = makeMap();
+  bool injected;
+  EXPECT_TRUE(runFilters(map, 42, 42, NULL, &injected));
+  EXPECT_TRUE(injected);
+  map_free(map);
+}
+
+TEST(PfDeterminism, SameSeedSameParticlesOnThreads)
+{
+  map_t* map = makeMap();
+  ThreadPool pool(4);
+  bool injected;
+  EXPECT_TRUE(runFilters(map, 42, 42, &pool, &injected));
+  map_free(map);
+}
+
+TEST(PfDeterminism, OtherSeedOtherParticles)
+{
+  map_t* map = makeMap();
+  bool injected;
+  EXPECT_FALSE(runFilters(map, 42, 43, NULL, &injected));
+  map_free(map);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,298 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks the histogram of pf_kdtree.c against a brute force one: the bins,
+ * their values and their clusters, which must be the connected components
+ * of the bins under 26-neighbour adjacency.  Also checks that the
+ * resampler of pf_update_resample keeps the weighted mean of the samples.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "amcl/pf/pf.h"
+#include "amcl/pf/pf_kdtree.h"
+
+struct Key
+{
+  int k[3];
+
+  bool operator<(const Key& other) const
+  {
+    return std::lexicographical_compare(k, k + 3, other.k, other.k + 3);
+  }
+};
+
+static Key binKey(pf_kdtree_t* tree, pf_vector_t pose)
+{
+  Key key;
+  for (int d = 0; d < 3; d++)
+    key.k[d] = (int)floor(pose.v[d] / tree->size[d]);
+  return key;
+}
+
+static pf_vector_t binCenter(pf_kdtree_t* tree, const Key& key)
+{
+  pf_vector_t pose;
+  for (int d = 0; d < 3; d++)
+    pose.v[d] = (key.k[d] + 0.5) * tree->size[d];
+  return pose;
+}
+
+static double uniform()
+{
+  return rand() / (RAND_MAX + 1.0);
+}
+
+// Poses in a few blobs, some of them touching, and scattered poses, on
+// both sides of the origin
+static std::vector<pf_vector_t> makePoses(int count, unsigned int seed)
+{
+  srand(seed);
+  std::vector<pf_vector_t> poses(count);
+  for (int i = 0; i < count; i++)
+  {
+    int blob = rand() % 6;
+    double spread = blob == 5 ? 20.0 : 0.8;
+    for (int d = 0; d < 3; d++)
+      poses[i].v[d] = (blob - 2.5) * 1.1 + (uniform() - 0.5) * spread;
+    poses[i].v[2] = (uniform() * 2 - 1) * (blob == 5 ? M_PI : 0.4);
+  }
+  return poses;
+}
+
+static int find(std::vector<int>& parent, int i)
+{
+  while (parent[i] != i)
+    i = parent[i] = parent[parent[i]];
+  return i;
+}
+
+// Insert the poses and compare the tree to a brute force histogram
+static void checkTree(pf_kdtree_t* tree, const std::vector<pf_vector_t>& poses)
+{
+  std::map<Key, double> bins;
+  for (size_t i = 0; i < poses.size(); i++)
+  {
+    double value = 0.5 + uniform();
+    pf_kdtree_insert(tree, poses[i], value);
+    bins[binKey(tree, poses[i])] += value;
+  }
+  pf_kdtree_cluster(tree);
+
+  ASSERT_EQ((int)bins.size(), tree->leaf_count);
+  std::vector<Key> keys;
+  for (std::map<Key, double>::iterator it = bins.begin(); it != bins.end(); ++it)
+  {
+    EXPECT_EQ(it->second, pf_kdtree_get_prob(tree, binCenter(tree, it->first)));
+    keys.push_back(it->first);
+  }
+
+  // Empty bins, also next to full ones
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    Key next = keys[i];
+    next.k[i % 3] += 1;
+    if (bins.count(next) == 0)
+    {
+      EXPECT_EQ(0.0, pf_kdtree_get_prob(tree, binCenter(tree, next)));
+      EXPECT_EQ(-1, pf_kdtree_get_cluster(tree, binCenter(tree, next)));
+    }
+  }
+
+  // Label the bins by union-find over every pair that touches
+  std::vector<int> parent(keys.size());
+  for (size_t i = 0; i < keys.size(); i++)
+    parent[i] = i;
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    for (size_t j = i + 1; j < keys.size(); j++)
+    {
+      bool touch = true;
+      for (int d = 0; d < 3; d++)
+        touch = touch && abs(keys[i].k[d] - keys[j].k[d]) <= 1;
+      if (touch)
+        parent[find(parent, i)] = find(parent, j);
+    }
+  }
+
+  // The labels must be the same partition of the bins, up to their names,
+  // and numbered from 0
+  std::map<int, int> component_of_label, label_of_component;
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    int label = pf_kdtree_get_cluster(tree, binCenter(tree, keys[i]));
+    int component = find(parent, i);
+    ASSERT_GE(label, 0);
+    ASSERT_LT(label, (int)keys.size());
+    if (component_of_label.count(label) == 0)
+      component_of_label[label] = component;
+    if (label_of_component.count(component) == 0)
+      label_of_component[component] = label;
+    ASSERT_EQ(component, component_of_label[label]) << "bin " << i;
+    ASSERT_EQ(label, label_of_component[component]) << "bin " << i;
+  }
+  EXPECT_EQ(component_of_label.size(), label_of_component.size());
+  EXPECT_EQ((int)component_of_label.size() - 1, component_of_label.rbegin()->first);
+  EXPECT_GT(component_of_label.size(), 1u);
+}
+
+TEST(PfKdtree, MatchesBruteForce)
+{
+  std::vector<pf_vector_t> poses = makePoses(5000, 1);
+  pf_kdtree_t* tree = pf_kdtree_alloc(3 * poses.size());
+  checkTree(tree, poses);
+  pf_kdtree_free(tree);
+}
+
+// Clearing empties only the slots in use; the next set must not see any of
+// the old bins
+TEST(PfKdtree, ClearAndReuse)
+{
+  pf_kdtree_t* tree = pf_kdtree_alloc(3 * 4000);
+  for (unsigned int seed = 2; seed < 6; seed++)
+  {
+    pf_kdtree_clear(tree);
+    EXPECT_EQ(0, tree->leaf_count);
+    checkTree(tree, makePoses(1000 * (seed - 1), seed));
+  }
+  pf_kdtree_free(tree);
+}
+
+// As many bins as there is room for, with a full table
+TEST(PfKdtree, OneSampleEachBin)
+{
+  pf_kdtree_t* tree = pf_kdtree_alloc(3000);
+  std::vector<pf_vector_t> poses;
+  for (int i = 0; i < 3000; i++)
+  {
+    pf_vector_t pose;
+    pose.v[0] = ((i % 20) - 10 + 0.5) * tree->size[0];
+    pose.v[1] = (((i / 20) % 15) * 2 - 15 + 0.5) * tree->size[1];
+    pose.v[2] = ((i / 300) - 5 + 0.5) * tree->size[2];
+    poses.push_back(pose);
+  }
+  checkTree(tree, poses);
+  EXPECT_EQ(3000, tree->leaf_count);
+  pf_kdtree_free(tree);
+}
+
+// With a fixed sample count the resampler draws every sample i between
+// floor(n w_i) and ceil(n w_i) times.  So when the poses are sorted along
+// each axis, the mean of the new set is within (max - min) / n of the
+// weighted mean of the old one on that axis.
+TEST(PfResample, KeepsWeightedMean)
+{
+  const int n = 4000;
+  pf_t* pf = pf_alloc(n, n, 0.0, 0.0, NULL, NULL);
+  pf_rng_seed(&pf->rng, 3);
+
+  pf_sample_set_t* set = pf->sets + pf->current_set;
+  srand(4);
+  double total = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    set->samples[i].pose.v[0] = -3.0 + 6.0 * i / n;
+    set->samples[i].pose.v[1] = 2.0 - 1.0 * i / n;
+    set->samples[i].pose.v[2] = -1.0 + 2.0 * i / n;
+    set->samples[i].weight = uniform() * uniform() * (i % 3 == 0 ? 5.0 : 1.0);
+    total += set->samples[i].weight;
+  }
+  pf_vector_t weighted_mean = pf_vector_zero();
+  for (int i = 0; i < n; i++)
+  {
+    set->samples[i].weight /= total;
+    for (int d = 0; d < 3; d++)
+      weighted_mean.v[d] += set->samples[i].weight * set->samples[i].pose.v[d];
+  }
+
+  pf_update_resample(pf);
+  set = pf->sets + pf->current_set;
+  ASSERT_EQ(n, set->sample_count);
+  pf_vector_t mean = pf_vector_zero();
+  for (int i = 0; i < n; i++)
+  {
+    EXPECT_EQ(1.0 / n, set->samples[i].weight);
+    for (int d = 0; d < 3; d++)
+      mean.v[d] += set->samples[i].pose.v[d] / n;
+  }
+  EXPECT_NEAR(weighted_mean.v[0], mean.v[0], 6.0 / n);
+  EXPECT_NEAR(weighted_mean.v[1], mean.v[1], 1.0 / n);
+  EXPECT_NEAR(weighted_mean.v[2], mean.v[2], 2.0 / n);
+
+  pf_free(pf);
+}
+
+// With an adaptive sample count the set is cut short at a random point of
+// a shuffle of the draws, so the mean is only close to the weighted one
+TEST(PfResample, AdaptiveCountKeepsWeightedMean)
+{
+  const int n = 20000;
+  pf_t* pf = pf_alloc(100, n, 0.0, 0.0, NULL, NULL);
+  pf_rng_seed(&pf->rng, 5);
+
+  // Poses in a 2 x 2 m square, enough bins for a few thousand samples
+  pf_sample_set_t* set = pf->sets + pf->current_set;
+  srand(6);
+  double total = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    set->samples[i].pose.v[0] = 2 * uniform() - 1;
+    set->samples[i].pose.v[1] = 2 * uniform() - 1;
+    set->samples[i].pose.v[2] = 0.6 * uniform() - 0.3;
+    set->samples[i].weight = exp(-2 * fabs(set->samples[i].pose.v[0] - 0.5));
+    total += set->samples[i].weight;
+  }
+  pf_vector_t weighted_mean = pf_vector_zero();
+  for (int i = 0; i < n; i++)
+  {
+    set->samples[i].weight /= total;
+    for (int d = 0; d < 2; d++)
+      weighted_mean.v[d] += set->samples[i].weight * set->samples[i].pose.v[d];
+  }
+
+  pf_update_resample(pf);
+  set = pf->sets + pf->current_set;
+  ASSERT_LT(set->sample_count, n);
+  ASSERT_GT(set->sample_count, 100);
+  pf_vector_t mean = pf_vector_zero();
+  for (int i = 0; i < set->sample_count; i++)
+    for (int d = 0; d < 2; d++)
+      mean.v[d] += set->samples[i].pose.v[d] / set->sample_count;
+
+  // Five standard errors of a uniform spread of 2 m
+  double tolerance = 5 * 2.0 / sqrt(12.0 * set->sample_count);
+  EXPECT_NEAR(weighted_mean.v[0], mean.v[0], tolerance);
+  EXPECT_NEAR(weighted_mean.v[1], mean.v[1], tolerance);
+
+  pf_free(pf);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
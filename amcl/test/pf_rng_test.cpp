@@ -0,0 +1,183 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Checks that the counter-based generator of the particle filter repeats
+ * its sequence for a seed, whichever way the numbers are drawn, and the
+ * statistics of its uniform and Gaussian numbers.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "amcl/pf/pf_rng.h"
+
+// The uniform number the generator makes of 64 random bits
+static double uniform(uint64_t bits)
+{
+  return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+TEST(PfRng, SplitMix64Sequence)
+{
+  pf_rng_t rng;
+  pf_rng_seed(&rng, 0);
+
+  // The first outputs of SplitMix64 for the seed 0, as published with it.
+  // SplitMix64 advances its state before mixing, so its outputs are the
+  // numbers from index 1 on.
+  pf_rng_draw(&rng);
+  EXPECT_EQ(uniform(0xe220a8397b1dcdafULL), pf_rng_draw(&rng));
+  EXPECT_EQ(uniform(0x6e789e6aa1b965f4ULL), pf_rng_draw(&rng));
+  EXPECT_EQ(uniform(0x06c45d188009454fULL), pf_rng_draw(&rng));
+  EXPECT_EQ(4u, rng.counter);
+}
+
+TEST(PfRng, SeedRepeatsSequence)
+{
+  pf_rng_t a, b, c;
+  pf_rng_seed(&a, 42);
+  pf_rng_seed(&b, 42);
+  pf_rng_seed(&c, 43);
+
+  std::vector<double> first(1000);
+  int same_as_other_seed = 0;
+  for (size_t i = 0; i < first.size(); i++)
+  {
+    first[i] = pf_rng_draw(&a);
+    ASSERT_EQ(first[i], pf_rng_draw(&b));
+    if (first[i] == pf_rng_draw(&c))
+      same_as_other_seed++;
+  }
+  EXPECT_EQ(0, same_as_other_seed);
+
+  // seeding again restarts the sequence
+  pf_rng_seed(&a, 42);
+  for (size_t i = 0; i < first.size(); i++)
+    ASSERT_EQ(first[i], pf_rng_draw(&a));
+}
+
+// Drawing the numbers one at a time or as arrays of any size gives the
+// same sequence
+TEST(PfRng, ArraysContinueSequence)
+{
+  pf_rng_t single, batched;
+  pf_rng_seed(&single, 7);
+  pf_rng_seed(&batched, 7);
+
+  std::vector<double> u(100);
+  pf_rng_uniform(&batched, &u[0], 37);
+  pf_rng_uniform(&batched, &u[37], 63);
+  for (size_t i = 0; i < u.size(); i++)
+    ASSERT_EQ(pf_rng_draw(&single), u[i]) << "number " << i;
+
+  // Gaussian numbers take a pair of uniform numbers each, and an odd count
+  // uses up the second number of the last pair
+  std::vector<double> all(64), parts(64);
+  pf_rng_t whole, split;
+  pf_rng_seed(&whole, 9);
+  pf_rng_seed(&split, 9);
+  pf_rng_gaussian(&whole, &all[0], 64);
+  pf_rng_gaussian(&split, &parts[0], 10);
+  pf_rng_gaussian(&split, &parts[10], 54);
+  for (size_t i = 0; i < all.size(); i++)
+    ASSERT_EQ(all[i], parts[i]) << "number " << i;
+  EXPECT_EQ(whole.counter, split.counter);
+
+  pf_rng_gaussian(&split, &parts[0], 5);
+  pf_rng_uniform(&whole, &u[0], 6);
+  EXPECT_EQ(whole.counter, split.counter);
+  EXPECT_EQ(pf_rng_draw(&whole), pf_rng_draw(&split));
+}
+
+TEST(PfRng, UniformStatistics)
+{
+  const int n = 1000000, bins = 100;
+  pf_rng_t rng;
+  pf_rng_seed(&rng, 1);
+  std::vector<double> u(n);
+  pf_rng_uniform(&rng, &u[0], n);
+
+  std::vector<int> histogram(bins, 0);
+  double sum = 0.0, sum_sq = 0.0;
+  for (int i = 0; i < n; i++)
+  {
+    ASSERT_GE(u[i], 0.0);
+    ASSERT_LT(u[i], 1.0);
+    sum += u[i];
+    sum_sq += u[i] * u[i];
+    histogram[(int)(u[i] * bins)]++;
+  }
+  double mean = sum / n;
+  EXPECT_NEAR(0.5, mean, 5 * sqrt(1.0 / 12 / n));
+  EXPECT_NEAR(1.0 / 12, sum_sq / n - mean * mean, 1e-3);
+
+  // chi-square with 99 degrees of freedom; 150 is beyond its 99.9th
+  // percentile
+  double chi_square = 0.0, expected = (double)n / bins;
+  for (int b = 0; b < bins; b++)
+    chi_square += (histogram[b] - expected) * (histogram[b] - expected) / expected;
+  EXPECT_LT(chi_square, 150.0);
+}
+
+TEST(PfRng, GaussianStatistics)
+{
+  const int n = 1000001;
+  pf_rng_t rng;
+  pf_rng_seed(&rng, 2);
+  std::vector<double> z(n);
+  pf_rng_gaussian(&rng, &z[0], n);
+
+  double sum = 0.0, sum_sq = 0.0, sum_cube = 0.0, sum_fourth = 0.0;
+  int within_one = 0, within_two = 0, within_three = 0;
+  for (int i = 0; i < n; i++)
+  {
+    ASSERT_TRUE(std::isfinite(z[i])) << "number " << i;
+    sum += z[i];
+    sum_sq += z[i] * z[i];
+    sum_cube += z[i] * z[i] * z[i];
+    sum_fourth += z[i] * z[i] * z[i] * z[i];
+    within_one += fabs(z[i]) < 1;
+    within_two += fabs(z[i]) < 2;
+    within_three += fabs(z[i]) < 3;
+  }
+  EXPECT_NEAR(0.0, sum / n, 5 / sqrt((double)n));
+  EXPECT_NEAR(1.0, sum_sq / n, 5 * sqrt(2.0 / n));
+  EXPECT_NEAR(0.0, sum_cube / n, 5 * sqrt(15.0 / n));
+  EXPECT_NEAR(3.0, sum_fourth / n, 5 * sqrt(96.0 / n));
+
+  EXPECT_NEAR(0.682689, (double)within_one / n, 0.002);
+  EXPECT_NEAR(0.954500, (double)within_two / n, 0.001);
+  EXPECT_NEAR(0.997300, (double)within_three / n, 0.0003);
+
+  // the two numbers of a pair are independent
+  double sum_product = 0.0;
+  for (int i = 0; i + 1 < n; i += 2)
+    sum_product += z[i] * z[i + 1];
+  EXPECT_NEAR(0.0, sum_product / (n / 2), 5 / sqrt(n / 2.0));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Benchmark of the range field of the beam model against map_calc_range,
+ * which traces every beam through the map cell by cell.  The build time and
+ * size of the field, the cost of a beam both ways and the number of beams
+ * whose ranges differ, which should be none, are reported.
+ *
+ * Usage: range_field_benchmark [map.pgm|-] [scale] [max_range]
+ * Without a map, a synthetic 1000x800 map is used.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "amcl/map/map.h"
+
+// Walls every 5 m with doors in them, and scattered obstacles, which is
+// roughly what a warehouse map looks like
+map_t* syntheticMap(int size_x, int size_y, double scale)
+{
+  map_t* map = map_alloc();
+  map->size_x = size_x;
+  map->size_y = size_y;
+  map->scale = scale;
+  map->cells = (map_cell_t*) calloc(size_x * size_y, sizeof(map_cell_t));
+  srand(42);
+  for (int j = 0; j < size_y; j++)
+  {
+    for (int i = 0; i < size_x; i++)
+    {
+      bool wall = (i % 100 == 0 && (j / 40) % 4 != 0) || (j % 100 == 0 && (i / 40) % 4 != 0);
+      bool clutter = rand() % 1000 == 0;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = (wall || clutter) ? +1 : -1;
+    }
+  }
+  return map;
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Beam
+{
+  double x, y, a;
+};
+
+int main(int argc, char** argv)
+{
+  const char* filename = argc > 1 ? argv[1] : "-";
+  double scale = argc > 2 ? atof(argv[2]) : 0.05;
+  double max_range = argc > 3 ? atof(argv[3]) : 30.0;
+
+  map_t* map;
+  if (strcmp(filename, "-") == 0)
+  {
+    map = syntheticMap(1000, 800, scale);
+  }
+  else
+  {
+    map = map_alloc();
+    if (map_load_occ(map, filename, scale, 0) != 0)
+      return 1;
+  }
+
+  // Scans of 30 beams over 270 degrees from random poses in free space, the
+  // way the beam model casts them from the particles
+  std::vector<int> free_cells;
+  for (int index = 0; index < map->size_x * map->size_y; index++)
+    if (map->cells[index].occ_state == -1)
+      free_cells.push_back(index);
+  printf("map: %d x %d cells at %.3f m, %zu free, max_range %.1f m\n",
+         map->size_x, map->size_y, scale, free_cells.size(), max_range);
+  if (free_cells.empty())
+    return 1;
+
+  const int scans = 100000, scan_beams = 30;
+  srand48(7);
+  std::vector<Beam> beams(scans * scan_beams);
+  for (int k = 0; k < scans; k++)
+  {
+    int index = free_cells[lrand48() % free_cells.size()];
+    double x = MAP_WXGX(map, index % map->size_x) + (drand48() - 0.5) * scale;
+    double y = MAP_WYGY(map, index / map->size_x) + (drand48() - 0.5) * scale;
+    double a = (drand48() * 2 - 1) * M_PI;
+    for (int b = 0; b < scan_beams; b++)
+    {
+      Beam& beam = beams[k * scan_beams + b];
+      beam.x = x;
+      beam.y = y;
+      beam.a = a + 1.5 * M_PI * (b / (scan_beams - 1.0) - 0.5);
+    }
+  }
+
+  std::vector<double> traced(beams.size());
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t k = 0; k < beams.size(); k++)
+    traced[k] = map_calc_range(map, beams[k].x, beams[k].y, beams[k].a, max_range);
+  double trace_time = elapsedMs(start);
+  printf("map_calc_range: %8.1f ns/beam\n", 1e6 * trace_time / beams.size());
+
+  start = std::chrono::steady_clock::now();
+  map_update_range_field(map);
+  double build_time = elapsedMs(start);
+  printf("range field: %.1f ms to build, %.1f MB\n", build_time,
+         map->size_x * (double) map->size_y / 1e6);
+
+  std::vector<double> looked_up(beams.size());
+  start = std::chrono::steady_clock::now();
+  for (size_t k = 0; k < beams.size(); k++)
+    looked_up[k] = map_lookup_range(map, beams[k].x, beams[k].y, beams[k].a, max_range);
+  double lookup_time = elapsedMs(start);
+
+  int different = 0;
+  for (size_t k = 0; k < beams.size(); k++)
+    if (looked_up[k] != traced[k])
+      different++;
+  printf("map_lookup_range: %6.1f ns/beam, %d of %zu beams differ\n",
+         1e6 * lookup_time / beams.size(), different, beams.size());
+
+  map_free(map);
+  return different == 0 ? 0 : 1;
+}
@@ -0,0 +1,766 @@
+/*
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Offline replay of a bag through the particle filter, as fast as it will
+ * go and without a ROS master.  The setup is read from one of the rostest
+ * files next to this one: the map and its resolution, the bag and where to
+ * start in it, the amcl parameters, and the map->odom transform the test
+ * expects at its end.  The scans are processed the way AmclNode does it,
+ * with the transforms of the bag in a tf2::BufferCore of our own.  The time
+ * spent in each stage of the filter, the particles weighted per second of
+ * the sensor stage and the error of the final map->odom transform are
+ * printed as one JSON object per input on stdout, in an array when there
+ * are several; progress goes to stderr.  The exit status is 2 when an error
+ * is outside the tolerances of its test.
+ *
+ * Usage: replay_benchmark <test.xml|log.bag>... [name:=value...]
+ *
+ * The names are amcl parameters, which override those of the test files,
+ * or one of:
+ *   package_dir   what $(find amcl) stands for, by default the directory
+ *                 above the test file; the bags and maps of the tests are
+ *                 downloaded to share/amcl of the devel space
+ *   bag, map, map_resolution, scan_topic
+ *                 the inputs, for a bag without a test file; without a map
+ *                 the first nav_msgs/OccupancyGrid in the bag is used
+ *   start, duration
+ *                 the part of the bag to replay, in seconds
+ *   global_localization
+ *                 1 to spread the particles over the map first
+ *   expected_x, expected_y, expected_a, tolerance_d, tolerance_a
+ *                 the map->odom transform expected at the end
+ *
+ * random_seed is 0 unless it is given, so that runs can be compared.
+ * "make run_replay_benchmark" replays the bags of all the *_corrected tests.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <nav_msgs/OccupancyGrid.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/LaserScan.h>
+#include <tf2/buffer_core.h>
+#include <tf2/exceptions.h>
+#include <tf2/LinearMath/Transform.h>
+#include <tf2/utils.h>
+#include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <tf2_msgs/TFMessage.h>
+
+#include "amcl/map/map.h"
+#include "amcl/pf/pf.h"
+#include "amcl/sensors/amcl_laser.h"
+#include "amcl/sensors/amcl_odom.h"
+#include "amcl/thread_pool.h"
+
+using namespace amcl;
+
+typedef std::map<std::string, std::string> Params;
+
+double paramDouble(const Params& params, const std::string& name, double value)
+{
+  Params::const_iterator it = params.find(name);
+  return it == params.end() ? value : atof(it->second.c_str());
+}
+
+int paramInt(const Params& params, const std::string& name, int value)
+{
+  Params::const_iterator it = params.find(name);
+  return it == params.end() ? value : atoi(it->second.c_str());
+}
+
+std::string paramString(const Params& params, const std::string& name, const std::string& value)
+{
+  Params::const_iterator it = params.find(name);
+  return it == params.end() ? value : it->second;
+}
+
+std::vector<std::string> splitArgs(const std::string& args)
+{
+  std::istringstream stream(args);
+  std::vector<std::string> tokens;
+  std::string token;
+  while (stream >> token)
+    tokens.push_back(token);
+  return tokens;
+}
+
+std::string substitutePackageDir(std::string path, const std::string& package_dir)
+{
+  const std::string find = "$(find amcl)";
+  size_t pos = path.find(find);
+  if (pos != std::string::npos)
+    path.replace(pos, find.size(), package_dir);
+  return path;
+}
+
+// Pull the inputs and the amcl parameters out of a rostest file
+bool readTestFile(const std::string& filename, const std::string& package_dir, Params& params)
+{
+  boost::property_tree::ptree tree;
+  try
+  {
+    boost::property_tree::read_xml(filename, tree);
+  }
+  catch (boost::property_tree::xml_parser_error& e)
+  {
+    fprintf(stderr, "Could not read %s: %s\n", filename.c_str(), e.what());
+    return false;
+  }
+
+  BOOST_FOREACH(const boost::property_tree::ptree::value_type& item, tree.get_child("launch"))
+  {
+    const boost::property_tree::ptree& node = item.second;
+    if (item.first == "node")
+    {
+      std::string type = node.get("<xmlattr>.type", "");
+      std::vector<std::string> args = splitArgs(substitutePackageDir(node.get("<xmlattr>.args", ""), package_dir));
+      if (type == "map_server" && args.size() >= 2)
+      {
+        params["map"] = args[0];
+        params["map_resolution"] = args[1];
+      }
+      else if (type == "play" && !args.empty())
+      {
+        params["bag"] = args.back();
+        for (size_t k = 0; k + 1 < args.size(); k++)
+          if (args[k] == "-s")
+            params["start"] = args[k + 1];
+      }
+      else if (type == "amcl")
+      {
+        BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, node)
+        {
+          if (child.first == "param")
+            params[child.second.get("<xmlattr>.name", "")] = child.second.get("<xmlattr>.value", "");
+          else if (child.first == "remap" && child.second.get("<xmlattr>.from", "") == "scan")
+            params["scan_topic"] = child.second.get("<xmlattr>.to", "");
+        }
+      }
+    }
+    else if (item.first == "test")
+    {
+      // basic_localization.py <global> <x> <y> <a> <tolerance_d> <tolerance_a> <duration>
+      std::vector<std::string> args = splitArgs(node.get("<xmlattr>.args", ""));
+      if (args.size() == 7)
+      {
+        params["global_localization"] = args[0];
+        params["expected_x"] = args[1];
+        params["expected_y"] = args[2];
+        params["expected_a"] = args[3];
+        params["tolerance_d"] = args[4];
+        params["tolerance_a"] = args[5];
+        params["duration"] = args[6];
+      }
+    }
+  }
+  return true;
+}
+
+// Read a number of a PGM header, skipping the comments before it
+bool readPgmNumber(FILE* file, int& value)
+{
+  int ch;
+  while ((ch = fgetc(file)) != EOF)
+  {
+    if (ch == '#')
+      while ((ch = fgetc(file)) != EOF && ch != '\n')
+        ;
+    else if (!isspace(ch))
+      break;
+  }
+  ungetc(ch, file);
+  return fscanf(file, "%d", &value) == 1;
+}
+
+// Load a PGM the way map_server does with its default thresholds, and lay
+// it out the way AmclNode::convertMap does, with the origin at the lower
+// left corner of the image
+map_t* loadPgm(const std::string& filename, double resolution)
+{
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Could not open %s\n", filename.c_str());
+    return NULL;
+  }
+  char magic[3];
+  int width, height, depth, ch;
+  if (fscanf(file, "%2s", magic) != 1 || strcmp(magic, "P5") != 0)
+  {
+    fprintf(stderr, "%s is not a binary PGM\n", filename.c_str());
+    fclose(file);
+    return NULL;
+  }
+  if (!readPgmNumber(file, width) || !readPgmNumber(file, height) || !readPgmNumber(file, depth) ||
+      fgetc(file) == EOF)
+  {
+    fprintf(stderr, "Could not read the size of %s\n", filename.c_str());
+    fclose(file);
+    return NULL;
+  }
+
+  map_t* map = map_alloc();
+  map->size_x = width;
+  map->size_y = height;
+  map->scale = resolution;
+  map->origin_x = (map->size_x / 2) * map->scale;
+  map->origin_y = (map->size_y / 2) * map->scale;
+  map->cells = (map_cell_t*) calloc(width * height, sizeof(map_cell_t));
+  for (int j = height - 1; j >= 0; j--)
+  {
+    for (int i = 0; i < width; i++)
+    {
+      ch = fgetc(file);
+      if (depth > 255)
+        ch = (ch << 8) | fgetc(file);
+      double occ = (depth - ch) / (double) depth;
+      map->cells[MAP_INDEX(map, i, j)].occ_state = occ > 0.65 ? +1 : (occ < 0.196 ? -1 : 0);
+    }
+  }
+  fclose(file);
+  return map;
+}
+
+map_t* convertGrid(const nav_msgs::OccupancyGrid& grid)
+{
+  map_t* map = map_alloc();
+  map->size_x = grid.info.width;
+  map->size_y = grid.info.height;
+  map->scale = grid.info.resolution;
+  map->origin_x = grid.info.origin.position.x + (map->size_x / 2) * map->scale;
+  map->origin_y = grid.info.origin.position.y + (map->size_y / 2) * map->scale;
+  map->cells = (map_cell_t*) malloc(sizeof(map_cell_t) * map->size_x * map->size_y);
+  for (int i = 0; i < map->size_x * map->size_y; i++)
+  {
+    if (grid.data[i] == 0)
+      map->cells[i].occ_state = -1;
+    else if (grid.data[i] == 100)
+      map->cells[i].occ_state = +1;
+    else
+      map->cells[i].occ_state = 0;
+  }
+  return map;
+}
+
+void uniformPoses(void* arg, pf_rng_t* rng, double* x, double* y, double* a, int count)
+{
+  map_t* map = (map_t*) arg;
+  std::vector<int> cells(count);
+  pf_rng_uniform(rng, a, count);
+  map_sample_cells(map, a, &cells[0], count);
+  for (int i = 0; i < count; i++)
+  {
+    x[i] = cells[i] < 0 ? map->origin_x : MAP_WXGX(map, cells[i] % map->size_x);
+    y[i] = cells[i] < 0 ? map->origin_y : MAP_WYGY(map, cells[i] / map->size_x);
+  }
+  pf_rng_uniform(rng, a, count);
+  for (int i = 0; i < count; i++)
+    a[i] = a[i] * 2 * M_PI - M_PI;
+}
+
+pf_vector_t uniformPose(void* arg, pf_rng_t* rng)
+{
+  pf_vector_t pose;
+  uniformPoses(arg, rng, &pose.v[0], &pose.v[1], &pose.v[2], 1);
+  return pose;
+}
+
+// A string as a JSON string literal, quoted and escaped
+std::string jsonString(const std::string& value)
+{
+  std::string quoted = "\"";
+  for (size_t i = 0; i < value.size(); i++)
+  {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\')
+    {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if (c < 0x20)
+    {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      quoted += escape;
+    }
+    else
+      quoted += c;
+  }
+  return quoted + "\"";
+}
+
+double angleDiff(double a, double b)
+{
+  return fmod(a - b + 5 * M_PI, 2 * M_PI) - M_PI;
+}
+
+struct Stage
+{
+  Stage() : count(0), total(0.0), max(0.0) {}
+  void add(double ms)
+  {
+    count++;
+    total += ms;
+    max = std::max(max, ms);
+  }
+  int count;
+  double total, max;
+};
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printStage(const char* name, const Stage& stage, bool last)
+{
+  printf("    \"%s\": {\"count\": %d, \"total_ms\": %.3f, \"mean_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+         name, stage.count, stage.total, stage.count ? stage.total / stage.count : 0.0, stage.max,
+         last ? "" : ",");
+}
+
+// Replay one test file or bag, and print its report.  Returns 0 when it
+// passed, 1 when it could not be replayed and 2 when the error is outside
+// the tolerances of the test.
+int replay(const std::string& input, const Params& overrides)
+{
+  Params params;
+  std::string package_dir = ".";
+  if (input.size() > 4 && input.compare(input.size() - 4, 4, ".xml") == 0)
+  {
+    std::string test_dir = input.substr(0, input.find_last_of('/') + 1);
+    package_dir = paramString(overrides, "package_dir", test_dir.empty() ? ".." : test_dir + "..");
+    if (!readTestFile(input, package_dir, params))
+      return 1;
+  }
+  else
+    params["bag"] = input;
+  for (Params::const_iterator it = overrides.begin(); it != overrides.end(); ++it)
+    params[it->first] = it->second;
+
+  // The filter parameters, with the defaults of AmclNode
+  int min_particles = paramInt(params, "min_particles", 100);
+  int max_particles = paramInt(params, "max_particles", 5000);
+  int max_beams = paramInt(params, "laser_max_beams", 30);
+  int resample_interval = paramInt(params, "resample_interval", 2);
+  double d_thresh = paramDouble(params, "update_min_d", 0.2);
+  double a_thresh = paramDouble(params, "update_min_a", M_PI / 6.0);
+  double laser_min_range = paramDouble(params, "laser_min_range", -1.0);
+  double laser_max_range = paramDouble(params, "laser_max_range", -1.0);
+  double laser_likelihood_max_dist = paramDouble(params, "laser_likelihood_max_dist", 2.0);
+  double z_hit = paramDouble(params, "laser_z_hit", 0.95);
+  double z_short = paramDouble(params, "laser_z_short", 0.1);
+  double z_max = paramDouble(params, "laser_z_max", 0.05);
+  double z_rand = paramDouble(params, "laser_z_rand", 0.05);
+  double sigma_hit = paramDouble(params, "laser_sigma_hit", 0.2);
+  double lambda_short = paramDouble(params, "laser_lambda_short", 0.1);
+  std::string laser_model = paramString(params, "laser_model_type", "likelihood_field");
+  std::string odom_model = paramString(params, "odom_model_type", "diff");
+  std::string odom_frame = paramString(params, "odom_frame_id", "odom");
+  std::string base_frame = paramString(params, "base_frame_id", "base_link");
+  std::string scan_topic = paramString(params, "scan_topic", "scan");
+  int random_seed = paramInt(params, "random_seed", 0);
+
+  odom_model_t odom_model_type = ODOM_MODEL_DIFF;
+  if (odom_model == "omni")
+    odom_model_type = ODOM_MODEL_OMNI;
+  else if (odom_model == "diff-corrected")
+    odom_model_type = ODOM_MODEL_DIFF_CORRECTED;
+  else if (odom_model == "omni-corrected")
+    odom_model_type = ODOM_MODEL_OMNI_CORRECTED;
+
+  rosbag::Bag bag;
+  std::string bag_filename = paramString(params, "bag", "");
+  try
+  {
+    bag.open(bag_filename, rosbag::bagmode::Read);
+  }
+  catch (rosbag::BagException& e)
+  {
+    fprintf(stderr, "Could not open %s: %s\n", bag_filename.c_str(), e.what());
+    return 1;
+  }
+
+  // The map
+  map_t* map = NULL;
+  if (params.count("map"))
+  {
+    map = loadPgm(params["map"], paramDouble(params, "map_resolution", 0.05));
+  }
+  else
+  {
+    rosbag::View maps(bag, rosbag::TypeQuery("nav_msgs/OccupancyGrid"));
+    for (rosbag::View::iterator it = maps.begin(); it != maps.end() && map == NULL; ++it)
+      map = convertGrid(*it->instantiate<nav_msgs::OccupancyGrid>());
+  }
+  if (map == NULL)
+  {
+    fprintf(stderr, "No map; give one with map:=<file.pgm>\n");
+    return 1;
+  }
+  fprintf(stderr, "map: %d x %d cells at %.3f m\n", map->size_x, map->size_y, map->scale);
+
+  // The filter and the models, set up as in AmclNode::handleMapMessage
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  pf_t* pf = pf_alloc(min_particles, max_particles,
+                      paramDouble(params, "recovery_alpha_slow", 0.001),
+                      paramDouble(params, "recovery_alpha_fast", 0.1),
+                      (pf_init_model_fn_t) uniformPose, (void*) map);
+  if (random_seed >= 0)
+    pf_rng_seed(&pf->rng, random_seed);
+  pf_set_selective_resampling(pf, paramInt(params, "selective_resampling", 0));
+  pf->pop_err = paramDouble(params, "kld_err", 0.01);
+  pf->pop_z = paramDouble(params, "kld_z", 0.99);
+
+  pf_vector_t init_pose = pf_vector_zero();
+  init_pose.v[0] = paramDouble(params, "initial_pose_x", 0.0);
+  init_pose.v[1] = paramDouble(params, "initial_pose_y", 0.0);
+  init_pose.v[2] = paramDouble(params, "initial_pose_a", 0.0);
+  pf_matrix_t init_cov = pf_matrix_zero();
+  init_cov.m[0][0] = paramDouble(params, "initial_cov_xx", 0.5 * 0.5);
+  init_cov.m[1][1] = paramDouble(params, "initial_cov_yy", 0.5 * 0.5);
+  init_cov.m[2][2] = paramDouble(params, "initial_cov_aa", (M_PI / 12.0) * (M_PI / 12.0));
+  pf_init(pf, init_pose, init_cov);
+
+  AMCLOdom odom;
+  odom.SetModel(odom_model_type, paramDouble(params, "odom_alpha1", 0.2), paramDouble(params, "odom_alpha2", 0.2),
+                paramDouble(params, "odom_alpha3", 0.2), paramDouble(params, "odom_alpha4", 0.2),
+                paramDouble(params, "odom_alpha5", 0.2));
+
+  if (laser_model == "beam" && paramInt(params, "laser_range_field", 0))
+    map_update_range_field(map);
+  ThreadPool thread_pool(paramInt(params, "laser_threads", 1));
+  AMCLLaser laser(max_beams, map);
+  laser.SetThreadPool(&thread_pool);
+  if (laser_model == "beam")
+    laser.SetModelBeam(z_hit, z_short, z_max, z_rand, sigma_hit, lambda_short, 0.0);
+  else if (laser_model == "likelihood_field_prob")
+    laser.SetModelLikelihoodFieldProb(z_hit, z_rand, sigma_hit, laser_likelihood_max_dist,
+                                      paramInt(params, "do_beamskip", 0),
+                                      paramDouble(params, "beam_skip_distance", 0.5),
+                                      paramDouble(params, "beam_skip_threshold", 0.3),
+                                      paramDouble(params, "beam_skip_error_threshold", 0.9));
+  else
+    laser.SetModelLikelihoodField(z_hit, z_rand, sigma_hit, laser_likelihood_max_dist);
+
+  if (paramInt(params, "global_localization", 0))
+  {
+    map_update_sample_cells(map, NULL, 0, 0);
+    pf_init_model_batch(pf, (pf_init_batch_fn_t) uniformPoses, (void*) map);
+  }
+  double setup_time = elapsedMs(start);
+
+  // The part of the bag to replay
+  rosbag::View full(bag);
+  ros::Time begin = full.getBeginTime() + ros::Duration(paramDouble(params, "start", 0.0));
+  ros::Time end = full.getEndTime();
+  if (params.count("duration"))
+    end = std::min(end, begin + ros::Duration(paramDouble(params, "duration", 0.0)));
+  std::vector<std::string> topics;
+  topics.push_back("/tf");
+  topics.push_back("tf");
+  topics.push_back(scan_topic);
+  topics.push_back("/" + scan_topic);
+  rosbag::View view(bag, rosbag::TopicQuery(topics), begin, end);
+
+  tf2::BufferCore tf(ros::Duration(30.0));
+  std::deque<sensor_msgs::LaserScan::ConstPtr> pending;
+  std::map<std::string, int> frame_to_laser;
+  std::vector<AMCLLaser*> lasers;
+  std::vector<bool> lasers_update;
+  Stage motion, sensor, resample, cluster;
+  long long particle_updates = 0;
+  int scans = 0, updates = 0, dropped = 0;
+  bool initialized = false;
+  int resample_count = 0;
+  pf_vector_t pf_odom_pose = pf_vector_zero();
+  tf2::Transform latest_odom;
+  bool have_odom = false;
+  std::chrono::steady_clock::time_point replay_start = std::chrono::steady_clock::now();
+
+  BOOST_FOREACH(rosbag::MessageInstance const msg, view)
+  {
+    tf2_msgs::TFMessage::ConstPtr tf_msg = msg.instantiate<tf2_msgs::TFMessage>();
+    if (tf_msg != NULL)
+    {
+      for (size_t k = 0; k < tf_msg->transforms.size(); k++)
+      {
+        geometry_msgs::TransformStamped transform = tf_msg->transforms[k];
+        // Old bags have frames with a leading slash
+        if (!transform.header.frame_id.empty() && transform.header.frame_id[0] == '/')
+          transform.header.frame_id.erase(0, 1);
+        if (!transform.child_frame_id.empty() && transform.child_frame_id[0] == '/')
+          transform.child_frame_id.erase(0, 1);
+        tf.setTransform(transform, "replay_benchmark");
+      }
+    }
+    sensor_msgs::LaserScan::ConstPtr scan = msg.instantiate<sensor_msgs::LaserScan>();
+    if (scan != NULL)
+    {
+      pending.push_back(scan);
+      scans++;
+    }
+
+    // Process the scans whose odometry has arrived, as the message filter
+    // of the node does
+    while (!pending.empty())
+    {
+      sensor_msgs::LaserScan::ConstPtr front = pending.front();
+      std::string laser_frame = front->header.frame_id;
+      if (!laser_frame.empty() && laser_frame[0] == '/')
+        laser_frame.erase(0, 1);
+      if (!tf.canTransform(odom_frame, laser_frame, front->header.stamp))
+      {
+        // Give up on scans the odometry has moved well past
+        if (msg.getTime() - front->header.stamp > ros::Duration(1.0))
+        {
+          pending.pop_front();
+          dropped++;
+          continue;
+        }
+        break;
+      }
+      pending.pop_front();
+
+      if (frame_to_laser.find(laser_frame) == frame_to_laser.end())
+      {
+        tf2::Transform laser_pose;
+        tf2::fromMsg(tf.lookupTransform(base_frame, laser_frame, ros::Time()).transform, laser_pose);
+        pf_vector_t laser_pose_v = pf_vector_zero();
+        laser_pose_v.v[0] = laser_pose.getOrigin().x();
+        laser_pose_v.v[1] = laser_pose.getOrigin().y();
+        frame_to_laser[laser_frame] = lasers.size();
+        lasers.push_back(new AMCLLaser(laser));
+        lasers.back()->SetLaserPose(laser_pose_v);
+        lasers_update.push_back(true);
+      }
+      int laser_index = frame_to_laser[laser_frame];
+
+      tf2::Transform odom_pose;
+      tf2::fromMsg(tf.lookupTransform(odom_frame, base_frame, front->header.stamp).transform, odom_pose);
+      pf_vector_t pose;
+      pose.v[0] = odom_pose.getOrigin().x();
+      pose.v[1] = odom_pose.getOrigin().y();
+      pose.v[2] = tf2::getYaw(odom_pose.getRotation());
+
+      pf_vector_t delta = pf_vector_zero();
+      if (!initialized)
+      {
+        pf_odom_pose = pose;
+        initialized = true;
+        lasers_update.assign(lasers.size(), true);
+        resample_count = 0;
+      }
+      else
+      {
+        delta.v[0] = pose.v[0] - pf_odom_pose.v[0];
+        delta.v[1] = pose.v[1] - pf_odom_pose.v[1];
+        delta.v[2] = angleDiff(pose.v[2], pf_odom_pose.v[2]);
+        if (fabs(delta.v[0]) > d_thresh || fabs(delta.v[1]) > d_thresh || fabs(delta.v[2]) > a_thresh)
+          lasers_update.assign(lasers.size(), true);
+        if (lasers_update[laser_index])
+        {
+          AMCLOdomData odata;
+          odata.pose = pose;
+          odata.delta = delta;
+          start = std::chrono::steady_clock::now();
+          odom.UpdateAction(pf, (AMCLSensorData*) &odata);
+          motion.add(elapsedMs(start));
+        }
+      }
+      if (!lasers_update[laser_index])
+        continue;
+      // The odometry that the estimate of this update goes with
+      latest_odom = odom_pose;
+      have_odom = true;
+
+      // The angles of the scan in the base frame
+      tf2::Transform laser_to_base;
+      tf2::fromMsg(tf.lookupTransform(base_frame, laser_frame, front->header.stamp).transform, laser_to_base);
+      tf2::Quaternion q;
+      q.setRPY(0.0, 0.0, front->angle_min);
+      double angle_min = tf2::getYaw(laser_to_base.getRotation() * q);
+      q.setRPY(0.0, 0.0, front->angle_min + front->angle_increment);
+      double angle_increment = angleDiff(tf2::getYaw(laser_to_base.getRotation() * q), angle_min);
+
+      AMCLLaserData ldata;
+      ldata.sensor = lasers[laser_index];
+      ldata.range_count = front->ranges.size();
+      ldata.range_max = laser_max_range > 0.0 ? std::min((double) front->range_max, laser_max_range)
+                                              : front->range_max;
+      double range_min = laser_min_range > 0.0 ? std::max((double) front->range_min, laser_min_range)
+                                               : front->range_min;
+      ldata.ranges = new double[ldata.range_count][2];
+      for (int i = 0; i < ldata.range_count; i++)
+      {
+        ldata.ranges[i][0] = front->ranges[i] <= range_min ? ldata.range_max : front->ranges[i];
+        ldata.ranges[i][1] = angle_min + i * angle_increment;
+      }
+
+      particle_updates += pf->sets[pf->current_set].sample_count;
+      start = std::chrono::steady_clock::now();
+      lasers[laser_index]->UpdateSensor(pf, (AMCLSensorData*) &ldata);
+      sensor.add(elapsedMs(start));
+      lasers_update[laser_index] = false;
+      pf_odom_pose = pose;
+      updates++;
+
+      if (!(++resample_count % resample_interval))
+      {
+        start = std::chrono::steady_clock::now();
+        pf_update_resample(pf);
+        // pf_update_resample ends with the cluster statistics of the new
+        // set, which are timed on their own
+        double cluster_time = 1e3 * pf->cluster_time;
+        resample.add(std::max(0.0, elapsedMs(start) - cluster_time));
+        cluster.add(cluster_time);
+      }
+    }
+  }
+  double replay_time = elapsedMs(replay_start);
+  bag.close();
+
+  // The best hypothesis, and the map->odom transform it gives
+  double max_weight = 0.0;
+  pf_vector_t best = pf_vector_zero();
+  for (int k = 0; k < pf->sets[pf->current_set].cluster_count; k++)
+  {
+    double weight;
+    pf_vector_t mean;
+    pf_matrix_t cov;
+    if (pf_get_cluster_stats(pf, k, &weight, &mean, &cov) && weight > max_weight)
+    {
+      max_weight = weight;
+      best = mean;
+    }
+  }
+  tf2::Quaternion q;
+  q.setRPY(0.0, 0.0, best.v[2]);
+  tf2::Transform map_to_base(q, tf2::Vector3(best.v[0], best.v[1], 0.0));
+  tf2::Transform map_to_odom = map_to_base * latest_odom.inverse();
+  double odom_x = map_to_odom.getOrigin().x();
+  double odom_y = map_to_odom.getOrigin().y();
+  double odom_a = tf2::getYaw(map_to_odom.getRotation());
+
+  double filter_time = motion.total + sensor.total + resample.total + cluster.total;
+  printf("{\n");
+  printf("  \"input\": %s,\n", jsonString(input).c_str());
+  printf("  \"bag\": %s,\n", jsonString(bag_filename).c_str());
+  printf("  \"laser_model_type\": %s,\n", jsonString(laser_model).c_str());
+  printf("  \"odom_model_type\": %s,\n", jsonString(odom_model).c_str());
+  printf("  \"min_particles\": %d,\n", min_particles);
+  printf("  \"max_particles\": %d,\n", max_particles);
+  printf("  \"laser_max_beams\": %d,\n", max_beams);
+  printf("  \"scans\": %d,\n", scans);
+  printf("  \"scans_dropped\": %d,\n", dropped);
+  printf("  \"filter_updates\": %d,\n", updates);
+  printf("  \"setup_ms\": %.3f,\n", setup_time);
+  printf("  \"replay_ms\": %.3f,\n", replay_time);
+  printf("  \"filter_ms\": %.3f,\n", filter_time);
+  printf("  \"stages\": {\n");
+  printStage("motion", motion, false);
+  printStage("sensor", sensor, false);
+  printStage("resample", resample, false);
+  printStage("cluster", cluster, true);
+  printf("  },\n");
+  printf("  \"particles_per_second\": %.0f,\n", sensor.total > 0.0 ? 1e3 * particle_updates / sensor.total : 0.0);
+  printf("  \"final_particles\": %d,\n", pf->sets[pf->current_set].sample_count);
+  printf("  \"final_pose\": [%.4f, %.4f, %.4f],\n", best.v[0], best.v[1], best.v[2]);
+  printf("  \"map_to_odom\": [%.4f, %.4f, %.4f]", odom_x, odom_y, odom_a);
+
+  int result = 0;
+  if (params.count("expected_x") && have_odom)
+  {
+    // basic_localization.py holds x and y to tolerance_d each
+    double error_x = fabs(odom_x - paramDouble(params, "expected_x", 0.0));
+    double error_y = fabs(odom_y - paramDouble(params, "expected_y", 0.0));
+    double error_a = fabs(angleDiff(odom_a, paramDouble(params, "expected_a", 0.0)));
+    double tolerance_d = paramDouble(params, "tolerance_d", 0.75);
+    bool passed = error_x <= tolerance_d && error_y <= tolerance_d &&
+                  error_a <= paramDouble(params, "tolerance_a", 0.75);
+    printf(",\n  \"expected_map_to_odom\": [%.4f, %.4f, %.4f],\n", paramDouble(params, "expected_x", 0.0),
+           paramDouble(params, "expected_y", 0.0), paramDouble(params, "expected_a", 0.0));
+    printf("  \"error_x\": %.4f,\n", error_x);
+    printf("  \"error_y\": %.4f,\n", error_y);
+    printf("  \"error_a\": %.4f,\n", error_a);
+    printf("  \"passed\": %s", passed ? "true" : "false");
+    result = passed ? 0 : 2;
+  }
+  printf("\n}");
+  fprintf(stderr, "%s: %d scans, %d filter updates in %.1f ms\n", input.c_str(), scans, updates, replay_time);
+
+  for (size_t k = 0; k < lasers.size(); k++)
+    delete lasers[k];
+  pf_free(pf);
+  map_free(map);
+  return result;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<std::string> inputs;
+  Params overrides;
+  for (int k = 1; k < argc; k++)
+  {
+    std::string arg = argv[k];
+    size_t pos = arg.find(":=");
+    if (pos == std::string::npos)
+      inputs.push_back(arg);
+    else
+      overrides[arg.substr(0, pos)] = arg.substr(pos + 2);
+  }
+  if (inputs.empty())
+  {
+    fprintf(stderr, "Usage: %s <test.xml|log.bag>... [name:=value...]\n", argv[0]);
+    return 1;
+  }
+
+  int result = 0;
+  if (inputs.size() > 1)
+    printf("[\n");
+  for (size_t k = 0; k < inputs.size(); k++)
+  {
+    if (k > 0)
+      printf(",\n");
+    int status = replay(inputs[k], overrides);
+    if (status == 1)
+      printf("{\"input\": %s, \"error\": \"could not be replayed\"}", jsonString(inputs[k]).c_str());
+    result = std::max(result, status);
+  }
+  printf(inputs.size() > 1 ? "\n]\n" : "\n");
+  return result;
+}
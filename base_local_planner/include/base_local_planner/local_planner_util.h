@@ -61,7 +61,7 @@ private:
   std::string name_;
   std::string global_frame_;
 
-  costmap_2d::Costmap2D* costmap_;
+  const costmap_2d::Costmap2D* costmap_;
   tf2_ros::Buffer* tf_;
 
 
@@ -87,7 +87,7 @@ public:
   }
 
   void initialize(tf2_ros::Buffer* tf,
-      costmap_2d::Costmap2D* costmap,
+      const costmap_2d::Costmap2D* costmap,
       std::string global_frame);
 
   bool getGoal(geometry_msgs::PoseStamped& goal_pose);
@@ -96,7 +96,10 @@ public:
 
   bool getLocalPlan(const geometry_msgs::PoseStamped& global_pose, std::vector<geometry_msgs::PoseStamped>& transformed_plan);
 
-  costmap_2d::Costmap2D* getCostmap();
+  const costmap_2d::Costmap2D* getCostmap();
+
+  /** @brief Plan on another costmap of the same frame from now on */
+  void setCostmap(const costmap_2d::Costmap2D* costmap);
 
   LocalPlannerLimits getCurrentLimits();
 
@@ -72,7 +72,7 @@ enum CostAggregationType { Last, Sum, Product};
  */
 class MapGridCostFunction: public base_local_planner::TrajectoryCostFunction {
 public:
-  MapGridCostFunction(costmap_2d::Costmap2D* costmap,
+  MapGridCostFunction(const costmap_2d::Costmap2D* costmap,
       double xshift = 0.0,
       double yshift = 0.0,
       bool is_local_goal_function = false,
@@ -93,6 +93,9 @@ public:
    * Default is true. */
   void setStopOnFailure(bool stop_on_failure) {stop_on_failure_ = stop_on_failure;}
 
+  /** @brief Score on another costmap of the same frame from now on, the next prepare() uses it */
+  void setCostmap(const costmap_2d::Costmap2D* costmap) {costmap_ = costmap;}
+
   /**
    * propagate distances
    */
@@ -120,7 +123,7 @@ public:
 
 private:
   std::vector<geometry_msgs::PoseStamped> target_poses_;
-  costmap_2d::Costmap2D* costmap_;
+  const costmap_2d::Costmap2D* costmap_;
 
   base_local_planner::MapGrid map_;
   CostAggregationType aggregationType_;
@@ -53,7 +53,7 @@ namespace base_local_planner {
 class ObstacleCostFunction : public TrajectoryCostFunction {
 
 public:
-  ObstacleCostFunction(costmap_2d::Costmap2D* costmap);
+  ObstacleCostFunction(const costmap_2d::Costmap2D* costmap);
   ~ObstacleCostFunction();
 
   bool prepare();
@@ -64,6 +64,9 @@ public:
   void setParams(double max_trans_vel, double max_scaling_factor, double scaling_speed);
   void setFootprint(std::vector<geometry_msgs::Point> footprint_spec);
 
+  /** @brief Score on another costmap of the same frame from now on */
+  void setCostmap(const costmap_2d::Costmap2D* costmap);
+
   // helper functions, made static for easy unit testing
   static double getScalingFactor(Trajectory &traj, double scaling_speed, double max_trans_vel, double max_scaling_factor);
   static double footprintCost(
@@ -72,11 +75,11 @@ public:
       const double& th,
       double scale,
       std::vector<geometry_msgs::Point> footprint_spec,
-      costmap_2d::Costmap2D* costmap,
+      const costmap_2d::Costmap2D* costmap,
       base_local_planner::WorldModel* world_model);
 
 private:
-  costmap_2d::Costmap2D* costmap_;
+  const costmap_2d::Costmap2D* costmap_;
   std::vector<geometry_msgs::Point> footprint_spec_;
   base_local_planner::WorldModel* world_model_;
   double max_trans_vel_;
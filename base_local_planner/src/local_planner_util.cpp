@@ -43,7 +43,7 @@ namespace base_local_planner {
 
 void LocalPlannerUtil::initialize(
     tf2_ros::Buffer* tf,
-    costmap_2d::Costmap2D* costmap,
+    const costmap_2d::Costmap2D* costmap,
     std::string global_frame) {
   if(!initialized_) {
     tf_ = tf;
@@ -70,10 +70,14 @@ void LocalPlannerUtil::reconfigureCB(LocalPlannerLimits &config, bool restore_de
   limits_ = LocalPlannerLimits(config);
 }
 
-costmap_2d::Costmap2D* LocalPlannerUtil::getCostmap() {
+const costmap_2d::Costmap2D* LocalPlannerUtil::getCostmap() {
   return costmap_;
 }
 
+void LocalPlannerUtil::setCostmap(const costmap_2d::Costmap2D* costmap) {
+  costmap_ = costmap;
+}
+
 LocalPlannerLimits LocalPlannerUtil::getCurrentLimits() {
   boost::mutex::scoped_lock l(limits_configuration_mutex_);
   return limits_;
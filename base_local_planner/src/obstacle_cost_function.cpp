@@ -42,7 +42,7 @@
 
 namespace base_local_planner {
 
-ObstacleCostFunction::ObstacleCostFunction(costmap_2d::Costmap2D* costmap) 
+ObstacleCostFunction::ObstacleCostFunction(const costmap_2d::Costmap2D* costmap) 
     : costmap_(costmap), sum_scores_(false) {
   if (costmap != NULL) {
     world_model_ = new base_local_planner::CostmapModel(*costmap_);
@@ -67,6 +67,14 @@ void ObstacleCostFunction::setFootprint(std::vector<geometry_msgs::Point> footpr
   footprint_spec_ = footprint_spec;
 }
 
+void ObstacleCostFunction::setCostmap(const costmap_2d::Costmap2D* costmap) {
+  if (costmap == costmap_)
+    return;
+  costmap_ = costmap;
+  delete world_model_;
+  world_model_ = new base_local_planner::CostmapModel(*costmap_);
+}
+
 bool ObstacleCostFunction::prepare() {
   return true;
 }
@@ -119,7 +127,7 @@ double ObstacleCostFunction::footprintCost (
     const double& th,
     double scale,
     std::vector<geometry_msgs::Point> footprint_spec,
-    costmap_2d::Costmap2D* costmap,
+    const costmap_2d::Costmap2D* costmap,
     base_local_planner::WorldModel* world_model) {
 
   //check if the footprint is legal
@@ -189,7 +189,13 @@ public:
    * @brief  Will return a pointer to the underlying unsigned char array used as the costmap
    * @return A pointer to the underlying unsigned char array storing cost values
    */
-  unsigned char* getCharMap() const;
+  unsigned char* getCharMap();
+
+  /**
+   * @brief  Will return a read-only pointer to the underlying unsigned char array used as the costmap
+   * @return A pointer to the underlying unsigned char array storing cost values
+   */
+  const unsigned char* getCharMap() const;
 
   /**
    * @brief  Accessor for the x size of the costmap in cells
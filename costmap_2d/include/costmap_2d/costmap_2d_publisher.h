@@ -39,6 +39,7 @@
 #define COSTMAP_2D_COSTMAP_2D_PUBLISHER_H_
 #include <ros/ros.h>
 #include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/dirty_region.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <map_msgs/OccupancyGridUpdate.h>
 
@@ -62,13 +63,17 @@ public:
    */
   ~Costmap2DPublisher();
 
-  /** @brief Include the given bounds in the changed-rectangle. */
+  /** @brief Include the given bounds in the changed region. */
   void updateBounds(unsigned int x0, unsigned int xn, unsigned int y0, unsigned int yn)
   {
-    x0_ = std::min(x0, x0_);
-    xn_ = std::max(xn, xn_);
-    y0_ = std::min(y0, y0_);
-    yn_ = std::max(yn, yn_);
+    if (x0 < xn && y0 < yn)
+      updated_region_.add(x0, y0, xn - 1, yn - 1);
+  }
+
+  /** @brief Include the given cells, as returned by LayeredCostmap::getUpdatedRegion(), in the changed region. */
+  void updateRegion(const DirtyRegion& region)
+  {
+    updated_region_.add(region);
   }
 
   /**
@@ -95,7 +100,7 @@ private:
   ros::NodeHandle* node;
   Costmap2D* costmap_;
   std::string global_frame_;
-  unsigned int x0_, xn_, y0_, yn_;
+  DirtyRegion updated_region_;  ///< @brief Cells changed since the last publication, one update is sent per rectangle
   double saved_origin_x_, saved_origin_y_;
   bool active_;
   bool always_send_full_costmap_;
@@ -41,6 +41,8 @@
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/layer.h>
 #include <costmap_2d/costmap_2d_publisher.h>
+#include <costmap_2d/lock_statistics.h>
+#include <costmap_2d/snapshot_buffer.h>
 #include <costmap_2d/Costmap2DConfig.h>
 #include <costmap_2d/footprint.h>
 #include <geometry_msgs/Polygon.h>
@@ -144,6 +146,44 @@ public:
       return layered_costmap_->getCostmap();
     }
 
+  /** @brief Whether the update thread publishes snapshots of the master costmap (~publish_snapshots). */
+  bool usesSnapshots() const
+    {
+      return publish_snapshots_;
+    }
+
+  /**
+   * @brief Get the most recent snapshot of the master costmap.
+   *
+   * A snapshot is a copy of the master costmap taken at the end of an update
+   * cycle and never modified afterwards, so it can be read for as long as
+   * needed without locking and without holding up the updates.
+   * @return The snapshot, or NULL if snapshots are disabled or no update has finished yet
+   */
+  boost::shared_ptr<const Costmap2D> getSnapshot();
+
+  /**
+   * @brief Set the outermost cells of the snapshots to LETHAL_OBSTACLE, for
+   *        planners that need a closed border around the map.
+   *
+   * Applies to the current snapshot as well, so the next getSnapshot() already
+   * returns an outlined one.
+   */
+  void setSnapshotOutline(bool outline);
+
+  /** @brief Time the update thread waited for the master costmap's mutex. */
+  LockStatistics& getUpdateLockStatistics()
+    {
+      return update_lock_statistics_;
+    }
+
+  /** @brief Time readers such as planners and controllers waited for the master costmap's
+   * mutex, or for a snapshot when ~publish_snapshots is enabled. */
+  LockStatistics& getReaderLockStatistics()
+    {
+      return reader_lock_statistics_;
+    }
+
   /**
    * @brief  Returns the global frame of the costmap
    * @return The global frame of the costmap
@@ -250,6 +290,11 @@ private:
   void reconfigureCB(costmap_2d::Costmap2DConfig &config, uint32_t level);
   void movementCB(const ros::TimerEvent &event);
   void mapUpdateLoop(double frequency);
+
+  /** @brief Copy the master costmap into a snapshot and make it the one returned by getSnapshot().
+   * Called by the update thread with the master costmap locked. */
+  void publishSnapshot();
+  void logLockStatistics();
   bool map_update_thread_shutdown_;
   bool stop_updates_, initialized_, stopped_, robot_stopped_;
   boost::thread* map_update_thread_;  ///< @brief A thread for updating the map
@@ -269,6 +314,12 @@ private:
   std::vector<geometry_msgs::Point> padded_footprint_;
   float footprint_padding_;
   costmap_2d::Costmap2DConfig old_config_;
+
+  bool publish_snapshots_;
+  SnapshotBuffer snapshots_;
+  LockStatistics update_lock_statistics_, reader_lock_statistics_;
+  double lock_statistics_period_;
+  ros::WallTime last_lock_statistics_;
 };
 // class Costmap2DROS
 }  // namespace costmap_2d
@@ -40,6 +40,7 @@
 #include <ros/ros.h>
 #include <costmap_2d/layer.h>
 #include <costmap_2d/layered_costmap.h>
+#include <costmap_2d/merge_kernels.h>
 
 namespace costmap_2d
 {
@@ -115,6 +116,14 @@ protected:
    */
   void updateWithAddition(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
 
+  /*
+   * Applies the given row kernel to every row of the
+   * bounding box. The kernels used by the updateWith*
+   * methods are vectorized where the CPU supports it.
+   */
+  void updateWithKernel(MergeRowKernel kernel, costmap_2d::Costmap2D& master_grid,
+                        int min_i, int min_j, int max_i, int max_j);
+
   /**
    * Updates the bounding box specified in the parameters to include
    * the location (x,y)
@@ -0,0 +1,135 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_2D_DIRTY_REGION_H_
+#define COSTMAP_2D_DIRTY_REGION_H_
+
+#include <vector>
+
+namespace costmap_2d
+{
+
+/**
+ * @struct DirtyRect
+ * @brief An axis-aligned rectangle, either in world or in map coordinates.
+ */
+struct DirtyRect
+{
+  DirtyRect(double min_x, double min_y, double max_x, double max_y) :
+      min_x(min_x), min_y(min_y), max_x(max_x), max_y(max_y)
+  {
+  }
+
+  double area() const
+  {
+    return (max_x - min_x) * (max_y - min_y);
+  }
+
+  /** @brief Whether the rectangles share any point, including touching edges. */
+  bool overlaps(const DirtyRect& other) const
+  {
+    return min_x <= other.max_x && other.min_x <= max_x && min_y <= other.max_y && other.min_y <= max_y;
+  }
+
+  /** @brief Grow this rectangle to the bounding box of itself and other. */
+  void merge(const DirtyRect& other);
+
+  double min_x, min_y, max_x, max_y;
+};
+
+/**
+ * @class DirtyRegion
+ * @brief The part of a costmap that changed, as a small set of disjoint rectangles.
+ *
+ * Rectangles that overlap are merged when they are added. When there are more
+ * than a fixed number of rectangles, the two whose bounding box adds the least
+ * area are merged, so the region never covers less than what was added and
+ * never covers more than the bounding box of all of it.
+ */
+class DirtyRegion
+{
+public:
+  explicit DirtyRegion(unsigned int max_rects = 8);
+
+  /** @brief Remove every rectangle. */
+  void clear()
+  {
+    rects_.clear();
+  }
+
+  bool empty() const
+  {
+    return rects_.empty();
+  }
+
+  /** @brief Add the given rectangle. Empty rectangles, where min > max, are ignored. */
+  void add(double min_x, double min_y, double max_x, double max_y);
+
+  /** @brief Add every rectangle of another region. */
+  void add(const DirtyRegion& other);
+
+  /** @brief Grow every rectangle by the given distance in all directions. */
+  void pad(double distance);
+
+  /**
+   * @brief Get the bounding box of the region. If the region is empty, the
+   *        bounds are set to the empty box produced by resetBounds().
+   */
+  void getBounds(double* min_x, double* min_y, double* max_x, double* max_y) const;
+
+  /** @brief Grow the given bounds to include the whole region. */
+  void expandBounds(double* min_x, double* min_y, double* max_x, double* max_y) const;
+
+  const std::vector<DirtyRect>& getRects() const
+  {
+    return rects_;
+  }
+
+  /** @brief Set the given bounds to an empty box, which any point or rectangle grows. */
+  static void resetBounds(double* min_x, double* min_y, double* max_x, double* max_y)
+  {
+    *min_x = *min_y = 1e30;
+    *max_x = *max_y = -1e30;
+  }
+
+private:
+  void insert(DirtyRect rect);
+
+  std::vector<DirtyRect> rects_;
+  unsigned int max_rects_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_2D_DIRTY_REGION_H_
@@ -0,0 +1,164 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_2D_DISTANCE_FIELD_H_
+#define COSTMAP_2D_DISTANCE_FIELD_H_
+
+#include <stdint.h>
+#include <vector>
+#include <costmap_2d/dirty_region.h>
+
+namespace costmap_2d
+{
+
+/**
+ * @class DistanceField
+ * @brief The squared distance from every cell of a grid to its nearest
+ *        obstacle cell, up to a maximum distance, kept up to date as obstacles
+ *        appear and disappear.
+ *
+ * Distances are exact Euclidean distances between cell centers, in cells.
+ * setObstacles() and shift() record which cells may have changed, and
+ * update() then recomputes the distances within the maximum distance of
+ * those cells only. The result is always the same as recompute().
+ */
+class DistanceField
+{
+public:
+  /** @brief The squared distance of cells with no obstacle within the maximum distance */
+  static const uint32_t OUT_OF_RANGE = 0xffffffff;
+
+  /** @brief Scratch space of the distance computation */
+  struct Workspace
+  {
+    std::vector<int> nearest_above, nearest_below;
+    std::vector<uint32_t> column_distances;
+    std::vector<int> parabolas;
+    std::vector<double> parabola_starts;
+  };
+
+  DistanceField();
+
+  /**
+   * @brief  Resize the field and remove all the obstacles
+   * @param max_distance Cells farther than this from every obstacle are OUT_OF_RANGE
+   */
+  void reset(unsigned int size_x, unsigned int size_y, unsigned int max_distance);
+
+  /** @brief  Free the memory of the field, which is empty until the next reset() */
+  void release();
+
+  unsigned int getSizeX() const
+  {
+    return size_x_;
+  }
+
+  unsigned int getSizeY() const
+  {
+    return size_y_;
+  }
+
+  unsigned int getMaxDistance() const
+  {
+    return max_distance_;
+  }
+
+  /**
+   * @brief  Copy the obstacles of a window of a grid of the same size, where
+   *         a cell is an obstacle if it has the given value
+   * @return The number of cells that changed
+   */
+  unsigned int setObstacles(const unsigned char* grid, unsigned char obstacle_value,
+                            int min_i, int min_j, int max_i, int max_j);
+
+  /**
+   * @brief  Move the field by the given number of cells, like
+   *         Costmap2D::updateOrigin(). Cells that come into the field have no obstacle.
+   */
+  void shift(int cell_dx, int cell_dy);
+
+  /** @brief  Recompute the distances that may have changed since the last update */
+  void update();
+
+  /** @brief  Recompute all the distances */
+  void recompute();
+
+  /**
+   * @brief  Recompute the distances of the cells in [min_i, max_i) x [min_j, max_j)
+   *         only, from the obstacles up to the maximum distance around it
+   */
+  void recompute(int min_i, int min_j, int max_i, int max_j);
+
+  /**
+   * @brief  Like recompute(min_i, min_j, max_i, max_j), with the given scratch
+   *         space. Threads with a workspace each may recompute disjoint windows
+   *         at the same time, as long as no obstacle changes meanwhile.
+   */
+  void recompute(int min_i, int min_j, int max_i, int max_j, Workspace* workspace);
+
+  bool isObstacle(unsigned int index) const
+  {
+    return obstacles_[index];
+  }
+
+  /** @brief  The squared distances, or OUT_OF_RANGE, indexed like the grid */
+  const uint32_t* getSquaredDistances() const
+  {
+    return &distances_[0];
+  }
+
+  /** @brief  The number of cells whose obstacle or distance differs from the other field */
+  unsigned int countDifferences(const DistanceField& other) const;
+
+private:
+  /**
+   * @brief  Compute the distances of the cells in [min_i, max_i) x [min_j, max_j)
+   *         from the obstacles up to max_distance_ around it
+   */
+  void computeDistances(int min_i, int min_j, int max_i, int max_j, Workspace* workspace);
+
+  unsigned int size_x_, size_y_, max_distance_;
+  std::vector<unsigned char> obstacles_;
+  std::vector<uint32_t> distances_;
+  DirtyRegion pending_;  ///< @brief The cells to recompute, in cells with exclusive maxima
+
+  // scratch space of computeDistances() and shift()
+  Workspace workspace_;
+  std::vector<unsigned char> shifted_obstacles_;
+  std::vector<uint32_t> shifted_distances_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_2D_DISTANCE_FIELD_H_
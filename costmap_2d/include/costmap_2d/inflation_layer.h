@@ -41,6 +41,7 @@
 #include <ros/ros.h>
 #include <costmap_2d/layer.h>
 #include <costmap_2d/layered_costmap.h>
+#include <costmap_2d/distance_field.h>
 #include <costmap_2d/InflationPluginConfig.h>
 #include <dynamic_reconfigure/server.h>
 #include <boost/thread.hpp>
@@ -89,6 +90,13 @@ public:
   virtual void onInitialize();
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
                             double* max_x, double* max_y);
+
+  /**
+   * @brief Pads every rectangle of the region by the inflation radius, and adds
+   *        the region of the previous cycle so that costs inflated from
+   *        obstacles that disappeared since are cleared.
+   */
+  virtual void updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region);
   virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
   virtual bool isDiscretized()
   {
@@ -125,6 +133,31 @@ public:
    */
   void setInflationParameters(double inflation_radius, double cost_scaling_factor);
 
+  /**
+   * @brief Switch between inflating the whole update window on every cycle and
+   *        the incremental mode, which keeps a distance field of the obstacles
+   *        and only recomputes it around the obstacles that changed.
+   *
+   * The incremental mode uses the exact distance to the nearest obstacle, where
+   * the wavefront follows the obstacle it came from. The two can differ in the
+   * rare cells that the wavefront reaches from an obstacle that is not the
+   * nearest, where the incremental mode gives a higher cost. The field takes
+   * 5 bytes per cell of the map, and is only kept in incremental mode. With
+   * LayeredCostmap::setParallelUpdate(), the incremental mode writes the costs
+   * tile by tile on the thread pool; the wavefront depends on the window it
+   * runs in, so it always runs on the whole window at once.
+   * @param incremental Whether to use the incremental mode
+   * @param verify Whether to check the distance field against a full recompute
+   *        on every cycle, which is as slow as not using the incremental mode
+   */
+  void setIncrementalInflation(bool incremental, bool verify);
+
+  /** @brief The number of cells where the last verification found a difference with a full recompute */
+  unsigned int getVerificationMismatches() const
+  {
+    return verification_mismatches_;
+  }
+
 protected:
   virtual void onFootprintChanged();
   boost::recursive_mutex* inflation_access_;
@@ -166,6 +199,45 @@ private:
     return cached_costs_[dx][dy];
   }
 
+  /**
+   * @brief  Lookup the pre-computed index of the inflation bin for a distance
+   * @param mx The x coordinate of the current cell
+   * @param my The y coordinate of the current cell
+   * @param src_x The x coordinate of the source cell
+   * @param src_y The y coordinate of the source cell
+   * @return The rank of distanceLookup(mx, my, src_x, src_y) among all distinct cached distances
+   */
+  inline unsigned int binLookup(int mx, int my, int src_x, int src_y)
+  {
+    unsigned int dx = abs(mx - src_x);
+    unsigned int dy = abs(my - src_y);
+    return cached_bins_[dx][dy];
+  }
+
+  /**
+   * @brief  updateCosts() for the incremental mode
+   */
+  void updateCostsIncremental(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+
+  /**
+   * @brief  Recompute the distances of the window in incremental mode, from
+   *         the obstacles that changed since the last cycle
+   */
+  void updateDistancesIncremental(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+
+  /**
+   * @brief  Raise the costs of the window of the master grid to the costs of their distances
+   */
+  void applyCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+
+  /**
+   * @brief  Apply the costs of the window on the thread pool in incremental
+   *         mode, the task-th of num_tasks threads handling its share of the
+   *         tiles of the window
+   */
+  void updateTiles(costmap_2d::Costmap2D* master_grid, int min_i, int min_j, int max_i, int max_j,
+                   unsigned int task, unsigned int num_tasks);
+
   void computeCaches();
   void deleteKernels();
   void inflate_area(int min_i, int min_j, int max_i, int max_j, unsigned char* master_grid);
@@ -180,14 +252,29 @@ private:
 
   unsigned int cell_inflation_radius_;
   unsigned int cached_cell_inflation_radius_;
-  std::map<double, std::vector<CellData> > inflation_cells_;
+
+  /**
+   * Bucket queue of cells waiting to be inflated. Bin k holds the cells whose distance to their source obstacle
+   * is the k-th smallest distinct value in cached_distances_, so visiting the bins in order processes cells by
+   * increasing distance without ever comparing floating point keys. The bins keep their capacity between cycles.
+   */
+  std::vector<std::vector<CellData> > inflation_cells_;
 
   bool* seen_;
   int seen_size_;
 
   unsigned char** cached_costs_;
   double** cached_distances_;
-  double last_min_x_, last_min_y_, last_max_x_, last_max_y_;
+  unsigned int** cached_bins_;
+  DirtyRegion last_region_;  ///< @brief The region of the previous cycle, before padding
+
+  bool incremental_, verify_incremental_;
+  bool field_valid_;  ///< @brief Whether distance_field_ matches the master grid of the last cycle
+  DistanceField distance_field_;  ///< @brief Distances to the lethal cells of the master grid, in incremental mode
+  DistanceField verification_field_;
+  double field_origin_x_, field_origin_y_;
+  std::vector<unsigned char> squared_distance_costs_;  ///< @brief The cost of each squared distance in cells
+  unsigned int verification_mismatches_;
 
   dynamic_reconfigure::Server<costmap_2d::InflationPluginConfig> *dsrv_;
   void reconfigureCB(costmap_2d::InflationPluginConfig &config, uint32_t level);
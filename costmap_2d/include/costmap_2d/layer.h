@@ -38,6 +38,7 @@
 #define COSTMAP_2D_LAYER_H_
 
 #include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/dirty_region.h>
 #include <costmap_2d/layered_costmap.h>
 #include <string>
 #include <tf2_ros/buffer.h>
@@ -64,12 +65,45 @@ public:
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
                             double* max_x, double* max_y) {}
 
+  /**
+   * @brief Like updateBounds(), but the part of the costmap that needs to be
+   *        updated is a set of rectangles rather than a single box. Each
+   *        layer can add rectangles to the region. updateCosts() is then
+   *        called once for each rectangle of the final region.
+   *
+   * The default implementation passes the bounding box of the region to
+   * updateBounds() and adds the resulting box, so layers that only implement
+   * updateBounds() keep working unchanged. Since that box may have been
+   * touched anywhere, the whole of it is added, which merges all the
+   * rectangles of the region into one. A single such layer therefore turns
+   * the update back into a single box; layers that know which part of the
+   * costmap they changed should override this to add only that part.
+   */
+  virtual void updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region);
+
   /**
    * @brief Actually update the underlying costmap, only within the bounds
    *        calculated during UpdateBounds().
    */
   virtual void updateCosts(Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j) {}
 
+  /**
+   * @brief Whether updateCosts() may be split into tiles.
+   *
+   * A tile-safe layer computes the value of each master cell only from that
+   * cell and from state that updateCosts() does not modify, and only writes
+   * master cells inside the given bounds. Calling updateCosts() on every tile
+   * of a partition of the bounds, possibly concurrently, then gives the same
+   * result as calling it once on the whole bounds. Layers that are not
+   * tile-safe are always updated with a single call, in which they may still
+   * split their own work over LayeredCostmap::getThreadPool(), as
+   * InflationLayer does in incremental mode.
+   */
+  virtual bool isTileSafe()
+  {
+    return false;
+  }
+
   /** @brief Stop publishers. */
   virtual void deactivate() {}
 
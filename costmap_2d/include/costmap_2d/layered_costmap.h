@@ -41,6 +41,10 @@
 #include <costmap_2d/cost_values.h>
 #include <costmap_2d/layer.h>
 #include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/dirty_region.h>
+#include <costmap_2d/thread_pool.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <vector>
 #include <string>
 
@@ -71,6 +75,34 @@ public:
    */
   void updateMap(double robot_x, double robot_y, double robot_yaw);
 
+  /**
+   * @brief  Split the update window of updateMap() into tiles that are updated in parallel.
+   *
+   * Runs of consecutive tile-safe layers (see Layer::isTileSafe()) are applied
+   * tile by tile on a pool of threads, the other layers are applied to the
+   * whole window as before, possibly using the pool themselves. The resulting
+   * costmap is identical to the serial one.
+   * @param num_threads The number of threads to use, 0 or 1 disables tiling
+   * @param tile_size The width and height of a tile in cells
+   */
+  void setParallelUpdate(unsigned int num_threads, unsigned int tile_size);
+
+  /**
+   * @brief  The threads of setParallelUpdate(), or NULL if the update is serial.
+   *         Layers may use them for their own work during updateBounds(), and
+   *         during updateCosts() if they are not tile-safe.
+   */
+  ThreadPool* getThreadPool()
+  {
+    return thread_pool_.get();
+  }
+
+  /** @brief  The width and height in cells of the tiles of setParallelUpdate() */
+  unsigned int getTileSize() const
+  {
+    return tile_size_;
+  }
+
   std::string getGlobalFrameID() const
   {
     return global_frame_;
@@ -87,6 +119,25 @@ public:
     maxy = maxy_;
   }
 
+  /**
+   * @brief  Get the cells updated by the last call to updateMap(), as a set
+   *         of disjoint rectangles. Each rectangle includes its max_x and max_y
+   *         cells. getBounds() returns the bounding box of this region.
+   */
+  const DirtyRegion& getUpdatedRegion() const
+  {
+    return updated_region_;
+  }
+
+  /**
+   * @brief  Have every later call to updateMap() add the cells it updates to
+   *         region, the same way as getUpdatedRegion(), until region is
+   *         destroyed. The whole map is added when it is resized or moved.
+   *         The region is only written with the costmap's mutex held, so
+   *         readers must hold it as well.
+   */
+  void addUpdateWatcher(const boost::shared_ptr<DirtyRegion>& region);
+
   bool isCurrent();
 
   Costmap2D* getCostmap()
@@ -155,6 +206,21 @@ public:
   double getInscribedRadius() { return inscribed_radius_; }
 
 private:
+  /**
+   * @brief  Apply the given tile-safe layers to the updated region one tile at a time, using the thread pool
+   */
+  void updateCostsTiled(const std::vector<Layer*>& layers);
+
+  /**
+   * @brief  Apply the given layers to the tile-th tile of the window
+   */
+  void updateTile(const std::vector<Layer*>& layers, int x0, int y0, int xn, int yn, unsigned int tile);
+
+  /**
+   * @brief  Add the given cells to the region of every update watcher, forgetting the expired ones
+   */
+  void notifyUpdateWatchers(const DirtyRegion& cells);
+
   Costmap2D costmap_;
   std::string global_frame_;
 
@@ -163,6 +229,9 @@ private:
   bool current_;
   double minx_, miny_, maxx_, maxy_;
   unsigned int bx0_, bxn_, by0_, byn_;
+  DirtyRegion dirty_region_;  ///< @brief The region the layers asked to update, in world coordinates
+  DirtyRegion updated_region_;  ///< @brief The region actually updated, in cells
+  std::vector<boost::weak_ptr<DirtyRegion> > update_watchers_;
 
   std::vector<boost::shared_ptr<Layer> > plugins_;
 
@@ -170,6 +239,9 @@ private:
   bool size_locked_;
   double circumscribed_radius_, inscribed_radius_;
   std::vector<geometry_msgs::Point> footprint_;
+
+  boost::scoped_ptr<ThreadPool> thread_pool_;
+  unsigned int tile_size_;
 };
 
 }  // namespace costmap_2d
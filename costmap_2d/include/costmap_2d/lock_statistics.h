@@ -0,0 +1,107 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_2D_LOCK_STATISTICS_H_
+#define COSTMAP_2D_LOCK_STATISTICS_H_
+
+#include <costmap_2d/costmap_2d.h>
+#include <boost/thread.hpp>
+#include <string>
+
+namespace costmap_2d
+{
+
+/**
+ * @class LockStatistics
+ * @brief Accumulates how long threads waited to get access to a costmap.
+ *
+ * Samples may be added from any thread.
+ */
+class LockStatistics
+{
+public:
+  LockStatistics();
+
+  /**
+   * @brief  Record one acquisition
+   * @param wait The time spent waiting, in seconds
+   */
+  void addSample(double wait);
+
+  /**
+   * @brief  Forget all samples recorded so far
+   */
+  void reset();
+
+  /**
+   * @brief  Read the statistics of the samples recorded so far
+   * @param count Set to the number of samples
+   * @param total Set to the sum of the waits, in seconds
+   * @param max Set to the longest wait, in seconds
+   */
+  void getStatistics(unsigned int* count, double* total, double* max) const;
+
+  /**
+   * @brief  A one line summary of the statistics, for logging
+   */
+  std::string toString() const;
+
+private:
+  mutable boost::mutex mutex_;
+  unsigned int count_;
+  double total_, max_;
+};
+
+/**
+ * @class TimedCostmapLock
+ * @brief A scoped lock on a costmap's mutex which records in a LockStatistics
+ *        how long it took to acquire.
+ */
+class TimedCostmapLock
+{
+public:
+  /**
+   * @brief  Lock the mutex, recording the wait in statistics
+   * @param acquire If false the mutex is left alone and nothing is recorded,
+   *        for callers which only sometimes need the lock
+   */
+  TimedCostmapLock(Costmap2D::mutex_t& mutex, LockStatistics& statistics, bool acquire = true);
+
+private:
+  boost::unique_lock<Costmap2D::mutex_t> lock_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_2D_LOCK_STATISTICS_H_
@@ -0,0 +1,76 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_2D_MERGE_KERNELS_H_
+#define COSTMAP_2D_MERGE_KERNELS_H_
+
+namespace costmap_2d
+{
+
+/**
+ * @brief A row kernel merges n cells of a layer into the same n cells of the master grid.
+ */
+typedef void (*MergeRowKernel)(unsigned char* master, const unsigned char* layer, unsigned int n);
+
+/**
+ * @struct MergeKernels
+ * @brief The row kernels implementing the CostmapLayer::updateWith*() merge policies.
+ *
+ * All implementations give exactly the same result; see CostmapLayer for the
+ * semantics of each policy.
+ */
+struct MergeKernels
+{
+  const char* name;
+  MergeRowKernel max;
+  MergeRowKernel overwrite;
+  MergeRowKernel true_overwrite;
+  MergeRowKernel addition;
+};
+
+/** @brief The portable implementation, always available. */
+const MergeKernels* getScalarMergeKernels();
+
+/** @brief The SSE2 implementation, or NULL if the CPU or the build does not support it. */
+const MergeKernels* getSSE2MergeKernels();
+
+/** @brief The AVX2 implementation, or NULL if the CPU or the build does not support it. */
+const MergeKernels* getAVX2MergeKernels();
+
+/** @brief The fastest implementation supported by this CPU, chosen on the first call. */
+const MergeKernels* getMergeKernels();
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_2D_MERGE_KERNELS_H_
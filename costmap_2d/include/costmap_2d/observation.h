@@ -34,14 +34,19 @@
 
 #include <geometry_msgs/Point.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <boost/shared_ptr.hpp>
 
 namespace costmap_2d
 {
 
 /**
  * @brief Stores an observation in terms of a point cloud and the origin of the source
- * @note Tried to make members and constructor arguments const but the compiler would not accept the default
- * assignment operator for vector insertion!
+ *
+ * The cloud is immutable and shared between the copies of an observation, so
+ * copying an observation does not copy its points.
+ *
+ * @note cloud_ used to be a boost::shared_ptr<sensor_msgs::PointCloud2>. Code
+ *       that modified the cloud of an observation must now copy it first.
  */
 class Observation
 {
@@ -56,7 +61,6 @@ public:
 
   virtual ~Observation()
   {
-    delete cloud_;
   }
 
   /**
@@ -74,12 +78,16 @@ public:
   }
 
   /**
-   * @brief  Copy constructor
-   * @param obs The observation to copy
+   * @brief  Creates an observation from an origin point and a shared point cloud, without copying it
+   * @param origin The origin point of the observation
+   * @param cloud The point cloud of the observation, which must not be modified afterwards
+   * @param obstacle_range The range out to which an observation should be able to insert obstacles
+   * @param raytrace_range The range out to which an observation should be able to clear via raytracing
    */
-  Observation(const Observation& obs) :
-      origin_(obs.origin_), cloud_(new sensor_msgs::PointCloud2(*(obs.cloud_))),
-      obstacle_range_(obs.obstacle_range_), raytrace_range_(obs.raytrace_range_)
+  Observation(const geometry_msgs::Point& origin, const boost::shared_ptr<const sensor_msgs::PointCloud2>& cloud,
+              double obstacle_range, double raytrace_range) :
+      origin_(origin), cloud_(cloud),
+      obstacle_range_(obstacle_range), raytrace_range_(raytrace_range)
   {
   }
 
@@ -94,7 +102,7 @@ public:
   }
 
   geometry_msgs::Point origin_;
-  sensor_msgs::PointCloud2* cloud_;
+  boost::shared_ptr<const sensor_msgs::PointCloud2> cloud_;
   double obstacle_range_, raytrace_range_;
 };
 
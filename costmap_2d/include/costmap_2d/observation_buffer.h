@@ -71,11 +71,12 @@ public:
    * @param  global_frame The frame to transform PointClouds into
    * @param  sensor_frame The frame of the origin of the sensor, can be left blank to be read from the messages
    * @param  tf_tolerance The amount of time to wait for a transform to be available when setting a new global frame
+   * @param  keep_all_fields Whether to keep every field of the points, instead of only x, y and z
    */
   ObservationBuffer(std::string topic_name, double observation_keep_time, double expected_update_rate,
                     double min_obstacle_height, double max_obstacle_height, double obstacle_range,
                     double raytrace_range, tf2_ros::Buffer& tf2_buffer, std::string global_frame,
-                    std::string sensor_frame, double tf_tolerance);
+                    std::string sensor_frame, double tf_tolerance, bool keep_all_fields = false);
 
   /**
    * @brief  Destructor... cleans up
@@ -92,14 +93,17 @@ public:
   bool setGlobalFrame(const std::string new_global_frame);
 
   /**
-   * @brief  Transforms a PointCloud to the global frame and buffers it
+   * @brief  Transforms a PointCloud to the global frame and buffers it. Only
+   *         the points within the height bounds are kept, as packed x, y and z
+   *         floats unless the buffer keeps all the fields.
    * <b>Note: The burden is on the user to make sure the transform is available... ie they should use a MessageNotifier</b>
    * @param  cloud The cloud to be buffered
    */
   void bufferCloud(const sensor_msgs::PointCloud2& cloud);
 
   /**
-   * @brief  Pushes copies of all current observations onto the end of the vector passed in
+   * @brief  Pushes copies of all current observations onto the end of the vector passed in.
+   *         The copies share their point clouds with the buffer.
    * @param  observations The vector to be filled
    */
   void getObservations(std::vector<Observation>& observations);
@@ -149,6 +153,7 @@ private:
   boost::recursive_mutex lock_;  ///< @brief A lock for accessing data in callbacks safely
   double obstacle_range_, raytrace_range_;
   double tf_tolerance_;
+  bool keep_all_fields_;
 };
 }  // namespace costmap_2d
 #endif  // COSTMAP_2D_OBSERVATION_BUFFER_H_
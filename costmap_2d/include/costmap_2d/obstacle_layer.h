@@ -62,7 +62,7 @@ namespace costmap_2d
 class ObstacleLayer : public CostmapLayer
 {
 public:
-  ObstacleLayer()
+  ObstacleLayer() : defer_clearing_(false)
   {
     costmap_ = NULL;  // this is the unsigned char* member of parent class Costmap2D.
   }
@@ -71,7 +71,17 @@ public:
   virtual void onInitialize();
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
                             double* max_x, double* max_y);
+
+  /**
+   * @brief Adds one rectangle for each observation and one for the footprint,
+   *        instead of growing a single box around all of them.
+   */
+  virtual void updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region);
   virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
+  virtual bool isTileSafe()
+  {
+    return true;
+  }
 
   virtual void activate();
   virtual void deactivate();
@@ -141,6 +151,21 @@ protected:
   virtual void raytraceFreespace(const costmap_2d::Observation& clearing_observation, double* min_x, double* min_y,
                                  double* max_x, double* max_y);
 
+  /**
+   * @brief  Clip the rays of one observation to the map and grow the bounds
+   *         like raytraceFreespace(), but only clear the cells on the next
+   *         call to clearRays()
+   */
+  void queueClearingRays(const costmap_2d::Observation& clearing_observation, double* min_x, double* min_y,
+                         double* max_x, double* max_y);
+
+  /**
+   * @brief  Clear the cells along the rays queued since the last call. The
+   *         rays are split between the threads of the LayeredCostmap, if it
+   *         has any.
+   */
+  void clearRays();
+
   void updateRaytraceBounds(double ox, double oy, double wx, double wy, double range, double* min_x, double* min_y,
                             double* max_x, double* max_y);
 
@@ -170,6 +195,37 @@ protected:
 
 private:
   void reconfigureCB(costmap_2d::ObstaclePluginConfig &config, uint32_t level);
+
+  /**
+   * @brief  Trace the chunk-th of num_chunks equal parts of clearing_rays_
+   */
+  void clearRayChunk(unsigned int chunk, unsigned int num_chunks);
+
+  struct ClearingRay
+  {
+    unsigned int x0, y0, x1, y1, max_length;
+  };
+  std::vector<ClearingRay> clearing_rays_;  ///< @brief The rays waiting for clearRays()
+  bool defer_clearing_;  ///< @brief raytraceFreespace() only queues its rays, updateRegion() clears them all at once
+
+  /**
+   * Sets cells to FREE_SPACE like MarkCell, with relaxed atomic stores so that
+   * rays sharing cells can be traced on several threads at once
+   */
+  class ClearCellShared
+  {
+  public:
+    explicit ClearCellShared(unsigned char* costmap) :
+        costmap_(costmap)
+    {
+    }
+    inline void operator()(unsigned int offset)
+    {
+      __atomic_store_n(&costmap_[offset], FREE_SPACE, __ATOMIC_RELAXED);
+    }
+  private:
+    unsigned char* costmap_;
+  };
 };
 
 }  // namespace costmap_2d
@@ -0,0 +1,88 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_2D_SNAPSHOT_BUFFER_H_
+#define COSTMAP_2D_SNAPSHOT_BUFFER_H_
+
+#include <costmap_2d/costmap_2d.h>
+#include <boost/shared_ptr.hpp>
+
+namespace costmap_2d
+{
+
+/**
+ * @class SnapshotBuffer
+ * @brief Hands out immutable copies of a costmap to readers on other threads.
+ *
+ * publish() copies the costmap into a new snapshot and makes it the one
+ * returned by get(). The buffer of the previous snapshot is reused by the
+ * next publish() if no reader holds on to it any more, so publishing a map
+ * of the same size over and over does not allocate.
+ */
+class SnapshotBuffer
+{
+public:
+  SnapshotBuffer();
+
+  /**
+   * @brief  Copy the costmap into a new snapshot and make it the latest one.
+   *         Must not be called from several threads at once.
+   */
+  void publish(const Costmap2D& costmap);
+
+  /**
+   * @brief  The latest snapshot, or NULL if none was published yet.
+   *         May be called from any thread.
+   */
+  boost::shared_ptr<const Costmap2D> get() const;
+
+  /**
+   * @brief  Whether publish() sets the outermost cells of the snapshots to
+   *         LETHAL_OBSTACLE, for readers that need a closed border and
+   *         cannot write it into the shared snapshot themselves
+   */
+  void setOutline(bool outline)
+  {
+    outline_ = outline;
+  }
+
+private:
+  boost::shared_ptr<Costmap2D> latest_;  ///< @brief Only accessed through boost::atomic_load/atomic_exchange
+  boost::shared_ptr<Costmap2D> spare_;  ///< @brief The previous snapshot, reused when no reader holds it
+  bool outline_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_2D_SNAPSHOT_BUFFER_H_
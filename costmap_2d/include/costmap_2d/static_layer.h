@@ -62,8 +62,17 @@ public:
 
   virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
                             double* max_x, double* max_y);
+  /** @brief Adds only the bounds of the map data that changed, not the bounding box of the region */
+  virtual void updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region);
   virtual void updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j);
 
+  /** @brief In a rolling window every updateCosts() call looks up the latest
+   *         transform, so tiles could see different transforms. */
+  virtual bool isTileSafe()
+  {
+    return !layered_costmap_->isRolling();
+  }
+
   virtual void matchSize();
 
 private:
@@ -0,0 +1,103 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef COSTMAP_2D_THREAD_POOL_H_
+#define COSTMAP_2D_THREAD_POOL_H_
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+namespace costmap_2d
+{
+
+/**
+ * @class ThreadPool
+ * @brief A fixed set of worker threads that runs batches of independent tasks.
+ *
+ * The threads are created once and sleep between batches, so handing a batch
+ * to the pool every update cycle does not create any threads.
+ */
+class ThreadPool
+{
+public:
+  /**
+   * @brief  Constructor
+   * @param num_threads The total number of threads working on a batch,
+   *        including the thread calling run(). A value of 1 runs everything
+   *        on the calling thread.
+   */
+  explicit ThreadPool(unsigned int num_threads);
+
+  /**
+   * @brief  Destructor, stops and joins the worker threads
+   */
+  ~ThreadPool();
+
+  /**
+   * @brief  Calls task(i) for every i in [0, num_tasks) and returns once all
+   *         of them have completed. The calling thread takes part in the work.
+   *         The order in which the tasks run is unspecified.
+   */
+  void run(unsigned int num_tasks, const boost::function<void(unsigned int)>& task);
+
+  unsigned int getNumThreads() const
+  {
+    return num_threads_;
+  }
+
+private:
+  void workerLoop();
+
+  /**
+   * @brief  Take tasks of the current batch until there are none left
+   * @param lock A lock on mutex_, which is held again when this returns
+   */
+  void runTasks(boost::unique_lock<boost::mutex>& lock);
+
+  unsigned int num_threads_;
+  boost::thread_group workers_;
+
+  boost::mutex mutex_;
+  boost::condition_variable work_cv_, done_cv_;
+  const boost::function<void(unsigned int)>* task_;
+  unsigned int num_tasks_;
+  unsigned int next_task_;
+  unsigned int unfinished_tasks_;
+  unsigned long batch_;
+  bool shutdown_;
+};
+
+}  // namespace costmap_2d
+
+#endif  // COSTMAP_2D_THREAD_POOL_H_
@@ -54,6 +54,7 @@
 #include <costmap_2d/VoxelPluginConfig.h>
 #include <costmap_2d/obstacle_layer.h>
 #include <voxel_grid/voxel_grid.h>
+#include <voxel_grid/sparse_voxel_grid.h>
 
 namespace costmap_2d
 {
@@ -62,7 +63,9 @@ class VoxelLayer : public ObstacleLayer
 {
 public:
   VoxelLayer() :
-      voxel_grid_(0, 0, 0)
+      voxel_grid_(0, 0, 0),
+      sparse_voxel_grid_(0, 0, 0),
+      sparse_voxels_(false)
   {
     costmap_ = NULL;  // this is the unsigned char* member of parent class's parent class Costmap2D.
   }
@@ -70,8 +73,7 @@ public:
   virtual ~VoxelLayer();
 
   virtual void onInitialize();
-  virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
-                            double* max_x, double* max_y);
+  virtual void updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region);
 
   void updateOrigin(double new_origin_x, double new_origin_y);
   bool isDiscretized()
@@ -98,10 +100,13 @@ private:
   bool publish_voxel_;
   ros::Publisher voxel_pub_;
   voxel_grid::VoxelGrid voxel_grid_;
+  voxel_grid::SparseVoxelGrid sparse_voxel_grid_;
+  bool sparse_voxels_;  ///< @brief Use sparse_voxel_grid_ rather than voxel_grid_
   double z_resolution_, origin_z_;
   unsigned int unknown_threshold_, mark_threshold_, size_z_;
   ros::Publisher clearing_endpoints_pub_;
   sensor_msgs::PointCloud clearing_endpoints_;
+  std::vector<voxel_grid::GridPoint> clearing_ends_;  ///< @brief End points of the rays of raytraceFreespace()
 
   inline bool worldToMap3DFloat(double wx, double wy, double wz, double& mx, double& my, double& mz)
   {
@@ -40,6 +40,7 @@
 #include <costmap_2d/costmap_math.h>
 #include <costmap_2d/footprint.h>
 #include <boost/thread.hpp>
+#include <boost/bind.hpp>
 #include <pluginlib/class_list_macros.h>
 
 PLUGINLIB_EXPORT_CLASS(costmap_2d::InflationLayer, costmap_2d::Layer)
@@ -59,16 +60,22 @@ InflationLayer::InflationLayer()
   , inflate_unknown_(false)
   , cell_inflation_radius_(0)
   , cached_cell_inflation_radius_(0)
-  , dsrv_(NULL)
   , seen_(NULL)
   , cached_costs_(NULL)
   , cached_distances_(NULL)
-  , last_min_x_(-std::numeric_limits<float>::max())
-  , last_min_y_(-std::numeric_limits<float>::max())
-  , last_max_x_(std::numeric_limits<float>::max())
-  , last_max_y_(std::numeric_limits<float>::max())
+  , cached_bins_(NULL)
+  , incremental_(false)
+  , verify_incremental_(false)
+  , field_valid_(false)
+  , field_origin_x_(0.0)
+  , field_origin_y_(0.0)
+  , verification_mismatches_(0)
+  , dsrv_(NULL)
 {
   inflation_access_ = new boost::recursive_mutex();
+  // inflate the whole map on the first cycle
+  last_region_.add(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                   std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
 }
 
 void InflationLayer::onInitialize()
@@ -109,6 +116,8 @@ void InflationLayer::reconfigureCB(costmap_2d::InflationPluginConfig &config, ui
     inflate_unknown_ = config.inflate_unknown;
     need_reinflation_ = true;
   }
+
+  setIncrementalInflation(config.incremental, config.verify_incremental);
 }
 
 void InflationLayer::matchSize()
@@ -124,40 +133,36 @@ void InflationLayer::matchSize()
     delete[] seen_;
   seen_size_ = size_x * size_y;
   seen_ = new bool[seen_size_];
+  field_valid_ = false;
 }
 
 void InflationLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
                                            double* min_y, double* max_x, double* max_y)
+{
+  DirtyRegion region;
+  region.add(*min_x, *min_y, *max_x, *max_y);
+  updateRegion(robot_x, robot_y, robot_yaw, &region);
+  region.expandBounds(min_x, min_y, max_x, max_y);
+}
+
+void InflationLayer::updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region)
 {
   if (need_reinflation_)
   {
-    last_min_x_ = *min_x;
-    last_min_y_ = *min_y;
-    last_max_x_ = *max_x;
-    last_max_y_ = *max_y;
+    last_region_ = *region;
     // For some reason when I make these -<double>::max() it does not
     // work with Costmap2D::worldToMapEnforceBounds(), so I'm using
     // -<float>::max() instead.
-    *min_x = -std::numeric_limits<float>::max();
-    *min_y = -std::numeric_limits<float>::max();
-    *max_x = std::numeric_limits<float>::max();
-    *max_y = std::numeric_limits<float>::max();
+    region->add(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
     need_reinflation_ = false;
   }
   else
   {
-    double tmp_min_x = last_min_x_;
-    double tmp_min_y = last_min_y_;
-    double tmp_max_x = last_max_x_;
-    double tmp_max_y = last_max_y_;
-    last_min_x_ = *min_x;
-    last_min_y_ = *min_y;
-    last_max_x_ = *max_x;
-    last_max_y_ = *max_y;
-    *min_x = std::min(tmp_min_x, *min_x) - inflation_radius_;
-    *min_y = std::min(tmp_min_y, *min_y) - inflation_radius_;
-    *max_x = std::max(tmp_max_x, *max_x) + inflation_radius_;
-    *max_y = std::max(tmp_max_y, *max_y) + inflation_radius_;
+    DirtyRegion previous = last_region_;
+    last_region_ = *region;
+    region->add(previous);
+    region->pad(inflation_radius_);
   }
 }
 
@@ -179,8 +184,15 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
   if (!enabled_ || (cell_inflation_radius_ == 0))
     return;
 
+  if (incremental_)
+  {
+    updateCostsIncremental(master_grid, min_i, min_j, max_i, max_j);
+    return;
+  }
+
   // make sure the inflation list is empty at the beginning of the cycle (should always be true)
-  ROS_ASSERT_MSG(inflation_cells_.empty(), "The inflation list must be empty at the beginning of inflation");
+  ROS_ASSERT_MSG(inflation_cells_.empty() || inflation_cells_[0].empty(),
+                 "The inflation list must be empty at the beginning of inflation");
 
   unsigned char* master_array = master_grid.getCharMap();
   unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
@@ -197,7 +209,6 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
     seen_size_ = size_x * size_y;
     seen_ = new bool[seen_size_];
   }
-  memset(seen_, false, size_x * size_y * sizeof(bool));
 
   // We need to include in the inflation cells outside the bounding
   // box min_i...max_j, by the amount cell_inflation_radius_.  Cells
@@ -213,11 +224,23 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
   max_i = std::min(int(size_x), max_i);
   max_j = std::min(int(size_y), max_j);
 
-  // Inflation list; we append cells to visit in a list associated with its distance to the nearest obstacle
-  // We use a map<distance, list> to emulate the priority queue used before, with a notable performance boost
+  // Only cells within cell_inflation_radius_ of the padded window can be
+  // visited, so that is the only part of seen_ that needs to be cleared.
+  int seen_min_i = std::max(0, min_i - int(cell_inflation_radius_));
+  int seen_min_j = std::max(0, min_j - int(cell_inflation_radius_));
+  int seen_max_i = std::min(int(size_x), max_i + int(cell_inflation_radius_));
+  int seen_max_j = std::min(int(size_y), max_j + int(cell_inflation_radius_));
+  for (int j = seen_min_j; j < seen_max_j; j++)
+  {
+    memset(seen_ + master_grid.getIndex(seen_min_i, j), false, (seen_max_i - seen_min_i) * sizeof(bool));
+  }
+
+  // Inflation list; we append cells to visit in a bin associated with the rank of their distance to the nearest
+  // obstacle. Visiting the bins in increasing order emulates the priority queue used before, in time linear in the
+  // number of cells visited.
 
-  // Start with lethal obstacles: by definition distance is 0.0
-  std::vector<CellData>& obs_bin = inflation_cells_[0.0];
+  // Start with lethal obstacles: by definition distance is 0.0, which is always the first bin
+  std::vector<CellData>& obs_bin = inflation_cells_[0];
   for (int j = min_j; j < max_j; j++)
   {
     for (int i = min_i; i < max_i; i++)
@@ -233,13 +256,13 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
 
   // Process cells by increasing distance; new cells are appended to the corresponding distance bin, so they
   // can overtake previously inserted but farther away cells
-  std::map<double, std::vector<CellData> >::iterator bin;
-  for (bin = inflation_cells_.begin(); bin != inflation_cells_.end(); ++bin)
+  for (unsigned int bin = 0; bin < inflation_cells_.size(); ++bin)
   {
-    for (int i = 0; i < bin->second.size(); ++i)
+    std::vector<CellData>& cells = inflation_cells_[bin];
+    for (int i = 0; i < cells.size(); ++i)
     {
-      // process all cells at distance dist_bin.first
-      const CellData& cell = bin->second[i];
+      // process all cells at the distance of this bin
+      const CellData& cell = cells[i];
 
       unsigned int index = cell.index_;
 
@@ -274,9 +297,121 @@ void InflationLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i,
       if (my < size_y - 1)
         enqueue(index + size_x, mx, my + 1, sx, sy);
     }
+    // clear() keeps the capacity, so steady state cycles do not allocate
+    cells.clear();
+  }
+}
+
+void InflationLayer::updateCostsIncremental(costmap_2d::Costmap2D& master_grid, int min_i, int min_j,
+                                            int max_i, int max_j)
+{
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(int(size_x), max_i);
+  max_j = std::min(int(size_y), max_j);
+  if (min_i >= max_i || min_j >= max_j)
+    return;
+
+  updateDistancesIncremental(master_grid, min_i, min_j, max_i, max_j);
+
+  // The cost of a cell only depends on its own distance, so the tiles of the
+  // window can be written at the same time.
+  ThreadPool* pool = layered_costmap_->getThreadPool();
+  if (pool)
+  {
+    unsigned int num_tasks = pool->getNumThreads();
+    pool->run(num_tasks, boost::bind(&InflationLayer::updateTiles, this, &master_grid, min_i, min_j, max_i, max_j,
+                                     _1, num_tasks));
+  }
+  else
+  {
+    applyCosts(master_grid, min_i, min_j, max_i, max_j);
+  }
+}
+
+void InflationLayer::updateTiles(costmap_2d::Costmap2D* master_grid, int min_i, int min_j, int max_i, int max_j,
+                                 unsigned int task, unsigned int num_tasks)
+{
+  int tile_size = layered_costmap_->getTileSize();
+  unsigned int tiles_x = (max_i - min_i + tile_size - 1) / tile_size;
+  unsigned int tiles_y = (max_j - min_j + tile_size - 1) / tile_size;
+  unsigned int num_tiles = tiles_x * tiles_y;
+  for (unsigned int tile = num_tiles * task / num_tasks; tile < num_tiles * (task + 1) / num_tasks; ++tile)
+  {
+    int tx0 = min_i + (tile % tiles_x) * tile_size;
+    int ty0 = min_j + (tile / tiles_x) * tile_size;
+    int txn = std::min(max_i, tx0 + tile_size);
+    int tyn = std::min(max_j, ty0 + tile_size);
+    applyCosts(*master_grid, tx0, ty0, txn, tyn);
+  }
+}
+
+void InflationLayer::updateDistancesIncremental(costmap_2d::Costmap2D& master_grid, int min_i, int min_j,
+                                                int max_i, int max_j)
+{
+  unsigned char* master_array = master_grid.getCharMap();
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+
+  if (!field_valid_ || distance_field_.getSizeX() != size_x || distance_field_.getSizeY() != size_y)
+  {
+    // start from all the obstacles of the map
+    distance_field_.reset(size_x, size_y, cell_inflation_radius_);
+    distance_field_.setObstacles(master_array, LETHAL_OBSTACLE, 0, 0, size_x, size_y);
+    distance_field_.recompute();
+    field_valid_ = true;
+  }
+  else if (master_grid.getOriginX() != field_origin_x_ || master_grid.getOriginY() != field_origin_y_)
+  {
+    // the map rolled with the robot, the origins only ever move by whole cells
+    double resolution = master_grid.getResolution();
+    distance_field_.shift(lround((master_grid.getOriginX() - field_origin_x_) / resolution),
+                          lround((master_grid.getOriginY() - field_origin_y_) / resolution));
+  }
+  field_origin_x_ = master_grid.getOriginX();
+  field_origin_y_ = master_grid.getOriginY();
+
+  // only the window was updated by the other layers, the lethal cells outside of it are the same as last cycle
+  distance_field_.setObstacles(master_array, LETHAL_OBSTACLE, min_i, min_j, max_i, max_j);
+  distance_field_.update();
+
+  if (verify_incremental_)
+  {
+    verification_field_.reset(size_x, size_y, cell_inflation_radius_);
+    verification_field_.setObstacles(master_array, LETHAL_OBSTACLE, 0, 0, size_x, size_y);
+    verification_field_.recompute();
+    verification_mismatches_ = distance_field_.countDifferences(verification_field_);
+    if (verification_mismatches_ > 0)
+    {
+      ROS_ERROR("InflationLayer: the incremental distance field differs from a full recompute in %u cells",
+                verification_mismatches_);
+    }
   }
+}
+
+void InflationLayer::applyCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
+{
+  unsigned char* master_array = master_grid.getCharMap();
+
+  // the cost of a cell only depends on its distance to the nearest obstacle
+  const uint32_t* distances = distance_field_.getSquaredDistances();
+  for (int j = min_j; j < max_j; j++)
+  {
+    for (int i = min_i; i < max_i; i++)
+    {
+      int index = master_grid.getIndex(i, j);
+      uint32_t distance = distances[index];
+      if (distance == DistanceField::OUT_OF_RANGE)
+        continue;
 
-  inflation_cells_.clear();
+      unsigned char cost = squared_distance_costs_[distance];
+      unsigned char old_cost = master_array[index];
+      if (old_cost == NO_INFORMATION && (inflate_unknown_ ? (cost > FREE_SPACE) : (cost >= INSCRIBED_INFLATED_OBSTACLE)))
+        master_array[index] = cost;
+      else
+        master_array[index] = std::max(old_cost, cost);
+    }
+  }
 }
 
 /**
@@ -301,7 +436,7 @@ inline void InflationLayer::enqueue(unsigned int index, unsigned int mx, unsigne
       return;
 
     // push the cell data onto the inflation list and mark
-    inflation_cells_[distance].push_back(CellData(index, mx, my, src_x, src_y));
+    inflation_cells_[binLookup(mx, my, src_x, src_y)].push_back(CellData(index, mx, my, src_x, src_y));
   }
 }
 
@@ -317,18 +452,40 @@ void InflationLayer::computeCaches()
 
     cached_costs_ = new unsigned char*[cell_inflation_radius_ + 2];
     cached_distances_ = new double*[cell_inflation_radius_ + 2];
+    cached_bins_ = new unsigned int*[cell_inflation_radius_ + 2];
 
+    // collect the distinct distances within the inflation radius, these are the bins of the inflation list
+    std::vector<double> bin_distances;
     for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i)
     {
       cached_costs_[i] = new unsigned char[cell_inflation_radius_ + 2];
       cached_distances_[i] = new double[cell_inflation_radius_ + 2];
+      cached_bins_[i] = new unsigned int[cell_inflation_radius_ + 2];
       for (unsigned int j = 0; j <= cell_inflation_radius_ + 1; ++j)
       {
         cached_distances_[i][j] = hypot(i, j);
+        if (cached_distances_[i][j] <= cell_inflation_radius_)
+          bin_distances.push_back(cached_distances_[i][j]);
+      }
+    }
+    std::sort(bin_distances.begin(), bin_distances.end());
+    bin_distances.erase(std::unique(bin_distances.begin(), bin_distances.end()), bin_distances.end());
+
+    // cells farther than the inflation radius are never enqueued, so their bin is never used
+    for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i)
+    {
+      for (unsigned int j = 0; j <= cell_inflation_radius_ + 1; ++j)
+      {
+        cached_bins_[i][j] = std::lower_bound(bin_distances.begin(), bin_distances.end(), cached_distances_[i][j])
+                             - bin_distances.begin();
       }
     }
 
+    inflation_cells_.clear();
+    inflation_cells_.resize(bin_distances.size());
+
     cached_cell_inflation_radius_ = cell_inflation_radius_;
+    field_valid_ = false;
   }
 
   for (unsigned int i = 0; i <= cell_inflation_radius_ + 1; ++i)
@@ -338,6 +495,12 @@ void InflationLayer::computeCaches()
       cached_costs_[i][j] = computeCost(cached_distances_[i][j]);
     }
   }
+
+  squared_distance_costs_.resize(cell_inflation_radius_ * cell_inflation_radius_ + 1);
+  for (unsigned int d = 0; d < squared_distance_costs_.size(); ++d)
+  {
+    squared_distance_costs_[d] = computeCost(sqrt(d));
+  }
 }
 
 void InflationLayer::deleteKernels()
@@ -364,6 +527,40 @@ void InflationLayer::deleteKernels()
     delete[] cached_costs_;
     cached_costs_ = NULL;
   }
+
+  if (cached_bins_ != NULL)
+  {
+    for (unsigned int i = 0; i <= cached_cell_inflation_radius_ + 1; ++i)
+    {
+      if (cached_bins_[i])
+        delete[] cached_bins_[i];
+    }
+    delete[] cached_bins_;
+    cached_bins_ = NULL;
+  }
+}
+
+void InflationLayer::setIncrementalInflation(bool incremental, bool verify)
+{
+  if (incremental_ != incremental || verify_incremental_ != verify)
+  {
+    boost::unique_lock < boost::recursive_mutex > lock(*inflation_access_);
+    incremental_ = incremental;
+    verify_incremental_ = verify;
+    verification_mismatches_ = 0;
+    field_valid_ = false;
+    need_reinflation_ = true;
+    if (!incremental_)
+    {
+      // the wavefront does not need the fields, which take 5 bytes per cell each
+      distance_field_.release();
+      verification_field_.release();
+    }
+    else if (!verify_incremental_)
+    {
+      verification_field_.release();
+    }
+  }
 }
 
 void InflationLayer::setInflationParameters(double inflation_radius, double cost_scaling_factor)
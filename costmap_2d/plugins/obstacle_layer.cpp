@@ -41,6 +41,7 @@
 
 #include <pluginlib/class_list_macros.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <boost/bind.hpp>
 
 PLUGINLIB_EXPORT_CLASS(costmap_2d::ObstacleLayer, costmap_2d::Layer)
 
@@ -89,7 +90,7 @@ void ObstacleLayer::onInitialize()
     // get the parameters for the specific topic
     double observation_keep_time, expected_update_rate, min_obstacle_height, max_obstacle_height;
     std::string topic, sensor_frame, data_type;
-    bool inf_is_valid, clearing, marking;
+    bool inf_is_valid, clearing, marking, keep_all_fields;
 
     source_node.param("topic", topic, source);
     source_node.param("sensor_frame", sensor_frame, std::string(""));
@@ -101,6 +102,7 @@ void ObstacleLayer::onInitialize()
     source_node.param("inf_is_valid", inf_is_valid, false);
     source_node.param("clearing", clearing, false);
     source_node.param("marking", marking, true);
+    source_node.param("keep_all_fields", keep_all_fields, false);
 
     if (!(data_type == "PointCloud2" || data_type == "PointCloud" || data_type == "LaserScan"))
     {
@@ -132,7 +134,7 @@ void ObstacleLayer::onInitialize()
         boost::shared_ptr < ObservationBuffer
             > (new ObservationBuffer(topic, observation_keep_time, expected_update_rate, min_obstacle_height,
                                      max_obstacle_height, obstacle_range, raytrace_range, *tf_, global_frame_,
-                                     sensor_frame, transform_tolerance)));
+                                     sensor_frame, transform_tolerance, keep_all_fields)));
 
     // check if we'll add this buffer to our marking observation buffers
     if (marking)
@@ -332,12 +334,23 @@ void ObstacleLayer::pointCloud2Callback(const sensor_msgs::PointCloud2ConstPtr&
 
 void ObstacleLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
                                           double* min_y, double* max_x, double* max_y)
+{
+  DirtyRegion region;
+  updateRegion(robot_x, robot_y, robot_yaw, &region);
+  region.expandBounds(min_x, min_y, max_x, max_y);
+}
+
+void ObstacleLayer::updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region)
 {
   if (rolling_window_)
     updateOrigin(robot_x - getSizeInMetersX() / 2, robot_y - getSizeInMetersY() / 2);
   if (!enabled_)
     return;
-  useExtraBounds(min_x, min_y, max_x, max_y);
+
+  double min_x, min_y, max_x, max_y;
+  DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+  useExtraBounds(&min_x, &min_y, &max_x, &max_y);
+  region->add(min_x, min_y, max_x, max_y);
 
   bool current = true;
   std::vector<Observation> observations, clearing_observations;
@@ -351,16 +364,23 @@ void ObstacleLayer::updateBounds(double robot_x, double robot_y, double robot_ya
   // update the global current status
   current_ = current;
 
-  // raytrace freespace
+  // raytrace freespace, each observation gets its own rectangle in the region, and the rays of all of them are
+  // cleared together
+  defer_clearing_ = true;
   for (unsigned int i = 0; i < clearing_observations.size(); ++i)
   {
-    raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+    DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+    raytraceFreespace(clearing_observations[i], &min_x, &min_y, &max_x, &max_y);
+    region->add(min_x, min_y, max_x, max_y);
   }
+  defer_clearing_ = false;
+  clearRays();
 
   // place the new obstacles into a priority queue... each with a priority of zero to begin with
   for (std::vector<Observation>::const_iterator it = observations.begin(); it != observations.end(); ++it)
   {
     const Observation& obs = *it;
+    DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
 
     const sensor_msgs::PointCloud2& cloud = *(obs.cloud_);
 
@@ -402,11 +422,14 @@ void ObstacleLayer::updateBounds(double robot_x, double robot_y, double robot_ya
 
       unsigned int index = getIndex(mx, my);
       costmap_[index] = LETHAL_OBSTACLE;
-      touch(px, py, min_x, min_y, max_x, max_y);
+      touch(px, py, &min_x, &min_y, &max_x, &max_y);
     }
+    region->add(min_x, min_y, max_x, max_y);
   }
 
-  updateFootprint(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+  DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+  updateFootprint(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+  region->add(min_x, min_y, max_x, max_y);
 }
 
 void ObstacleLayer::updateFootprint(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
@@ -419,6 +442,10 @@ void ObstacleLayer::updateFootprint(double robot_x, double robot_y, double robot
     {
       touch(transformed_footprint_[i].x, transformed_footprint_[i].y, min_x, min_y, max_x, max_y);
     }
+
+    // Clear the footprint here rather than in updateCosts(), so that
+    // updateCosts() only reads this layer and stays tile-safe.
+    setConvexPolygonCost(transformed_footprint_, costmap_2d::FREE_SPACE);
 }
 
 void ObstacleLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
@@ -426,11 +453,6 @@ void ObstacleLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, i
   if (!enabled_)
     return;
 
-  if (footprint_clearing_enabled_)
-  {
-    setConvexPolygonCost(transformed_footprint_, costmap_2d::FREE_SPACE);
-  }
-
   switch (combination_method_)
   {
     case 0:  // Overwrite
@@ -494,6 +516,14 @@ bool ObstacleLayer::getClearingObservations(std::vector<Observation>& clearing_o
 
 void ObstacleLayer::raytraceFreespace(const Observation& clearing_observation, double* min_x, double* min_y,
                                               double* max_x, double* max_y)
+{
+  queueClearingRays(clearing_observation, min_x, min_y, max_x, max_y);
+  if (!defer_clearing_)
+    clearRays();
+}
+
+void ObstacleLayer::queueClearingRays(const Observation& clearing_observation, double* min_x, double* min_y,
+                                      double* max_x, double* max_y)
 {
   double ox = clearing_observation.origin_.x;
   double oy = clearing_observation.origin_.y;
@@ -516,6 +546,7 @@ void ObstacleLayer::raytraceFreespace(const Observation& clearing_observation, d
 
 
   touch(ox, oy, min_x, min_y, max_x, max_y);
+  unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
 
   // for each point in the cloud, we want to trace a line from the origin and clear obstacles along it
   sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
@@ -566,15 +597,47 @@ void ObstacleLayer::raytraceFreespace(const Observation& clearing_observation, d
     if (!worldToMap(wx, wy, x1, y1))
       continue;
 
-    unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
-    MarkCell marker(costmap_, FREE_SPACE);
-    // and finally... we can execute our trace to clear obstacles along that line
-    raytraceLine(marker, x0, y0, x1, y1, cell_raytrace_range);
+    // and finally... we can queue our trace to clear obstacles along that line
+    ClearingRay ray = { x0, y0, x1, y1, cell_raytrace_range };
+    clearing_rays_.push_back(ray);
 
     updateRaytraceBounds(ox, oy, wx, wy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
   }
 }
 
+void ObstacleLayer::clearRays()
+{
+  // clearing only ever writes FREE_SPACE, so the rays can be traced in any order
+  ThreadPool* pool = layered_costmap_->getThreadPool();
+  if (pool && clearing_rays_.size() >= 256)
+  {
+    unsigned int num_chunks = 4 * pool->getNumThreads();
+    pool->run(num_chunks, boost::bind(&ObstacleLayer::clearRayChunk, this, _1, num_chunks));
+  }
+  else
+  {
+    MarkCell marker(costmap_, FREE_SPACE);
+    for (unsigned int i = 0; i < clearing_rays_.size(); ++i)
+    {
+      const ClearingRay& ray = clearing_rays_[i];
+      raytraceLine(marker, ray.x0, ray.y0, ray.x1, ray.y1, ray.max_length);
+    }
+  }
+  clearing_rays_.clear();
+}
+
+void ObstacleLayer::clearRayChunk(unsigned int chunk, unsigned int num_chunks)
+{
+  size_t begin = clearing_rays_.size() * chunk / num_chunks;
+  size_t end = clearing_rays_.size() * (chunk + 1) / num_chunks;
+  ClearCellShared marker(costmap_);
+  for (size_t i = begin; i < end; ++i)
+  {
+    const ClearingRay& ray = clearing_rays_[i];
+    raytraceLine(marker, ray.x0, ray.y0, ray.x1, ray.y1, ray.max_length);
+  }
+}
+
 void ObstacleLayer::activate()
 {
   // if we're stopped we need to re-subscribe to topics
@@ -291,6 +291,16 @@ void StaticLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
   has_updated_data_ = false;
 }
 
+void StaticLayer::updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region)
+{
+  // updateBounds() only grows the bounds by the map data, so starting from
+  // an empty box gives the part of this layer that changed
+  double min_x, min_y, max_x, max_y;
+  DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+  updateBounds(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+  region->add(min_x, min_y, max_x, max_y);
+}
+
 void StaticLayer::updateCosts(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
 {
   if (!map_received_)
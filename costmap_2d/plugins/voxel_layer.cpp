@@ -38,6 +38,7 @@
 #include <costmap_2d/voxel_layer.h>
 #include <pluginlib/class_list_macros.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <boost/bind.hpp>
 
 #define VOXEL_BITS 16
 PLUGINLIB_EXPORT_CLASS(costmap_2d::VoxelLayer, costmap_2d::Layer)
@@ -54,9 +55,13 @@ namespace costmap_2d
 
 void VoxelLayer::onInitialize()
 {
-  ObstacleLayer::onInitialize();
   ros::NodeHandle private_nh("~/" + name_);
 
+  // must be known before the first reconfigure callback sizes the grid
+  private_nh.param("sparse_voxel_grid", sparse_voxels_, false);
+
+  ObstacleLayer::onInitialize();
+
   private_nh.param("publish_voxel_map", publish_voxel_, false);
   if (publish_voxel_)
     voxel_pub_ = private_nh.advertise < costmap_2d::VoxelGrid > ("voxel_grid", 1);
@@ -84,9 +89,16 @@ void VoxelLayer::reconfigureCB(costmap_2d::VoxelPluginConfig &config, uint32_t l
   footprint_clearing_enabled_ = config.footprint_clearing_enabled;
   max_obstacle_height_ = config.max_obstacle_height;
   size_z_ = config.z_voxels;
+  if (!sparse_voxels_ && size_z_ > VOXEL_BITS)
+  {
+    ROS_WARN("%s: z_voxels is %u, but only %d are supported unless sparse_voxel_grid is enabled", name_.c_str(),
+             size_z_, VOXEL_BITS);
+    size_z_ = VOXEL_BITS;
+  }
   origin_z_ = config.origin_z;
   z_resolution_ = config.z_resolution;
-  unknown_threshold_ = config.unknown_threshold + (VOXEL_BITS - size_z_);
+  // the levels above size_z_ of a dense column are always unknown, so they must not count
+  unknown_threshold_ = config.unknown_threshold + (sparse_voxels_ ? 0 : VOXEL_BITS - size_z_);
   mark_threshold_ = config.mark_threshold;
   combination_method_ = config.combination_method;
   matchSize();
@@ -95,32 +107,45 @@ void VoxelLayer::reconfigureCB(costmap_2d::VoxelPluginConfig &config, uint32_t l
 void VoxelLayer::matchSize()
 {
   ObstacleLayer::matchSize();
-  voxel_grid_.resize(size_x_, size_y_, size_z_);
-  ROS_ASSERT(voxel_grid_.sizeX() == size_x_ && voxel_grid_.sizeY() == size_y_);
+  if (sparse_voxels_)
+  {
+    sparse_voxel_grid_.resize(size_x_, size_y_, size_z_);
+    ROS_ASSERT(sparse_voxel_grid_.sizeX() == size_x_ && sparse_voxel_grid_.sizeY() == size_y_);
+  }
+  else
+  {
+    voxel_grid_.resize(size_x_, size_y_, size_z_);
+    ROS_ASSERT(voxel_grid_.sizeX() == size_x_ && voxel_grid_.sizeY() == size_y_);
+  }
 }
 
 void VoxelLayer::reset()
 {
   deactivate();
   resetMaps();
-  voxel_grid_.reset();
   activate();
 }
 
 void VoxelLayer::resetMaps()
 {
   Costmap2D::resetMaps();
-  voxel_grid_.reset();
+  if (sparse_voxels_)
+    sparse_voxel_grid_.reset();
+  else
+    voxel_grid_.reset();
 }
 
-void VoxelLayer::updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x,
-                                       double* min_y, double* max_x, double* max_y)
+void VoxelLayer::updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region)
 {
   if (rolling_window_)
     updateOrigin(robot_x - getSizeInMetersX() / 2, robot_y - getSizeInMetersY() / 2);
   if (!enabled_)
     return;
-  useExtraBounds(min_x, min_y, max_x, max_y);
+
+  double min_x, min_y, max_x, max_y;
+  DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+  useExtraBounds(&min_x, &min_y, &max_x, &max_y);
+  region->add(min_x, min_y, max_x, max_y);
 
   bool current = true;
   std::vector<Observation> observations, clearing_observations;
@@ -134,16 +159,19 @@ void VoxelLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
   // update the global current status
   current_ = current;
 
-  // raytrace freespace
+  // raytrace freespace, each observation gets its own rectangle in the region
   for (unsigned int i = 0; i < clearing_observations.size(); ++i)
   {
-    raytraceFreespace(clearing_observations[i], min_x, min_y, max_x, max_y);
+    DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+    raytraceFreespace(clearing_observations[i], &min_x, &min_y, &max_x, &max_y);
+    region->add(min_x, min_y, max_x, max_y);
   }
 
   // place the new obstacles into a priority queue... each with a priority of zero to begin with
   for (std::vector<Observation>::const_iterator it = observations.begin(); it != observations.end(); ++it)
   {
     const Observation& obs = *it;
+    DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
 
     const sensor_msgs::PointCloud2& cloud = *(obs.cloud_);
 
@@ -181,25 +209,42 @@ void VoxelLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
       }
 
       // mark the cell in the voxel grid and check if we should also mark it in the costmap
-      if (voxel_grid_.markVoxelInMap(mx, my, mz, mark_threshold_))
+      bool marked = sparse_voxels_ ? sparse_voxel_grid_.markVoxelInMap(mx, my, mz, mark_threshold_) :
+                                     voxel_grid_.markVoxelInMap(mx, my, mz, mark_threshold_);
+      if (marked)
       {
         unsigned int index = getIndex(mx, my);
 
         costmap_[index] = LETHAL_OBSTACLE;
-        touch(double(*iter_x), double(*iter_y), min_x, min_y, max_x, max_y);
+        touch(double(*iter_x), double(*iter_y), &min_x, &min_y, &max_x, &max_y);
       }
     }
+    region->add(min_x, min_y, max_x, max_y);
   }
 
   if (publish_voxel_)
   {
     costmap_2d::VoxelGrid grid_msg;
-    unsigned int size = voxel_grid_.sizeX() * voxel_grid_.sizeY();
-    grid_msg.size_x = voxel_grid_.sizeX();
-    grid_msg.size_y = voxel_grid_.sizeY();
-    grid_msg.size_z = voxel_grid_.sizeZ();
+    unsigned int size = size_x_ * size_y_;
+    grid_msg.size_x = size_x_;
+    grid_msg.size_y = size_y_;
+    grid_msg.size_z = size_z_;
     grid_msg.data.resize(size);
-    memcpy(&grid_msg.data[0], voxel_grid_.getData(), size * sizeof(unsigned int));
+    if (sparse_voxels_)
+    {
+      // the message packs each column into 32 bits, like the dense grid
+      if (size_z_ > VOXEL_BITS)
+      {
+        ROS_WARN_ONCE("%s: only the lowest %d of the %u voxels of each column are published", name_.c_str(),
+                      VOXEL_BITS, size_z_);
+        grid_msg.size_z = VOXEL_BITS;
+      }
+      sparse_voxel_grid_.getPackedData(&grid_msg.data[0]);
+    }
+    else
+    {
+      memcpy(&grid_msg.data[0], voxel_grid_.getData(), size * sizeof(unsigned int));
+    }
 
     grid_msg.origin.x = origin_x_;
     grid_msg.origin.y = origin_y_;
@@ -213,7 +258,9 @@ void VoxelLayer::updateBounds(double robot_x, double robot_y, double robot_yaw,
     voxel_pub_.publish(grid_msg);
   }
 
-  updateFootprint(robot_x, robot_y, robot_yaw, min_x, min_y, max_x, max_y);
+  DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+  updateFootprint(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+  region->add(min_x, min_y, max_x, max_y);
 }
 
 void VoxelLayer::clearNonLethal(double wx, double wy, double w_size_x, double w_size_y, bool clear_no_info)
@@ -256,7 +303,10 @@ void VoxelLayer::clearNonLethal(double wx, double wy, double w_size_x, double w_
         if (clear_no_info || *current != NO_INFORMATION)
         {
           *current = FREE_SPACE;
-          voxel_grid_.clearVoxelColumn(index);
+          if (sparse_voxels_)
+            sparse_voxel_grid_.clearVoxelColumn(index);
+          else
+            voxel_grid_.clearVoxelColumn(index);
         }
       }
       current++;
@@ -303,6 +353,10 @@ void VoxelLayer::raytraceFreespace(const Observation& clearing_observation, doub
   sensor_msgs::PointCloud2ConstIterator<float> iter_y(*(clearing_observation.cloud_), "y");
   sensor_msgs::PointCloud2ConstIterator<float> iter_z(*(clearing_observation.cloud_), "z");
 
+  // the rays are clipped here and then cleared all at once
+  clearing_ends_.clear();
+  clearing_ends_.reserve(clearing_observation_cloud_size);
+
   for (;iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z)
   {
     double wpx = *iter_x;
@@ -361,12 +415,7 @@ void VoxelLayer::raytraceFreespace(const Observation& clearing_observation, doub
     double point_x, point_y, point_z;
     if (worldToMap3DFloat(wpx, wpy, wpz, point_x, point_y, point_z))
     {
-      unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
-
-      // voxel_grid_.markVoxelLine(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z);
-      voxel_grid_.clearVoxelLineInMap(sensor_x, sensor_y, sensor_z, point_x, point_y, point_z, costmap_,
-                                      unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
-                                      cell_raytrace_range);
+      clearing_ends_.push_back(voxel_grid::GridPoint(point_x, point_y, point_z));
 
       updateRaytraceBounds(ox, oy, wpx, wpy, clearing_observation.raytrace_range_, min_x, min_y, max_x, max_y);
 
@@ -381,6 +430,27 @@ void VoxelLayer::raytraceFreespace(const Observation& clearing_observation, doub
     }
   }
 
+  unsigned int cell_raytrace_range = cellDistance(clearing_observation.raytrace_range_);
+
+  // share the threads of the tiled update, which are idle while the bounds are updated
+  voxel_grid::ParallelFor parallel_for;
+  ThreadPool* pool = layered_costmap_->getThreadPool();
+  if (pool)
+    parallel_for = boost::bind(&ThreadPool::run, pool, _1, _2);
+
+  if (sparse_voxels_)
+  {
+    sparse_voxel_grid_.clearVoxelLinesInMap(sensor_x, sensor_y, sensor_z, clearing_ends_, costmap_,
+                                            unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
+                                            cell_raytrace_range, parallel_for);
+  }
+  else
+  {
+    voxel_grid_.clearVoxelLinesInMap(sensor_x, sensor_y, sensor_z, clearing_ends_, costmap_,
+                                     unknown_threshold_, mark_threshold_, FREE_SPACE, NO_INFORMATION,
+                                     cell_raytrace_range, parallel_for);
+  }
+
   if (publish_clearing_points)
   {
     clearing_endpoints_.header.frame_id = global_frame_;
@@ -420,16 +490,27 @@ void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
 
   // we need a map to store the obstacles in the window temporarily
   unsigned char* local_map = new unsigned char[cell_size_x * cell_size_y];
-  unsigned int* local_voxel_map = new unsigned int[cell_size_x * cell_size_y];
-  unsigned int* voxel_map = voxel_grid_.getData();
+  unsigned int* local_voxel_map = NULL;
+  unsigned int* voxel_map = NULL;
 
   // copy the local window in the costmap to the local map
   copyMapRegion(costmap_, lower_left_x, lower_left_y, size_x_, local_map, 0, 0, cell_size_x, cell_size_x, cell_size_y);
-  copyMapRegion(voxel_map, lower_left_x, lower_left_y, size_x_, local_voxel_map, 0, 0, cell_size_x, cell_size_x,
-                cell_size_y);
+  if (sparse_voxels_)
+  {
+    // the sparse grid moves its own tiles, and must not be reset below
+    sparse_voxel_grid_.updateOrigin(cell_ox, cell_oy);
+    Costmap2D::resetMaps();
+  }
+  else
+  {
+    local_voxel_map = new unsigned int[cell_size_x * cell_size_y];
+    voxel_map = voxel_grid_.getData();
+    copyMapRegion(voxel_map, lower_left_x, lower_left_y, size_x_, local_voxel_map, 0, 0, cell_size_x, cell_size_x,
+                  cell_size_y);
 
-  // we'll reset our maps to unknown space if appropriate
-  resetMaps();
+    // we'll reset our maps to unknown space if appropriate
+    resetMaps();
+  }
 
   // update the origin with the appropriate world coordinates
   origin_x_ = new_grid_ox;
@@ -441,7 +522,8 @@ void VoxelLayer::updateOrigin(double new_origin_x, double new_origin_y)
 
   // now we want to copy the overlapping information back into the map, but in its new location
   copyMapRegion(local_map, 0, 0, cell_size_x, costmap_, start_x, start_y, size_x_, cell_size_x, cell_size_y);
-  copyMapRegion(local_voxel_map, 0, 0, cell_size_x, voxel_map, start_x, start_y, size_x_, cell_size_x, cell_size_y);
+  if (!sparse_voxels_)
+    copyMapRegion(local_voxel_map, 0, 0, cell_size_x, voxel_map, start_x, start_y, size_x_, cell_size_x, cell_size_y);
 
   // make sure to clean up
   delete[] local_map;
@@ -189,8 +189,16 @@ Costmap2D& Costmap2D::operator=(const Costmap2D& map)
   if (this == &map)
     return *this;
 
-  // clean up old data
-  deleteMaps();
+  // keep the old buffer when the size matches, so copying snapshots of the
+  // same map over and over does not allocate
+  if (costmap_ == NULL || size_x_ * size_y_ != map.size_x_ * map.size_y_)
+  {
+    // clean up old data
+    deleteMaps();
+
+    // initialize our various maps
+    initMaps(map.size_x_, map.size_y_);
+  }
 
   size_x_ = map.size_x_;
   size_y_ = map.size_y_;
@@ -198,9 +206,6 @@ Costmap2D& Costmap2D::operator=(const Costmap2D& map)
   origin_x_ = map.origin_x_;
   origin_y_ = map.origin_y_;
 
-  // initialize our various maps
-  initMaps(size_x_, size_y_);
-
   // copy the cost map
   memcpy(costmap_, map.costmap_, size_x_ * size_y_ * sizeof(unsigned char));
 
@@ -233,7 +238,12 @@ unsigned int Costmap2D::cellDistance(double world_dist)
   return (unsigned int)cells_dist;
 }
 
-unsigned char* Costmap2D::getCharMap() const
+unsigned char* Costmap2D::getCharMap()
+{
+  return costmap_;
+}
+
+const unsigned char* Costmap2D::getCharMap() const
 {
   return costmap_;
 }
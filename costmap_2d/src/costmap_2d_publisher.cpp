@@ -71,9 +71,6 @@ Costmap2DPublisher::Costmap2DPublisher(ros::NodeHandle * ros_node, Costmap2D* co
     }
   }
 
-  xn_ = yn_ = 0;
-  x0_ = costmap_->getSizeInCellsX();
-  y0_ = costmap_->getSizeInCellsY();
 }
 
 Costmap2DPublisher::~Costmap2DPublisher()
@@ -136,34 +133,38 @@ void Costmap2DPublisher::publishCostmap()
     prepareGrid();
     costmap_pub_.publish(grid_);
   }
-  else if (x0_ < xn_)
+  else
   {
     boost::unique_lock<Costmap2D::mutex_t> lock(*(costmap_->getMutex()));
-    // Publish Just an Update
-    map_msgs::OccupancyGridUpdate update;
-    update.header.stamp = ros::Time::now();
-    update.header.frame_id = global_frame_;
-    update.x = x0_;
-    update.y = y0_;
-    update.width = xn_ - x0_;
-    update.height = yn_ - y0_;
-    update.data.resize(update.width * update.height);
-
-    unsigned int i = 0;
-    for (unsigned int y = y0_; y < yn_; y++)
+    // Publish Just an Update for each changed rectangle
+    const std::vector<DirtyRect>& rects = updated_region_.getRects();
+    for (unsigned int r = 0; r < rects.size(); r++)
     {
-      for (unsigned int x = x0_; x < xn_; x++)
+      unsigned int x0 = rects[r].min_x, y0 = rects[r].min_y;
+      unsigned int xn = rects[r].max_x + 1, yn = rects[r].max_y + 1;
+      map_msgs::OccupancyGridUpdate update;
+      update.header.stamp = ros::Time::now();
+      update.header.frame_id = global_frame_;
+      update.x = x0;
+      update.y = y0;
+      update.width = xn - x0;
+      update.height = yn - y0;
+      update.data.resize(update.width * update.height);
+
+      unsigned int i = 0;
+      for (unsigned int y = y0; y < yn; y++)
       {
-        unsigned char cost = costmap_->getCost(x, y);
-        update.data[i++] = cost_translation_table_[ cost ];
+        for (unsigned int x = x0; x < xn; x++)
+        {
+          unsigned char cost = costmap_->getCost(x, y);
+          update.data[i++] = cost_translation_table_[ cost ];
+        }
       }
+      costmap_update_pub_.publish(update);
     }
-    costmap_update_pub_.publish(update);
   }
 
-  xn_ = yn_ = 0;
-  x0_ = costmap_->getSizeInCellsX();
-  y0_ = costmap_->getSizeInCellsY();
+  updated_region_.clear();
 }
 
 }  // end namespace costmap_2d
@@ -76,7 +76,9 @@ Costmap2DROS::Costmap2DROS(const std::string& name, tf2_ros::Buffer& tf) :
     plugin_loader_("costmap_2d", "costmap_2d::Layer"),
     publisher_(NULL),
     dsrv_(NULL),
-    footprint_padding_(0.0)
+    footprint_padding_(0.0),
+    publish_snapshots_(false),
+    lock_statistics_period_(0.0)
 {
   // Initialize old pose with something
   tf2::toMsg(tf2::Transform::getIdentity(), old_pose_.pose);
@@ -114,6 +116,21 @@ Costmap2DROS::Costmap2DROS(const std::string& name, tf2_ros::Buffer& tf) :
 
   layered_costmap_ = new LayeredCostmap(global_frame_, rolling_window, track_unknown_space);
 
+  // optionally spread the cost updates of tile-safe layers over several threads
+  int update_threads, update_tile_size;
+  private_nh.param("update_threads", update_threads, 0);
+  private_nh.param("update_tile_size", update_tile_size, 256);
+  if (update_threads > 1)
+  {
+    ROS_INFO("%s: Updating costs with %d threads in tiles of %d cells", name_.c_str(), update_threads,
+             update_tile_size);
+    layered_costmap_->setParallelUpdate(update_threads, std::max(1, update_tile_size));
+  }
+
+  // optionally hand out immutable snapshots to readers instead of having them lock the master costmap
+  private_nh.param("publish_snapshots", publish_snapshots_, false);
+  private_nh.param("lock_statistics_period", lock_statistics_period_, 0.0);
+
   if (!private_nh.hasParam("plugins"))
   {
     loadOldParameters(private_nh);
@@ -461,9 +478,7 @@ void Costmap2DROS::mapUpdateLoop(double frequency)
     
     if (publish_cycle.toSec() > 0 && layered_costmap_->isInitialized())
     {
-      unsigned int x0, y0, xn, yn;
-      layered_costmap_->getBounds(&x0, &xn, &y0, &yn);
-      publisher_->updateBounds(x0, xn, y0, yn);
+      publisher_->updateRegion(layered_costmap_->getUpdatedRegion());
 
       ros::Time now = ros::Time::now();
       if (last_publish_ + publish_cycle < now)
@@ -472,6 +487,9 @@ void Costmap2DROS::mapUpdateLoop(double frequency)
         last_publish_ = now;
       }
     }
+    if (lock_statistics_period_ > 0.0)
+      logLockStatistics();
+
     r.sleep();
     // make sure to sleep for the remainder of our cycle time
     if (r.cycleTime() > ros::Duration(1 / frequency))
@@ -492,7 +510,12 @@ void Costmap2DROS::updateMap()
              y = pose.pose.position.y,
              yaw = tf2::getYaw(pose.pose.orientation);
 
-      layered_costmap_->updateMap(x, y, yaw);
+      {
+        TimedCostmapLock lock(*(layered_costmap_->getCostmap()->getMutex()), update_lock_statistics_);
+        layered_costmap_->updateMap(x, y, yaw);
+        if (publish_snapshots_)
+          publishSnapshot();
+      }
 
       geometry_msgs::PolygonStamped footprint;
       footprint.header.frame_id = global_frame_;
@@ -505,6 +528,44 @@ void Costmap2DROS::updateMap()
   }
 }
 
+void Costmap2DROS::publishSnapshot()
+{
+  snapshots_.publish(*(layered_costmap_->getCostmap()));
+}
+
+boost::shared_ptr<const Costmap2D> Costmap2DROS::getSnapshot()
+{
+  ros::WallTime start = ros::WallTime::now();
+  boost::shared_ptr<const Costmap2D> snapshot = snapshots_.get();
+  reader_lock_statistics_.addSample((ros::WallTime::now() - start).toSec());
+  return snapshot;
+}
+
+void Costmap2DROS::setSnapshotOutline(bool outline)
+{
+  // the update thread publishes with the master costmap locked
+  boost::unique_lock<Costmap2D::mutex_t> lock(*(layered_costmap_->getCostmap()->getMutex()));
+  snapshots_.setOutline(outline);
+  if (snapshots_.get())
+    publishSnapshot();
+}
+
+void Costmap2DROS::logLockStatistics()
+{
+  ros::WallTime now = ros::WallTime::now();
+  if (last_lock_statistics_.isZero())
+    last_lock_statistics_ = now;
+  if (now - last_lock_statistics_ < ros::WallDuration(lock_statistics_period_))
+    return;
+
+  ROS_INFO("%s: lock waits over the last %.1f s (%s): update thread %s; readers %s",
+           name_.c_str(), (now - last_lock_statistics_).toSec(), publish_snapshots_ ? "snapshots" : "locking",
+           update_lock_statistics_.toString().c_str(), reader_lock_statistics_.toString().c_str());
+  update_lock_statistics_.reset();
+  reader_lock_statistics_.reset();
+  last_lock_statistics_ = now;
+}
+
 void Costmap2DROS::start()
 {
   std::vector < boost::shared_ptr<Layer> > *plugins = layered_costmap_->getPlugins();
@@ -64,26 +64,7 @@ void CostmapLayer::updateWithMax(costmap_2d::Costmap2D& master_grid, int min_i,
 {
   if (!enabled_)
     return;
-
-  unsigned char* master_array = master_grid.getCharMap();
-  unsigned int span = master_grid.getSizeInCellsX();
-
-  for (int j = min_j; j < max_j; j++)
-  {
-    unsigned int it = j * span + min_i;
-    for (int i = min_i; i < max_i; i++)
-    {
-      if (costmap_[it] == NO_INFORMATION){
-        it++;
-        continue;
-      }
-
-      unsigned char old_cost = master_array[it];
-      if (old_cost == NO_INFORMATION || old_cost < costmap_[it])
-        master_array[it] = costmap_[it];
-      it++;
-    }
-  }
+  updateWithKernel(getMergeKernels()->max, master_grid, min_i, min_j, max_i, max_j);
 }
 
 void CostmapLayer::updateWithTrueOverwrite(costmap_2d::Costmap2D& master_grid, int min_i, int min_j,
@@ -91,69 +72,35 @@ void CostmapLayer::updateWithTrueOverwrite(costmap_2d::Costmap2D& master_grid, i
 {
   if (!enabled_)
     return;
-  unsigned char* master = master_grid.getCharMap();
-  unsigned int span = master_grid.getSizeInCellsX();
-
-  for (int j = min_j; j < max_j; j++)
-  {
-    unsigned int it = span*j+min_i;
-    for (int i = min_i; i < max_i; i++)
-    {
-      master[it] = costmap_[it];
-      it++;
-    }
-  }
+  updateWithKernel(getMergeKernels()->true_overwrite, master_grid, min_i, min_j, max_i, max_j);
 }
 
 void CostmapLayer::updateWithOverwrite(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
 {
   if (!enabled_)
     return;
-  unsigned char* master = master_grid.getCharMap();
-  unsigned int span = master_grid.getSizeInCellsX();
-
-  for (int j = min_j; j < max_j; j++)
-  {
-    unsigned int it = span*j+min_i;
-    for (int i = min_i; i < max_i; i++)
-    {
-      if (costmap_[it] != NO_INFORMATION)
-        master[it] = costmap_[it];
-      it++;
-    }
-  }
+  updateWithKernel(getMergeKernels()->overwrite, master_grid, min_i, min_j, max_i, max_j);
 }
 
 void CostmapLayer::updateWithAddition(costmap_2d::Costmap2D& master_grid, int min_i, int min_j, int max_i, int max_j)
 {
   if (!enabled_)
     return;
-  unsigned char* master_array = master_grid.getCharMap();
+  updateWithKernel(getMergeKernels()->addition, master_grid, min_i, min_j, max_i, max_j);
+}
+
+void CostmapLayer::updateWithKernel(MergeRowKernel kernel, costmap_2d::Costmap2D& master_grid,
+                                    int min_i, int min_j, int max_i, int max_j)
+{
+  if (max_i <= min_i)
+    return;
+  unsigned char* master = master_grid.getCharMap();
   unsigned int span = master_grid.getSizeInCellsX();
 
   for (int j = min_j; j < max_j; j++)
   {
-    unsigned int it = j * span + min_i;
-    for (int i = min_i; i < max_i; i++)
-    {
-      if (costmap_[it] == NO_INFORMATION){
-        it++;
-        continue;
-      }
-
-      unsigned char old_cost = master_array[it];
-      if (old_cost == NO_INFORMATION)
-        master_array[it] = costmap_[it];
-      else
-      {
-        int sum = old_cost + costmap_[it];
-        if (sum >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
-            master_array[it] = costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1;
-        else
-            master_array[it] = sum;
-      }
-      it++;
-    }
+    unsigned int it = span * j + min_i;
+    kernel(master + it, costmap_ + it, max_i - min_i);
   }
 }
 }  // namespace costmap_2d
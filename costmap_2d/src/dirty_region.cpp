@@ -0,0 +1,150 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/dirty_region.h>
+#include <algorithm>
+
+namespace costmap_2d
+{
+
+void DirtyRect::merge(const DirtyRect& other)
+{
+  min_x = std::min(min_x, other.min_x);
+  min_y = std::min(min_y, other.min_y);
+  max_x = std::max(max_x, other.max_x);
+  max_y = std::max(max_y, other.max_y);
+}
+
+DirtyRegion::DirtyRegion(unsigned int max_rects) :
+    max_rects_(std::max(1u, max_rects))
+{
+}
+
+void DirtyRegion::add(double min_x, double min_y, double max_x, double max_y)
+{
+  if (min_x > max_x || min_y > max_y)
+    return;
+  insert(DirtyRect(min_x, min_y, max_x, max_y));
+}
+
+void DirtyRegion::add(const DirtyRegion& other)
+{
+  for (unsigned int i = 0; i < other.rects_.size(); ++i)
+  {
+    insert(other.rects_[i]);
+  }
+}
+
+void DirtyRegion::pad(double distance)
+{
+  std::vector<DirtyRect> rects;
+  rects.swap(rects_);
+  for (unsigned int i = 0; i < rects.size(); ++i)
+  {
+    const DirtyRect& r = rects[i];
+    insert(DirtyRect(r.min_x - distance, r.min_y - distance, r.max_x + distance, r.max_y + distance));
+  }
+}
+
+void DirtyRegion::getBounds(double* min_x, double* min_y, double* max_x, double* max_y) const
+{
+  resetBounds(min_x, min_y, max_x, max_y);
+  expandBounds(min_x, min_y, max_x, max_y);
+}
+
+void DirtyRegion::expandBounds(double* min_x, double* min_y, double* max_x, double* max_y) const
+{
+  for (unsigned int i = 0; i < rects_.size(); ++i)
+  {
+    *min_x = std::min(*min_x, rects_[i].min_x);
+    *min_y = std::min(*min_y, rects_[i].min_y);
+    *max_x = std::max(*max_x, rects_[i].max_x);
+    *max_y = std::max(*max_y, rects_[i].max_y);
+  }
+}
+
+void DirtyRegion::insert(DirtyRect rect)
+{
+  // absorb every rectangle the new one overlaps; the merged rectangle can
+  // overlap further ones, so keep going until it is disjoint from the rest
+  bool merged = true;
+  while (merged)
+  {
+    merged = false;
+    for (unsigned int i = 0; i < rects_.size(); ++i)
+    {
+      if (rect.overlaps(rects_[i]))
+      {
+        rect.merge(rects_[i]);
+        rects_[i] = rects_.back();
+        rects_.pop_back();
+        merged = true;
+        break;
+      }
+    }
+  }
+
+  if (rects_.size() < max_rects_)
+  {
+    rects_.push_back(rect);
+    return;
+  }
+
+  // too many rectangles: merge the pair that wastes the least area
+  rects_.push_back(rect);
+  unsigned int best_i = 0, best_j = 1;
+  double best_waste = 0.0;
+  for (unsigned int i = 0; i < rects_.size(); ++i)
+  {
+    for (unsigned int j = i + 1; j < rects_.size(); ++j)
+    {
+      DirtyRect bounds = rects_[i];
+      bounds.merge(rects_[j]);
+      double waste = bounds.area() - rects_[i].area() - rects_[j].area();
+      if ((i == 0 && j == 1) || waste < best_waste)
+      {
+        best_waste = waste;
+        best_i = i;
+        best_j = j;
+      }
+    }
+  }
+  DirtyRect bounds = rects_[best_i];
+  bounds.merge(rects_[best_j]);
+  rects_.erase(rects_.begin() + best_j);
+  rects_.erase(rects_.begin() + best_i);
+  insert(bounds);
+}
+
+}  // namespace costmap_2d
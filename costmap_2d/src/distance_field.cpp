@@ -0,0 +1,328 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/distance_field.h>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace costmap_2d
+{
+
+const uint32_t DistanceField::OUT_OF_RANGE;
+
+DistanceField::DistanceField() :
+    size_x_(0), size_y_(0), max_distance_(0), pending_(16)
+{
+}
+
+void DistanceField::reset(unsigned int size_x, unsigned int size_y, unsigned int max_distance)
+{
+  size_x_ = size_x;
+  size_y_ = size_y;
+  max_distance_ = max_distance;
+  obstacles_.assign(size_x * size_y, 0);
+  distances_.assign(size_x * size_y, OUT_OF_RANGE);
+  pending_.clear();
+}
+
+void DistanceField::release()
+{
+  size_x_ = size_y_ = 0;
+  std::vector<unsigned char>().swap(obstacles_);
+  std::vector<uint32_t>().swap(distances_);
+  std::vector<unsigned char>().swap(shifted_obstacles_);
+  std::vector<uint32_t>().swap(shifted_distances_);
+  workspace_ = Workspace();
+  pending_.clear();
+}
+
+unsigned int DistanceField::setObstacles(const unsigned char* grid, unsigned char obstacle_value,
+                                         int min_i, int min_j, int max_i, int max_j)
+{
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(int(size_x_), max_i);
+  max_j = std::min(int(size_y_), max_j);
+
+  int r = max_distance_;
+  unsigned int changed = 0;
+  for (int j = min_j; j < max_j; ++j)
+  {
+    // each row adds the bounding box of its changes, padded by the distance they can affect
+    int first = -1, last = -1;
+    for (int i = min_i; i < max_i; ++i)
+    {
+      unsigned int index = j * size_x_ + i;
+      unsigned char obstacle = grid[index] == obstacle_value;
+      if (obstacle != obstacles_[index])
+      {
+        obstacles_[index] = obstacle;
+        if (first < 0)
+          first = i;
+        last = i;
+        ++changed;
+      }
+    }
+    if (first >= 0)
+      pending_.add(first - r, j - r, last + 1 + r, j + 1 + r);
+  }
+  return changed;
+}
+
+void DistanceField::shift(int cell_dx, int cell_dy)
+{
+  if (cell_dx == 0 && cell_dy == 0)
+    return;
+
+  if (abs(cell_dx) >= int(size_x_) || abs(cell_dy) >= int(size_y_))
+  {
+    reset(size_x_, size_y_, max_distance_);
+    return;
+  }
+
+  // copy the part of the field that stays in it, cell (i, j) is the old cell (i + cell_dx, j + cell_dy)
+  shifted_obstacles_.assign(size_x_ * size_y_, 0);
+  shifted_distances_.assign(size_x_ * size_y_, OUT_OF_RANGE);
+  int min_i = std::max(0, -cell_dx), max_i = std::min(int(size_x_), int(size_x_) - cell_dx);
+  int min_j = std::max(0, -cell_dy), max_j = std::min(int(size_y_), int(size_y_) - cell_dy);
+  for (int j = min_j; j < max_j; ++j)
+  {
+    unsigned int to = j * size_x_ + min_i;
+    unsigned int from = (j + cell_dy) * size_x_ + min_i + cell_dx;
+    memcpy(&shifted_obstacles_[to], &obstacles_[from], (max_i - min_i) * sizeof(unsigned char));
+    memcpy(&shifted_distances_[to], &distances_[from], (max_i - min_i) * sizeof(uint32_t));
+  }
+  obstacles_.swap(shifted_obstacles_);
+  distances_.swap(shifted_distances_);
+
+  DirtyRegion pending = pending_;
+  pending_.clear();
+  for (unsigned int i = 0; i < pending.getRects().size(); ++i)
+  {
+    const DirtyRect& rect = pending.getRects()[i];
+    pending_.add(rect.min_x - cell_dx, rect.min_y - cell_dy, rect.max_x - cell_dx, rect.max_y - cell_dy);
+  }
+
+  // the cells that came in, and the cells whose nearest obstacle may have left
+  double r = max_distance_;
+  if (cell_dx > 0)
+  {
+    pending_.add(size_x_ - cell_dx, 0, size_x_, size_y_);
+    pending_.add(0, 0, r, size_y_);
+  }
+  else if (cell_dx < 0)
+  {
+    pending_.add(0, 0, -cell_dx, size_y_);
+    pending_.add(size_x_ - r, 0, size_x_, size_y_);
+  }
+  if (cell_dy > 0)
+  {
+    pending_.add(0, size_y_ - cell_dy, size_x_, size_y_);
+    pending_.add(0, 0, size_x_, r);
+  }
+  else if (cell_dy < 0)
+  {
+    pending_.add(0, 0, size_x_, -cell_dy);
+    pending_.add(0, size_y_ - r, size_x_, size_y_);
+  }
+}
+
+void DistanceField::update()
+{
+  const std::vector<DirtyRect>& rects = pending_.getRects();
+  for (unsigned int i = 0; i < rects.size(); ++i)
+  {
+    computeDistances(int(rects[i].min_x), int(rects[i].min_y), int(rects[i].max_x), int(rects[i].max_y),
+                     &workspace_);
+  }
+  pending_.clear();
+}
+
+void DistanceField::recompute()
+{
+  computeDistances(0, 0, size_x_, size_y_, &workspace_);
+  pending_.clear();
+}
+
+void DistanceField::recompute(int min_i, int min_j, int max_i, int max_j)
+{
+  computeDistances(min_i, min_j, max_i, max_j, &workspace_);
+}
+
+void DistanceField::recompute(int min_i, int min_j, int max_i, int max_j, Workspace* workspace)
+{
+  computeDistances(min_i, min_j, max_i, max_j, workspace);
+}
+
+unsigned int DistanceField::countDifferences(const DistanceField& other) const
+{
+  if (size_x_ != other.size_x_ || size_y_ != other.size_y_)
+    return std::max(size_x_ * size_y_, other.size_x_ * other.size_y_);
+
+  unsigned int differences = 0;
+  for (unsigned int i = 0; i < size_x_ * size_y_; ++i)
+  {
+    if (obstacles_[i] != other.obstacles_[i] || distances_[i] != other.distances_[i])
+      ++differences;
+  }
+  return differences;
+}
+
+void DistanceField::computeDistances(int min_i, int min_j, int max_i, int max_j, Workspace* workspace)
+{
+  min_i = std::max(0, min_i);
+  min_j = std::max(0, min_j);
+  max_i = std::min(int(size_x_), max_i);
+  max_j = std::min(int(size_y_), max_j);
+  if (min_i >= max_i || min_j >= max_j)
+    return;
+
+  // obstacles farther than max_distance_ from the box cannot affect it
+  int r = max_distance_;
+  int64_t max_squared = int64_t(r) * r;
+  int ex0 = std::max(0, min_i - r), ex1 = std::min(int(size_x_), max_i + r);
+  int ey0 = std::max(0, min_j - r), ey1 = std::min(int(size_y_), max_j + r);
+  int width = ex1 - ex0;
+
+  // this is the two pass exact transform of Felzenszwalb and Huttenlocher, done in stripes of rows
+  // so that the scratch space stays small
+  const int stripe = 64;
+  std::vector<int>& nearest_above = workspace->nearest_above;
+  std::vector<int>& nearest_below = workspace->nearest_below;
+  std::vector<uint32_t>& column_distances = workspace->column_distances;
+  std::vector<int>& parabolas = workspace->parabolas;
+  std::vector<double>& parabola_starts = workspace->parabola_starts;
+  nearest_above.resize(width);
+  nearest_below.resize(width);
+  column_distances.resize(width * stripe);
+  parabolas.resize(width);
+  parabola_starts.resize(width);
+
+  for (int sy0 = min_j; sy0 < max_j; sy0 += stripe)
+  {
+    int sy1 = std::min(max_j, sy0 + stripe);
+
+    // first pass, along the columns: the squared distance to the nearest obstacle in the same column
+    std::fill(nearest_above.begin(), nearest_above.end(), INT_MIN / 2);
+    for (int y = std::max(ey0, sy0 - r); y < sy1; ++y)
+    {
+      const unsigned char* row = &obstacles_[y * size_x_ + ex0];
+      for (int x = 0; x < width; ++x)
+      {
+        if (row[x])
+          nearest_above[x] = y;
+      }
+      if (y < sy0)
+        continue;
+
+      uint32_t* column_distance = &column_distances[(y - sy0) * width];
+      for (int x = 0; x < width; ++x)
+      {
+        int d = y - nearest_above[x];
+        column_distance[x] = d <= r ? d * d : OUT_OF_RANGE;
+      }
+    }
+
+    std::fill(nearest_below.begin(), nearest_below.end(), INT_MAX / 2);
+    for (int y = std::min(ey1, sy1 + r) - 1; y >= sy0; --y)
+    {
+      const unsigned char* row = &obstacles_[y * size_x_ + ex0];
+      for (int x = 0; x < width; ++x)
+      {
+        if (row[x])
+          nearest_below[x] = y;
+      }
+      if (y >= sy1)
+        continue;
+
+      uint32_t* column_distance = &column_distances[(y - sy0) * width];
+      for (int x = 0; x < width; ++x)
+      {
+        int d = nearest_below[x] - y;
+        if (d <= r && uint32_t(d * d) < column_distance[x])
+          column_distance[x] = d * d;
+      }
+    }
+
+    // second pass, along the rows: the lower envelope of the parabolas column_distance[q] + (x - q)^2
+    for (int y = sy0; y < sy1; ++y)
+    {
+      const uint32_t* column_distance = &column_distances[(y - sy0) * width];
+      int k = -1;
+      for (int q = 0; q < width; ++q)
+      {
+        if (column_distance[q] == OUT_OF_RANGE)
+          continue;
+
+        // drop the parabolas that this one is below of from where they start
+        double start = 0.0;
+        while (k >= 0)
+        {
+          int v = parabolas[k];
+          start = ((double(column_distance[q]) + double(q) * q) - (double(column_distance[v]) + double(v) * v))
+                  / (2.0 * (q - v));
+          if (start > parabola_starts[k])
+            break;
+          --k;
+        }
+        ++k;
+        parabolas[k] = q;
+        parabola_starts[k] = k == 0 ? -std::numeric_limits<double>::infinity() : start;
+      }
+
+      uint32_t* distance = &distances_[y * size_x_];
+      int last = k;
+      k = 0;
+      for (int x = min_i; x < max_i; ++x)
+      {
+        if (last < 0)
+        {
+          distance[x] = OUT_OF_RANGE;
+          continue;
+        }
+        int bx = x - ex0;
+        while (k < last && parabola_starts[k + 1] < bx)
+          ++k;
+        int v = parabolas[k];
+        int64_t d = int64_t(column_distance[v]) + int64_t(bx - v) * (bx - v);
+        distance[x] = d <= max_squared ? uint32_t(d) : OUT_OF_RANGE;
+      }
+    }
+  }
+}
+
+}  // namespace costmap_2d
@@ -28,6 +28,7 @@
  */
 
 #include "costmap_2d/layer.h"
+#include <ros/console.h>
 
 namespace costmap_2d
 {
@@ -48,6 +49,28 @@ void Layer::initialize(LayeredCostmap* parent, std::string name, tf2_ros::Buffer
   onInitialize();
 }
 
+void Layer::updateRegion(double robot_x, double robot_y, double robot_yaw, DirtyRegion* region)
+{
+  double min_x, min_y, max_x, max_y;
+  region->getBounds(&min_x, &min_y, &max_x, &max_y);
+  double prev_min_x = min_x, prev_min_y = min_y, prev_max_x = max_x, prev_max_y = max_y;
+
+  updateBounds(robot_x, robot_y, robot_yaw, &min_x, &min_y, &max_x, &max_y);
+
+  if (min_x > prev_min_x || min_y > prev_min_y || max_x < prev_max_x || max_y < prev_max_y)
+  {
+    ROS_WARN_THROTTLE(1.0, "Illegal bounds change, was [tl: (%f, %f), br: (%f, %f)], but "
+                      "is now [tl: (%f, %f), br: (%f, %f)]. The offending layer is %s",
+                      prev_min_x, prev_min_y, prev_max_x , prev_max_y,
+                      min_x, min_y, max_x , max_y,
+                      name_.c_str());
+  }
+
+  // the box may have been touched anywhere, also between the rectangles
+  // of the region, so all of it needs updating
+  region->add(min_x, min_y, max_x, max_y);
+}
+
 const std::vector<geometry_msgs::Point>& Layer::getFootprint() const
 {
   return layered_costmap_->getFootprint();
@@ -63,7 +63,8 @@ LayeredCostmap::LayeredCostmap(std::string global_frame, bool rolling_window, bo
     initialized_(false),
     size_locked_(false),
     circumscribed_radius_(1.0),
-    inscribed_radius_(0.1)
+    inscribed_radius_(0.1),
+    tile_size_(256)
 {
   if (track_unknown)
     costmap_.setDefaultValue(255);
@@ -85,6 +86,9 @@ void LayeredCostmap::resizeMap(unsigned int size_x, unsigned int size_y, double
   boost::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
   size_locked_ = size_locked;
   costmap_.resizeMap(size_x, size_y, resolution, origin_x, origin_y);
+  DirtyRegion whole_map;
+  whole_map.add(0, 0, double(size_x) - 1, double(size_y) - 1);
+  notifyUpdateWatchers(whole_map);
   for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins_.begin(); plugin != plugins_.end();
       ++plugin)
   {
@@ -92,6 +96,16 @@ void LayeredCostmap::resizeMap(unsigned int size_x, unsigned int size_y, double
   }
 }
 
+void LayeredCostmap::setParallelUpdate(unsigned int num_threads, unsigned int tile_size)
+{
+  boost::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  if (num_threads > 1)
+    thread_pool_.reset(new ThreadPool(num_threads));
+  else
+    thread_pool_.reset();
+  tile_size_ = std::max(1u, tile_size);
+}
+
 void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
 {
   // Lock for the remainder of this function, some plugins (e.g. VoxelLayer)
@@ -103,62 +117,145 @@ void LayeredCostmap::updateMap(double robot_x, double robot_y, double robot_yaw)
   {
     double new_origin_x = robot_x - costmap_.getSizeInMetersX() / 2;
     double new_origin_y = robot_y - costmap_.getSizeInMetersY() / 2;
+    double old_origin_x = costmap_.getOriginX(), old_origin_y = costmap_.getOriginY();
     costmap_.updateOrigin(new_origin_x, new_origin_y);
+    if (costmap_.getOriginX() != old_origin_x || costmap_.getOriginY() != old_origin_y)
+    {
+      // every cell now holds a different spot of the world
+      DirtyRegion whole_map;
+      whole_map.add(0, 0, double(costmap_.getSizeInCellsX()) - 1, double(costmap_.getSizeInCellsY()) - 1);
+      notifyUpdateWatchers(whole_map);
+    }
   }
 
   if (plugins_.size() == 0)
     return;
 
-  minx_ = miny_ = 1e30;
-  maxx_ = maxy_ = -1e30;
-
+  dirty_region_.clear();
   for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins_.begin(); plugin != plugins_.end();
        ++plugin)
   {
-    double prev_minx = minx_;
-    double prev_miny = miny_;
-    double prev_maxx = maxx_;
-    double prev_maxy = maxy_;
-    (*plugin)->updateBounds(robot_x, robot_y, robot_yaw, &minx_, &miny_, &maxx_, &maxy_);
-    if (minx_ > prev_minx || miny_ > prev_miny || maxx_ < prev_maxx || maxy_ < prev_maxy)
-    {
-      ROS_WARN_THROTTLE(1.0, "Illegal bounds change, was [tl: (%f, %f), br: (%f, %f)], but "
-                        "is now [tl: (%f, %f), br: (%f, %f)]. The offending layer is %s",
-                        prev_minx, prev_miny, prev_maxx , prev_maxy,
-                        minx_, miny_, maxx_ , maxy_,
-                        (*plugin)->getName().c_str());
-    }
+    (*plugin)->updateRegion(robot_x, robot_y, robot_yaw, &dirty_region_);
   }
+  dirty_region_.getBounds(&minx_, &miny_, &maxx_, &maxy_);
+
+  // convert the region to cells; rectangles that end up overlapping once
+  // rounded to cells are merged again, so each cell is updated only once
+  updated_region_.clear();
+  const vector<DirtyRect>& rects = dirty_region_.getRects();
+  for (unsigned int i = 0; i < rects.size(); ++i)
+  {
+    int x0, xn, y0, yn;
+    costmap_.worldToMapEnforceBounds(rects[i].min_x, rects[i].min_y, x0, y0);
+    costmap_.worldToMapEnforceBounds(rects[i].max_x, rects[i].max_y, xn, yn);
 
-  int x0, xn, y0, yn;
-  costmap_.worldToMapEnforceBounds(minx_, miny_, x0, y0);
-  costmap_.worldToMapEnforceBounds(maxx_, maxy_, xn, yn);
+    x0 = std::max(0, x0);
+    xn = std::min(int(costmap_.getSizeInCellsX()), xn + 1);
+    y0 = std::max(0, y0);
+    yn = std::min(int(costmap_.getSizeInCellsY()), yn + 1);
 
-  x0 = std::max(0, x0);
-  xn = std::min(int(costmap_.getSizeInCellsX()), xn + 1);
-  y0 = std::max(0, y0);
-  yn = std::min(int(costmap_.getSizeInCellsY()), yn + 1);
+    if (xn < x0 || yn < y0)
+      continue;
 
-  ROS_DEBUG("Updating area x: [%d, %d] y: [%d, %d]", x0, xn, y0, yn);
+    // cell rectangles are half open, shrink them by one so that merely
+    // adjacent rectangles do not count as overlapping
+    updated_region_.add(x0, y0, xn - 1, yn - 1);
+  }
 
-  if (xn < x0 || yn < y0)
+  if (updated_region_.empty())
     return;
+  notifyUpdateWatchers(updated_region_);
+
+  const vector<DirtyRect>& cells = updated_region_.getRects();
+  for (unsigned int i = 0; i < cells.size(); ++i)
+  {
+    ROS_DEBUG("Updating area x: [%d, %d] y: [%d, %d]", int(cells[i].min_x), int(cells[i].max_x) + 1,
+              int(cells[i].min_y), int(cells[i].max_y) + 1);
+    costmap_.resetMap(cells[i].min_x, cells[i].min_y, cells[i].max_x + 1, cells[i].max_y + 1);
+  }
 
-  costmap_.resetMap(x0, y0, xn, yn);
+  // With a thread pool, consecutive tile-safe layers are applied together
+  // tile by tile, every other layer waits for the tiles before it and is
+  // applied to each rectangle of the region in one call.
+  vector<Layer*> tiled_layers;
   for (vector<boost::shared_ptr<Layer> >::iterator plugin = plugins_.begin(); plugin != plugins_.end();
        ++plugin)
   {
-    (*plugin)->updateCosts(costmap_, x0, y0, xn, yn);
+    if (thread_pool_ && (*plugin)->isTileSafe())
+    {
+      tiled_layers.push_back(plugin->get());
+      continue;
+    }
+    updateCostsTiled(tiled_layers);
+    tiled_layers.clear();
+    for (unsigned int i = 0; i < cells.size(); ++i)
+    {
+      (*plugin)->updateCosts(costmap_, cells[i].min_x, cells[i].min_y, cells[i].max_x + 1, cells[i].max_y + 1);
+    }
   }
+  updateCostsTiled(tiled_layers);
 
+  double x0, y0, xn, yn;
+  updated_region_.getBounds(&x0, &y0, &xn, &yn);
   bx0_ = x0;
-  bxn_ = xn;
+  bxn_ = xn + 1;
   by0_ = y0;
-  byn_ = yn;
+  byn_ = yn + 1;
 
   initialized_ = true;
 }
 
+void LayeredCostmap::updateCostsTiled(const vector<Layer*>& layers)
+{
+  if (layers.empty())
+    return;
+
+  const vector<DirtyRect>& cells = updated_region_.getRects();
+  for (unsigned int i = 0; i < cells.size(); ++i)
+  {
+    int x0 = cells[i].min_x, y0 = cells[i].min_y, xn = cells[i].max_x + 1, yn = cells[i].max_y + 1;
+    unsigned int tiles_x = (xn - x0 + tile_size_ - 1) / tile_size_;
+    unsigned int tiles_y = (yn - y0 + tile_size_ - 1) / tile_size_;
+    thread_pool_->run(tiles_x * tiles_y,
+                      boost::bind(&LayeredCostmap::updateTile, this, boost::cref(layers), x0, y0, xn, yn, _1));
+  }
+}
+
+void LayeredCostmap::updateTile(const vector<Layer*>& layers, int x0, int y0, int xn, int yn, unsigned int tile)
+{
+  unsigned int tiles_x = (xn - x0 + tile_size_ - 1) / tile_size_;
+  int tx0 = x0 + (tile % tiles_x) * tile_size_;
+  int ty0 = y0 + (tile / tiles_x) * tile_size_;
+  int txn = std::min(xn, tx0 + int(tile_size_));
+  int tyn = std::min(yn, ty0 + int(tile_size_));
+
+  for (vector<Layer*>::const_iterator layer = layers.begin(); layer != layers.end(); ++layer)
+  {
+    (*layer)->updateCosts(costmap_, tx0, ty0, txn, tyn);
+  }
+}
+
+void LayeredCostmap::addUpdateWatcher(const boost::shared_ptr<DirtyRegion>& region)
+{
+  boost::unique_lock<Costmap2D::mutex_t> lock(*(costmap_.getMutex()));
+  update_watchers_.push_back(region);
+}
+
+void LayeredCostmap::notifyUpdateWatchers(const DirtyRegion& cells)
+{
+  for (unsigned int i = 0; i < update_watchers_.size();)
+  {
+    boost::shared_ptr<DirtyRegion> region = update_watchers_[i].lock();
+    if (!region)
+    {
+      update_watchers_.erase(update_watchers_.begin() + i);
+      continue;
+    }
+    region->add(cells);
+    ++i;
+  }
+}
+
 bool LayeredCostmap::isCurrent()
 {
   current_ = true;
@@ -0,0 +1,95 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/lock_statistics.h>
+#include <ros/time.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace costmap_2d
+{
+
+LockStatistics::LockStatistics() :
+    count_(0), total_(0.0), max_(0.0)
+{
+}
+
+void LockStatistics::addSample(double wait)
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  ++count_;
+  total_ += wait;
+  max_ = std::max(max_, wait);
+}
+
+void LockStatistics::reset()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  count_ = 0;
+  total_ = 0.0;
+  max_ = 0.0;
+}
+
+void LockStatistics::getStatistics(unsigned int* count, double* total, double* max) const
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  *count = count_;
+  *total = total_;
+  *max = max_;
+}
+
+std::string LockStatistics::toString() const
+{
+  unsigned int count;
+  double total, max;
+  getStatistics(&count, &total, &max);
+
+  char buffer[128];
+  snprintf(buffer, sizeof(buffer), "%u acquisitions, mean wait %.3f ms, max wait %.3f ms", count,
+           count > 0 ? 1e3 * total / count : 0.0, 1e3 * max);
+  return std::string(buffer);
+}
+
+TimedCostmapLock::TimedCostmapLock(Costmap2D::mutex_t& mutex, LockStatistics& statistics, bool acquire) :
+    lock_(mutex, boost::defer_lock)
+{
+  if (!acquire)
+    return;
+
+  ros::WallTime start = ros::WallTime::now();
+  lock_.lock();
+  statistics.addSample((ros::WallTime::now() - start).toSec());
+}
+
+}  // namespace costmap_2d
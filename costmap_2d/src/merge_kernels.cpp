@@ -0,0 +1,253 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/merge_kernels.h>
+#include <costmap_2d/cost_values.h>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COSTMAP_2D_HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace costmap_2d
+{
+
+// The special values are handled with selects rather than branches, which
+// lets the compiler vectorize the scalar versions as well.
+
+static inline unsigned char mergeMax(unsigned char master, unsigned char layer)
+{
+  unsigned char m = master == NO_INFORMATION ? 0 : master;
+  unsigned char merged = m < layer ? layer : m;
+  return layer == NO_INFORMATION ? master : merged;
+}
+
+static inline unsigned char mergeOverwrite(unsigned char master, unsigned char layer)
+{
+  return layer == NO_INFORMATION ? master : layer;
+}
+
+static inline unsigned char mergeAddition(unsigned char master, unsigned char layer)
+{
+  unsigned int sum = master + layer;
+  unsigned char capped = sum >= INSCRIBED_INFLATED_OBSTACLE ? INSCRIBED_INFLATED_OBSTACLE - 1 : sum;
+  unsigned char merged = master == NO_INFORMATION ? layer : capped;
+  return layer == NO_INFORMATION ? master : merged;
+}
+
+static void maxRowScalar(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  for (unsigned int i = 0; i < n; i++)
+    master[i] = mergeMax(master[i], layer[i]);
+}
+
+static void overwriteRowScalar(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  for (unsigned int i = 0; i < n; i++)
+    master[i] = mergeOverwrite(master[i], layer[i]);
+}
+
+static void trueOverwriteRow(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  memcpy(master, layer, n);
+}
+
+static void additionRowScalar(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  for (unsigned int i = 0; i < n; i++)
+    master[i] = mergeAddition(master[i], layer[i]);
+}
+
+static const MergeKernels scalar_kernels =
+{
+  "scalar", maxRowScalar, overwriteRowScalar, trueOverwriteRow, additionRowScalar
+};
+
+const MergeKernels* getScalarMergeKernels()
+{
+  return &scalar_kernels;
+}
+
+#ifdef COSTMAP_2D_HAVE_X86_KERNELS
+
+// select(mask, a, b) = mask ? a : b, per byte, for masks of all ones or all zeros
+#define SELECT_SSE2(mask, a, b) _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b))
+
+__attribute__((target("sse2")))
+static void maxRowSSE2(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  const __m128i unknown = _mm_set1_epi8((char)NO_INFORMATION);
+  unsigned int i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i m = _mm_loadu_si128((const __m128i*)(master + i));
+    __m128i l = _mm_loadu_si128((const __m128i*)(layer + i));
+    __m128i merged = _mm_max_epu8(_mm_andnot_si128(_mm_cmpeq_epi8(m, unknown), m), l);
+    _mm_storeu_si128((__m128i*)(master + i), SELECT_SSE2(_mm_cmpeq_epi8(l, unknown), m, merged));
+  }
+  maxRowScalar(master + i, layer + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void overwriteRowSSE2(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  const __m128i unknown = _mm_set1_epi8((char)NO_INFORMATION);
+  unsigned int i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i m = _mm_loadu_si128((const __m128i*)(master + i));
+    __m128i l = _mm_loadu_si128((const __m128i*)(layer + i));
+    _mm_storeu_si128((__m128i*)(master + i), SELECT_SSE2(_mm_cmpeq_epi8(l, unknown), m, l));
+  }
+  overwriteRowScalar(master + i, layer + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void additionRowSSE2(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  const __m128i unknown = _mm_set1_epi8((char)NO_INFORMATION);
+  const __m128i cap = _mm_set1_epi8((char)(INSCRIBED_INFLATED_OBSTACLE - 1));
+  unsigned int i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i m = _mm_loadu_si128((const __m128i*)(master + i));
+    __m128i l = _mm_loadu_si128((const __m128i*)(layer + i));
+    // a saturated sum of 255 is above the cap as well, so saturation does not change the result
+    __m128i sum = _mm_min_epu8(_mm_adds_epu8(m, l), cap);
+    __m128i merged = SELECT_SSE2(_mm_cmpeq_epi8(m, unknown), l, sum);
+    _mm_storeu_si128((__m128i*)(master + i), SELECT_SSE2(_mm_cmpeq_epi8(l, unknown), m, merged));
+  }
+  additionRowScalar(master + i, layer + i, n - i);
+}
+
+#undef SELECT_SSE2
+
+__attribute__((target("avx2")))
+static void maxRowAVX2(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  const __m256i unknown = _mm256_set1_epi8((char)NO_INFORMATION);
+  unsigned int i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    __m256i m = _mm256_loadu_si256((const __m256i*)(master + i));
+    __m256i l = _mm256_loadu_si256((const __m256i*)(layer + i));
+    __m256i merged = _mm256_max_epu8(_mm256_andnot_si256(_mm256_cmpeq_epi8(m, unknown), m), l);
+    _mm256_storeu_si256((__m256i*)(master + i), _mm256_blendv_epi8(merged, m, _mm256_cmpeq_epi8(l, unknown)));
+  }
+  maxRowScalar(master + i, layer + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void overwriteRowAVX2(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  const __m256i unknown = _mm256_set1_epi8((char)NO_INFORMATION);
+  unsigned int i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    __m256i m = _mm256_loadu_si256((const __m256i*)(master + i));
+    __m256i l = _mm256_loadu_si256((const __m256i*)(layer + i));
+    _mm256_storeu_si256((__m256i*)(master + i), _mm256_blendv_epi8(l, m, _mm256_cmpeq_epi8(l, unknown)));
+  }
+  overwriteRowScalar(master + i, layer + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void additionRowAVX2(unsigned char* master, const unsigned char* layer, unsigned int n)
+{
+  const __m256i unknown = _mm256_set1_epi8((char)NO_INFORMATION);
+  const __m256i cap = _mm256_set1_epi8((char)(INSCRIBED_INFLATED_OBSTACLE - 1));
+  unsigned int i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    __m256i m = _mm256_loadu_si256((const __m256i*)(master + i));
+    __m256i l = _mm256_loadu_si256((const __m256i*)(layer + i));
+    __m256i sum = _mm256_min_epu8(_mm256_adds_epu8(m, l), cap);
+    __m256i merged = _mm256_blendv_epi8(sum, l, _mm256_cmpeq_epi8(m, unknown));
+    _mm256_storeu_si256((__m256i*)(master + i), _mm256_blendv_epi8(merged, m, _mm256_cmpeq_epi8(l, unknown)));
+  }
+  additionRowScalar(master + i, layer + i, n - i);
+}
+
+static const MergeKernels sse2_kernels =
+{
+  "sse2", maxRowSSE2, overwriteRowSSE2, trueOverwriteRow, additionRowSSE2
+};
+
+static const MergeKernels avx2_kernels =
+{
+  "avx2", maxRowAVX2, overwriteRowAVX2, trueOverwriteRow, additionRowAVX2
+};
+
+const MergeKernels* getSSE2MergeKernels()
+{
+  return __builtin_cpu_supports("sse2") ? &sse2_kernels : NULL;
+}
+
+const MergeKernels* getAVX2MergeKernels()
+{
+  return __builtin_cpu_supports("avx2") ? &avx2_kernels : NULL;
+}
+
+#else
+
+const MergeKernels* getSSE2MergeKernels()
+{
+  return NULL;
+}
+
+const MergeKernels* getAVX2MergeKernels()
+{
+  return NULL;
+}
+
+#endif  // COSTMAP_2D_HAVE_X86_KERNELS
+
+static const MergeKernels* selectMergeKernels()
+{
+  const MergeKernels* kernels = getAVX2MergeKernels();
+  if (kernels == NULL)
+    kernels = getSSE2MergeKernels();
+  if (kernels == NULL)
+    kernels = getScalarMergeKernels();
+  return kernels;
+}
+
+const MergeKernels* getMergeKernels()
+{
+  static const MergeKernels* kernels = selectMergeKernels();
+  return kernels;
+}
+
+}  // namespace costmap_2d
@@ -39,6 +39,7 @@
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2_sensor_msgs/tf2_sensor_msgs.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <cstring>
 
 using namespace std;
 using namespace tf2;
@@ -48,11 +49,12 @@ namespace costmap_2d
 ObservationBuffer::ObservationBuffer(string topic_name, double observation_keep_time, double expected_update_rate,
                                      double min_obstacle_height, double max_obstacle_height, double obstacle_range,
                                      double raytrace_range, tf2_ros::Buffer& tf2_buffer, string global_frame,
-                                     string sensor_frame, double tf_tolerance) :
+                                     string sensor_frame, double tf_tolerance, bool keep_all_fields) :
     tf2_buffer_(tf2_buffer), observation_keep_time_(observation_keep_time), expected_update_rate_(expected_update_rate),
     last_updated_(ros::Time::now()), global_frame_(global_frame), sensor_frame_(sensor_frame), topic_name_(topic_name),
     min_obstacle_height_(min_obstacle_height), max_obstacle_height_(max_obstacle_height),
-    obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance)
+    obstacle_range_(obstacle_range), raytrace_range_(raytrace_range), tf_tolerance_(tf_tolerance),
+    keep_all_fields_(keep_all_fields)
 {
 }
 
@@ -89,8 +91,10 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
       tf2_buffer_.transform(origin, origin, new_global_frame);
       obs.origin_ = origin.point;
 
-      // we also need to transform the cloud of the observation to the new global frame
-      tf2_buffer_.transform(*(obs.cloud_), *(obs.cloud_), new_global_frame);
+      // we also need to transform the cloud of the observation to the new global frame, the old one may be shared
+      boost::shared_ptr<sensor_msgs::PointCloud2> cloud(new sensor_msgs::PointCloud2());
+      tf2_buffer_.transform(*(obs.cloud_), *cloud, new_global_frame);
+      obs.cloud_ = cloud;
     }
     catch (TransformException& ex)
     {
@@ -108,9 +112,7 @@ bool ObservationBuffer::setGlobalFrame(const std::string new_global_frame)
 void ObservationBuffer::bufferCloud(const sensor_msgs::PointCloud2& cloud)
 {
   geometry_msgs::PointStamped global_origin;
-
-  // create a new observation on the list to be populated
-  observation_list_.push_front(Observation());
+  boost::shared_ptr<sensor_msgs::PointCloud2> observation_cloud(new sensor_msgs::PointCloud2());
 
   // check whether the origin frame has been set explicitly or whether we should get it from the cloud
   string origin_frame = sensor_frame_ == "" ? cloud.header.frame_id : sensor_frame_;
@@ -125,62 +127,97 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::PointCloud2& cloud)
     local_origin.point.y = 0;
     local_origin.point.z = 0;
     tf2_buffer_.transform(local_origin, global_origin, global_frame_);
-    tf2::convert(global_origin.point, observation_list_.front().origin_);
-
-    // make sure to pass on the raytrace/obstacle range of the observation buffer to the observations
-    observation_list_.front().raytrace_range_ = raytrace_range_;
-    observation_list_.front().obstacle_range_ = obstacle_range_;
-
-    sensor_msgs::PointCloud2 global_frame_cloud;
-
-    // transform the point cloud
-    tf2_buffer_.transform(cloud, global_frame_cloud, global_frame_);
-    global_frame_cloud.header.stamp = cloud.header.stamp;
-
-    // now we need to remove observations from the cloud that are below or above our height thresholds
-    sensor_msgs::PointCloud2& observation_cloud = *(observation_list_.front().cloud_);
-    observation_cloud.height = global_frame_cloud.height;
-    observation_cloud.width = global_frame_cloud.width;
-    observation_cloud.fields = global_frame_cloud.fields;
-    observation_cloud.is_bigendian = global_frame_cloud.is_bigendian;
-    observation_cloud.point_step = global_frame_cloud.point_step;
-    observation_cloud.row_step = global_frame_cloud.row_step;
-    observation_cloud.is_dense = global_frame_cloud.is_dense;
-
-    unsigned int cloud_size = global_frame_cloud.height*global_frame_cloud.width;
-    sensor_msgs::PointCloud2Modifier modifier(observation_cloud);
-    modifier.resize(cloud_size);
+
+    // look up the transform of the cloud once, the points are transformed as they are copied
+    tf2::Transform transform;
+    tf2::fromMsg(tf2_buffer_.lookupTransform(global_frame_, cloud.header.frame_id, cloud.header.stamp).transform,
+                 transform);
+
+    // find the coordinates in the points
+    int offset_x = -1, offset_y = -1, offset_z = -1;
+    for (unsigned int i = 0; i < cloud.fields.size(); ++i)
+    {
+      if (cloud.fields[i].name == "x")
+        offset_x = cloud.fields[i].offset;
+      else if (cloud.fields[i].name == "y")
+        offset_y = cloud.fields[i].offset;
+      else if (cloud.fields[i].name == "z")
+        offset_z = cloud.fields[i].offset;
+    }
+    if (offset_x < 0 || offset_y < 0 || offset_z < 0)
+    {
+      ROS_ERROR("The cloud on topic %s has no x, y or z field, it is not buffered", topic_name_.c_str());
+      return;
+    }
+
+    // the observation only keeps the coordinates of the points, packed as 3 floats, unless it keeps every field
+    sensor_msgs::PointCloud2Modifier modifier(*observation_cloud);
+    int obs_offset_x = 0, obs_offset_y = sizeof(float), obs_offset_z = 2 * sizeof(float);
+    if (keep_all_fields_)
+    {
+      observation_cloud->fields = cloud.fields;
+      observation_cloud->is_bigendian = cloud.is_bigendian;
+      observation_cloud->point_step = cloud.point_step;
+      obs_offset_x = offset_x;
+      obs_offset_y = offset_y;
+      obs_offset_z = offset_z;
+    }
+    else
+    {
+      modifier.setPointCloud2Fields(3, "x", 1, sensor_msgs::PointField::FLOAT32,
+                                       "y", 1, sensor_msgs::PointField::FLOAT32,
+                                       "z", 1, sensor_msgs::PointField::FLOAT32);
+    }
+    observation_cloud->is_dense = cloud.is_dense;
+    modifier.resize(cloud.height * cloud.width);
+    unsigned int obs_point_step = observation_cloud->point_step;
     unsigned int point_count = 0;
 
-    // copy over the points that are within our height bounds
-    sensor_msgs::PointCloud2Iterator<float> iter_z(global_frame_cloud, "z");
-    std::vector<unsigned char>::const_iterator iter_global = global_frame_cloud.data.begin(), iter_global_end = global_frame_cloud.data.end();
-    std::vector<unsigned char>::iterator iter_obs = observation_cloud.data.begin();
-    for (; iter_global != iter_global_end; ++iter_z, iter_global += global_frame_cloud.point_step)
+    // copy over the points that are within our height bounds once transformed, row by row since the rows of an
+    // organized cloud may be padded
+    for (unsigned int row = 0; row < cloud.height && cloud.width > 0; ++row)
     {
-      if ((*iter_z) <= max_obstacle_height_
-          && (*iter_z) >= min_obstacle_height_)
+      const unsigned char* point_data = &cloud.data[row * cloud.row_step];
+      for (unsigned int col = 0; col < cloud.width; ++col, point_data += cloud.point_step)
       {
-        std::copy(iter_global, iter_global + global_frame_cloud.point_step, iter_obs);
-        iter_obs += global_frame_cloud.point_step;
-        ++point_count;
+        float x, y, z;
+        memcpy(&x, point_data + offset_x, sizeof(float));
+        memcpy(&y, point_data + offset_y, sizeof(float));
+        memcpy(&z, point_data + offset_z, sizeof(float));
+        tf2::Vector3 point = transform * tf2::Vector3(x, y, z);
+        if (point.z() <= max_obstacle_height_
+            && point.z() >= min_obstacle_height_)
+        {
+          unsigned char* obs_data = &observation_cloud->data[point_count * obs_point_step];
+          if (keep_all_fields_)
+            memcpy(obs_data, point_data, cloud.point_step);
+          x = point.x();
+          y = point.y();
+          z = point.z();
+          memcpy(obs_data + obs_offset_x, &x, sizeof(float));
+          memcpy(obs_data + obs_offset_y, &y, sizeof(float));
+          memcpy(obs_data + obs_offset_z, &z, sizeof(float));
+          ++point_count;
+        }
       }
     }
 
     // resize the cloud for the number of legal points
     modifier.resize(point_count);
-    observation_cloud.header.stamp = cloud.header.stamp;
-    observation_cloud.header.frame_id = global_frame_cloud.header.frame_id;
+    observation_cloud->header.stamp = cloud.header.stamp;
+    observation_cloud->header.seq = cloud.header.seq;
+    observation_cloud->header.frame_id = global_frame_;
   }
   catch (TransformException& ex)
   {
-    // if an exception occurs, we need to remove the empty observation from the list
-    observation_list_.pop_front();
     ROS_ERROR("TF Exception that should never happen for sensor frame: %s, cloud frame: %s, %s", sensor_frame_.c_str(),
               cloud.header.frame_id.c_str(), ex.what());
     return;
   }
 
+  // make sure to pass on the raytrace/obstacle range of the observation buffer to the observations
+  observation_list_.push_front(Observation(global_origin.point, observation_cloud, obstacle_range_, raytrace_range_));
+
   // if the update was successful, we want to update the last updated time
   last_updated_ = ros::Time::now();
 
@@ -188,13 +225,13 @@ void ObservationBuffer::bufferCloud(const sensor_msgs::PointCloud2& cloud)
   purgeStaleObservations();
 }
 
-// returns a copy of the observations
+// returns a copy of the observations, which share their clouds with the buffer
 void ObservationBuffer::getObservations(vector<Observation>& observations)
 {
   // first... let's make sure that we don't have any stale observations
   purgeStaleObservations();
 
-  // now we'll just copy the observations for the caller
+  // now we'll just copy the observations for the caller, the points are not copied
   list<Observation>::iterator obs_it;
   for (obs_it = observation_list_.begin(); obs_it != observation_list_.end(); ++obs_it)
   {
@@ -0,0 +1,78 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/snapshot_buffer.h>
+#include <costmap_2d/cost_values.h>
+#include <cstring>
+
+namespace costmap_2d
+{
+
+SnapshotBuffer::SnapshotBuffer() :
+    outline_(false)
+{
+}
+
+void SnapshotBuffer::publish(const Costmap2D& costmap)
+{
+  // The spare is the snapshot that was replaced by the last publish(), so
+  // readers can no longer get it from latest_. If the count is one, nobody
+  // holds it and nobody can start holding it while it is overwritten.
+  boost::shared_ptr<Costmap2D> snapshot;
+  snapshot.swap(spare_);
+  if (!snapshot || !snapshot.unique())
+    snapshot.reset(new Costmap2D());
+
+  *snapshot = costmap;
+  if (outline_)
+  {
+    unsigned int size_x = snapshot->getSizeInCellsX(), size_y = snapshot->getSizeInCellsY();
+    unsigned char* map = snapshot->getCharMap();
+    if (size_x > 0 && size_y > 0)
+    {
+      memset(map, LETHAL_OBSTACLE, size_x);
+      memset(map + (size_y - 1) * size_x, LETHAL_OBSTACLE, size_x);
+      for (unsigned int j = 1; j + 1 < size_y; ++j)
+        map[j * size_x] = map[j * size_x + size_x - 1] = LETHAL_OBSTACLE;
+    }
+  }
+  spare_ = boost::atomic_exchange(&latest_, snapshot);
+}
+
+boost::shared_ptr<const Costmap2D> SnapshotBuffer::get() const
+{
+  return boost::atomic_load(&latest_);
+}
+
+}  // namespace costmap_2d
@@ -0,0 +1,122 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <costmap_2d/thread_pool.h>
+#include <algorithm>
+
+namespace costmap_2d
+{
+
+ThreadPool::ThreadPool(unsigned int num_threads) :
+    num_threads_(std::max(1u, num_threads)),
+    task_(NULL),
+    num_tasks_(0),
+    next_task_(0),
+    unfinished_tasks_(0),
+    batch_(0),
+    shutdown_(false)
+{
+  for (unsigned int i = 1; i < num_threads_; ++i)
+  {
+    workers_.create_thread(boost::bind(&ThreadPool::workerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  work_cv_.notify_all();
+  workers_.join_all();
+}
+
+void ThreadPool::run(unsigned int num_tasks, const boost::function<void(unsigned int)>& task)
+{
+  if (num_tasks == 0)
+    return;
+
+  if (num_threads_ == 1 || num_tasks == 1)
+  {
+    for (unsigned int i = 0; i < num_tasks; ++i)
+      task(i);
+    return;
+  }
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  task_ = &task;
+  num_tasks_ = num_tasks;
+  next_task_ = 0;
+  unfinished_tasks_ = num_tasks;
+  ++batch_;
+  work_cv_.notify_all();
+
+  runTasks(lock);
+
+  while (unfinished_tasks_ > 0)
+    done_cv_.wait(lock);
+  task_ = NULL;
+}
+
+void ThreadPool::workerLoop()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  unsigned long last_batch = batch_;
+  while (true)
+  {
+    while (!shutdown_ && batch_ == last_batch)
+      work_cv_.wait(lock);
+    if (shutdown_)
+      return;
+    last_batch = batch_;
+    runTasks(lock);
+  }
+}
+
+void ThreadPool::runTasks(boost::unique_lock<boost::mutex>& lock)
+{
+  while (next_task_ < num_tasks_)
+  {
+    unsigned int i = next_task_++;
+    const boost::function<void(unsigned int)>& task = *task_;
+    lock.unlock();
+    task(i);
+    lock.lock();
+    if (--unfinished_tasks_ == 0)
+      done_cv_.notify_all();
+  }
+}
+
+}  // namespace costmap_2d
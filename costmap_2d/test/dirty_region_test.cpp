@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <costmap_2d/dirty_region.h>
+#include <costmap_2d/layer.h>
+
+using namespace costmap_2d;
+
+TEST(dirty_region, disjoint_rectangles_stay_separate)
+{
+  DirtyRegion region;
+  region.add(0, 0, 1, 1);
+  region.add(5, 5, 6, 6);
+  EXPECT_EQ(2, region.getRects().size());
+
+  double min_x, min_y, max_x, max_y;
+  region.getBounds(&min_x, &min_y, &max_x, &max_y);
+  EXPECT_EQ(0, min_x);
+  EXPECT_EQ(0, min_y);
+  EXPECT_EQ(6, max_x);
+  EXPECT_EQ(6, max_y);
+}
+
+TEST(dirty_region, overlapping_rectangles_are_merged)
+{
+  DirtyRegion region;
+  region.add(0, 0, 2, 2);
+  region.add(4, 0, 6, 2);
+  // overlaps both, so all three become one
+  region.add(1, 1, 5, 1.5);
+  ASSERT_EQ(1, region.getRects().size());
+  EXPECT_EQ(0, region.getRects()[0].min_x);
+  EXPECT_EQ(6, region.getRects()[0].max_x);
+}
+
+TEST(dirty_region, empty_rectangles_are_ignored)
+{
+  DirtyRegion region;
+  double min_x, min_y, max_x, max_y;
+  DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+  region.add(min_x, min_y, max_x, max_y);
+  EXPECT_TRUE(region.empty());
+
+  region.getBounds(&min_x, &min_y, &max_x, &max_y);
+  EXPECT_GT(min_x, max_x);
+}
+
+TEST(dirty_region, number_of_rectangles_is_capped)
+{
+  DirtyRegion region(4);
+  for (int i = 0; i < 10; i++)
+  {
+    region.add(10 * i, 0, 10 * i + 1, 1);
+  }
+  const std::vector<DirtyRect>& rects = region.getRects();
+  EXPECT_EQ(4, rects.size());
+
+  // the rectangles still cover everything that was added, without overlapping
+  for (int i = 0; i < 10; i++)
+  {
+    int covering = 0;
+    for (unsigned int r = 0; r < rects.size(); r++)
+    {
+      if (rects[r].overlaps(DirtyRect(10 * i, 0, 10 * i + 1, 1)))
+      {
+        EXPECT_LE(rects[r].min_x, 10 * i);
+        EXPECT_GE(rects[r].max_x, 10 * i + 1);
+        covering++;
+      }
+    }
+    EXPECT_EQ(1, covering);
+  }
+}
+
+TEST(dirty_region, padding_merges_neighbours)
+{
+  DirtyRegion region;
+  region.add(0, 0, 1, 1);
+  region.add(3, 0, 4, 1);
+  EXPECT_EQ(2, region.getRects().size());
+  region.pad(1.0);
+  ASSERT_EQ(1, region.getRects().size());
+  EXPECT_EQ(-1, region.getRects()[0].min_x);
+  EXPECT_EQ(5, region.getRects()[0].max_x);
+}
+
+/** @brief A layer that only implements updateBounds(), touching a fixed box */
+class BoxLayer : public Layer
+{
+public:
+  BoxLayer(double min_x, double min_y, double max_x, double max_y) :
+      min_x_(min_x), min_y_(min_y), max_x_(max_x), max_y_(max_y)
+  {
+  }
+
+  virtual void updateBounds(double robot_x, double robot_y, double robot_yaw, double* min_x, double* min_y,
+                            double* max_x, double* max_y)
+  {
+    *min_x = std::min(*min_x, min_x_);
+    *min_y = std::min(*min_y, min_y_);
+    *max_x = std::max(*max_x, max_x_);
+    *max_y = std::max(*max_y, max_y_);
+  }
+
+private:
+  double min_x_, min_y_, max_x_, max_y_;
+};
+
+TEST(dirty_region, legacy_layer_adds_its_bounding_box)
+{
+  // the box of the layer lies between the rectangles, inside their bounding box
+  BoxLayer layer(4, 4, 5, 5);
+  DirtyRegion region;
+  region.add(0, 0, 1, 1);
+  region.add(8, 8, 9, 9);
+  layer.updateRegion(0, 0, 0, &region);
+  ASSERT_EQ(1, region.getRects().size());
+  EXPECT_EQ(0, region.getRects()[0].min_x);
+  EXPECT_EQ(9, region.getRects()[0].max_x);
+
+  // on an empty region it adds only its own box
+  DirtyRegion empty;
+  layer.updateRegion(0, 0, 0, &empty);
+  ASSERT_EQ(1, empty.getRects().size());
+  EXPECT_EQ(4, empty.getRects()[0].min_x);
+  EXPECT_EQ(5, empty.getRects()[0].max_x);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
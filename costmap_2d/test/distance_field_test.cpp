@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+#include <costmap_2d/distance_field.h>
+
+using namespace costmap_2d;
+
+/**
+ * The distances of every cell to the obstacles of the grid, checking every obstacle
+ */
+std::vector<uint32_t> bruteForce(const std::vector<unsigned char>& grid, int size_x, int size_y, int max_distance)
+{
+  std::vector<uint32_t> distances(size_x * size_y, DistanceField::OUT_OF_RANGE);
+  for (int j = 0; j < size_y; ++j)
+    for (int i = 0; i < size_x; ++i)
+      for (int oj = 0; oj < size_y; ++oj)
+        for (int oi = 0; oi < size_x; ++oi)
+        {
+          uint32_t d = (oi - i) * (oi - i) + (oj - j) * (oj - j);
+          if (grid[oj * size_x + oi] && d <= uint32_t(max_distance * max_distance) && d < distances[j * size_x + i])
+            distances[j * size_x + i] = d;
+        }
+  return distances;
+}
+
+void randomObstacles(std::vector<unsigned char>& grid, int count)
+{
+  for (int n = 0; n < count; ++n)
+    grid[rand() % grid.size()] = 1;
+}
+
+void expectDistances(const DistanceField& field, const std::vector<uint32_t>& expected)
+{
+  for (unsigned int i = 0; i < expected.size(); ++i)
+    ASSERT_EQ(expected[i], field.getSquaredDistances()[i]) << "at cell " << i;
+}
+
+TEST(distance_field, recompute_is_exact)
+{
+  int size_x = 37, size_y = 29, max_distance = 6;
+  std::vector<unsigned char> grid(size_x * size_y, 0);
+  srand(1);
+  randomObstacles(grid, 12);
+
+  DistanceField field;
+  field.reset(size_x, size_y, max_distance);
+  field.setObstacles(&grid[0], 1, 0, 0, size_x, size_y);
+  field.recompute();
+  expectDistances(field, bruteForce(grid, size_x, size_y, max_distance));
+}
+
+TEST(distance_field, window_recompute_is_exact)
+{
+  int size_x = 41, size_y = 33, max_distance = 5;
+  std::vector<unsigned char> grid(size_x * size_y, 0);
+  srand(4);
+  randomObstacles(grid, 15);
+
+  // only the obstacles around the window are up to date, like in a full update of InflationLayer
+  DistanceField field;
+  field.reset(size_x, size_y, max_distance);
+  int min_i = 9, min_j = 7, max_i = 30, max_j = 21;
+  field.setObstacles(&grid[0], 1, min_i - max_distance, min_j - max_distance,
+                     max_i + max_distance, max_j + max_distance);
+  field.recompute(min_i, min_j, max_i, max_j);
+
+  std::vector<uint32_t> expected = bruteForce(grid, size_x, size_y, max_distance);
+  for (int j = 0; j < size_y; ++j)
+  {
+    for (int i = 0; i < size_x; ++i)
+    {
+      uint32_t distance = field.getSquaredDistances()[j * size_x + i];
+      if (i >= min_i && i < max_i && j >= min_j && j < max_j)
+        ASSERT_EQ(expected[j * size_x + i], distance) << "at cell " << i << ", " << j;
+      else
+        ASSERT_EQ(DistanceField::OUT_OF_RANGE, distance) << "at cell " << i << ", " << j;
+    }
+  }
+}
+
+TEST(distance_field, update_matches_recompute)
+{
+  int size_x = 60, size_y = 45, max_distance = 5;
+  std::vector<unsigned char> grid(size_x * size_y, 0);
+  srand(2);
+  randomObstacles(grid, 40);
+
+  DistanceField field;
+  field.reset(size_x, size_y, max_distance);
+  field.setObstacles(&grid[0], 1, 0, 0, size_x, size_y);
+  field.update();
+
+  for (int cycle = 0; cycle < 20; ++cycle)
+  {
+    // obstacles appear and disappear in a window, cells outside of it are not looked at
+    int min_i = rand() % size_x, min_j = rand() % size_y;
+    int max_i = min_i + 1 + rand() % 15, max_j = min_j + 1 + rand() % 15;
+    for (int n = 0; n < 10; ++n)
+    {
+      int i = min_i + rand() % (max_i - min_i), j = min_j + rand() % (max_j - min_j);
+      if (i < size_x && j < size_y)
+        grid[j * size_x + i] = !grid[j * size_x + i];
+    }
+    field.setObstacles(&grid[0], 1, min_i, min_j, max_i, max_j);
+    field.update();
+    expectDistances(field, bruteForce(grid, size_x, size_y, max_distance));
+  }
+}
+
+TEST(distance_field, shift_matches_recompute)
+{
+  int size_x = 50, size_y = 40, max_distance = 4;
+  std::vector<unsigned char> grid(size_x * size_y, 0);
+  srand(3);
+  randomObstacles(grid, 60);
+
+  DistanceField field;
+  field.reset(size_x, size_y, max_distance);
+  field.setObstacles(&grid[0], 1, 0, 0, size_x, size_y);
+  field.update();
+
+  int shifts[][2] = { { 3, 0 }, { 0, -5 }, { -7, 2 }, { 1, 1 }, { 60, 0 } };
+  for (int s = 0; s < 5; ++s)
+  {
+    int dx = shifts[s][0], dy = shifts[s][1];
+    std::vector<unsigned char> shifted(size_x * size_y, 0);
+    for (int j = 0; j < size_y; ++j)
+      for (int i = 0; i < size_x; ++i)
+        if (i + dx >= 0 && i + dx < size_x && j + dy >= 0 && j + dy < size_y)
+          shifted[j * size_x + i] = grid[(j + dy) * size_x + i + dx];
+    grid.swap(shifted);
+
+    field.shift(dx, dy);
+    field.update();
+    expectDistances(field, bruteForce(grid, size_x, size_y, max_distance));
+
+    // new obstacles come in after the move
+    randomObstacles(grid, 10);
+    field.setObstacles(&grid[0], 1, 0, 0, size_x, size_y);
+    field.update();
+    expectDistances(field, bruteForce(grid, size_x, size_y, max_distance));
+  }
+}
+
+TEST(distance_field, differences_are_counted)
+{
+  std::vector<unsigned char> grid(100, 0);
+  grid[55] = 1;
+
+  DistanceField a, b;
+  a.reset(10, 10, 3);
+  b.reset(10, 10, 3);
+  a.setObstacles(&grid[0], 1, 0, 0, 10, 10);
+  a.recompute();
+  EXPECT_LT(0u, a.countDifferences(b));
+
+  b.setObstacles(&grid[0], 1, 0, 0, 10, 10);
+  b.recompute();
+  EXPECT_EQ(0u, a.countDifferences(b));
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
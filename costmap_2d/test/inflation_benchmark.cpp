@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Benchmark of InflationLayer::updateCosts against the std::map based
+ * wavefront it replaced. Both are run on the same large synthetic map and
+ * the outputs are checked to be identical. The incremental mode is timed
+ * as well, with a few obstacles changing between updates. It inflates by the
+ * exact distance to the nearest obstacle, which is never farther than the
+ * obstacle the wavefront reached a cell from, so its costs are checked to be
+ * at least those of the default mode.
+ *
+ * Usage: rosrun costmap_2d inflation_benchmark [size_m] [resolution] [inflation_radius] [iterations]
+ */
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <ros/ros.h>
+#include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/layered_costmap.h>
+#include <costmap_2d/inflation_layer.h>
+#include <costmap_2d/testing_helper.h>
+
+using namespace costmap_2d;
+
+/**
+ * The previous inflation algorithm: a wavefront ordered by a std::map keyed
+ * on the floating point distance to the source obstacle.
+ */
+void referenceInflation(Costmap2D& master_grid, InflationLayer* ilayer, unsigned int cell_inflation_radius)
+{
+  unsigned char* master_array = master_grid.getCharMap();
+  unsigned int size_x = master_grid.getSizeInCellsX(), size_y = master_grid.getSizeInCellsY();
+  std::vector<bool> seen(size_x * size_y, false);
+  std::map<double, std::vector<CellData> > inflation_cells;
+
+  // the layer caches its costs as well, so do the same here to keep the comparison fair
+  unsigned int cache_size = cell_inflation_radius + 2;
+  std::vector<unsigned char> cached_costs(cache_size * cache_size);
+  for (unsigned int dx = 0; dx < cache_size; ++dx)
+    for (unsigned int dy = 0; dy < cache_size; ++dy)
+      cached_costs[dx * cache_size + dy] = ilayer->computeCost(hypot(dx, dy));
+
+  std::vector<CellData>& obs_bin = inflation_cells[0.0];
+  for (unsigned int j = 0; j < size_y; j++)
+  {
+    for (unsigned int i = 0; i < size_x; i++)
+    {
+      unsigned int index = master_grid.getIndex(i, j);
+      if (master_array[index] == LETHAL_OBSTACLE)
+        obs_bin.push_back(CellData(index, i, j, i, j));
+    }
+  }
+
+  std::map<double, std::vector<CellData> >::iterator bin;
+  for (bin = inflation_cells.begin(); bin != inflation_cells.end(); ++bin)
+  {
+    for (int i = 0; i < bin->second.size(); ++i)
+    {
+      const CellData cell = bin->second[i];
+      if (seen[cell.index_])
+        continue;
+      seen[cell.index_] = true;
+
+      unsigned int dx = abs(int(cell.x_) - int(cell.src_x_));
+      unsigned int dy = abs(int(cell.y_) - int(cell.src_y_));
+      unsigned char cost = cached_costs[dx * cache_size + dy];
+      unsigned char old_cost = master_array[cell.index_];
+      if (old_cost == NO_INFORMATION && cost >= INSCRIBED_INFLATED_OBSTACLE)
+        master_array[cell.index_] = cost;
+      else
+        master_array[cell.index_] = std::max(old_cost, cost);
+
+      int nx[4] = { -1, 0, 1, 0 };
+      int ny[4] = { 0, -1, 0, 1 };
+      for (int n = 0; n < 4; ++n)
+      {
+        int mx = int(cell.x_) + nx[n], my = int(cell.y_) + ny[n];
+        if (mx < 0 || my < 0 || mx >= int(size_x) || my >= int(size_y))
+          continue;
+        unsigned int index = master_grid.getIndex(mx, my);
+        if (seen[index])
+          continue;
+        double distance = hypot(abs(mx - int(cell.src_x_)), abs(my - int(cell.src_y_)));
+        if (distance > cell_inflation_radius)
+          continue;
+        inflation_cells[distance].push_back(CellData(index, mx, my, cell.src_x_, cell.src_y_));
+      }
+    }
+  }
+}
+
+/**
+ * Fill the map with free space, some unknown patches, walls and scattered
+ * obstacle points, which is roughly what a building map looks like.
+ */
+void fillMap(Costmap2D& costmap)
+{
+  unsigned int size_x = costmap.getSizeInCellsX(), size_y = costmap.getSizeInCellsY();
+  unsigned char* array = costmap.getCharMap();
+  memset(array, FREE_SPACE, size_x * size_y);
+  srand(42);
+
+  // unknown patches
+  for (unsigned int n = 0; n < 20; ++n)
+  {
+    unsigned int x0 = rand() % size_x, y0 = rand() % size_y;
+    for (unsigned int y = y0; y < std::min(size_y, y0 + size_y / 20); ++y)
+      for (unsigned int x = x0; x < std::min(size_x, x0 + size_x / 20); ++x)
+        array[costmap.getIndex(x, y)] = NO_INFORMATION;
+  }
+
+  // walls every 10% of the map, with doors in them
+  for (unsigned int k = size_y / 10; k < size_y; k += size_y / 10)
+    for (unsigned int x = 0; x < size_x; ++x)
+      if ((x / 40) % 5 != 0)
+        array[costmap.getIndex(x, k)] = LETHAL_OBSTACLE;
+  for (unsigned int k = size_x / 10; k < size_x; k += size_x / 10)
+    for (unsigned int y = 0; y < size_y; ++y)
+      if ((y / 40) % 5 != 0)
+        array[costmap.getIndex(k, y)] = LETHAL_OBSTACLE;
+
+  // clutter
+  for (unsigned int n = 0; n < size_x * size_y / 1000; ++n)
+    array[rand() % (size_x * size_y)] = LETHAL_OBSTACLE;
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "inflation_benchmark");
+
+  double size = argc > 1 ? atof(argv[1]) : 100.0;
+  double resolution = argc > 2 ? atof(argv[2]) : 0.025;
+  double inflation_radius = argc > 3 ? atof(argv[3]) : 1.5;
+  int iterations = argc > 4 ? atoi(argv[4]) : 5;
+
+  tf2_ros::Buffer tf;
+  LayeredCostmap layers("frame", false, false), full_layers("frame", false, false);
+  unsigned int cells = (unsigned int)(size / resolution);
+  layers.resizeMap(cells, cells, resolution, 0, 0);
+  full_layers.resizeMap(cells, cells, resolution, 0, 0);
+
+  InflationLayer* ilayer = addInflationLayer(layers, tf);
+  ilayer->setInflationParameters(inflation_radius, 10.0);
+  InflationLayer* full_ilayer = addInflationLayer(full_layers, tf);
+  full_ilayer->setInflationParameters(inflation_radius, 10.0);
+
+  std::vector<geometry_msgs::Point> footprint;
+  geometry_msgs::Point p;
+  p.x = 0.3; p.y = 0.3; footprint.push_back(p);
+  p.x = 0.3; p.y = -0.3; footprint.push_back(p);
+  p.x = -0.3; p.y = -0.3; footprint.push_back(p);
+  p.x = -0.3; p.y = 0.3; footprint.push_back(p);
+  layers.setFootprint(footprint);
+  full_layers.setFootprint(footprint);
+
+  Costmap2D input(cells, cells, resolution, 0, 0);
+  fillMap(input);
+  Costmap2D* master = layers.getCostmap();
+  Costmap2D reference(input);
+  unsigned int cell_inflation_radius = master->cellDistance(inflation_radius);
+
+  printf("map: %u x %u cells at %.3f m, inflation radius %.2f m (%u cells)\n",
+         cells, cells, resolution, inflation_radius, cell_inflation_radius);
+
+  double bucket_time = 0.0, reference_time = 0.0;
+  for (int it = 0; it < iterations; ++it)
+  {
+    *master = input;
+    ros::WallTime start = ros::WallTime::now();
+    ilayer->updateCosts(*master, 0, 0, cells, cells);
+    bucket_time += (ros::WallTime::now() - start).toSec();
+
+    reference = input;
+    start = ros::WallTime::now();
+    referenceInflation(reference, ilayer, cell_inflation_radius);
+    reference_time += (ros::WallTime::now() - start).toSec();
+  }
+
+  unsigned int mismatches = 0;
+  const unsigned char* a = master->getCharMap();
+  const unsigned char* b = reference.getCharMap();
+  for (unsigned int i = 0; i < cells * cells; ++i)
+    if (a[i] != b[i])
+      ++mismatches;
+
+  // incremental mode: a few obstacles appear and disappear between updates
+  ilayer->setIncrementalInflation(true, false);
+  *master = input;
+  ilayer->updateCosts(*master, 0, 0, cells, cells);
+  Costmap2D* full = full_layers.getCostmap();
+  double incremental_time = 0.0;
+  unsigned int lower = 0, higher = 0;
+  for (int it = 0; it < iterations; ++it)
+  {
+    *master = input;
+    unsigned int x = rand() % (cells - 20), y = rand() % (cells - 20);
+    for (unsigned int k = 0; k < 20; ++k)
+      master->setCost(x + k, y + k, LETHAL_OBSTACLE);
+    *full = *master;
+    ros::WallTime start = ros::WallTime::now();
+    ilayer->updateCosts(*master, 0, 0, cells, cells);
+    incremental_time += (ros::WallTime::now() - start).toSec();
+
+    full_ilayer->updateCosts(*full, 0, 0, cells, cells);
+    for (unsigned int i = 0; i < cells * cells; ++i)
+    {
+      if (master->getCharMap()[i] < full->getCharMap()[i])
+        ++lower;
+      else if (master->getCharMap()[i] > full->getCharMap()[i])
+        ++higher;
+    }
+  }
+
+  printf("bucket queue:  %8.2f ms/update\n", 1e3 * bucket_time / iterations);
+  printf("std::map:      %8.2f ms/update\n", 1e3 * reference_time / iterations);
+  printf("speedup:       %8.2fx\n", reference_time / bucket_time);
+  printf("mismatching cells: %u\n", mismatches);
+  printf("incremental:   %8.2f ms/update\n", 1e3 * incremental_time / iterations);
+  printf("incremental cells costlier than the wavefront: %u, cheaper: %u\n", higher, lower);
+
+  return mismatches == 0 && lower == 0 ? 0 : 1;
+}
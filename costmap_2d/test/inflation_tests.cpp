@@ -409,6 +409,178 @@ TEST(costmap, testInflation3){
   ASSERT_EQ(countValues(*costmap, INSCRIBED_INFLATED_OBSTACLE), (unsigned int)4);
 }
 
+/**
+ * Test that the incremental mode agrees with a full recompute as obstacles
+ * appear and get cleared, and that it is never cheaper than the wavefront
+ */
+TEST(costmap, testIncrementalInflation){
+  tf2_ros::Buffer tf;
+  LayeredCostmap layers("frame", false, false), reference_layers("frame", false, false);
+  layers.resizeMap(20, 20, 1, 0, 0);
+  reference_layers.resizeMap(20, 20, 1, 0, 0);
+
+  const double inflation_radius = 4.1;
+  std::vector<Point> polygon = setRadii(layers, 2.1, 2.3, inflation_radius);
+  setRadii(reference_layers, 2.1, 2.3, inflation_radius);
+
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+  InflationLayer* ilayer = addInflationLayer(layers, tf);
+  layers.setFootprint(polygon);
+  ilayer->setIncrementalInflation(true, true);
+
+  ObstacleLayer* reference_olayer = addObstacleLayer(reference_layers, tf);
+  InflationLayer* reference_ilayer = addInflationLayer(reference_layers, tf);
+  reference_layers.setFootprint(polygon);
+
+  // each observation is raytraced from the origin, clearing the previous ones on its way
+  double points[][2] = { { 5, 5 }, { 8, 8 }, { 8, 2 }, { 12, 12 }, { 15, 3 }, { 3, 15 }, { 16, 16 } };
+  for (unsigned int n = 0; n < sizeof(points) / sizeof(points[0]); ++n)
+  {
+    olayer->clearStaticObservations(true, true);
+    reference_olayer->clearStaticObservations(true, true);
+    addObservation(olayer, points[n][0], points[n][1], MAX_Z);
+    addObservation(reference_olayer, points[n][0], points[n][1], MAX_Z);
+    layers.updateMap(0, 0, 0);
+    reference_layers.updateMap(0, 0, 0);
+
+    ASSERT_EQ(ilayer->getVerificationMismatches(), 0u);
+
+    Costmap2D* costmap = layers.getCostmap();
+    Costmap2D* reference = reference_layers.getCostmap();
+    ASSERT_EQ(countValues(*costmap, LETHAL_OBSTACLE), countValues(*reference, LETHAL_OBSTACLE));
+    for (unsigned int j = 0; j < costmap->getSizeInCellsY(); ++j)
+      for (unsigned int i = 0; i < costmap->getSizeInCellsX(); ++i)
+        ASSERT_GE(costmap->getCost(i, j), reference->getCost(i, j));
+  }
+
+  // the last obstacle is fully inflated
+  validatePointInflation(16, 16, layers.getCostmap(), ilayer, inflation_radius);
+}
+
+/**
+ * Test that the incremental mode gives every cell the cost of its exact
+ * distance to the nearest lethal cell, on a cluttered map with unknown cells,
+ * and that the wavefront never gives a higher one
+ */
+TEST(costmap, testInflationMatchesExactDistance){
+  tf2_ros::Buffer tf;
+  LayeredCostmap layers("frame", false, false), incremental_layers("frame", false, false);
+  const unsigned int size = 60;
+  layers.resizeMap(size, size, 0.1, 0, 0);
+  incremental_layers.resizeMap(size, size, 0.1, 0, 0);
+
+  const double inflation_radius = 0.65;
+  std::vector<Point> polygon = setRadii(layers, 0.2, 0.2, inflation_radius);
+  setRadii(incremental_layers, 0.2, 0.2, inflation_radius);
+  InflationLayer* ilayer = addInflationLayer(layers, tf);
+  InflationLayer* incremental_ilayer = addInflationLayer(incremental_layers, tf);
+  layers.setFootprint(polygon);
+  incremental_layers.setFootprint(polygon);
+  ilayer->setInflationParameters(inflation_radius, 3.0);
+  incremental_ilayer->setInflationParameters(inflation_radius, 3.0);
+  incremental_ilayer->setIncrementalInflation(true, true);
+
+  Costmap2D input(size, size, 0.1, 0, 0);
+  Costmap2D* costmap = layers.getCostmap();
+  Costmap2D* incremental_costmap = incremental_layers.getCostmap();
+  int radius = costmap->cellDistance(inflation_radius);
+  srand(5);
+  for (int cycle = 0; cycle < 5; ++cycle)
+  {
+    for (unsigned int n = 0; n < 80; ++n)
+    {
+      int value = rand() % 3;
+      input.setCost(rand() % size, rand() % size,
+                    value == 0 ? FREE_SPACE : value == 1 ? NO_INFORMATION : LETHAL_OBSTACLE);
+    }
+    *costmap = input;
+    *incremental_costmap = input;
+    ilayer->updateCosts(*costmap, 0, 0, size, size);
+    incremental_ilayer->updateCosts(*incremental_costmap, 0, 0, size, size);
+    ASSERT_EQ(incremental_ilayer->getVerificationMismatches(), 0u);
+
+    for (int j = 0; j < int(size); ++j)
+    {
+      for (int i = 0; i < int(size); ++i)
+      {
+        int nearest = -1;
+        for (int y = std::max(0, j - radius); y <= std::min(int(size) - 1, j + radius); ++y)
+        {
+          for (int x = std::max(0, i - radius); x <= std::min(int(size) - 1, i + radius); ++x)
+          {
+            int distance = (x - i) * (x - i) + (y - j) * (y - j);
+            if (input.getCost(x, y) == LETHAL_OBSTACLE && (nearest < 0 || distance < nearest))
+              nearest = distance;
+          }
+        }
+
+        unsigned char expected = input.getCost(i, j);
+        if (nearest >= 0 && nearest <= radius * radius)
+        {
+          unsigned char cost = ilayer->computeCost(sqrt(nearest));
+          if (expected == NO_INFORMATION && cost >= INSCRIBED_INFLATED_OBSTACLE)
+            expected = cost;
+          else
+            expected = std::max(expected, cost);
+        }
+        ASSERT_LE(costmap->getCost(i, j), expected);
+        ASSERT_EQ(incremental_costmap->getCost(i, j), expected);
+      }
+    }
+  }
+}
+
+/**
+ * Test that a parallel update gives the same costs as a serial one in both
+ * modes; the incremental mode writes its costs on the thread pool.
+ */
+TEST(costmap, testParallelInflation){
+  tf2_ros::Buffer tf;
+  const unsigned int size = 100;
+  const double inflation_radius = 0.65;
+  LayeredCostmap serial_layers("frame", false, false);
+  serial_layers.resizeMap(size, size, 0.1, 0, 0);
+  std::vector<Point> polygon = setRadii(serial_layers, 0.2, 0.2, inflation_radius);
+  serial_layers.setFootprint(polygon);
+  InflationLayer* serial_ilayer = addInflationLayer(serial_layers, tf);
+  serial_ilayer->setInflationParameters(inflation_radius, 3.0);
+
+  for (int incremental = 0; incremental < 2; ++incremental)
+  {
+    LayeredCostmap layers("frame", false, false);
+    layers.resizeMap(size, size, 0.1, 0, 0);
+    setRadii(layers, 0.2, 0.2, inflation_radius);
+    layers.setFootprint(polygon);
+    layers.setParallelUpdate(3, 17);
+    InflationLayer* ilayer = addInflationLayer(layers, tf);
+    ilayer->setInflationParameters(inflation_radius, 3.0);
+    ilayer->setIncrementalInflation(incremental, true);
+    serial_ilayer->setIncrementalInflation(incremental, false);
+
+    Costmap2D input(size, size, 0.1, 0, 0);
+    Costmap2D* serial_costmap = serial_layers.getCostmap();
+    Costmap2D* costmap = layers.getCostmap();
+    srand(7);
+    for (int cycle = 0; cycle < 5; ++cycle)
+    {
+      for (unsigned int n = 0; n < 150; ++n)
+      {
+        int value = rand() % 3;
+        input.setCost(rand() % size, rand() % size,
+                      value == 0 ? FREE_SPACE : value == 1 ? NO_INFORMATION : LETHAL_OBSTACLE);
+      }
+      *serial_costmap = input;
+      *costmap = input;
+      serial_ilayer->updateCosts(*serial_costmap, 0, 0, size, size);
+      ilayer->updateCosts(*costmap, 0, 0, size, size);
+      ASSERT_EQ(ilayer->getVerificationMismatches(), 0u);
+
+      for (unsigned int j = 0; j < size; ++j)
+        for (unsigned int i = 0; i < size; ++i)
+          ASSERT_EQ(costmap->getCost(i, j), serial_costmap->getCost(i, j));
+    }
+  }
+}
 
 int main(int argc, char** argv){
   ros::init(argc, argv, "inflation_tests");
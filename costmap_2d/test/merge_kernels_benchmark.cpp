@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Microbenchmark of the CostmapLayer merge kernels. For every implementation
+ * supported by this machine, prints the throughput of each merge policy in
+ * cells per second on a few typical update window sizes.
+ *
+ * Usage: rosrun costmap_2d merge_kernels_benchmark [repetitions]
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/merge_kernels.h>
+
+using namespace costmap_2d;
+
+/**
+ * Returns the number of cells per second for merging a width x height window of a layer into a map of the same size
+ */
+double benchmark(MergeRowKernel kernel, unsigned int width, unsigned int height, int repetitions)
+{
+  std::vector<unsigned char> master(width * height), layer(width * height);
+  srand(42);
+  for (unsigned int i = 0; i < width * height; i++)
+  {
+    // mostly free space with some obstacles and unknown cells, roughly like a real layer
+    int r = rand() % 100;
+    master[i] = r < 70 ? FREE_SPACE : r < 80 ? NO_INFORMATION : rand() % 256;
+    r = rand() % 100;
+    layer[i] = r < 60 ? FREE_SPACE : r < 90 ? NO_INFORMATION : rand() % 256;
+  }
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for (int k = 0; k < repetitions; k++)
+  {
+    for (unsigned int j = 0; j < height; j++)
+    {
+      kernel(&master[j * width], &layer[j * width], width);
+    }
+  }
+  double elapsed = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() * 1e-6;
+  return double(width) * height * repetitions / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+  int repetitions = argc > 1 ? atoi(argv[1]) : 100;
+  const MergeKernels* implementations[3] = { getScalarMergeKernels(), getSSE2MergeKernels(), getAVX2MergeKernels() };
+  const unsigned int sizes[4] = { 100, 400, 1000, 4000 };
+
+  printf("dispatch selects: %s\n", getMergeKernels()->name);
+  printf("%-8s %-10s %12s %12s %12s %12s   (Mcells/s)\n", "impl", "window",
+         "max", "overwrite", "true_ovw", "addition");
+  for (unsigned int k = 0; k < 3; k++)
+  {
+    const MergeKernels* kernels = implementations[k];
+    if (kernels == NULL)
+      continue;
+    for (unsigned int s = 0; s < 4; s++)
+    {
+      unsigned int size = sizes[s];
+      // keep the number of cells merged roughly constant across window sizes
+      int reps = std::max(1, int(repetitions * 1e6 / (double(size) * size)));
+      char window[32];
+      snprintf(window, sizeof(window), "%ux%u", size, size);
+      printf("%-8s %-10s %12.1f %12.1f %12.1f %12.1f\n", kernels->name, window,
+             benchmark(kernels->max, size, size, reps) * 1e-6,
+             benchmark(kernels->overwrite, size, size, reps) * 1e-6,
+             benchmark(kernels->true_overwrite, size, size, reps) * 1e-6,
+             benchmark(kernels->addition, size, size, reps) * 1e-6);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/merge_kernels.h>
+
+using namespace costmap_2d;
+
+/*
+ * Reference versions of the merges, as CostmapLayer implemented them per cell.
+ */
+unsigned char referenceMax(unsigned char old_cost, unsigned char cost)
+{
+  if (cost == NO_INFORMATION)
+    return old_cost;
+  if (old_cost == NO_INFORMATION || old_cost < cost)
+    return cost;
+  return old_cost;
+}
+
+unsigned char referenceOverwrite(unsigned char old_cost, unsigned char cost)
+{
+  return cost != NO_INFORMATION ? cost : old_cost;
+}
+
+unsigned char referenceAddition(unsigned char old_cost, unsigned char cost)
+{
+  if (cost == NO_INFORMATION)
+    return old_cost;
+  if (old_cost == NO_INFORMATION)
+    return cost;
+  int sum = old_cost + cost;
+  if (sum >= INSCRIBED_INFLATED_OBSTACLE)
+    return INSCRIBED_INFLATED_OBSTACLE - 1;
+  return sum;
+}
+
+/**
+ * Merge every pair of values with the given kernel, using a row length that
+ * is not a multiple of the vector width so the tail handling is covered too.
+ */
+void checkKernel(MergeRowKernel kernel, unsigned char (*reference)(unsigned char, unsigned char))
+{
+  const unsigned int n = 256 * 256 + 7;
+  std::vector<unsigned char> master(n), layer(n);
+  for (unsigned int i = 0; i < n; i++)
+  {
+    master[i] = i / 256;
+    layer[i] = i % 256;
+  }
+  kernel(&master[0], &layer[0], n);
+  for (unsigned int i = 0; i < n; i++)
+  {
+    ASSERT_EQ(reference((i / 256) % 256, i % 256), master[i]) << "old " << i / 256 << " layer " << i % 256;
+  }
+}
+
+void checkKernels(const MergeKernels* kernels)
+{
+  if (kernels == NULL)
+    return;
+  SCOPED_TRACE(kernels->name);
+  checkKernel(kernels->max, referenceMax);
+  checkKernel(kernels->overwrite, referenceOverwrite);
+  checkKernel(kernels->addition, referenceAddition);
+
+  std::vector<unsigned char> master(1000, FREE_SPACE), layer(1000, NO_INFORMATION);
+  kernels->true_overwrite(&master[0], &layer[0], 1000);
+  EXPECT_TRUE(master == layer);
+}
+
+TEST(merge_kernels, scalar)
+{
+  checkKernels(getScalarMergeKernels());
+}
+
+TEST(merge_kernels, sse2)
+{
+  checkKernels(getSSE2MergeKernels());
+}
+
+TEST(merge_kernels, avx2)
+{
+  checkKernels(getAVX2MergeKernels());
+}
+
+TEST(merge_kernels, dispatch)
+{
+  ASSERT_TRUE(getMergeKernels() != NULL);
+  checkKernels(getMergeKernels());
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -35,8 +35,10 @@
 #include <costmap_2d/costmap_2d.h>
 #include <costmap_2d/layered_costmap.h>
 #include <costmap_2d/observation_buffer.h>
+#include <costmap_2d/footprint.h>
 #include <costmap_2d/testing_helper.h>
 #include <set>
+#include <cstring>
 #include <gtest/gtest.h>
 
 using namespace costmap_2d;
@@ -244,6 +246,243 @@ TEST(costmap, testMultipleAdditions){
 }
 
 
+/**
+ * Verify that obstacles far apart are updated as separate rectangles, leaving the cells between them alone
+ */
+TEST(costmap, testDirtyRegion){
+  tf2_ros::Buffer tf;
+  LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+  ObstacleLayer* olayer = addObstacleLayer(layers, tf);
+
+  addObservation(olayer, 1.5, 1.5, MAX_Z/2, 1.0, 1.0, MAX_Z/2);
+  addObservation(olayer, 8.5, 8.5, MAX_Z/2, 8.0, 8.0, MAX_Z/2);
+
+  // mark a cell between the two, it must not be reset by the update
+  layers.getCostmap()->setCost(5, 5, LETHAL_OBSTACLE);
+  layers.updateMap(0, 0, 0);
+
+  ASSERT_EQ(2, layers.getUpdatedRegion().getRects().size());
+  ASSERT_EQ(LETHAL_OBSTACLE, layers.getCostmap()->getCost(1, 1));
+  ASSERT_EQ(LETHAL_OBSTACLE, layers.getCostmap()->getCost(8, 8));
+  ASSERT_EQ(LETHAL_OBSTACLE, layers.getCostmap()->getCost(5, 5));
+}
+
+/**
+ * Verify that splitting the update into tiles on several threads gives the same costmap as the serial update
+ */
+TEST(costmap, testParallelUpdate){
+  tf2_ros::Buffer tf;
+  LayeredCostmap serial("frame", false, false), parallel("frame", false, false);
+  parallel.setParallelUpdate(4, 3);
+
+  LayeredCostmap* layers[2] = { &serial, &parallel };
+  for (int i = 0; i < 2; i++)
+  {
+    addStaticLayer(*layers[i], tf);
+    ObstacleLayer* olayer = addObstacleLayer(*layers[i], tf);
+    InflationLayer* ilayer = addInflationLayer(*layers[i], tf);
+    ilayer->setInflationParameters(3.0, 1.0);
+    layers[i]->setFootprint(makeFootprintFromRadius(1.0));
+
+    addObservation(olayer, 0.0, 0.0, MAX_Z/2, 0, 0, MAX_Z/2);
+    addObservation(olayer, 5.5, 3.5);
+    addObservation(olayer, 9.5, 9.5, MAX_Z/2, 0.5, 0.5, MAX_Z/2);
+    layers[i]->updateMap(0, 0, 0);
+  }
+
+  Costmap2D* a = serial.getCostmap();
+  Costmap2D* b = parallel.getCostmap();
+  for (unsigned int y = 0; y < a->getSizeInCellsY(); y++)
+    for (unsigned int x = 0; x < a->getSizeInCellsX(); x++)
+      ASSERT_EQ(a->getCost(x, y), b->getCost(x, y));
+}
+
+/**
+ * Verify that clearing the rays on several threads gives the same costmap and bounds as clearing them in order
+ */
+TEST(costmap, testParallelClearing){
+  tf2_ros::Buffer tf;
+  LayeredCostmap serial("frame", false, false), parallel("frame", false, false);
+  parallel.setParallelUpdate(4, 16);
+
+  LayeredCostmap* layers[2] = { &serial, &parallel };
+  ObstacleLayer* olayers[2];
+  for (int i = 0; i < 2; i++)
+  {
+    layers[i]->resizeMap(50, 50, 1, 0, 0);
+    olayers[i] = addObstacleLayer(*layers[i], tf);
+  }
+
+  // enough rays for the parallel path, the second round clears part of the first one
+  srand(7);
+  for (int round = 0; round < 2; round++)
+  {
+    double ox = 5 + rand() % 40, oy = 5 + rand() % 40;
+    for (int n = 0; n < 400; n++)
+    {
+      double x = (rand() % 600) / 10.0 - 5.0, y = (rand() % 600) / 10.0 - 5.0;
+      for (int i = 0; i < 2; i++)
+        addObservation(olayers[i], x, y, MAX_Z/2, ox, oy, MAX_Z/2);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+      layers[i]->updateMap(0, 0, 0);
+      olayers[i]->clearStaticObservations(true, true);
+    }
+
+    const std::vector<DirtyRect>& a_rects = serial.getUpdatedRegion().getRects();
+    const std::vector<DirtyRect>& b_rects = parallel.getUpdatedRegion().getRects();
+    ASSERT_EQ(a_rects.size(), b_rects.size());
+    for (unsigned int r = 0; r < a_rects.size(); r++)
+    {
+      ASSERT_EQ(a_rects[r].min_x, b_rects[r].min_x);
+      ASSERT_EQ(a_rects[r].min_y, b_rects[r].min_y);
+      ASSERT_EQ(a_rects[r].max_x, b_rects[r].max_x);
+      ASSERT_EQ(a_rects[r].max_y, b_rects[r].max_y);
+    }
+
+    Costmap2D* a = serial.getCostmap();
+    Costmap2D* b = parallel.getCostmap();
+    for (unsigned int y = 0; y < a->getSizeInCellsY(); y++)
+      for (unsigned int x = 0; x < a->getSizeInCellsX(); x++)
+        ASSERT_EQ(a->getCost(x, y), b->getCost(x, y));
+  }
+}
+
+/**
+ * A layer that clears one observation by itself, outside of updateRegion()
+ */
+class DirectClearingLayer : public ObstacleLayer
+{
+public:
+  void clear(double x, double y, double ox, double oy)
+  {
+    sensor_msgs::PointCloud2 cloud;
+    sensor_msgs::PointCloud2Modifier modifier(cloud);
+    modifier.setPointCloud2FieldsByString(1, "xyz");
+    modifier.resize(1);
+    sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+    *iter_x = x;
+    *iter_y = y;
+    *iter_z = MAX_Z/2;
+
+    geometry_msgs::Point p;
+    p.x = ox;
+    p.y = oy;
+    p.z = MAX_Z/2;
+
+    double min_x, min_y, max_x, max_y;
+    DirtyRegion::resetBounds(&min_x, &min_y, &max_x, &max_y);
+    raytraceFreespace(Observation(p, cloud, 100.0, 100.0), &min_x, &min_y, &max_x, &max_y);
+  }
+};
+
+/**
+ * Verify that raytraceFreespace() called by a subclass clears the cells right away
+ */
+TEST(costmap, testDirectRaytraceFreespace){
+  tf2_ros::Buffer tf;
+  LayeredCostmap layers("frame", false, false);
+  layers.resizeMap(10, 10, 1, 0, 0);
+  DirectClearingLayer* olayer = new DirectClearingLayer();
+  olayer->initialize(&layers, "obstacles", &tf);
+  layers.addPlugin(boost::shared_ptr<Layer>(olayer));
+
+  addObservation(olayer, 5.5, 5.5);
+  layers.updateMap(0, 0, 0);
+  ASSERT_EQ(LETHAL_OBSTACLE, olayer->getCost(5, 5));
+  olayer->clearStaticObservations(true, true);
+
+  // the ray ends past the obstacle, so the obstacle's cell is on it
+  olayer->clear(8.5, 8.5, 0.5, 0.5);
+  ASSERT_EQ(FREE_SPACE, olayer->getCost(5, 5));
+}
+
+/**
+ * Verify that the observation buffer transforms and filters the points, and that the copies of an observation share its cloud
+ */
+TEST(costmap, testObservationBuffer){
+  tf2_ros::Buffer tf;
+  geometry_msgs::TransformStamped transform;
+  transform.header.frame_id = "frame";
+  transform.child_frame_id = "sensor";
+  transform.transform.translation.x = 1.0;
+  transform.transform.translation.z = 0.5;
+  transform.transform.rotation.w = 1.0;
+  tf.setTransform(transform, "obstacle_tests", true);
+
+  ObservationBuffer buffer("cloud", 0.0, 0.0, 0.0, 1.0, 5.0, 6.0, tf, "frame", "", 0.1);
+  ObservationBuffer all_fields_buffer("cloud", 0.0, 0.0, 0.0, 1.0, 5.0, 6.0, tf, "frame", "", 0.1, true);
+
+  // an organized cloud of 2 rows of 2 points, with 8 bytes of padding at the end of each row
+  sensor_msgs::PointCloud2 cloud;
+  cloud.header.frame_id = "sensor";
+  cloud.header.stamp = ros::Time(10.0);
+  sensor_msgs::PointCloud2Modifier modifier(cloud);
+  modifier.setPointCloud2Fields(4, "x", 1, sensor_msgs::PointField::FLOAT32,
+                                   "y", 1, sensor_msgs::PointField::FLOAT32,
+                                   "z", 1, sensor_msgs::PointField::FLOAT32,
+                                   "intensity", 1, sensor_msgs::PointField::FLOAT32);
+  cloud.height = 2;
+  cloud.width = 2;
+  cloud.row_step = 2 * cloud.point_step + 8;
+  cloud.data.assign(cloud.height * cloud.row_step, 0xff);
+  float points[4][3] = { { 0.0, 0.0, 0.0 }, { 1.0, 2.0, 0.8 }, { 2.0, 0.0, -0.4 }, { 0.0, 1.0, 0.7 } };
+  for (int i = 0; i < 4; i++)
+  {
+    float point[4] = { points[i][0], points[i][1], points[i][2], 10.0f * i };
+    memcpy(&cloud.data[(i / 2) * cloud.row_step + (i % 2) * cloud.point_step], point, sizeof(point));
+  }
+  buffer.bufferCloud(cloud);
+  all_fields_buffer.bufferCloud(cloud);
+
+  std::vector<Observation> a, b;
+  buffer.getObservations(a);
+  buffer.getObservations(b);
+  ASSERT_EQ(1, a.size());
+  ASSERT_EQ(1, b.size());
+  ASSERT_EQ(a[0].cloud_.get(), b[0].cloud_.get());
+  EXPECT_DOUBLE_EQ(1.0, a[0].origin_.x);
+  EXPECT_DOUBLE_EQ(0.5, a[0].origin_.z);
+  EXPECT_DOUBLE_EQ(5.0, a[0].obstacle_range_);
+  EXPECT_DOUBLE_EQ(6.0, a[0].raytrace_range_);
+
+  // the second and last points are above the maximum height once transformed, only x, y and z are kept
+  const sensor_msgs::PointCloud2& observation_cloud = *(a[0].cloud_);
+  ASSERT_EQ(2, observation_cloud.width * observation_cloud.height);
+  ASSERT_EQ(3, observation_cloud.fields.size());
+  ASSERT_EQ(3 * sizeof(float), observation_cloud.point_step);
+  EXPECT_EQ("frame", observation_cloud.header.frame_id);
+  sensor_msgs::PointCloud2ConstIterator<float> iter_obs(observation_cloud, "x");
+  EXPECT_FLOAT_EQ(1.0, iter_obs[0]);
+  EXPECT_FLOAT_EQ(0.5, iter_obs[2]);
+  ++iter_obs;
+  EXPECT_FLOAT_EQ(3.0, iter_obs[0]);
+  EXPECT_FLOAT_EQ(0.1, iter_obs[2]);
+
+  // the other buffer keeps the other fields as well
+  std::vector<Observation> c;
+  all_fields_buffer.getObservations(c);
+  ASSERT_EQ(1, c.size());
+  const sensor_msgs::PointCloud2& all_fields_cloud = *(c[0].cloud_);
+  ASSERT_EQ(2, all_fields_cloud.width * all_fields_cloud.height);
+  ASSERT_EQ(4, all_fields_cloud.fields.size());
+  ASSERT_EQ(cloud.point_step, all_fields_cloud.point_step);
+  sensor_msgs::PointCloud2ConstIterator<float> iter_all(all_fields_cloud, "x");
+  sensor_msgs::PointCloud2ConstIterator<float> iter_intensity(all_fields_cloud, "intensity");
+  EXPECT_FLOAT_EQ(1.0, iter_all[0]);
+  EXPECT_FLOAT_EQ(0.5, iter_all[2]);
+  EXPECT_FLOAT_EQ(0.0, *iter_intensity);
+  ++iter_all;
+  ++iter_intensity;
+  EXPECT_FLOAT_EQ(3.0, iter_all[0]);
+  EXPECT_FLOAT_EQ(0.1, iter_all[2]);
+  EXPECT_FLOAT_EQ(20.0, *iter_intensity);
+}
+
 int main(int argc, char** argv){
   ros::init(argc, argv, "obstacle_tests");
   testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+#include <boost/thread.hpp>
+
+#include <costmap_2d/cost_values.h>
+#include <costmap_2d/snapshot_buffer.h>
+
+using namespace costmap_2d;
+
+TEST(snapshot_buffer, snapshots_are_copies)
+{
+  SnapshotBuffer buffer;
+  EXPECT_FALSE(buffer.get());
+
+  Costmap2D costmap(10, 10, 0.1, 0.0, 0.0, 7);
+  buffer.publish(costmap);
+  boost::shared_ptr<const Costmap2D> snapshot = buffer.get();
+  ASSERT_TRUE(snapshot);
+  costmap.setCost(3, 4, 100);
+  EXPECT_EQ(7, snapshot->getCost(3, 4));
+  EXPECT_EQ(10, snapshot->getSizeInCellsX());
+}
+
+TEST(snapshot_buffer, buffers_are_reused_once_released)
+{
+  SnapshotBuffer buffer;
+  Costmap2D costmap(10, 10, 0.1, 0.0, 0.0, 1);
+  buffer.publish(costmap);
+  const Costmap2D* first = buffer.get().get();
+
+  // nobody holds the first snapshot, so the one after the next reuses it
+  costmap.setCost(0, 0, 2);
+  buffer.publish(costmap);
+  costmap.setCost(0, 0, 3);
+  buffer.publish(costmap);
+  EXPECT_EQ(first, buffer.get().get());
+  EXPECT_EQ(3, buffer.get()->getCost(0, 0));
+}
+
+TEST(snapshot_buffer, held_snapshots_are_not_overwritten)
+{
+  SnapshotBuffer buffer;
+  Costmap2D costmap(10, 10, 0.1, 0.0, 0.0, 1);
+  buffer.publish(costmap);
+  boost::shared_ptr<const Costmap2D> held = buffer.get();
+
+  for (unsigned char value = 2; value < 6; ++value)
+  {
+    costmap.setCost(0, 0, value);
+    buffer.publish(costmap);
+    EXPECT_NE(held.get(), buffer.get().get());
+    EXPECT_EQ(value, buffer.get()->getCost(0, 0));
+  }
+  EXPECT_EQ(1, held->getCost(0, 0));
+  EXPECT_TRUE(held.unique());
+}
+
+TEST(snapshot_buffer, outline)
+{
+  SnapshotBuffer buffer;
+  buffer.setOutline(true);
+  Costmap2D costmap(6, 5, 0.1, 0.0, 0.0, FREE_SPACE);
+  buffer.publish(costmap);
+  boost::shared_ptr<const Costmap2D> snapshot = buffer.get();
+  for (unsigned int j = 0; j < 5; ++j)
+  {
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+      bool border = i == 0 || j == 0 || i == 5 || j == 4;
+      EXPECT_EQ(border ? LETHAL_OBSTACLE : FREE_SPACE, snapshot->getCost(i, j));
+    }
+  }
+  EXPECT_EQ(FREE_SPACE, costmap.getCost(0, 0));
+}
+
+/** @brief Reads snapshots while they are published and checks that each is a whole copy */
+void readSnapshots(SnapshotBuffer* buffer, volatile bool* done, unsigned int* torn)
+{
+  while (!*done)
+  {
+    boost::shared_ptr<const Costmap2D> snapshot = buffer->get();
+    if (!snapshot)
+      continue;
+    const unsigned char* map = snapshot->getCharMap();
+    unsigned int size = snapshot->getSizeInCellsX() * snapshot->getSizeInCellsY();
+    for (unsigned int i = 1; i < size; ++i)
+    {
+      if (map[i] != map[0])
+      {
+        ++*torn;
+        break;
+      }
+    }
+  }
+}
+
+TEST(snapshot_buffer, concurrent_readers_see_whole_snapshots)
+{
+  SnapshotBuffer buffer;
+  Costmap2D costmap(200, 200, 0.1, 0.0, 0.0);
+  volatile bool done = false;
+  unsigned int torn[2] = {0, 0};
+  boost::thread reader1(readSnapshots, &buffer, &done, &torn[0]);
+  boost::thread reader2(readSnapshots, &buffer, &done, &torn[1]);
+  for (unsigned int n = 0; n < 2000; ++n)
+  {
+    memset(costmap.getCharMap(), n % 250, 200 * 200);
+    buffer.publish(costmap);
+  }
+  done = true;
+  reader1.join();
+  reader2.join();
+  EXPECT_EQ(0, torn[0]);
+  EXPECT_EQ(0, torn[1]);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
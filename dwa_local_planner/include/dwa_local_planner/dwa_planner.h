@@ -144,6 +144,11 @@ namespace dwa_local_planner {
        */
       bool setPlan(const std::vector<geometry_msgs::PoseStamped>& orig_global_plan);
 
+      /**
+       * @brief Score trajectories on the costmap the LocalPlannerUtil was switched to with setCostmap()
+       */
+      void updateCostmap();
+
     private:
 
       base_local_planner::LocalPlannerUtil *planner_util_;
@@ -114,6 +114,13 @@ namespace dwa_local_planner {
        */
       bool isGoalReached();
 
+      /**
+       * @brief  Whether computeVelocityCommands() scores on snapshots of the costmap,
+       *         which it does when the costmap publishes them
+       */
+      bool usesCostmapSnapshots() {
+        return initialized_ && costmap_ros_->usesSnapshots();
+      }
 
 
       bool isInitialized() {
@@ -140,6 +147,11 @@ namespace dwa_local_planner {
       boost::shared_ptr<DWAPlanner> dp_; ///< @brief The trajectory controller
 
       costmap_2d::Costmap2DROS* costmap_ros_;
+      /**
+       * @brief The snapshot scored on when ~publish_snapshots is enabled. Nothing writes to it,
+       *        since it is shared with other readers.
+       */
+      boost::shared_ptr<const costmap_2d::Costmap2D> snapshot_;
 
       dynamic_reconfigure::Server<DWAPlannerConfig> *dsrv_;
       dwa_local_planner::DWAPlannerConfig default_config_;
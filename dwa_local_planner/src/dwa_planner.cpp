@@ -205,6 +205,15 @@ namespace dwa_local_planner {
     return planner_util_->setPlan(orig_global_plan);
   }
 
+  void DWAPlanner::updateCostmap() {
+    const costmap_2d::Costmap2D* costmap = planner_util_->getCostmap();
+    obstacle_costs_.setCostmap(costmap);
+    path_costs_.setCostmap(costmap);
+    goal_costs_.setCostmap(costmap);
+    goal_front_costs_.setCostmap(costmap);
+    alignment_costs_.setCostmap(costmap);
+  }
+
   /**
    * This function is used when other strategies are to be applied,
    * but the cost functions for obstacles are to be reused.
@@ -109,6 +109,17 @@ namespace dwa_local_planner {
 
       // make sure to update the costmap we'll use for this cycle
       costmap_2d::Costmap2D* costmap = costmap_ros_->getCostmap();
+      if (costmap_ros_->usesSnapshots()) {
+        // score trajectories on the latest snapshot, picked up every cycle. Until the first one is
+        // published, score them on a copy of the live costmap that nobody else reads.
+        boost::shared_ptr<costmap_2d::Costmap2D> copy;
+        {
+          boost::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(*(costmap->getMutex()));
+          copy.reset(new costmap_2d::Costmap2D(*costmap));
+        }
+        snapshot_ = copy;
+        costmap = copy.get();
+      }
 
       planner_util_.initialize(tf, costmap, costmap_ros_->getGlobalFrameID());
 
@@ -262,6 +273,15 @@ namespace dwa_local_planner {
 
 
   bool DWAPlannerROS::computeVelocityCommands(geometry_msgs::Twist& cmd_vel) {
+    if (costmap_ros_->usesSnapshots()) {
+      boost::shared_ptr<const costmap_2d::Costmap2D> snapshot = costmap_ros_->getSnapshot();
+      if (snapshot && snapshot != snapshot_) {
+        snapshot_ = snapshot;
+        planner_util_.setCostmap(snapshot.get());
+        dp_->updateCostmap();
+      }
+    }
+
     // dispatches to either dwa sampling control or stop and rotate control, depending on whether we have been close enough to goal
     if ( ! costmap_ros_->getRobotPose(current_pose_)) {
       ROS_ERROR("Could not get robot pose");
@@ -57,8 +57,8 @@ class DijkstraExpansion : public Expander {
     public:
         DijkstraExpansion(PotentialCalculator* p_calc, int nx, int ny);
         ~DijkstraExpansion();
-        bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y, int cycles,
-                                float* potential);
+        bool calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+                                int cycles, float* potential);
 
         /**
          * @brief  Sets or resets the size of the map
@@ -81,18 +81,7 @@ class DijkstraExpansion : public Expander {
          * @param potential The potential array in which we are calculating
          * @param n The index to update
          */
-        void updateCell(unsigned char* costs, float* potential, int n); /** updates the cell at index n */
-
-        float getCost(unsigned char* costs, int n) {
-            float c = costs[n];
-            if (c < lethal_cost_ - 1 || (unknown_ && c==255)) {
-                c = c * factor_ + neutral_cost_;
-                if (c >= lethal_cost_)
-                    c = lethal_cost_ - 1;
-                return c;
-            }
-            return lethal_cost_;
-        }
+        void updateCell(const unsigned char* costs, float* potential, int n); /** updates the cell at index n */
 
         /** block priority buffers */
         int *buffer1_, *buffer2_, *buffer3_; /**< storage buffers for priority blocks */
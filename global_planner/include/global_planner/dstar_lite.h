@@ -0,0 +1,141 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef _DSTAR_LITE_H
+#define _DSTAR_LITE_H
+
+#include <global_planner/planner_core.h>
+#include <global_planner/expander.h>
+#include <vector>
+#include <algorithm>
+
+namespace global_planner {
+
+/**
+ * @class DStarLiteExpansion
+ * @brief D* Lite over the 8-connected grid, which repairs its search from one plan to the next as long as the goal
+ *        stays the same.
+ *
+ * The search runs from the goal towards the start, with the same step costs
+ * as JumpPointExpansion, and is kept between plans. For a new goal, new cost
+ * settings or a new map size it starts over. Otherwise only the cells passed
+ * to invalidate() are compared against the costs the search last saw, and
+ * only the part of the search that depends on the ones that changed, or on
+ * where the start moved, is done again. The costs given to
+ * calculatePotentials() must not change anywhere else between plans.
+ *
+ * Costs are kept as whole sixteenths of a cost unit, so that cells whose
+ * keys tie on paper also tie in the search, which D* Lite relies on to
+ * expand each cell at most twice per plan.
+ *
+ * Only the cells of the resulting path get a finite potential, increasing
+ * from the start, which is all GridPath and GradientPath need to trace it
+ * back. The potential array is expected to be the same from one plan to the
+ * next, so that only the cells written the last time need to be reset.
+ */
+class DStarLiteExpansion : public Expander {
+    public:
+        DStarLiteExpansion(PotentialCalculator* p_calc, int nx, int ny);
+        bool calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+                                int cycles, float* potential);
+        void setSize(int nx, int ny);
+        bool writesPathOnly() {
+            return true;
+        }
+        void invalidate(int x0, int y0, int xn, int yn);
+        void invalidateAll();
+        void clearEndpoint(const unsigned char* costs, float* potential, int gx, int gy, int s);
+
+    private:
+        static const int COST_INFINITE = 0x3fffffff;  ///< @brief Cost of what cannot be reached, with room to add a step
+
+        struct Key {
+            Key(int i, long long k1, int k2) :
+                    i(i), k1(k1), k2(k2) {
+            }
+            int i;
+            long long k1;
+            int k2;
+        };
+
+        struct greaterKey {
+            bool operator()(const Key& a, const Key& b) const {
+                return a.k1 > b.k1 || (a.k1 == b.k1 && a.k2 > b.k2);
+            }
+        };
+
+        struct Cells {
+            int x0, y0, xn, yn;
+        };
+
+        /** @brief Cost of the step from cell i to its neighbour at (dx, dy), COST_INFINITE if it cannot be taken */
+        int stepCost(int i, int dx, int dy);
+        int heuristic(int i);
+        Key calculateKey(int i);
+        void push(int i);
+
+        void reset(const unsigned char* costs);
+        /** @brief Compare the costs of the invalidated cells to the ones the search saw, and update the ones that changed */
+        void updateCosts(const unsigned char* costs);
+        void updateVertex(int i);
+        /** @brief updateVertex() on every cell that can step into cell i */
+        void updatePredecessors(int i);
+        /** @brief updatePredecessors() for when g(i) went down */
+        void lowerPredecessors(int i);
+        bool computeShortestPath(int cycles);
+        bool writePath(float* potential);
+
+        std::vector<unsigned char> costs_;  ///< @brief The costs the search state is for
+        std::vector<int> g_, rhs_;
+        std::vector<unsigned int> key_;  ///< @brief Low bits of the first part of the key a cell was last queued with
+        std::vector<bool> open_;
+        std::vector<Key> queue_;
+        std::vector<int> changed_;
+
+        bool searched_, all_changed_;
+        std::vector<Cells> changed_cells_;
+        unsigned char searched_lethal_, searched_neutral_;
+        float searched_factor_;
+        bool searched_unknown_;
+
+        int start_i_, start_x_, start_y_, goal_i_;
+        long long km_;
+        int straight_, diagonal_;  ///< @brief The cheapest steps
+
+        float* last_potential_;
+        std::vector<int> written_;  ///< @brief Cells of last_potential_ that were given a potential
+};
+
+} //end namespace global_planner
+#endif
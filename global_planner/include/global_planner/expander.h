@@ -37,6 +37,7 @@
  *********************************************************************/
 #ifndef _EXPANDER_H
 #define _EXPANDER_H
+#include <cmath>
 #include <global_planner/potential_calculator.h>
 #include <global_planner/planner_core.h>
 
@@ -48,7 +49,9 @@ class Expander {
                 unknown_(true), lethal_cost_(253), neutral_cost_(50), factor_(3.0), p_calc_(p_calc) {
             setSize(nx, ny);
         }
-        virtual bool calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+        virtual ~Expander() {
+        }
+        virtual bool calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
                                         int cycles, float* potential) = 0;
 
         /**
@@ -74,7 +77,24 @@ class Expander {
             unknown_ = unknown;
         }
 
-        void clearEndpoint(unsigned char* costs, float* potential, int gx, int gy, int s){
+        /**
+         * @brief  Whether only the cells of the path found get a finite potential, rather than every cell searched
+         */
+        virtual bool writesPathOnly() {
+            return false;
+        }
+
+        /**
+         * @brief  Tell an expander that keeps state between plans that the costs of some cells may have changed, the
+         *         ones from column x0 and row y0 to column xn and row yn
+         */
+        virtual void invalidate(int /* x0 */, int /* y0 */, int /* xn */, int /* yn */) {
+        }
+        /** @brief  Tell an expander that keeps state between plans that the costs of any cell may have changed */
+        virtual void invalidateAll() {
+        }
+
+        virtual void clearEndpoint(const unsigned char* costs, float* potential, int gx, int gy, int s){
             int startCell = toIndex(gx, gy);
             for(int i=-s;i<=s;i++){
             for(int j=-s;j<=s;j++){
@@ -93,6 +113,36 @@ class Expander {
             return x + nx_ * y;
         }
 
+        /**
+         * @brief  Cost of moving into cell n, lethal_cost_ if it cannot be entered
+         */
+        inline float getCost(const unsigned char* costs, int n) {
+            float c = costs[n];
+            if (c < lethal_cost_ - 1 || (unknown_ && c == 255)) {
+                c = c * factor_ + neutral_cost_;
+                if (c >= lethal_cost_)
+                    c = lethal_cost_ - 1;
+                return c;
+            }
+            return lethal_cost_;
+        }
+
+        /**
+         * @brief  Cost of the step from cell i to its neighbour at (dx, dy) on the 8-connected grid, POT_HIGH if the
+         *         neighbour cannot be entered or a diagonal step would cut the corner of a cell that cannot be
+         */
+        inline float stepCost(const unsigned char* costs, int i, int dx, int dy) {
+            float c = getCost(costs, i + dx + dy * nx_);
+            if (c >= lethal_cost_)
+                return POT_HIGH;
+            if (dx != 0 && dy != 0) {
+                if (getCost(costs, i + dx) >= lethal_cost_ || getCost(costs, i + dy * nx_) >= lethal_cost_)
+                    return POT_HIGH;
+                return c * M_SQRT2;
+            }
+            return c;
+        }
+
         int nx_, ny_, ns_; /**< size of grid, in pixels */
         bool unknown_;
         unsigned char lethal_cost_, neutral_cost_;
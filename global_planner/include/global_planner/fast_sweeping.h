@@ -0,0 +1,105 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef _FAST_SWEEPING_H
+#define _FAST_SWEEPING_H
+
+#include <global_planner/planner_core.h>
+#include <global_planner/expander.h>
+#include <costmap_2d/thread_pool.h>
+#include <vector>
+
+namespace global_planner {
+
+/**
+ * @class FastSweepingExpansion
+ * @brief Finds the potential of the whole map with the same update as DijkstraExpansion, sweeping square tiles of
+ *        the map on several threads.
+ *
+ * Instead of following a wavefront, each tile is swept row by row in all
+ * four diagonal directions, updating every cell from its neighbours with the
+ * PotentialCalculator, until none of its cells gets any lower. A tile is
+ * swept again whenever a cell along the border it shares with a neighbour
+ * got lower. The tiles are coloured like a checkerboard and all the tiles of
+ * one colour that need sweeping are swept at the same time, so no two
+ * threads ever touch the same cells or the border cells the other one reads.
+ *
+ * The result is the fixed point of the update, which the wavefront of
+ * DijkstraExpansion stops short of in places, so many potentials come out
+ * lower, by up to about 12% far from the start. A few come out higher, by
+ * about one unit of cost at most, where the order of the updates
+ * picks a different pair of neighbours. test/fast_sweeping_test.cpp checks
+ * both against DijkstraExpansion. Unlike DijkstraExpansion, the whole map
+ * gets a potential, which is what the make_plan service and
+ * publish_potential need; the cells of the outer border are never updated.
+ *
+ * On one thread it is slower: filling a 2000x2000 map takes about twice as
+ * long as DijkstraExpansion run over the whole map, and on the maps of
+ * expander_benchmark four to six times as long as DijkstraExpansion
+ * stopping at the goal (119 ms against 18 ms on the building map). It only
+ * pays off with several cores, or when the whole map is needed anyway.
+ */
+class FastSweepingExpansion : public Expander {
+    public:
+        /**
+         * @param num_threads The number of threads sweeping tiles, including the one planning
+         * @param tile_size The width and height of the tiles in cells
+         */
+        FastSweepingExpansion(PotentialCalculator* p_calc, int nx, int ny, unsigned int num_threads, int tile_size);
+        bool calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+                                int cycles, float* potential);
+        void setSize(int nx, int ny);
+
+        void setPreciseStart(bool precise){ precise_ = precise; }
+
+    private:
+        /** @brief Marks the tile holding cell n to be swept */
+        void activate(int n);
+        /** @brief Sweeps the i-th tile of the current colour until it stops changing */
+        void sweepTile(unsigned int i);
+        /** @brief One sweep over a tile, returns whether any cell got lower */
+        bool sweep(int tile, int x0, int y0, int xn, int yn, int dx, int dy);
+
+        costmap_2d::ThreadPool pool_;
+        int tile_size_, tiles_x_, tiles_y_;
+        std::vector<bool> active_;
+        std::vector<int> sweeping_;  ///< @brief Tiles swept at the same time
+        std::vector<unsigned char> changed_borders_;  ///< @brief Per tile, the borders on which a cell got lower
+        const unsigned char* costs_;
+        float* potential_;
+        bool precise_;
+};
+
+} //end namespace global_planner
+#endif
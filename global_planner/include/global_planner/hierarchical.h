@@ -0,0 +1,172 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef _HIERARCHICAL_H
+#define _HIERARCHICAL_H
+
+#include <global_planner/planner_core.h>
+#include <global_planner/expander.h>
+#include <global_planner/astar.h>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace global_planner {
+
+/**
+ * @class HierarchicalExpansion
+ * @brief A* on a graph of entrances between square clusters of the map, refined on the cells of the clusters it
+ *        crosses.
+ *
+ * The map is split into clusters of cluster_size x cluster_size cells. Where
+ * two neighbouring clusters share a run of free cells along their border, one
+ * or two entrances are placed on it, and the cost of crossing a cluster from
+ * one entrance to another is the cost of the cheapest path that stays inside
+ * it. Entrances and crossing costs are found for the whole map by the first
+ * plan and cached, and later plans only find them again for the clusters
+ * that invalidate() was called for. The search of the abstract graph picks
+ * the clusters the path goes through, then A* over the cells of just those
+ * clusters gives the path itself, with the same step costs as
+ * JumpPointExpansion. If the graph has no path, all of the cells are
+ * searched before giving up. The cycles given to calculatePotentials() limit
+ * the cells expanded by these searches of the cells, all of them together;
+ * the search of the graph is not limited.
+ *
+ * The paths are not always the cheapest ones: they have to go through the
+ * entrances picked on the borders and stay inside the clusters the graph
+ * search picked. On random 60x50 maps with clusters of 16 cells
+ * (test/hierarchical_test.cpp), about one plan in twenty comes out costlier
+ * than the cheapest 8-connected path, mostly by less than 15% but by up to
+ * two thirds for a few.
+ *
+ * The costs of the map must not change between plans other than where
+ * invalidate() says, and the cached costs are dropped whenever the cost
+ * settings change.
+ *
+ * Only the cells of the resulting path get a finite potential, decreasing
+ * towards the start, which is all GridPath and GradientPath need to trace it
+ * back.
+ */
+class HierarchicalExpansion : public Expander {
+    public:
+        HierarchicalExpansion(PotentialCalculator* p_calc, int nx, int ny, int cluster_size);
+        bool calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+                                int cycles, float* potential);
+        void setSize(int nx, int ny);
+        bool writesPathOnly() {
+            return true;
+        }
+
+        /** @brief Forget what is cached about the clusters holding any of the cells from (x0, y0) to (xn, yn) */
+        void invalidate(int x0, int y0, int xn, int yn);
+        void invalidateAll();
+
+    private:
+        typedef std::vector<std::pair<int, int> > Border;  ///< @brief Entrances as pairs of cells facing each other
+
+        struct Cluster {
+            int x0, y0, xn, yn;  ///< @brief Cells covered, the last ones excluded
+            bool valid;
+            std::vector<int> nodes;  ///< @brief Cells of the entrances into the cluster, sorted
+            std::vector<float> edges;  ///< @brief Cost from each node to every other one, by rows
+            unsigned int search;  ///< @brief Last search the state below belongs to
+            std::vector<float> g;
+            std::vector<int> parent;
+            std::vector<bool> closed;
+        };
+
+        inline int clusterOf(int i) {
+            return (i / nx_) / cluster_size_ * cnx_ + (i % nx_) / cluster_size_;
+        }
+
+        float heuristic(int i);
+
+        void updateBorders(const unsigned char* costs);
+        /** @brief Entrances between the cells first + k * along and the ones across from them, for k up to length */
+        void findEntrances(const unsigned char* costs, int first, int across, int along, int length, Border& border);
+        /** @brief Find the nodes and edges of every cluster that is not valid */
+        void updateClusters(const unsigned char* costs);
+        /** @brief Set up the state of cluster c for the current search */
+        Cluster& touch(int c);
+        void loadCosts(const unsigned char* costs, const Cluster& cluster);
+        void markNodes(const Cluster& cluster, bool mark);
+        /**
+         * @brief Dijkstra from cell i inside the cluster whose costs were loaded last, towards i when reverse is set,
+         *        into local_g_. Stops once the given number of marked cells have their cost.
+         */
+        void searchCluster(const Cluster& cluster, int i, bool reverse, int targets);
+        void relax(int c, int node, float g, int parent);
+        void crossBorder(const unsigned char* costs, const Border& border, bool from_second, int cell, int other, float g,
+                         int code);
+
+        bool searchGraph(const unsigned char* costs, int start_i, int goal_i);
+        /**
+         * @brief A* over the cells of the clusters in corridor_, writing the potential along the path it finds. Every
+         *        cell expanded is taken off cycles, and the search gives up when none are left.
+         */
+        bool refine(const unsigned char* costs, float* potential, int start_i, int goal_i, int& cycles);
+        inline int local(const Cluster& cluster, int i) {
+            return i % nx_ - cluster.x0 + (i / nx_ - cluster.y0) * cluster_size_;
+        }
+        inline int slotIndex(int i) {
+            int c = clusterOf(i);
+            return slot_[c] * cluster_size_ * cluster_size_ + local(clusters_[c], i);
+        }
+
+        int cluster_size_, cnx_, cny_, stride_;
+        std::vector<Cluster> clusters_;
+        std::vector<Border> vborders_, hborders_;  ///< @brief Entrances to the cluster on the right and above
+        std::vector<bool> vborder_valid_, hborder_valid_;
+        unsigned char cached_lethal_, cached_neutral_;
+        float cached_factor_;
+        bool cached_unknown_;
+
+        std::vector<float> local_cost_, local_g_;
+        std::vector<bool> local_target_;
+        std::vector<Index> local_queue_;
+
+        unsigned int search_;
+        std::vector<Index> queue_;
+        std::vector<float> to_goal_;
+        std::vector<int> corridor_;
+
+        std::vector<int> slot_;  ///< @brief Where the cells of each cluster of the corridor are kept, or -1
+        std::vector<float> cell_g_;
+        std::vector<int> cell_parent_;
+        std::vector<bool> cell_closed_;
+        int goal_x_, goal_y_;
+};
+
+} //end namespace global_planner
+#endif
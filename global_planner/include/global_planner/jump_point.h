@@ -0,0 +1,124 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef _JUMP_POINT_H
+#define _JUMP_POINT_H
+
+#include <global_planner/planner_core.h>
+#include <global_planner/expander.h>
+#include <global_planner/astar.h>
+#include <vector>
+#include <algorithm>
+
+namespace global_planner {
+
+/**
+ * @class JumpPointExpansion
+ * @brief A* over the 8-connected grid that jumps across patches of uniform cost.
+ *
+ * Moving into a cell costs the same as in DijkstraExpansion, scaled by the
+ * length of the step. Where the 3x3 block around a cell all has the same
+ * cost, the usual jump point search pruning applies and straight and
+ * diagonal scans skip over the patch, stopping at the first cell whose
+ * neighbourhood is not uniform. Where a scan crosses the trail of a cheaper
+ * one, the crossing cell becomes a jump point of its own instead of covering
+ * the same ground again. Every other cell is expanded to all of its
+ * neighbours, so inflated areas are searched like plain A* and the path is
+ * optimal for the step costs.
+ *
+ * Only the cells of the resulting path get a finite potential, decreasing
+ * towards the start, which is all GridPath and GradientPath need to trace it
+ * back, and GradientPath has to be told so with Traceback::setPathOnly().
+ *
+ * The state of the search is only reset for the cells a plan touches, and the
+ * distance to the goal is weighed by the cheapest cost on the map. This pays
+ * off on large open maps: on a 3000x3000 site with scattered obstacles
+ * (test/expander_benchmark.cpp) a plan takes about half the time of
+ * DijkstraExpansion. Where most of the map is inflated or the scans fan out
+ * over rooms, as on navfn/test/willow_costmap.pgm or the synthetic building,
+ * it is two to three times slower than DijkstraExpansion, whose bucketed
+ * queue is cheaper than the binary heap used here.
+ */
+class JumpPointExpansion : public Expander {
+    public:
+        JumpPointExpansion(PotentialCalculator* p_calc, int nx, int ny);
+        bool calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+                                int cycles, float* potential);
+        void setSize(int nx, int ny);
+        bool writesPathOnly() {
+            return true;
+        }
+
+    private:
+        static const unsigned char ALL_DIRECTIONS = 0xff;  ///< @brief Scan directions of a cell expanded in all of them
+
+        /** @brief Whether the cell and all eight of its neighbours have cost c */
+        bool isUniform(const unsigned char* costs, int x, int y, unsigned char c);
+        /** @brief Whether the cell one step beyond a uniform cell along (dx, dy) is uniform as well */
+        bool staysUniform(const unsigned char* costs, int x, int y, int dx, int dy, unsigned char c);
+
+        void expandAll(const unsigned char* costs, int i);
+        void jumpStraight(const unsigned char* costs, int i, int x, int y, int dx, int dy, float g, float w);
+        void jumpDiagonal(const unsigned char* costs, int i, int dx, int dy);
+        /** @brief Whether what the scan from i would find past cell n is already covered by another */
+        bool scanned(int i, int n, int dx, int dy, float g);
+        void add(int parent, int next_i, float g);
+        void writePath(const unsigned char* costs, float* potential, int start_i);
+
+        /** @brief Reset the state of a cell the first time the current plan touches it */
+        inline void touch(int n) {
+            if (plan_of_[n] != plan_) {
+                plan_of_[n] = plan_;
+                closed_[n] = false;
+                g_[n] = POT_HIGH;
+                scan_potential_[n] = POT_HIGH;
+                scan_directions_[n] = 0;
+            }
+        }
+
+        std::vector<Index> queue_;
+        std::vector<int> parent_;
+        std::vector<float> g_;
+        std::vector<bool> closed_;
+        std::vector<float> scan_potential_;
+        std::vector<unsigned char> scan_directions_;
+        std::vector<int> scan_parent_;
+        std::vector<unsigned int> plan_of_;
+        unsigned int plan_;
+        float min_step_;
+        int goal_i_, goal_x_, goal_y_;
+};
+
+} //end namespace global_planner
+#endif
@@ -40,6 +40,7 @@
 #define POT_HIGH 1.0e10        // unassigned cell potential
 #include <ros/ros.h>
 #include <costmap_2d/costmap_2d.h>
+#include <costmap_2d/dirty_region.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <geometry_msgs/Point.h>
 #include <nav_msgs/Path.h>
@@ -92,6 +93,14 @@ class GlobalPlanner : public nav_core::BaseGlobalPlanner {
 
         void initialize(std::string name, costmap_2d::Costmap2D* costmap, std::string frame_id);
 
+        /**
+         * @brief  Whether makePlan() plans on snapshots of the costmap, which it does when the
+         *         costmap passed to initialize() publishes them
+         */
+        bool usesCostmapSnapshots() {
+            return costmap_ros_ != NULL;
+        }
+
         /**
          * @brief Given a goal pose in the world, compute a plan
          * @param start The start pose
@@ -168,7 +177,7 @@ class GlobalPlanner : public nav_core::BaseGlobalPlanner {
         /**
          * @brief Store a copy of the current costmap in \a costmap.  Called by makePlan.
          */
-        costmap_2d::Costmap2D* costmap_;
+        const costmap_2d::Costmap2D* costmap_;
         std::string frame_id_;
         ros::Publisher plan_pub_;
         bool initialized_, allow_unknown_;
@@ -178,13 +187,31 @@ class GlobalPlanner : public nav_core::BaseGlobalPlanner {
         bool worldToMap(double wx, double wy, double& mx, double& my);
         void clearRobotCell(const geometry_msgs::PoseStamped& global_pose, unsigned int mx, unsigned int my);
         void publishPotential(float* potential);
+        /**
+         * @brief  Tell an expander that keeps its search between plans which parts of the costmap changed since the last plan
+         * @param  start_x The start cell, which clearRobotCell changed
+         * @param  start_y
+         */
+        void invalidateChangedCells(unsigned int start_x, unsigned int start_y);
 
         double planner_window_x_, planner_window_y_, default_tolerance_;
         boost::mutex mutex_;
         ros::ServiceServer make_plan_srv_;
 
+        costmap_2d::Costmap2DROS* costmap_ros_;  ///< @brief Only set when planning on snapshots of the costmap
+        boost::shared_ptr<const costmap_2d::Costmap2D> snapshot_;  ///< @brief The snapshot costmap_ points to when planning on snapshots
+        /**
+         * @brief The costmap costmap_ points to when not planning on snapshots, in which clearRobotCell and outlineMap
+         *        write. Not set when planning on snapshots, since those are shared with other readers.
+         */
+        costmap_2d::Costmap2D* live_costmap_;
+
         PotentialCalculator* p_calc_;
         Expander* planner_;
+        bool incremental_;  ///< @brief Whether planner_ keeps its search between plans
+        boost::shared_ptr<costmap_2d::DirtyRegion> updated_cells_;  ///< @brief Cells the costmap updated since the last plan
+        costmap_2d::DirtyRegion previous_updated_cells_;
+        unsigned int last_start_x_, last_start_y_;
         Traceback* path_maker_;
         OrientationFilter* orientation_filter_;
 
@@ -194,7 +221,8 @@ class GlobalPlanner : public nav_core::BaseGlobalPlanner {
 
         void outlineMap(unsigned char* costarr, int nx, int ny, unsigned char value);
         unsigned char* cost_array_;
-        float* potential_array_;
+        float* potential_array_;  ///< @brief Kept from one plan to the next, expanders may only write part of it
+        int potential_size_;
         unsigned int start_x_, start_y_, end_x_, end_y_;
 
         bool old_navfn_behavior_;
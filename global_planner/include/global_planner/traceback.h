@@ -44,7 +44,7 @@ namespace global_planner {
 
 class Traceback {
     public:
-        Traceback(PotentialCalculator* p_calc) : p_calc_(p_calc) {}
+        Traceback(PotentialCalculator* p_calc) : path_only_(false), p_calc_(p_calc) {}
 
         virtual bool getPath(float* potential, double start_x, double start_y, double end_x, double end_y, std::vector<std::pair<float, float> >& path) = 0;
         virtual void setSize(int xs, int ys) {
@@ -57,9 +57,16 @@ class Traceback {
         void setLethalCost(unsigned char lethal_cost) {
             lethal_cost_ = lethal_cost;
         }
+        /**
+         * @brief  Tell the traceback whether only the cells of a path have a potential, see Expander::writesPathOnly()
+         */
+        void setPathOnly(bool path_only) {
+            path_only_ = path_only;
+        }
     protected:
         int xs_, ys_;
         unsigned char lethal_cost_;
+        bool path_only_;
         PotentialCalculator* p_calc_;
 };
 
@@ -44,7 +44,7 @@ AStarExpansion::AStarExpansion(PotentialCalculator* p_calc, int xs, int ys) :
         Expander(p_calc, xs, ys) {
 }
 
-bool AStarExpansion::calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+bool AStarExpansion::calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
                                         int cycles, float* potential) {
     queue_.clear();
     int start_i = toIndex(start_x, start_y);
@@ -76,7 +76,7 @@ bool AStarExpansion::calculatePotentials(unsigned char* costs, double start_x, d
     return false;
 }
 
-void AStarExpansion::add(unsigned char* costs, float* potential, float prev_potential, int next_i, int end_x,
+void AStarExpansion::add(const unsigned char* costs, float* potential, float prev_potential, int next_i, int end_x,
                          int end_y) {
     if (next_i < 0 || next_i >= ns_)
         return;
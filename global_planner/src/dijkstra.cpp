@@ -77,7 +77,7 @@ void DijkstraExpansion::setSize(int xs, int ys) {
 //   or until the Start cell is found (atStart = true)
 //
 
-bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
+bool DijkstraExpansion::calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x, double end_y,
                                            int cycles, float* potential) {
     cells_visited_ = 0;
     // priority buffers
@@ -189,7 +189,7 @@ bool DijkstraExpansion::calculatePotentials(unsigned char* costs, double start_x
 
 #define INVSQRT2 0.707106781
 
-inline void DijkstraExpansion::updateCell(unsigned char* costs, float* potential, int n) {
+inline void DijkstraExpansion::updateCell(const unsigned char* costs, float* potential, int n) {
     cells_visited_++;
 
     // do planar wave update
@@ -0,0 +1,331 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <global_planner/dstar_lite.h>
+#include <cmath>
+#include <cstdlib>
+
+namespace global_planner {
+
+const int DStarLiteExpansion::COST_INFINITE;
+
+DStarLiteExpansion::DStarLiteExpansion(PotentialCalculator* p_calc, int xs, int ys) :
+        Expander(p_calc, xs, ys), searched_(false), all_changed_(false), last_potential_(NULL) {
+    straight_ = neutral_cost_ * 16;
+    diagonal_ = neutral_cost_ * 16 * M_SQRT2;
+    setSize(xs, ys);
+}
+
+void DStarLiteExpansion::setSize(int xs, int ys) {
+    // called before every plan, only a new size throws the search away
+    if (xs == nx_ && ys == ny_ && (int) g_.size() == xs * ys)
+        return;
+    Expander::setSize(xs, ys);
+    costs_.resize(ns_);
+    g_.resize(ns_);
+    rhs_.resize(ns_);
+    key_.resize(ns_);
+    open_.resize(ns_);
+    searched_ = false;
+    last_potential_ = NULL;
+}
+
+void DStarLiteExpansion::invalidate(int x0, int y0, int xn, int yn) {
+    Cells cells;
+    cells.x0 = std::max(x0, 0);
+    cells.y0 = std::max(y0, 0);
+    cells.xn = std::min(xn, nx_ - 1);
+    cells.yn = std::min(yn, ny_ - 1);
+    if (cells.xn >= cells.x0 && cells.yn >= cells.y0)
+        changed_cells_.push_back(cells);
+}
+
+void DStarLiteExpansion::invalidateAll() {
+    all_changed_ = true;
+}
+
+bool DStarLiteExpansion::calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x,
+                                             double end_y, int cycles, float* potential) {
+    int start_i = toIndex(start_x, start_y);
+    int goal_i = toIndex(end_x, end_y);
+
+    if (!searched_ || goal_i != goal_i_ || lethal_cost_ != searched_lethal_ || neutral_cost_ != searched_neutral_ ||
+            factor_ != searched_factor_ || unknown_ != searched_unknown_) {
+        goal_i_ = goal_i;
+        start_i_ = start_i;
+        start_x_ = start_i % nx_;
+        start_y_ = start_i / nx_;
+        reset(costs);
+    } else {
+        // keys already queued were found with the heuristic to the old start, which is at most this far off
+        km_ += heuristic(start_i);
+        start_i_ = start_i;
+        start_x_ = start_i % nx_;
+        start_y_ = start_i / nx_;
+        updateCosts(costs);
+    }
+    changed_cells_.clear();
+    all_changed_ = false;
+
+    bool found = computeShortestPath(cycles);
+    return writePath(potential) && found;
+}
+
+void DStarLiteExpansion::clearEndpoint(const unsigned char* costs, float* potential, int gx, int gy, int s) {
+    Expander::clearEndpoint(costs, potential, gx, gy, s);
+    // so that they are reset with the path next time
+    for (int j = -s; j <= s; j++) {
+        for (int i = -s; i <= s; i++) {
+            int n = toIndex(gx + i, gy + j);
+            if (n >= 0 && n < ns_)
+                written_.push_back(n);
+        }
+    }
+}
+
+int DStarLiteExpansion::stepCost(int i, int dx, int dy) {
+    float c = Expander::stepCost(&costs_[0], i, dx, dy);
+    if (c >= POT_HIGH)
+        return COST_INFINITE;
+    return c * 16 + 0.5;
+}
+
+int DStarLiteExpansion::heuristic(int i) {
+    // octile distance to the start, no step is cheaper than through a free cell
+    int dx = abs(i % nx_ - start_x_), dy = abs(i / nx_ - start_y_);
+    return (std::max(dx, dy) - std::min(dx, dy)) * straight_ + std::min(dx, dy) * diagonal_;
+}
+
+DStarLiteExpansion::Key DStarLiteExpansion::calculateKey(int i) {
+    int m = std::min(g_[i], rhs_[i]);
+    return Key(i, (long long) m + heuristic(i) + km_, m);
+}
+
+void DStarLiteExpansion::push(int i) {
+    Key key = calculateKey(i);
+    open_[i] = true;
+    key_[i] = key.k1;
+    queue_.push_back(key);
+    std::push_heap(queue_.begin(), queue_.end(), greaterKey());
+}
+
+void DStarLiteExpansion::reset(const unsigned char* costs) {
+    std::copy(costs, costs + ns_, costs_.begin());
+    std::fill(g_.begin(), g_.end(), COST_INFINITE);
+    std::fill(rhs_.begin(), rhs_.end(), COST_INFINITE);
+    std::fill(open_.begin(), open_.end(), false);
+    queue_.clear();
+    km_ = 0;
+    straight_ = neutral_cost_ * 16;
+    diagonal_ = neutral_cost_ * 16 * M_SQRT2;
+    searched_lethal_ = lethal_cost_;
+    searched_neutral_ = neutral_cost_;
+    searched_factor_ = factor_;
+    searched_unknown_ = unknown_;
+    searched_ = true;
+
+    rhs_[goal_i_] = 0;
+    push(goal_i_);
+}
+
+void DStarLiteExpansion::updateCosts(const unsigned char* costs) {
+    changed_.clear();
+    if (all_changed_) {
+        for (int i = 0; i < ns_; i++) {
+            if (costs[i] != costs_[i]) {
+                costs_[i] = costs[i];
+                changed_.push_back(i);
+            }
+        }
+    } else {
+        for (unsigned int k = 0; k < changed_cells_.size(); k++) {
+            const Cells& cells = changed_cells_[k];
+            for (int y = cells.y0; y <= cells.yn; y++) {
+                for (int i = toIndex(cells.x0, y); i <= toIndex(cells.xn, y); i++) {
+                    if (costs[i] != costs_[i]) {
+                        costs_[i] = costs[i];
+                        changed_.push_back(i);
+                    }
+                }
+            }
+        }
+    }
+
+    // the cost of a cell is in the steps into it and the diagonal steps past it, which all start next to it
+    for (unsigned int k = 0; k < changed_.size(); k++)
+        updatePredecessors(changed_[k]);
+}
+
+void DStarLiteExpansion::updateVertex(int i) {
+    if (i != goal_i_) {
+        int x = i % nx_, y = i / nx_;
+        int rhs = COST_INFINITE;
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= nx_ || y + dy < 0 || y + dy >= ny_)
+                    continue;
+                int g = g_[i + dx + dy * nx_];
+                if (g >= COST_INFINITE)
+                    continue;
+                int step = stepCost(i, dx, dy);
+                if (step < COST_INFINITE)
+                    rhs = std::min(rhs, std::min(g + step, COST_INFINITE));
+            }
+        }
+        rhs_[i] = rhs;
+    }
+
+    if (g_[i] != rhs_[i])
+        push(i);
+    else
+        open_[i] = false;
+}
+
+void DStarLiteExpansion::updatePredecessors(int i) {
+    int x = i % nx_, y = i / nx_;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= nx_ || y + dy < 0 || y + dy >= ny_)
+                continue;
+            updateVertex(i + dx + dy * nx_);
+        }
+    }
+}
+
+void DStarLiteExpansion::lowerPredecessors(int i) {
+    // g(i) only went down, so the cheapest way on from a neighbour either goes through i now or is the same as before
+    int x = i % nx_, y = i / nx_;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= nx_ || y + dy < 0 || y + dy >= ny_)
+                continue;
+            int n = i + dx + dy * nx_;
+            if (n == goal_i_)
+                continue;
+            int step = stepCost(n, -dx, -dy);
+            if (step >= COST_INFINITE || g_[i] + step >= rhs_[n])
+                continue;
+            rhs_[n] = g_[i] + step;
+            if (g_[n] != rhs_[n])
+                push(n);
+            else
+                open_[n] = false;
+        }
+    }
+}
+
+bool DStarLiteExpansion::computeShortestPath(int cycles) {
+    int cycle = 0;
+    cells_visited_ = 0;
+    while (queue_.size() > 0 && cycle < cycles) {
+        Key top = queue_[0];
+        Key start_key = calculateKey(start_i_);
+        bool before_start = top.k1 < start_key.k1 || (top.k1 == start_key.k1 && top.k2 < start_key.k2);
+        if (!before_start && rhs_[start_i_] == g_[start_i_])
+            return true;
+
+        std::pop_heap(queue_.begin(), queue_.end(), greaterKey());
+        queue_.pop_back();
+
+        // only the last time a cell was queued counts
+        int i = top.i;
+        if (!open_[i] || (unsigned int) top.k1 != key_[i])
+            continue;
+
+        Key key = calculateKey(i);
+        if (top.k1 < key.k1 || (top.k1 == key.k1 && top.k2 < key.k2)) {
+            push(i);
+            continue;
+        }
+
+        open_[i] = false;
+        cells_visited_++;
+        cycle++;
+        if (g_[i] > rhs_[i]) {
+            g_[i] = rhs_[i];
+            lowerPredecessors(i);
+        } else {
+            g_[i] = COST_INFINITE;
+            updateVertex(i);
+            updatePredecessors(i);
+        }
+    }
+    return rhs_[start_i_] == g_[start_i_];
+}
+
+bool DStarLiteExpansion::writePath(float* potential) {
+    if (potential != last_potential_) {
+        std::fill(potential, potential + ns_, POT_HIGH);
+        last_potential_ = potential;
+    } else {
+        for (unsigned int k = 0; k < written_.size(); k++)
+            potential[written_[k]] = POT_HIGH;
+    }
+    written_.clear();
+
+    if (g_[start_i_] >= COST_INFINITE)
+        return false;
+
+    // downhill from the start, adding up the same step costs as the search
+    int i = start_i_;
+    int potential_i = 0;
+    potential[i] = potential_i;
+    written_.push_back(i);
+    while (i != goal_i_) {
+        int x = i % nx_, y = i / nx_, next = -1;
+        int best = COST_INFINITE, next_step = 0;
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= nx_ || y + dy < 0 || y + dy >= ny_)
+                    continue;
+                int n = i + dx + dy * nx_;
+                int step = stepCost(i, dx, dy);
+                if (g_[n] >= COST_INFINITE || step >= COST_INFINITE || g_[n] + step >= best)
+                    continue;
+                best = g_[n] + step;
+                next = n;
+                next_step = step;
+            }
+        }
+        if (next < 0 || (int) written_.size() > ns_)
+            return false;
+        i = next;
+        potential_i += next_step;
+        potential[i] = potential_i / 16.0;
+        written_.push_back(i);
+    }
+    return true;
+}
+
+} //end namespace global_planner
@@ -0,0 +1,173 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <global_planner/fast_sweeping.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace global_planner {
+
+// borders of a tile
+#define BORDER_LEFT 1
+#define BORDER_RIGHT 2
+#define BORDER_TOP 4
+#define BORDER_BOTTOM 8
+
+FastSweepingExpansion::FastSweepingExpansion(PotentialCalculator* p_calc, int xs, int ys, unsigned int num_threads,
+                                             int tile_size) :
+        Expander(p_calc, xs, ys), pool_(num_threads), tile_size_(std::max(tile_size, 1)), costs_(NULL),
+        potential_(NULL), precise_(false) {
+    setSize(xs, ys);
+}
+
+void FastSweepingExpansion::setSize(int xs, int ys) {
+    Expander::setSize(xs, ys);
+    tiles_x_ = (nx_ + tile_size_ - 1) / tile_size_;
+    tiles_y_ = (ny_ + tile_size_ - 1) / tile_size_;
+    active_.resize(tiles_x_ * tiles_y_);
+    changed_borders_.resize(tiles_x_ * tiles_y_);
+}
+
+bool FastSweepingExpansion::calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x,
+                                                double end_y, int cycles, float* potential) {
+    costs_ = costs;
+    potential_ = potential;
+    cells_visited_ = 0;
+    std::fill(potential, potential + ns_, POT_HIGH);
+    std::fill(active_.begin(), active_.end(), false);
+
+    // the same start as DijkstraExpansion
+    int k = toIndex(start_x, start_y);
+    if (precise_) {
+        double dx = start_x - (int)start_x, dy = start_y - (int)start_y;
+        dx = floorf(dx * 100 + 0.5) / 100;
+        dy = floorf(dy * 100 + 0.5) / 100;
+        potential[k] = neutral_cost_ * 2 * dx * dy;
+        potential[k + 1] = neutral_cost_ * 2 * (1 - dx) * dy;
+        potential[k + nx_] = neutral_cost_ * 2 * dx * (1 - dy);
+        potential[k + nx_ + 1] = neutral_cost_ * 2 * (1 - dx) * (1 - dy);
+        activate(k + 1);
+        activate(k + nx_);
+        activate(k + nx_ + 1);
+    } else {
+        potential[k] = 0;
+    }
+    activate(k);
+
+    for (int round = 0; round < cycles; round++) {
+        bool swept = false;
+        for (int colour = 0; colour < 2; colour++) {
+            sweeping_.clear();
+            for (int t = 0; t < tiles_x_ * tiles_y_; t++) {
+                if (active_[t] && (t % tiles_x_ + t / tiles_x_) % 2 == colour) {
+                    sweeping_.push_back(t);
+                    active_[t] = false;
+                }
+            }
+            if (sweeping_.empty())
+                continue;
+            swept = true;
+            pool_.run(sweeping_.size(), boost::bind(&FastSweepingExpansion::sweepTile, this, _1));
+
+            // the neighbours of a tile have to be swept again where it got lower along their border
+            for (unsigned int i = 0; i < sweeping_.size(); i++) {
+                int t = sweeping_[i], tx = t % tiles_x_, ty = t / tiles_x_;
+                unsigned char borders = changed_borders_[t];
+                if ((borders & BORDER_LEFT) && tx > 0)
+                    active_[t - 1] = true;
+                if ((borders & BORDER_RIGHT) && tx < tiles_x_ - 1)
+                    active_[t + 1] = true;
+                if ((borders & BORDER_TOP) && ty > 0)
+                    active_[t - tiles_x_] = true;
+                if ((borders & BORDER_BOTTOM) && ty < tiles_y_ - 1)
+                    active_[t + tiles_x_] = true;
+                cells_visited_++;
+            }
+        }
+        if (!swept)
+            break;
+    }
+
+    return potential[toIndex(end_x, end_y)] < POT_HIGH;
+}
+
+void FastSweepingExpansion::activate(int n) {
+    if (n >= 0 && n < ns_)
+        active_[(n / nx_) / tile_size_ * tiles_x_ + (n % nx_) / tile_size_] = true;
+}
+
+void FastSweepingExpansion::sweepTile(unsigned int i) {
+    int t = sweeping_[i];
+    int x0 = t % tiles_x_ * tile_size_, y0 = t / tiles_x_ * tile_size_;
+    int xn = std::min(x0 + tile_size_, nx_) - 1, yn = std::min(y0 + tile_size_, ny_) - 1;
+    changed_borders_[t] = 0;
+    // the tile is done once the last four sweeps, one in each direction, left it as it was
+    static const int directions[4][2] = { { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+    for (int d = 0, unchanged = 0; unchanged < 4; d = (d + 1) % 4) {
+        if (sweep(t, x0, y0, xn, yn, directions[d][0], directions[d][1]))
+            unchanged = 0;
+        else
+            unchanged++;
+    }
+}
+
+bool FastSweepingExpansion::sweep(int tile, int x0, int y0, int xn, int yn, int dx, int dy) {
+    // the update reads all four neighbours, so the outer border of the map is left out
+    int ux0 = std::max(x0, 1), uy0 = std::max(y0, 1);
+    int uxn = std::min(xn, nx_ - 2), uyn = std::min(yn, ny_ - 2);
+    unsigned char borders = 0;
+    bool changed = false;
+    for (int j = 0; j <= uyn - uy0; j++) {
+        int y = dy > 0 ? uy0 + j : uyn - j;
+        for (int i = 0; i <= uxn - ux0; i++) {
+            int x = dx > 0 ? ux0 + i : uxn - i;
+            int n = toIndex(x, y);
+            float c = getCost(costs_, n);
+            if (c >= lethal_cost_)
+                continue;
+            float pot = p_calc_->calculatePotential(potential_, c, n);
+            if (pot >= potential_[n])
+                continue;
+            potential_[n] = pot;
+            changed = true;
+            borders |= (x == x0 ? BORDER_LEFT : 0) | (x == xn ? BORDER_RIGHT : 0) | (y == y0 ? BORDER_TOP : 0) |
+                       (y == yn ? BORDER_BOTTOM : 0);
+        }
+    }
+    changed_borders_[tile] |= borders;
+    return changed;
+}
+
+} //end namespace global_planner
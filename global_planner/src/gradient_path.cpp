@@ -161,6 +161,14 @@ bool GradientPath::getPath(float* potential, double start_x, double start_y, dou
                 minp = potential[st];
                 minc = st;
             }
+            // the bottom of the potential next to the start, which is where following the grid ends when only
+            // the cells of a path have a potential
+            if (path_only_ && minc == stc && fabs(nx - start_x) < 1.0 && fabs(ny - start_y) < 1.0) {
+                current.first = start_x;
+                current.second = start_y;
+                path.push_back(current);
+                return true;
+            }
             stc = minc;
             dx = 0;
             dy = 0;
@@ -0,0 +1,510 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <global_planner/hierarchical.h>
+#include <cmath>
+#include <cstdlib>
+
+namespace global_planner {
+
+HierarchicalExpansion::HierarchicalExpansion(PotentialCalculator* p_calc, int xs, int ys, int cluster_size) :
+        Expander(p_calc, xs, ys), cluster_size_(std::max(cluster_size, 2)), search_(0) {
+    stride_ = 4 * cluster_size_;
+    local_cost_.resize(cluster_size_ * cluster_size_);
+    local_g_.resize(cluster_size_ * cluster_size_);
+    local_target_.resize(cluster_size_ * cluster_size_);
+    cached_lethal_ = lethal_cost_;
+    cached_neutral_ = neutral_cost_;
+    cached_factor_ = factor_;
+    cached_unknown_ = unknown_;
+    setSize(xs, ys);
+}
+
+void HierarchicalExpansion::setSize(int xs, int ys) {
+    // called before every plan, only a new size throws the clusters away
+    if (xs == nx_ && ys == ny_ && !clusters_.empty())
+        return;
+    Expander::setSize(xs, ys);
+    cnx_ = (nx_ + cluster_size_ - 1) / cluster_size_;
+    cny_ = (ny_ + cluster_size_ - 1) / cluster_size_;
+    int n = cnx_ * cny_;
+
+    clusters_.resize(n);
+    for (int c = 0; c < n; c++) {
+        Cluster& cluster = clusters_[c];
+        cluster.x0 = c % cnx_ * cluster_size_;
+        cluster.y0 = c / cnx_ * cluster_size_;
+        cluster.xn = std::min(cluster.x0 + cluster_size_, nx_);
+        cluster.yn = std::min(cluster.y0 + cluster_size_, ny_);
+        cluster.search = 0;
+    }
+    vborders_.assign(n, Border());
+    hborders_.assign(n, Border());
+    vborder_valid_.resize(n);
+    hborder_valid_.resize(n);
+    slot_.assign(n, -1);
+    invalidateAll();
+}
+
+void HierarchicalExpansion::invalidate(int x0, int y0, int xn, int yn) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    xn = std::min(xn, nx_ - 1);
+    yn = std::min(yn, ny_ - 1);
+    if (xn < x0 || yn < y0)
+        return;
+
+    for (int cy = y0 / cluster_size_; cy <= yn / cluster_size_; cy++) {
+        for (int cx = x0 / cluster_size_; cx <= xn / cluster_size_; cx++) {
+            int c = cy * cnx_ + cx;
+            clusters_[c].valid = false;
+            vborder_valid_[c] = false;
+            hborder_valid_[c] = false;
+            if (cx > 0)
+                vborder_valid_[c - 1] = false;
+            if (cy > 0)
+                hborder_valid_[c - cnx_] = false;
+        }
+    }
+}
+
+void HierarchicalExpansion::invalidateAll() {
+    for (unsigned int c = 0; c < clusters_.size(); c++)
+        clusters_[c].valid = false;
+    std::fill(vborder_valid_.begin(), vborder_valid_.end(), false);
+    std::fill(hborder_valid_.begin(), hborder_valid_.end(), false);
+}
+
+bool HierarchicalExpansion::calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x,
+                                                double end_y, int cycles, float* potential) {
+    if (lethal_cost_ != cached_lethal_ || neutral_cost_ != cached_neutral_ || factor_ != cached_factor_ ||
+            unknown_ != cached_unknown_) {
+        invalidateAll();
+        cached_lethal_ = lethal_cost_;
+        cached_neutral_ = neutral_cost_;
+        cached_factor_ = factor_;
+        cached_unknown_ = unknown_;
+    }
+
+    std::fill(potential, potential + ns_, POT_HIGH);
+    int start_i = toIndex(start_x, start_y);
+    goal_x_ = end_x;
+    goal_y_ = end_y;
+    int goal_i = toIndex(goal_x_, goal_y_);
+    if (getCost(costs, goal_i) >= lethal_cost_)
+        return false;
+
+    updateBorders(costs);
+    updateClusters(costs);
+    if (searchGraph(costs, start_i, goal_i)) {
+        if (refine(costs, potential, start_i, goal_i, cycles))
+            return true;
+
+        // the corridor always holds a path unless the map changed somewhere nobody invalidated, so start over
+        if (cycles > 0) {
+            invalidateAll();
+            updateBorders(costs);
+            updateClusters(costs);
+            if (searchGraph(costs, start_i, goal_i) && refine(costs, potential, start_i, goal_i, cycles))
+                return true;
+        }
+    }
+    if (cycles <= 0)
+        return false;
+
+    // the graph misses gaps that can only be crossed diagonally at the corners of clusters, so before giving up
+    // search every cell
+    corridor_.resize(clusters_.size());
+    for (unsigned int c = 0; c < clusters_.size(); c++)
+        corridor_[c] = c;
+    return refine(costs, potential, start_i, goal_i, cycles);
+}
+
+float HierarchicalExpansion::heuristic(int i) {
+    // octile distance, every step costs at least neutral_cost_ per cell travelled
+    int dx = abs(i % nx_ - goal_x_), dy = abs(i / nx_ - goal_y_);
+    return (std::max(dx, dy) + (M_SQRT2 - 1.0) * std::min(dx, dy)) * neutral_cost_;
+}
+
+void HierarchicalExpansion::updateBorders(const unsigned char* costs) {
+    Border border;
+    for (unsigned int c = 0; c < clusters_.size(); c++) {
+        const Cluster& cluster = clusters_[c];
+        if (!vborder_valid_[c] && cluster.xn < nx_) {
+            findEntrances(costs, toIndex(cluster.xn - 1, cluster.y0), 1, nx_, cluster.yn - cluster.y0, border);
+            if (border != vborders_[c]) {
+                vborders_[c].swap(border);
+                clusters_[c].valid = false;
+                clusters_[c + 1].valid = false;
+            }
+        }
+        vborder_valid_[c] = true;
+
+        if (!hborder_valid_[c] && cluster.yn < ny_) {
+            findEntrances(costs, toIndex(cluster.x0, cluster.yn - 1), nx_, 1, cluster.xn - cluster.x0, border);
+            if (border != hborders_[c]) {
+                hborders_[c].swap(border);
+                clusters_[c].valid = false;
+                clusters_[c + cnx_].valid = false;
+            }
+        }
+        hborder_valid_[c] = true;
+    }
+}
+
+void HierarchicalExpansion::findEntrances(const unsigned char* costs, int first, int across, int along, int length,
+                                          Border& border) {
+    border.clear();
+    int k = 0;
+    while (k < length) {
+        int a = first + k * along;
+        if (getCost(costs, a) >= lethal_cost_ || getCost(costs, a + across) >= lethal_cost_) {
+            k++;
+            continue;
+        }
+        int begin = k;
+        for (; k < length; k++) {
+            a = first + k * along;
+            if (getCost(costs, a) >= lethal_cost_ || getCost(costs, a + across) >= lethal_cost_)
+                break;
+        }
+
+        // one entrance on short runs of free cells, one in each half of long ones, where the crossing is cheapest
+        // and otherwise as close to the middle as possible
+        int ends[3] = { begin, (begin + k) / 2, k };
+        int parts = k - begin < 6 ? 1 : 2;
+        if (parts == 1)
+            ends[1] = k;
+        for (int p = 0; p < parts; p++) {
+            int best = -1;
+            float best_cost = 0;
+            for (int j = ends[p]; j < ends[p + 1]; j++) {
+                a = first + j * along;
+                float cost = getCost(costs, a) + getCost(costs, a + across);
+                if (best < 0 || cost < best_cost || (cost == best_cost &&
+                        abs(2 * j - ends[p] - ends[p + 1] + 1) < abs(2 * best - ends[p] - ends[p + 1] + 1))) {
+                    best = j;
+                    best_cost = cost;
+                }
+            }
+            a = first + best * along;
+            border.push_back(std::make_pair(a, a + across));
+        }
+    }
+}
+
+void HierarchicalExpansion::updateClusters(const unsigned char* costs) {
+    for (unsigned int c = 0; c < clusters_.size(); c++) {
+        Cluster& cluster = clusters_[c];
+        if (cluster.valid)
+            continue;
+
+        int cx = c % cnx_, cy = c / cnx_;
+        cluster.nodes.clear();
+        if (cx + 1 < cnx_)
+            for (unsigned int e = 0; e < vborders_[c].size(); e++)
+                cluster.nodes.push_back(vborders_[c][e].first);
+        if (cx > 0)
+            for (unsigned int e = 0; e < vborders_[c - 1].size(); e++)
+                cluster.nodes.push_back(vborders_[c - 1][e].second);
+        if (cy + 1 < cny_)
+            for (unsigned int e = 0; e < hborders_[c].size(); e++)
+                cluster.nodes.push_back(hborders_[c][e].first);
+        if (cy > 0)
+            for (unsigned int e = 0; e < hborders_[c - cnx_].size(); e++)
+                cluster.nodes.push_back(hborders_[c - cnx_][e].second);
+        std::sort(cluster.nodes.begin(), cluster.nodes.end());
+        cluster.nodes.erase(std::unique(cluster.nodes.begin(), cluster.nodes.end()), cluster.nodes.end());
+
+        int k = cluster.nodes.size();
+        cluster.edges.resize(k * k);
+        loadCosts(costs, cluster);
+        markNodes(cluster, true);
+        for (int j = 0; j < k; j++) {
+            searchCluster(cluster, cluster.nodes[j], false, k);
+            for (int l = 0; l < k; l++)
+                cluster.edges[j * k + l] = local_g_[local(cluster, cluster.nodes[l])];
+        }
+        markNodes(cluster, false);
+        cluster.search = 0;
+        cluster.valid = true;
+    }
+}
+
+HierarchicalExpansion::Cluster& HierarchicalExpansion::touch(int c) {
+    Cluster& cluster = clusters_[c];
+    if (cluster.search != search_) {
+        int k = cluster.nodes.size();
+        cluster.search = search_;
+        cluster.g.assign(k, POT_HIGH);
+        cluster.parent.assign(k, -1);
+        cluster.closed.assign(k, false);
+    }
+    return cluster;
+}
+
+void HierarchicalExpansion::loadCosts(const unsigned char* costs, const Cluster& cluster) {
+    for (int y = cluster.y0; y < cluster.yn; y++) {
+        float* row = &local_cost_[(y - cluster.y0) * cluster_size_];
+        for (int x = cluster.x0; x < cluster.xn; x++)
+            row[x - cluster.x0] = getCost(costs, toIndex(x, y));
+    }
+}
+
+void HierarchicalExpansion::markNodes(const Cluster& cluster, bool mark) {
+    for (unsigned int j = 0; j < cluster.nodes.size(); j++)
+        local_target_[local(cluster, cluster.nodes[j])] = mark;
+}
+
+void HierarchicalExpansion::searchCluster(const Cluster& cluster, int i, bool reverse, int targets) {
+    int w = cluster.xn - cluster.x0, h = cluster.yn - cluster.y0;
+    for (int y = 0; y < h; y++) {
+        float* row = &local_g_[y * cluster_size_];
+        std::fill(row, row + w, POT_HIGH);
+    }
+
+    // the same as the search over the whole map, in cluster coordinates
+    int source = local(cluster, i);
+    local_queue_.clear();
+    local_g_[source] = 0;
+    local_queue_.push_back(Index(source, 0));
+    int found = 0;
+    while (local_queue_.size() > 0) {
+        Index top = local_queue_[0];
+        std::pop_heap(local_queue_.begin(), local_queue_.end(), greater1());
+        local_queue_.pop_back();
+        int l = top.i;
+        if (top.cost > local_g_[l])
+            continue;
+        if (local_target_[l] && ++found == targets)
+            return;
+
+        int x = l % cluster_size_, y = l / cluster_size_;
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= w || y + dy < 0 || y + dy >= h)
+                    continue;
+                int n = l + dx + dy * cluster_size_;
+                if (local_cost_[n] >= lethal_cost_)
+                    continue;
+                // towards i, the step is taken the other way
+                float step = reverse ? local_cost_[l] : local_cost_[n];
+                if (dx != 0 && dy != 0) {
+                    if (local_cost_[l + dx] >= lethal_cost_ || local_cost_[l + dy * cluster_size_] >= lethal_cost_)
+                        continue;
+                    step *= M_SQRT2;
+                }
+                float g = top.cost + step;
+                if (g < local_g_[n]) {
+                    local_g_[n] = g;
+                    local_queue_.push_back(Index(n, g));
+                    std::push_heap(local_queue_.begin(), local_queue_.end(), greater1());
+                }
+            }
+        }
+    }
+}
+
+void HierarchicalExpansion::relax(int c, int node, float g, int parent) {
+    Cluster& cluster = touch(c);
+    if (cluster.closed[node] || g >= cluster.g[node])
+        return;
+    cluster.g[node] = g;
+    cluster.parent[node] = parent;
+    queue_.push_back(Index(c * stride_ + node, g + heuristic(cluster.nodes[node])));
+    std::push_heap(queue_.begin(), queue_.end(), greater1());
+}
+
+void HierarchicalExpansion::crossBorder(const unsigned char* costs, const Border& border, bool from_second, int cell,
+                                        int other, float g, int code) {
+    for (unsigned int e = 0; e < border.size(); e++) {
+        int from = from_second ? border[e].second : border[e].first;
+        if (from != cell)
+            continue;
+        int to = from_second ? border[e].first : border[e].second;
+        Cluster& cluster = touch(other);
+        int node = std::lower_bound(cluster.nodes.begin(), cluster.nodes.end(), to) - cluster.nodes.begin();
+        relax(other, node, g + getCost(costs, to), code);
+    }
+}
+
+bool HierarchicalExpansion::searchGraph(const unsigned char* costs, int start_i, int goal_i) {
+    search_++;
+    queue_.clear();
+    int start_c = clusterOf(start_i), goal_c = clusterOf(goal_i);
+    float best = POT_HIGH;
+    int best_code = -1;
+
+    // the start is connected to the nodes of its cluster, and to the goal if it is in there too
+    Cluster& start_cluster = touch(start_c);
+    loadCosts(costs, start_cluster);
+    markNodes(start_cluster, true);
+    int targets = start_cluster.nodes.size();
+    if (start_c == goal_c && !local_target_[local(start_cluster, goal_i)]) {
+        local_target_[local(start_cluster, goal_i)] = true;
+        targets++;
+    }
+    searchCluster(start_cluster, start_i, false, targets);
+    markNodes(start_cluster, false);
+    if (start_c == goal_c) {
+        local_target_[local(start_cluster, goal_i)] = false;
+        best = local_g_[local(start_cluster, goal_i)];
+    }
+    for (unsigned int j = 0; j < start_cluster.nodes.size(); j++) {
+        float g = local_g_[local(start_cluster, start_cluster.nodes[j])];
+        if (g < POT_HIGH)
+            relax(start_c, j, g, -1);
+    }
+
+    // and the nodes of the goal's cluster to the goal
+    Cluster& goal_cluster = touch(goal_c);
+    loadCosts(costs, goal_cluster);
+    markNodes(goal_cluster, true);
+    searchCluster(goal_cluster, goal_i, true, goal_cluster.nodes.size());
+    markNodes(goal_cluster, false);
+    to_goal_.resize(goal_cluster.nodes.size());
+    for (unsigned int j = 0; j < goal_cluster.nodes.size(); j++)
+        to_goal_[j] = local_g_[local(goal_cluster, goal_cluster.nodes[j])];
+
+    while (queue_.size() > 0) {
+        Index top = queue_[0];
+        std::pop_heap(queue_.begin(), queue_.end(), greater1());
+        queue_.pop_back();
+        if (top.cost >= best)
+            break;
+
+        int c = top.i / stride_, node = top.i % stride_;
+        Cluster& cluster = clusters_[c];
+        if (cluster.closed[node])
+            continue;
+        cluster.closed[node] = true;
+        float g = cluster.g[node];
+
+        if (c == goal_c && g + to_goal_[node] < best) {
+            best = g + to_goal_[node];
+            best_code = top.i;
+        }
+
+        const float* row = &cluster.edges[node * cluster.nodes.size()];
+        for (unsigned int j = 0; j < cluster.nodes.size(); j++) {
+            if (int(j) != node && row[j] < POT_HIGH)
+                relax(c, j, g + row[j], top.i);
+        }
+
+        int cell = cluster.nodes[node], cx = c % cnx_, cy = c / cnx_;
+        if (cx + 1 < cnx_)
+            crossBorder(costs, vborders_[c], false, cell, c + 1, g, top.i);
+        if (cx > 0)
+            crossBorder(costs, vborders_[c - 1], true, cell, c - 1, g, top.i);
+        if (cy + 1 < cny_)
+            crossBorder(costs, hborders_[c], false, cell, c + cnx_, g, top.i);
+        if (cy > 0)
+            crossBorder(costs, hborders_[c - cnx_], true, cell, c - cnx_, g, top.i);
+    }
+
+    if (best >= POT_HIGH)
+        return false;
+
+    corridor_.clear();
+    corridor_.push_back(start_c);
+    corridor_.push_back(goal_c);
+    for (int code = best_code; code >= 0; code = clusters_[code / stride_].parent[code % stride_])
+        corridor_.push_back(code / stride_);
+    std::sort(corridor_.begin(), corridor_.end());
+    corridor_.erase(std::unique(corridor_.begin(), corridor_.end()), corridor_.end());
+    return true;
+}
+
+bool HierarchicalExpansion::refine(const unsigned char* costs, float* potential, int start_i, int goal_i, int& cycles) {
+    for (unsigned int s = 0; s < corridor_.size(); s++)
+        slot_[corridor_[s]] = s;
+    int cells = corridor_.size() * cluster_size_ * cluster_size_;
+    cell_g_.assign(cells, POT_HIGH);
+    cell_parent_.resize(cells);
+    cell_closed_.assign(cells, false);
+
+    queue_.clear();
+    cell_g_[slotIndex(start_i)] = 0;
+    queue_.push_back(Index(start_i, heuristic(start_i)));
+    bool found = false;
+    while (queue_.size() > 0 && cycles > 0) {
+        Index top = queue_[0];
+        std::pop_heap(queue_.begin(), queue_.end(), greater1());
+        queue_.pop_back();
+
+        int i = top.i, si = slotIndex(i);
+        if (cell_closed_[si])
+            continue;
+        cell_closed_[si] = true;
+        cycles--;
+        if (i == goal_i) {
+            found = true;
+            break;
+        }
+
+        int x = i % nx_, y = i / nx_;
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= nx_ || y + dy < 0 || y + dy >= ny_)
+                    continue;
+                int n = i + dx + dy * nx_;
+                if (slot_[clusterOf(n)] < 0)
+                    continue;
+                float step = stepCost(costs, i, dx, dy);
+                if (step >= POT_HIGH)
+                    continue;
+                float g = cell_g_[si] + step;
+                int sn = slotIndex(n);
+                if (g < cell_g_[sn]) {
+                    cell_g_[sn] = g;
+                    cell_parent_[sn] = i;
+                    queue_.push_back(Index(n, g + heuristic(n)));
+                    std::push_heap(queue_.begin(), queue_.end(), greater1());
+                }
+            }
+        }
+    }
+
+    if (found) {
+        for (int i = goal_i; i != start_i; i = cell_parent_[slotIndex(i)])
+            potential[i] = cell_g_[slotIndex(i)];
+        potential[start_i] = 0;
+    }
+
+    for (unsigned int s = 0; s < corridor_.size(); s++)
+        slot_[corridor_[s]] = -1;
+    return found;
+}
+
+} //end namespace global_planner
@@ -0,0 +1,304 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <global_planner/jump_point.h>
+#include <costmap_2d/cost_values.h>
+#include <cmath>
+#include <cstdlib>
+
+namespace global_planner {
+
+const unsigned char JumpPointExpansion::ALL_DIRECTIONS;
+
+JumpPointExpansion::JumpPointExpansion(PotentialCalculator* p_calc, int xs, int ys) :
+        Expander(p_calc, xs, ys), plan_(0) {
+    setSize(xs, ys);
+}
+
+void JumpPointExpansion::setSize(int xs, int ys) {
+    Expander::setSize(xs, ys);
+    parent_.resize(ns_);
+    g_.resize(ns_);
+    closed_.resize(ns_);
+    scan_potential_.resize(ns_);
+    scan_directions_.resize(ns_);
+    scan_parent_.resize(ns_);
+    plan_of_.assign(ns_, 0);
+    plan_ = 0;
+}
+
+bool JumpPointExpansion::calculatePotentials(const unsigned char* costs, double start_x, double start_y, double end_x,
+                                             double end_y, int cycles, float* potential) {
+    queue_.clear();
+    // a new plan, with every cell untouched
+    if (++plan_ == 0) {
+        std::fill(plan_of_.begin(), plan_of_.end(), 0);
+        plan_ = 1;
+    }
+
+    // every step enters a cell at least as cheap as the cheapest one on the map
+    unsigned char lowest = 255;
+    for (int n = 0; n < ns_; n++)
+        lowest = std::min(lowest, costs[n]);
+    min_step_ = lowest < lethal_cost_ - 1 ? std::min(lowest * factor_ + neutral_cost_, lethal_cost_ - 1.0f) :
+                                            neutral_cost_;
+
+    int start_i = toIndex(start_x, start_y);
+    touch(start_i);
+    g_[start_i] = 0;
+    parent_[start_i] = start_i;
+    queue_.push_back(Index(start_i, 0));
+
+    goal_x_ = end_x;
+    goal_y_ = end_y;
+    goal_i_ = toIndex(goal_x_, goal_y_);
+    int cycle = 0;
+    cells_visited_ = 0;
+
+    while (queue_.size() > 0 && cycle < cycles) {
+        Index top = queue_[0];
+        std::pop_heap(queue_.begin(), queue_.end(), greater1());
+        queue_.pop_back();
+
+        // the queue may hold several entries for a cell, only the first one counts
+        int i = top.i;
+        if (closed_[i])
+            continue;
+        closed_[i] = true;
+        cells_visited_++;
+
+        if (i == goal_i_) {
+            writePath(costs, potential, start_i);
+            return true;
+        }
+
+        int x = i % nx_, y = i / nx_;
+        if (getCost(costs, i) >= lethal_cost_ || !isUniform(costs, x, y, costs[i])) {
+            expandAll(costs, i);
+        } else if (i == start_i || scan_directions_[i] == ALL_DIRECTIONS) {
+            float w = getCost(costs, i);
+            for (int dx = -1; dx <= 1; dx++) {
+                for (int dy = -1; dy <= 1; dy++) {
+                    if (dx != 0 && dy != 0)
+                        jumpDiagonal(costs, i, dx, dy);
+                    else if (dx != 0 || dy != 0)
+                        jumpStraight(costs, i, x, y, dx, dy, g_[i], w);
+                }
+            }
+        } else {
+            // other than where scans cross, a uniform cell is only reached from a neighbour, so this is the
+            // direction of the last step
+            int p = parent_[i];
+            int dx = x - p % nx_, dy = y - p / nx_;
+            float w = getCost(costs, i);
+            if (dx != 0 && dy != 0) {
+                jumpStraight(costs, i, x, y, dx, 0, g_[i], w);
+                jumpStraight(costs, i, x, y, 0, dy, g_[i], w);
+                jumpDiagonal(costs, i, dx, dy);
+            } else {
+                jumpStraight(costs, i, x, y, dx, dy, g_[i], w);
+            }
+        }
+
+        cycle++;
+    }
+
+    std::fill(potential, potential + ns_, POT_HIGH);
+    return false;
+}
+
+bool JumpPointExpansion::isUniform(const unsigned char* costs, int x, int y, unsigned char c) {
+    if (x < 1 || y < 1 || x > nx_ - 2 || y > ny_ - 2)
+        return false;
+    for (int j = -1; j <= 1; j++) {
+        const unsigned char* row = costs + toIndex(x, y + j);
+        if (row[-1] != c || row[0] != c || row[1] != c)
+            return false;
+    }
+    return true;
+}
+
+bool JumpPointExpansion::staysUniform(const unsigned char* costs, int x, int y, int dx, int dy, unsigned char c) {
+    if (x < 1 || y < 1 || x > nx_ - 2 || y > ny_ - 2)
+        return false;
+    // the rest of the 3x3 block was covered by the block of the previous cell
+    if (dx != 0) {
+        int n = toIndex(x + dx, y);
+        if (costs[n - nx_] != c || costs[n] != c || costs[n + nx_] != c)
+            return false;
+    }
+    if (dy != 0) {
+        int n = toIndex(x, y + dy);
+        if (costs[n - 1] != c || costs[n] != c || costs[n + 1] != c)
+            return false;
+    }
+    return true;
+}
+
+void JumpPointExpansion::expandAll(const unsigned char* costs, int i) {
+    int x = i % nx_, y = i / nx_;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            if (dx == 0 && dy == 0)
+                continue;
+            if (x + dx < 0 || x + dx >= nx_ || y + dy < 0 || y + dy >= ny_)
+                continue;
+            float w = stepCost(costs, i, dx, dy);
+            if (w >= POT_HIGH)
+                continue;
+            add(i, toIndex(x + dx, y + dy), g_[i] + w);
+        }
+    }
+}
+
+void JumpPointExpansion::jumpStraight(const unsigned char* costs, int i, int x, int y, int dx, int dy, float g,
+                                      float w) {
+    // (x, y) is uniform, so the cell after it has the same cost and can be entered
+    unsigned char c = costs[toIndex(x, y)];
+    while (true) {
+        x += dx;
+        y += dy;
+        g += w;
+        int n = toIndex(x, y);
+        if (n == goal_i_ || !staysUniform(costs, x, y, dx, dy, c)) {
+            add(i, n, g);
+            return;
+        }
+        if (scanned(i, n, dx, dy, g))
+            return;
+    }
+}
+
+void JumpPointExpansion::jumpDiagonal(const unsigned char* costs, int i, int dx, int dy) {
+    int x = i % nx_, y = i / nx_;
+    unsigned char c = costs[i];
+    float w = getCost(costs, i);
+    float g = g_[i];
+    while (true) {
+        x += dx;
+        y += dy;
+        g += w * M_SQRT2;
+        int n = toIndex(x, y);
+        if (n == goal_i_ || !staysUniform(costs, x, y, dx, dy, c)) {
+            add(i, n, g);
+            return;
+        }
+        if (scanned(i, n, dx, dy, g))
+            return;
+        // the ends of the straight scans are reached from i diagonally first, then straight, which is how
+        // writePath draws the segment, so there is no need to stop at n
+        jumpStraight(costs, i, x, y, dx, 0, g, w);
+        jumpStraight(costs, i, x, y, 0, dy, g, w);
+    }
+}
+
+bool JumpPointExpansion::scanned(int i, int n, int dx, int dy, float g) {
+    // what a scan finds past a cell only depends on the cell and the direction, so one that comes through
+    // later with a higher potential would only find the same cells, at a higher cost
+    int d = (dx + 1) * 3 + dy + 1;
+    touch(n);
+    unsigned char bit = 1 << (d < 4 ? d : d - 1);
+    if (g < scan_potential_[n]) {
+        scan_potential_[n] = g;
+        scan_parent_[n] = i;
+        if (scan_directions_[n] == ALL_DIRECTIONS) {
+            add(i, n, g);
+            return true;
+        }
+        scan_directions_[n] = bit;
+        return false;
+    }
+    if (scan_directions_[n] & bit)
+        return true;
+    if (g == scan_potential_[n]) {
+        scan_directions_[n] |= bit;
+        return false;
+    }
+    if (closed_[n])
+        return false;
+
+    // crossing a cheaper scan in another direction: n becomes a jump point, reached the cheaper way and
+    // expanded in all directions, which covers this scan and any later one through n
+    scan_directions_[n] = ALL_DIRECTIONS;
+    add(scan_parent_[n], n, scan_potential_[n]);
+    return true;
+}
+
+void JumpPointExpansion::add(int parent, int next_i, float g) {
+    touch(next_i);
+    if (closed_[next_i] || g >= g_[next_i])
+        return;
+
+    g_[next_i] = g;
+    parent_[next_i] = parent;
+
+    // octile distance, every step costs at least min_step_ per cell travelled
+    int dx = abs(next_i % nx_ - goal_x_), dy = abs(next_i / nx_ - goal_y_);
+    float distance = std::max(dx, dy) + (M_SQRT2 - 1.0) * std::min(dx, dy);
+
+    queue_.push_back(Index(next_i, g + distance * min_step_));
+    std::push_heap(queue_.begin(), queue_.end(), greater1());
+}
+
+void JumpPointExpansion::writePath(const unsigned char* costs, float* potential, int start_i) {
+    std::vector<int> jumps;
+    for (int i = goal_i_; i != start_i; i = parent_[i])
+        jumps.push_back(i);
+
+    std::fill(potential, potential + ns_, POT_HIGH);
+
+    // same step costs as the search, drawn diagonal steps first like the scans go
+    int i = start_i;
+    float g = 0;
+    potential[i] = g;
+    for (int k = jumps.size() - 1; k >= 0; k--) {
+        int dx = jumps[k] % nx_ - i % nx_, dy = jumps[k] / nx_ - i / nx_;
+        int sx = (dx > 0) - (dx < 0), sy = (dy > 0) - (dy < 0);
+        int diagonal = std::min(abs(dx), abs(dy));
+        for (int s = 0; s < diagonal; s++) {
+            i += sx + sy * nx_;
+            g += getCost(costs, i) * M_SQRT2;
+            potential[i] = g;
+        }
+        int straight = abs(dx) + abs(dy) - 2 * diagonal;
+        int step = abs(dx) > abs(dy) ? sx : sy * nx_;
+        for (int s = 0; s < straight; s++) {
+            i += step;
+            g += getCost(costs, i);
+            potential[i] = g;
+        }
+    }
+}
+
+} //end namespace global_planner
@@ -42,6 +42,10 @@
 
 #include <global_planner/dijkstra.h>
 #include <global_planner/astar.h>
+#include <global_planner/jump_point.h>
+#include <global_planner/hierarchical.h>
+#include <global_planner/dstar_lite.h>
+#include <global_planner/fast_sweeping.h>
 #include <global_planner/grid_path.h>
 #include <global_planner/gradient_path.h>
 #include <global_planner/quadratic_calculator.h>
@@ -67,11 +71,13 @@ void GlobalPlanner::outlineMap(unsigned char* costarr, int nx, int ny, unsigned
 }
 
 GlobalPlanner::GlobalPlanner() :
-        costmap_(NULL), initialized_(false), allow_unknown_(true) {
+        costmap_(NULL), initialized_(false), allow_unknown_(true), costmap_ros_(NULL), live_costmap_(NULL), incremental_(false),
+        previous_updated_cells_(32), last_start_x_(0), last_start_y_(0), potential_array_(NULL), potential_size_(0) {
 }
 
 GlobalPlanner::GlobalPlanner(std::string name, costmap_2d::Costmap2D* costmap, std::string frame_id) :
-        costmap_(NULL), initialized_(false), allow_unknown_(true) {
+        costmap_(NULL), initialized_(false), allow_unknown_(true), costmap_ros_(NULL), live_costmap_(NULL), incremental_(false),
+        previous_updated_cells_(32), last_start_x_(0), last_start_y_(0), potential_array_(NULL), potential_size_(0) {
     //initialize the planner
     initialize(name, costmap, frame_id);
 }
@@ -83,18 +89,46 @@ GlobalPlanner::~GlobalPlanner() {
         delete planner_;
     if (path_maker_)
         delete path_maker_;
+    delete[] potential_array_;
     if (dsrv_)
         delete dsrv_;
 }
 
 void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros) {
-    initialize(name, costmap_ros->getCostmap(), costmap_ros->getGlobalFrameID());
+    if (costmap_ros->usesSnapshots()) {
+        //plan on the latest snapshot, which makePlan picks up, instead of the live costmap. Until the first one
+        //is published, plan on a copy of the live costmap that nobody else reads.
+        costmap_ros_ = costmap_ros;
+        boost::shared_ptr<costmap_2d::Costmap2D> copy;
+        {
+            boost::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(*(costmap_ros->getCostmap()->getMutex()));
+            copy.reset(new costmap_2d::Costmap2D(*(costmap_ros->getCostmap())));
+        }
+        snapshot_ = copy;
+        initialize(name, copy.get(), costmap_ros->getGlobalFrameID());
+        live_costmap_ = NULL;
+
+        //the planner cannot outline the shared snapshots itself, so they come outlined
+        if (outline_map_) {
+            outlineMap(copy->getCharMap(), copy->getSizeInCellsX(), copy->getSizeInCellsY(),
+                       costmap_2d::LETHAL_OBSTACLE);
+            costmap_ros->setSnapshotOutline(true);
+        }
+    } else
+        initialize(name, costmap_ros->getCostmap(), costmap_ros->getGlobalFrameID());
+
+    if (incremental_) {
+        //the search kept from the last plan only needs to look again at the parts of the costmap that changed
+        updated_cells_.reset(new costmap_2d::DirtyRegion(32));
+        costmap_ros->getLayeredCostmap()->addUpdateWatcher(updated_cells_);
+    }
 }
 
 void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2D* costmap, std::string frame_id) {
     if (!initialized_) {
         ros::NodeHandle private_nh("~/" + name);
         costmap_ = costmap;
+        live_costmap_ = costmap;
         frame_id_ = frame_id;
 
         unsigned int cx = costmap->getSizeInCellsX(), cy = costmap->getSizeInCellsY();
@@ -112,9 +146,40 @@ void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2D* costmap,
         else
             p_calc_ = new PotentialCalculator(cx, cy);
 
-        bool use_dijkstra;
+        bool use_dijkstra, use_jump_point, use_hierarchical, use_dstar_lite, use_fast_sweeping;
         private_nh.param("use_dijkstra", use_dijkstra, true);
-        if (use_dijkstra)
+        private_nh.param("use_jump_point", use_jump_point, false);
+        private_nh.param("use_hierarchical", use_hierarchical, false);
+        private_nh.param("use_dstar_lite", use_dstar_lite, false);
+        private_nh.param("use_fast_sweeping", use_fast_sweeping, false);
+        if (use_hierarchical)
+        {
+            int cluster_size;
+            private_nh.param("cluster_size", cluster_size, 64);
+            planner_ = new HierarchicalExpansion(p_calc_, cx, cy, cluster_size);
+            incremental_ = true;
+        }
+        else if (use_dstar_lite)
+        {
+            planner_ = new DStarLiteExpansion(p_calc_, cx, cy);
+            incremental_ = true;
+        }
+        else if (use_fast_sweeping)
+        {
+            // Slower than dijkstra on a single core, see fast_sweeping.h
+            int sweep_threads, sweep_tile_size;
+            private_nh.param("sweep_threads", sweep_threads, 0);
+            private_nh.param("sweep_tile_size", sweep_tile_size, 64);
+            if (sweep_threads <= 0)
+                sweep_threads = boost::thread::hardware_concurrency();
+            FastSweepingExpansion* fe = new FastSweepingExpansion(p_calc_, cx, cy, sweep_threads, sweep_tile_size);
+            if(!old_navfn_behavior_)
+                fe->setPreciseStart(true);
+            planner_ = fe;
+        }
+        else if (use_jump_point)
+            planner_ = new JumpPointExpansion(p_calc_, cx, cy);
+        else if (use_dijkstra)
         {
             DijkstraExpansion* de = new DijkstraExpansion(p_calc_, cx, cy);
             if(!old_navfn_behavior_)
@@ -130,6 +195,7 @@ void GlobalPlanner::initialize(std::string name, costmap_2d::Costmap2D* costmap,
             path_maker_ = new GridPath(p_calc_);
         else
             path_maker_ = new GradientPath(p_calc_);
+        path_maker_->setPathOnly(planner_->writesPathOnly());
 
         orientation_filter_ = new OrientationFilter();
 
@@ -174,8 +240,12 @@ void GlobalPlanner::clearRobotCell(const geometry_msgs::PoseStamped& global_pose
         return;
     }
 
+    //a snapshot is shared with other readers, and the expanders never look at the cost of the start cell anyway
+    if (!live_costmap_)
+        return;
+
     //set the associated costs in the cost map to be free
-    costmap_->setCost(mx, my, costmap_2d::FREE_SPACE);
+    live_costmap_->setCost(mx, my, costmap_2d::FREE_SPACE);
 }
 
 bool GlobalPlanner::makePlanService(nav_msgs::GetPlan::Request& req, nav_msgs::GetPlan::Response& resp) {
@@ -222,6 +292,14 @@ bool GlobalPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geom
         return false;
     }
 
+    if (costmap_ros_) {
+        boost::shared_ptr<const costmap_2d::Costmap2D> snapshot = costmap_ros_->getSnapshot();
+        if (snapshot) {
+            snapshot_ = snapshot;
+            costmap_ = snapshot.get();
+        }
+    }
+
     //clear the plan, just in case
     plan.clear();
 
@@ -283,10 +361,17 @@ bool GlobalPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geom
     p_calc_->setSize(nx, ny);
     planner_->setSize(nx, ny);
     path_maker_->setSize(nx, ny);
-    potential_array_ = new float[nx * ny];
+    if (nx * ny != potential_size_) {
+        delete[] potential_array_;
+        potential_array_ = new float[nx * ny];
+        potential_size_ = nx * ny;
+    }
+
+    if (incremental_)
+        invalidateChangedCells(start_x_i, start_y_i);
 
-    if(outline_map_)
-        outlineMap(costmap_->getCharMap(), nx, ny, costmap_2d::LETHAL_OBSTACLE);
+    if(outline_map_ && live_costmap_)
+        outlineMap(live_costmap_->getCharMap(), nx, ny, costmap_2d::LETHAL_OBSTACLE);
 
     bool found_legal = planner_->calculatePotentials(costmap_->getCharMap(), start_x, start_y, goal_x, goal_y,
                                                     nx * ny * 2, potential_array_);
@@ -315,10 +400,39 @@ bool GlobalPlanner::makePlan(const geometry_msgs::PoseStamped& start, const geom
 
     //publish the plan for visualization purposes
     publishPlan(plan);
-    delete potential_array_;
     return !plan.empty();
 }
 
+void GlobalPlanner::invalidateChangedCells(unsigned int start_x, unsigned int start_y) {
+    //clearRobotCell changed the start cell without telling the costmap, and a new snapshot puts the last one back
+    planner_->invalidate(start_x, start_y, start_x, start_y);
+    planner_->invalidate(last_start_x_, last_start_y_, last_start_x_, last_start_y_);
+    last_start_x_ = start_x;
+    last_start_y_ = start_y;
+
+    if (!updated_cells_) {
+        ROS_WARN_ONCE("The global planner cannot follow the updates of this costmap, so it will look at the whole "
+                      "costmap again for every plan");
+        planner_->invalidateAll();
+        return;
+    }
+
+    //the costmap planned on can be a snapshot taken before the last updates, so the cells updated before the
+    //previous plan are looked at again as well
+    costmap_2d::DirtyRegion updated = previous_updated_cells_;
+    {
+        costmap_2d::Costmap2D* costmap = costmap_ros_ ? costmap_ros_->getCostmap() : live_costmap_;
+        boost::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(*(costmap->getMutex()));
+        previous_updated_cells_ = *updated_cells_;
+        updated_cells_->clear();
+    }
+    updated.add(previous_updated_cells_);
+
+    const std::vector<costmap_2d::DirtyRect>& rects = updated.getRects();
+    for (unsigned int i = 0; i < rects.size(); i++)
+        planner_->invalidate(rects[i].min_x, rects[i].min_y, rects[i].max_x, rects[i].max_y);
+}
+
 void GlobalPlanner::publishPlan(const std::vector<geometry_msgs::PoseStamped>& path) {
     if (!initialized_) {
         ROS_ERROR(
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks that D* Lite, kept from plan to plan while the robot moves towards
+ * one goal and the map changes, finds the same paths as a fresh D* Lite
+ * search and as a plain 8-connected Dijkstra search, when every cell whose
+ * cost changed is passed to invalidate().
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <global_planner/dstar_lite.h>
+#include <global_planner/gradient_path.h>
+#include <global_planner/grid_path.h>
+#include <global_planner/potential_calculator.h>
+
+#include "reference_search.h"
+
+using namespace global_planner;
+
+static const int NX = 60, NY = 50;
+
+// Change the map around a random cell, an obstacle showing up or a patch clearing, and return the bounds of the
+// cells that changed in x0, y0, xn and yn, with xn < 0 if none did
+static void changeMap(std::vector<unsigned char>& costs, int& x0, int& y0, int& xn, int& yn)
+{
+  std::vector<unsigned char> before(costs);
+  int cx = rand() % NX, cy = rand() % NY;
+  if (rand() % 3 == 0)
+  {
+    for (int y = std::max(0, cy - 8); y < std::min(NY, cy + 8); ++y)
+      for (int x = std::max(0, cx - 8); x < std::min(NX, cx + 8); ++x)
+        costs[x + y * NX] = costmap_2d::FREE_SPACE;
+    reference_search::outlineMap(NX, NY, costs);
+  }
+  else
+    reference_search::addObstacle(NX, NY, cx, cy, rand() % 6, rand() % 5, costs);
+
+  x0 = NX;
+  y0 = NY;
+  xn = yn = -1;
+  for (int i = 0; i < NX * NY; ++i)
+    if (costs[i] != before[i])
+    {
+      x0 = std::min(x0, i % NX);
+      xn = std::max(xn, i % NX);
+      y0 = std::min(y0, i / NX);
+      yn = std::max(yn, i / NX);
+    }
+}
+
+TEST(DStarLite, ReplansMatchFreshSearch)
+{
+  PotentialCalculator p_calc(NX, NY);
+  DStarLiteExpansion dstar_lite(&p_calc, NX, NY);
+  GridPath grid_path(&p_calc);
+  grid_path.setSize(NX, NY);
+  GradientPath gradient_path(&p_calc);
+  gradient_path.setSize(NX, NY);
+  gradient_path.setPathOnly(dstar_lite.writesPathOnly());
+  // D* Lite expects the same potential array from one plan to the next
+  std::vector<float> potential(NX * NY), fresh_potential(NX * NY);
+  std::vector<unsigned char> costs;
+
+  int replans = 0;
+  for (unsigned int seed = 0; seed < 200; ++seed)
+  {
+    reference_search::randomMap(NX, NY, seed, costs);
+    int goal = reference_search::randomCell(costs), start = reference_search::randomCell(costs);
+    for (int k = 0; k < 12; ++k)
+    {
+      if (k > 0 && rand() % 2 == 0)
+      {
+        int x0, y0, xn, yn;
+        changeMap(costs, x0, y0, xn, yn);
+        if (rand() % 5 == 0)
+          dstar_lite.invalidateAll();
+        else if (xn >= 0)
+          dstar_lite.invalidate(x0, y0, xn, yn);
+      }
+      // a new goal halfway, which starts the search over
+      if (k == 6)
+        goal = reference_search::randomCell(costs);
+      // the robot moves a few cells, or somewhere else entirely
+      if (rand() % 4 == 0)
+        start = reference_search::randomCell(costs);
+      else
+        for (int tries = 0; tries < 20; ++tries)
+        {
+          int n = start + rand() % 7 - 3 + (rand() % 7 - 3) * NX;
+          if (n >= 0 && n < NX * NY && reference_search::stepCost(costs, n) < 253)
+          {
+            start = n;
+            break;
+          }
+        }
+      if (reference_search::stepCost(costs, start) >= 253 || reference_search::stepCost(costs, goal) >= 253)
+        continue;
+
+      double start_x = start % NX + 0.001 * (rand() % 1000), start_y = start / NX + 0.001 * (rand() % 1000);
+      double goal_x = goal % NX + 0.5, goal_y = goal / NX + 0.5;
+      bool ok = dstar_lite.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, NX * NY * 2,
+                                               &potential[0]);
+      DStarLiteExpansion fresh(&p_calc, NX, NY);
+      bool fresh_ok = fresh.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, NX * NY * 2,
+                                                &fresh_potential[0]);
+      double expected = reference_search::pathCost(costs, NX, NY, start, goal);
+      ASSERT_EQ(fresh_ok, ok) << "seed " << seed << " plan " << k;
+      ASSERT_EQ(expected >= 0, ok) << "seed " << seed << " plan " << k;
+      if (!ok)
+        continue;
+
+      // the costs are kept in sixteenths, rounded at every step
+      EXPECT_EQ(fresh_potential[goal], potential[goal]) << "seed " << seed << " plan " << k;
+      EXPECT_NEAR(expected, potential[goal], 1e-3 * expected + 0.5) << "seed " << seed << " plan " << k;
+      replans += k > 0;
+
+      std::vector<std::pair<float, float> > path;
+      EXPECT_TRUE(grid_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path))
+          << "seed " << seed << " plan " << k;
+      path.clear();
+      EXPECT_TRUE(gradient_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path))
+          << "seed " << seed << " plan " << k;
+    }
+  }
+  EXPECT_GT(replans, 1500);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
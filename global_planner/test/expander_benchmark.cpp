@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Benchmark of the Expander implementations on the same maps: Dijkstra (with
+ * the quadratic potential and a precise start, like the planner's defaults),
+ * A*, jump point search and the hierarchical search. Each plan is timed from
+ * the expansion through the GradientPath traceback, and the length and cost of
+ * the resulting paths are reported so the expanders can be compared on quality
+ * as well as speed.
+ *
+ * The start and goal of every plan are connected, so the times compare searches
+ * that find a path rather than ones that give up.
+ *
+ * Before every plan but the first, a small obstacle is dropped somewhere on
+ * the map and the hierarchical search is told where, so its times include
+ * keeping its cache up to date. Its first plan, which finds the whole cache,
+ * is reported on its own as well. The fast sweeping expander runs on as many
+ * threads as there are cores and finds the potential of the whole map, so it
+ * is best compared with Dijkstra when the goal is far from the start.
+ *
+ * D* Lite only pays off when the goal stays the same, so it is timed on its
+ * own afterwards: the robot moves along the path to one goal, obstacles show
+ * up further along it, and every replan is compared with Dijkstra doing the
+ * same plan from scratch.
+ *
+ * The map is a synthetic building with rooms along corridors, a synthetic
+ * open site with scattered obstacles, or a costmap saved as a binary PGM
+ * holding the raw costs (navfn/test/willow_costmap.pgm for instance). It is
+ * repeated tiles x tiles times to get site sized maps.
+ *
+ * Usage: rosrun global_planner expander_benchmark [building|site|costmap.pgm] [tiles] [plans]
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <costmap_2d/cost_values.h>
+#include <global_planner/astar.h>
+#include <global_planner/dijkstra.h>
+#include <global_planner/dstar_lite.h>
+#include <global_planner/fast_sweeping.h>
+#include <global_planner/gradient_path.h>
+#include <global_planner/hierarchical.h>
+#include <global_planner/jump_point.h>
+#include <global_planner/quadratic_calculator.h>
+
+using namespace global_planner;
+
+/**
+ * Read a binary PGM whose pixels are costmap costs.
+ */
+bool readCostmap(const char* filename, int& nx, int& ny, std::vector<unsigned char>& costs)
+{
+  FILE* file = fopen(filename, "rb");
+  if (!file)
+    return false;
+
+  // header fields, skipping whitespace and comments
+  int fields[3], nfields = 0;
+  char magic[3] = { 0 };
+  if (fread(magic, 1, 2, file) != 2 || std::string(magic) != "P5")
+  {
+    fclose(file);
+    return false;
+  }
+  while (nfields < 3)
+  {
+    int c = fgetc(file);
+    if (c == '#')
+      while (c != '\n' && c != EOF)
+        c = fgetc(file);
+    if (c == EOF)
+    {
+      fclose(file);
+      return false;
+    }
+    if (c >= '0' && c <= '9')
+    {
+      ungetc(c, file);
+      if (fscanf(file, "%d", &fields[nfields++]) != 1)
+      {
+        fclose(file);
+        return false;
+      }
+    }
+  }
+  fgetc(file);
+
+  nx = fields[0];
+  ny = fields[1];
+  costs.resize(nx * ny);
+  bool ok = fields[2] == 255 && fread(&costs[0], 1, costs.size(), file) == costs.size();
+  fclose(file);
+  return ok;
+}
+
+/**
+ * Clutter and unknown patches, with rooms along corridors if walls is set,
+ * inflated with an exponential decay like the inflation layer does.
+ */
+void syntheticMap(int nx, int ny, bool walls, std::vector<unsigned char>& costs)
+{
+  costs.assign(nx * ny, costmap_2d::FREE_SPACE);
+  srand(42);
+
+  // walls every 60 cells, with doors in them
+  for (int k = 60; walls && k < ny; k += 60)
+    for (int x = 0; x < nx; ++x)
+      if ((x + k) % 60 > 8)
+        costs[x + k * nx] = costmap_2d::LETHAL_OBSTACLE;
+  for (int k = 60; walls && k < nx; k += 60)
+    for (int y = 0; y < ny; ++y)
+      if ((y + 2 * k) % 60 > 8)
+        costs[k + y * nx] = costmap_2d::LETHAL_OBSTACLE;
+
+  // unknown patches and clutter
+  for (int n = 0; n < nx * ny / 20000; ++n)
+  {
+    int x0 = rand() % nx, y0 = rand() % ny;
+    for (int y = y0; y < std::min(ny, y0 + 20); ++y)
+      for (int x = x0; x < std::min(nx, x0 + 20); ++x)
+        costs[x + y * nx] = costmap_2d::NO_INFORMATION;
+  }
+  for (int n = 0; n < nx * ny / (walls ? 5000 : 50000); ++n)
+    costs[rand() % (nx * ny)] = costmap_2d::LETHAL_OBSTACLE;
+
+  // inflation
+  const int radius = 6;
+  std::vector<unsigned char> inflated(costs);
+  for (int y = 0; y < ny; ++y)
+    for (int x = 0; x < nx; ++x)
+    {
+      if (costs[x + y * nx] != costmap_2d::LETHAL_OBSTACLE)
+        continue;
+      for (int j = std::max(0, y - radius); j <= std::min(ny - 1, y + radius); ++j)
+        for (int i = std::max(0, x - radius); i <= std::min(nx - 1, x + radius); ++i)
+        {
+          double d = hypot(i - x, j - y);
+          if (d > radius)
+            continue;
+          unsigned char cost = d <= 2 ? costmap_2d::INSCRIBED_INFLATED_OBSTACLE :
+                               (unsigned char)((costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1) * exp(-(d - 2)));
+          unsigned char& old_cost = inflated[i + j * nx];
+          if (old_cost == costmap_2d::NO_INFORMATION ? cost >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE : cost > old_cost)
+            old_cost = cost;
+        }
+    }
+  inflated.swap(costs);
+}
+
+/** @brief The accumulated cost of a path, weighing each piece by the cost of the cell it ends in */
+double pathCost(const std::vector<unsigned char>& costs, int nx, const std::vector<std::pair<float, float> >& path)
+{
+  double total = 0.0;
+  for (size_t k = 1; k < path.size(); ++k)
+  {
+    double length = hypot(path[k].first - path[k - 1].first, path[k].second - path[k - 1].second);
+    int cell = int(path[k].first + 0.5) + int(path[k].second + 0.5) * nx;
+    total += length * (costs[cell] * 3.0 + 50);
+  }
+  return total;
+}
+
+/** @brief Mark the cells that can be reached from start without going through lethal cells */
+void reachable(const std::vector<unsigned char>& costs, int nx, int start, std::vector<bool>& reached)
+{
+  reached.assign(costs.size(), false);
+  std::vector<int> stack(1, start);
+  reached[start] = true;
+  while (!stack.empty())
+  {
+    int n = stack.back();
+    stack.pop_back();
+    int next[] = { n - 1, n + 1, n - nx, n + nx };
+    for (int k = 0; k < 4; ++k)
+      if (next[k] >= 0 && next[k] < (int)costs.size() && !reached[next[k]] &&
+          costs[next[k]] < costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
+      {
+        reached[next[k]] = true;
+        stack.push_back(next[k]);
+      }
+  }
+}
+
+struct Result
+{
+  Result() : time(0.0), found(0), length(0.0), cost(0.0) {}
+  double time;
+  int found;
+  double length, cost;
+};
+
+int main(int argc, char** argv)
+{
+  std::string filename = argc > 1 ? argv[1] : "building";
+  int tiles = argc > 2 ? atoi(argv[2]) : 1;
+  int plans = argc > 3 ? atoi(argv[3]) : 20;
+
+  int tx, ty;
+  std::vector<unsigned char> tile;
+  if (filename == "building" || filename == "site")
+  {
+    tx = ty = 1000;
+    syntheticMap(tx, ty, filename == "building", tile);
+  }
+  else if (!readCostmap(filename.c_str(), tx, ty, tile))
+  {
+    fprintf(stderr, "could not read a binary costmap from %s\n", filename.c_str());
+    return 1;
+  }
+
+  int nx = tx * tiles, ny = ty * tiles;
+  std::vector<unsigned char> costs(nx * ny);
+  for (int y = 0; y < ny; ++y)
+    for (int x = 0; x < nx; ++x)
+      costs[x + y * nx] = tile[x % tx + (y % ty) * tx];
+
+  // the planner outlines the map before planning
+  for (int x = 0; x < nx; ++x)
+    costs[x] = costs[x + (ny - 1) * nx] = costmap_2d::LETHAL_OBSTACLE;
+  for (int y = 0; y < ny; ++y)
+    costs[y * nx] = costs[nx - 1 + y * nx] = costmap_2d::LETHAL_OBSTACLE;
+
+  printf("map: %d x %d cells, %d plans, %u threads sweeping\n", nx, ny, plans, boost::thread::hardware_concurrency());
+
+  QuadraticCalculator p_calc(nx, ny);
+  DijkstraExpansion dijkstra(&p_calc, nx, ny);
+  dijkstra.setPreciseStart(true);
+  AStarExpansion astar(&p_calc, nx, ny);
+  JumpPointExpansion jump_point(&p_calc, nx, ny);
+  FastSweepingExpansion fast_sweeping(&p_calc, nx, ny, boost::thread::hardware_concurrency(), 64);
+  fast_sweeping.setPreciseStart(true);
+  HierarchicalExpansion hierarchical(&p_calc, nx, ny, 64);
+  Expander* expanders[] = { &dijkstra, &astar, &jump_point, &fast_sweeping, &hierarchical };
+  const char* names[] = { "dijkstra", "astar", "jump_point", "sweeping", "hierarchical" };
+  const int count = sizeof(expanders) / sizeof(expanders[0]);
+  Result results[count];
+  for (int e = 0; e < count; ++e)
+    expanders[e]->setSize(nx, ny);
+
+  GradientPath path_maker(&p_calc);
+  path_maker.setSize(nx, ny);
+  std::vector<float> potential(nx * ny);
+  std::vector<bool> reached;
+  double first_hierarchical = 0.0;
+
+  srand(7);
+  for (int n = 0; n < plans; ++n)
+  {
+    if (n > 0)
+    {
+      // an inflated obstacle the size of a person
+      int x0 = 1 + rand() % (nx - 11), y0 = 1 + rand() % (ny - 11);
+      for (int y = y0; y < y0 + 9; ++y)
+        for (int x = x0; x < x0 + 9; ++x)
+          costs[x + y * nx] = std::max<unsigned char>(costs[x + y * nx], costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 50);
+      for (int y = y0 + 3; y < y0 + 6; ++y)
+        for (int x = x0 + 3; x < x0 + 6; ++x)
+          costs[x + y * nx] = costmap_2d::LETHAL_OBSTACLE;
+      hierarchical.invalidate(x0, y0, x0 + 8, y0 + 8);
+    }
+
+    // both ends in cheap cells that are connected, so every expander has a path to find, at a random spot
+    // inside them like the planner's precise start
+    int start, goal;
+    do
+      start = rand() % (nx * ny);
+    while (costs[start] >= 128);
+    reachable(costs, nx, start, reached);
+    do
+      goal = rand() % (nx * ny);
+    while (costs[goal] >= 128 || !reached[goal]);
+    double start_x = start % nx + 0.01 * (rand() % 100), start_y = start / nx + 0.01 * (rand() % 100);
+    double goal_x = goal % nx + 0.01 * (rand() % 100), goal_y = goal / nx + 0.01 * (rand() % 100);
+
+    for (int e = 0; e < count; ++e)
+    {
+      std::vector<std::pair<float, float> > path;
+      ros::WallTime begin = ros::WallTime::now();
+      bool found = expanders[e]->calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, nx * ny * 2,
+                                                     &potential[0]);
+      if (found)
+      {
+        expanders[e]->clearEndpoint(&costs[0], &potential[0], goal_x, goal_y, 2);
+        path_maker.setPathOnly(expanders[e]->writesPathOnly());
+        found = path_maker.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path);
+      }
+      results[e].time += (ros::WallTime::now() - begin).toSec();
+      if (n == 0 && expanders[e] == &hierarchical)
+        first_hierarchical = (ros::WallTime::now() - begin).toSec();
+
+      if (!found)
+        continue;
+      results[e].found++;
+      for (size_t k = 1; k < path.size(); ++k)
+        results[e].length += hypot(path[k].first - path[k - 1].first, path[k].second - path[k - 1].second);
+      results[e].cost += pathCost(costs, nx, path);
+    }
+  }
+
+  printf("%-12s %12s %8s %14s %14s\n", "expander", "ms/plan", "found", "length/plan", "cost/plan");
+  for (int e = 0; e < count; ++e)
+  {
+    int found = std::max(results[e].found, 1);
+    printf("%-12s %12.2f %8d %14.1f %14.1f\n", names[e], 1e3 * results[e].time / plans, results[e].found,
+           results[e].length / found, results[e].cost / found);
+  }
+  printf("hierarchical: first plan %.2f ms, later plans %.2f ms/plan\n", 1e3 * first_hierarchical,
+         plans > 1 ? 1e3 * (results[count - 1].time - first_hierarchical) / (plans - 1) : 0.0);
+
+  // replanning to one goal, D* Lite keeps its own potential array like the planner does
+  DStarLiteExpansion dstar_lite(&p_calc, nx, ny);
+  std::vector<float> dstar_potential(nx * ny);
+  // a connected goal far enough for the robot to keep going for a while, or the farthest of many tries
+  int start, goal = -1, distance = -1;
+  do
+    start = rand() % (nx * ny);
+  while (costs[start] >= 128);
+  reachable(costs, nx, start, reached);
+  for (int tries = 0; tries < 100000 && distance < (nx + ny) / 2; ++tries)
+  {
+    int n = rand() % (nx * ny);
+    int d = abs(n % nx - start % nx) + abs(n / nx - start / nx);
+    if (costs[n] < 128 && reached[n] && d > distance)
+    {
+      goal = n;
+      distance = d;
+    }
+  }
+  double first_dstar = 0.0, dstar_time = 0.0, dijkstra_time = 0.0;
+  int replans = 0;
+  std::vector<std::pair<float, float> > path;
+  for (int n = 0; goal >= 0 && n < plans; ++n)
+  {
+    if (n > 0)
+    {
+      if (path.size() < 40)
+        break;
+      // the robot moved a few cells, and an obstacle the size of a person stands a bit further along, the path
+      // runs from the goal back to the start
+      int moved = path.size() - 11, ahead = path.size() - path.size() / 3;
+      start = int(path[moved].first + 0.5) + int(path[moved].second + 0.5) * nx;
+      int cx = int(path[ahead].first + 0.5), cy = int(path[ahead].second + 0.5);
+      if (std::max(abs(cx - start % nx), abs(cy - start / nx)) > 6 &&
+          std::max(abs(cx - goal % nx), abs(cy - goal / nx)) > 6)
+      {
+        int x0 = std::max(1, cx - 4), y0 = std::max(1, cy - 4);
+        int xn = std::min(nx - 2, cx + 4), yn = std::min(ny - 2, cy + 4);
+        for (int y = y0; y <= yn; ++y)
+          for (int x = x0; x <= xn; ++x)
+            costs[x + y * nx] = abs(x - cx) <= 1 && abs(y - cy) <= 1 ? costmap_2d::LETHAL_OBSTACLE :
+                std::max<unsigned char>(costs[x + y * nx], costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 50);
+        dstar_lite.invalidate(x0, y0, xn, yn);
+      }
+    }
+    double start_x = start % nx + 0.5, start_y = start / nx + 0.5;
+    double goal_x = goal % nx + 0.5, goal_y = goal / nx + 0.5;
+
+    ros::WallTime begin = ros::WallTime::now();
+    bool found = dstar_lite.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, nx * ny * 2,
+                                                &dstar_potential[0]);
+    path.clear();
+    if (found)
+    {
+      dstar_lite.clearEndpoint(&costs[0], &dstar_potential[0], goal_x, goal_y, 2);
+      path_maker.setPathOnly(dstar_lite.writesPathOnly());
+      found = path_maker.getPath(&dstar_potential[0], start_x, start_y, goal_x, goal_y, path);
+    }
+    double time = (ros::WallTime::now() - begin).toSec();
+    if (!found)
+      break;
+    if (n == 0)
+    {
+      first_dstar = time;
+      continue;
+    }
+    dstar_time += time;
+
+    begin = ros::WallTime::now();
+    std::vector<std::pair<float, float> > dijkstra_path;
+    if (dijkstra.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, nx * ny * 2, &potential[0]))
+    {
+      dijkstra.clearEndpoint(&costs[0], &potential[0], goal_x, goal_y, 2);
+      path_maker.setPathOnly(dijkstra.writesPathOnly());
+      path_maker.getPath(&potential[0], start_x, start_y, goal_x, goal_y, dijkstra_path);
+    }
+    dijkstra_time += (ros::WallTime::now() - begin).toSec();
+    replans++;
+  }
+  printf("dstar_lite: first plan %.2f ms, %d replans %.2f ms/plan, dijkstra on the same replans %.2f ms/plan\n",
+         1e3 * first_dstar, replans, replans > 0 ? 1e3 * dstar_time / replans : 0.0,
+         replans > 0 ? 1e3 * dijkstra_time / replans : 0.0);
+
+  return 0;
+}
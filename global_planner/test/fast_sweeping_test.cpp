@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks the potentials of fast sweeping against those of DijkstraExpansion
+ * over the whole of random maps, with both potential calculators and with
+ * and without a precise start: the same cells get a potential, and each
+ * one is within a tolerance of Dijkstra's. Many cells come out lower, as the
+ * sweeps find the fixed point of the update that Dijkstra's wavefront stops
+ * short of, but a few come out higher, which the tolerance allows for too.
+ * The potentials must not depend on the number of threads.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <global_planner/dijkstra.h>
+#include <global_planner/fast_sweeping.h>
+#include <global_planner/potential_calculator.h>
+#include <global_planner/quadratic_calculator.h>
+
+#include "reference_search.h"
+
+using namespace global_planner;
+
+// How much higher a potential may come out than Dijkstra's, in cost units
+static const float HIGHER_TOLERANCE = 2.0;
+// How much lower, as a part of Dijkstra's potential plus half the neutral cost, for the cells right next to the start
+static const float LOWER_TOLERANCE = 0.15, LOWER_SLACK = 25.0;
+
+TEST(FastSweeping, MatchesDijkstra)
+{
+  int lower = 0, higher = 0, cells = 0;
+  double total_difference = 0;
+  for (unsigned int seed = 0; seed < 100; ++seed)
+  {
+    int nx = 60 + seed * 7 % 100, ny = 50 + seed * 13 % 100;
+    std::vector<unsigned char> costs;
+    reference_search::randomMap(nx, ny, seed, costs);
+    QuadraticCalculator quadratic(nx, ny);
+    PotentialCalculator plain(nx, ny);
+    PotentialCalculator* p_calc = seed % 2 ? &quadratic : &plain;
+    bool precise = seed % 4 < 2;
+
+    DijkstraExpansion dijkstra(p_calc, nx, ny);
+    dijkstra.setSize(nx, ny);
+    dijkstra.setPreciseStart(precise);
+    FastSweepingExpansion fast_sweeping(p_calc, nx, ny, 1 + seed % 4, 16);
+    fast_sweeping.setPreciseStart(precise);
+
+    int start;
+    do
+      start = reference_search::randomCell(costs);
+    while (start % nx >= nx - 2 || start / nx >= ny - 2);
+    double start_x = start % nx + 0.001 * (rand() % 1000), start_y = start / nx + 0.001 * (rand() % 1000);
+
+    // Dijkstra covers the whole map when it never reaches the goal, on the outline
+    std::vector<float> expected(nx * ny), potential(nx * ny);
+    dijkstra.calculatePotentials(&costs[0], start_x, start_y, 0, 0, nx * ny * 2, &expected[0]);
+    fast_sweeping.calculatePotentials(&costs[0], start_x, start_y, 0, 0, nx * ny * 2, &potential[0]);
+
+    for (int y = 1; y < ny - 1; ++y)
+      for (int x = 1; x < nx - 1; ++x)
+      {
+        int i = x + y * nx;
+        ASSERT_EQ(expected[i] < POT_HIGH, potential[i] < POT_HIGH) << "seed " << seed << " cell " << x << ", " << y;
+        if (expected[i] >= POT_HIGH)
+          continue;
+        EXPECT_LE(potential[i], expected[i] + HIGHER_TOLERANCE) << "seed " << seed << " cell " << x << ", " << y;
+        EXPECT_GE(potential[i], expected[i] * (1 - LOWER_TOLERANCE) - LOWER_SLACK)
+            << "seed " << seed << " cell " << x << ", " << y;
+        cells++;
+        total_difference += fabs(potential[i] - expected[i]) / std::max(expected[i], 1.0f);
+        if (potential[i] > expected[i] + 1e-3)
+          higher++;
+        if (potential[i] < expected[i] - 1e-3)
+          lower++;
+      }
+  }
+  EXPECT_GT(lower, cells / 4);
+  EXPECT_GT(higher, 0);
+  EXPECT_LT(total_difference / cells, 0.01);
+}
+
+TEST(FastSweeping, SameOnAnyNumberOfThreads)
+{
+  const int nx = 150, ny = 130;
+  std::vector<unsigned char> costs;
+  reference_search::randomMap(nx, ny, 7, costs);
+  QuadraticCalculator p_calc(nx, ny);
+  FastSweepingExpansion one_thread(&p_calc, nx, ny, 1, 16), four_threads(&p_calc, nx, ny, 4, 16);
+  one_thread.setPreciseStart(true);
+  four_threads.setPreciseStart(true);
+
+  int start = reference_search::randomCell(costs);
+  std::vector<float> expected(nx * ny), potential(nx * ny);
+  one_thread.calculatePotentials(&costs[0], start % nx + 0.3, start / nx + 0.6, 0, 0, nx * ny * 2, &expected[0]);
+  four_threads.calculatePotentials(&costs[0], start % nx + 0.3, start / nx + 0.6, 0, 0, nx * ny * 2, &potential[0]);
+  for (int i = 0; i < nx * ny; ++i)
+    ASSERT_EQ(expected[i], potential[i]) << "cell " << i % nx << ", " << i / nx;
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
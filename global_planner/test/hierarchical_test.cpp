@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks the hierarchical search on random maps: that its paths are never
+ * cheaper than a plain 8-connected Dijkstra search and seldom costlier, that
+ * after changing the map and invalidating the changed cells a replan finds
+ * the same path as a fresh expander, and that it gives up once it has
+ * expanded as many cells as it is allowed to.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <global_planner/gradient_path.h>
+#include <global_planner/grid_path.h>
+#include <global_planner/hierarchical.h>
+#include <global_planner/potential_calculator.h>
+
+#include "reference_search.h"
+
+using namespace global_planner;
+
+static const int NX = 60, NY = 50, CLUSTER_SIZE = 16;
+
+TEST(Hierarchical, CloseToReferenceCost)
+{
+  PotentialCalculator p_calc(NX, NY);
+  HierarchicalExpansion hierarchical(&p_calc, NX, NY, CLUSTER_SIZE);
+  GridPath grid_path(&p_calc);
+  grid_path.setSize(NX, NY);
+  GradientPath gradient_path(&p_calc);
+  gradient_path.setSize(NX, NY);
+  gradient_path.setPathOnly(hierarchical.writesPathOnly());
+  std::vector<float> potential(NX * NY);
+  std::vector<unsigned char> costs;
+
+  int found = 0, costlier = 0;
+  double worst = 1.0;
+  for (unsigned int seed = 0; seed < 500; ++seed)
+  {
+    reference_search::randomMap(NX, NY, seed, costs);
+    hierarchical.invalidateAll();
+    for (int k = 0; k < 4; ++k)
+    {
+      int start = reference_search::randomCell(costs), goal = reference_search::randomCell(costs);
+      double start_x = start % NX + 0.5, start_y = start / NX + 0.5;
+      double goal_x = goal % NX + 0.5, goal_y = goal / NX + 0.5;
+      double expected = reference_search::pathCost(costs, NX, NY, start, goal);
+
+      bool ok = hierarchical.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, NX * NY * 2,
+                                                 &potential[0]);
+      ASSERT_EQ(expected >= 0, ok) << "seed " << seed << " plan " << k;
+      if (!ok)
+        continue;
+      found++;
+      ASSERT_GE(potential[goal], expected * (1 - 1e-4)) << "seed " << seed << " plan " << k;
+      if (potential[goal] > expected * (1 + 1e-4))
+        costlier++;
+      worst = std::max(worst, potential[goal] / expected);
+
+      std::vector<std::pair<float, float> > path;
+      EXPECT_TRUE(grid_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path))
+          << "seed " << seed << " plan " << k;
+      path.clear();
+      EXPECT_TRUE(gradient_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path))
+          << "seed " << seed << " plan " << k;
+    }
+  }
+  EXPECT_GT(found, 1900);
+  // how much costlier hierarchical.h says the paths are
+  EXPECT_LT(costlier, found / 10);
+  EXPECT_LT(worst, 1.8);
+}
+
+TEST(Hierarchical, ReplanAfterInvalidate)
+{
+  PotentialCalculator p_calc(NX, NY);
+  HierarchicalExpansion hierarchical(&p_calc, NX, NY, CLUSTER_SIZE);
+  std::vector<float> potential(NX * NY), fresh_potential(NX * NY);
+  std::vector<unsigned char> costs;
+
+  int replans = 0;
+  for (unsigned int seed = 0; seed < 200; ++seed)
+  {
+    reference_search::randomMap(NX, NY, seed, costs);
+    hierarchical.invalidateAll();
+    for (int k = 0; k < 6; ++k)
+    {
+      if (k > 0)
+      {
+        // an obstacle shows up or a patch of the map clears, and the expander is told where
+        std::vector<unsigned char> before(costs);
+        int cx = rand() % NX, cy = rand() % NY;
+        if (rand() % 3 == 0)
+        {
+          for (int y = std::max(0, cy - 8); y < std::min(NY, cy + 8); ++y)
+            for (int x = std::max(0, cx - 8); x < std::min(NX, cx + 8); ++x)
+              costs[x + y * NX] = costmap_2d::FREE_SPACE;
+          reference_search::outlineMap(NX, NY, costs);
+        }
+        else
+          reference_search::addObstacle(NX, NY, cx, cy, rand() % 6, rand() % 5, costs);
+
+        int x0 = NX, y0 = NY, xn = -1, yn = -1;
+        for (int i = 0; i < NX * NY; ++i)
+          if (costs[i] != before[i])
+          {
+            x0 = std::min(x0, i % NX);
+            xn = std::max(xn, i % NX);
+            y0 = std::min(y0, i / NX);
+            yn = std::max(yn, i / NX);
+          }
+        if (xn >= 0)
+          hierarchical.invalidate(x0, y0, xn, yn);
+      }
+
+      int start = reference_search::randomCell(costs), goal = reference_search::randomCell(costs);
+      double start_x = start % NX + 0.5, start_y = start / NX + 0.5;
+      double goal_x = goal % NX + 0.5, goal_y = goal / NX + 0.5;
+      bool ok = hierarchical.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, NX * NY * 2,
+                                                 &potential[0]);
+      HierarchicalExpansion fresh(&p_calc, NX, NY, CLUSTER_SIZE);
+      bool fresh_ok = fresh.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, NX * NY * 2,
+                                                &fresh_potential[0]);
+      ASSERT_EQ(fresh_ok, ok) << "seed " << seed << " plan " << k;
+      if (ok)
+      {
+        ASSERT_EQ(fresh_potential[goal], potential[goal]) << "seed " << seed << " plan " << k;
+        replans += k > 0;
+      }
+    }
+  }
+  EXPECT_GT(replans, 800);
+}
+
+TEST(Hierarchical, CyclesLimit)
+{
+  std::vector<unsigned char> costs(NX * NY, costmap_2d::FREE_SPACE);
+  reference_search::outlineMap(NX, NY, costs);
+  PotentialCalculator p_calc(NX, NY);
+  HierarchicalExpansion hierarchical(&p_calc, NX, NY, CLUSTER_SIZE);
+  std::vector<float> potential(NX * NY);
+
+  // the path from corner to corner has 55 cells after the start
+  EXPECT_FALSE(hierarchical.calculatePotentials(&costs[0], 2.5, 2.5, 57.5, 47.5, 20, &potential[0]));
+  EXPECT_TRUE(hierarchical.calculatePotentials(&costs[0], 2.5, 2.5, 57.5, 47.5, NX * NY * 2, &potential[0]));
+  EXPECT_LT(potential[57 + 47 * NX], POT_HIGH);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks that jump point search finds paths as cheap as a plain 8-connected
+ * Dijkstra search on random maps, with one expander reused from plan to plan,
+ * and that GridPath and GradientPath trace back the potential it writes, which
+ * only has the cells of the path.
+ */
+
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <global_planner/gradient_path.h>
+#include <global_planner/grid_path.h>
+#include <global_planner/jump_point.h>
+#include <global_planner/potential_calculator.h>
+
+#include "reference_search.h"
+
+using namespace global_planner;
+
+// Whether the path runs from the goal to the start, in steps to neighbouring cells
+static void checkPath(const std::vector<std::pair<float, float> >& path, double start_x, double start_y,
+                      double goal_x, double goal_y)
+{
+  ASSERT_GE(path.size(), 1u);
+  EXPECT_NEAR(goal_x, path.front().first, 1.0);
+  EXPECT_NEAR(goal_y, path.front().second, 1.0);
+  EXPECT_NEAR(start_x, path.back().first, 1.0);
+  EXPECT_NEAR(start_y, path.back().second, 1.0);
+  for (size_t k = 1; k < path.size(); ++k)
+  {
+    EXPECT_LE(fabs(path[k].first - path[k - 1].first), 2.0);
+    EXPECT_LE(fabs(path[k].second - path[k - 1].second), 2.0);
+  }
+}
+
+TEST(JumpPoint, MatchesReferenceCost)
+{
+  const int nx = 60, ny = 50;
+  PotentialCalculator p_calc(nx, ny);
+  JumpPointExpansion jump_point(&p_calc, nx, ny);
+  GridPath grid_path(&p_calc);
+  grid_path.setSize(nx, ny);
+  GradientPath gradient_path(&p_calc);
+  gradient_path.setSize(nx, ny);
+  gradient_path.setPathOnly(jump_point.writesPathOnly());
+  std::vector<float> potential(nx * ny);
+  std::vector<unsigned char> costs;
+
+  int found = 0;
+  for (unsigned int seed = 0; seed < 500; ++seed)
+  {
+    reference_search::randomMap(nx, ny, seed, costs);
+    for (int k = 0; k < 4; ++k)
+    {
+      int start = reference_search::randomCell(costs), goal = reference_search::randomCell(costs);
+      double start_x = start % nx + 0.001 * (rand() % 1000), start_y = start / nx + 0.001 * (rand() % 1000);
+      double goal_x = goal % nx + 0.001 * (rand() % 1000), goal_y = goal / nx + 0.001 * (rand() % 1000);
+      double expected = reference_search::pathCost(costs, nx, ny, start, goal);
+
+      bool ok = jump_point.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, nx * ny * 2,
+                                               &potential[0]);
+      ASSERT_EQ(expected >= 0, ok) << "seed " << seed << " plan " << k;
+      if (!ok)
+        continue;
+      found++;
+      ASSERT_NEAR(expected, potential[goal], 1e-4 * expected) << "seed " << seed << " plan " << k;
+
+      std::vector<std::pair<float, float> > path;
+      ASSERT_TRUE(grid_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path))
+          << "seed " << seed << " plan " << k;
+      checkPath(path, start_x, start_y, goal_x, goal_y);
+      path.clear();
+      ASSERT_TRUE(gradient_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path))
+          << "seed " << seed << " plan " << k;
+      checkPath(path, start_x, start_y, goal_x, goal_y);
+    }
+  }
+  EXPECT_GT(found, 1900);
+}
+
+// Following the gradient of a path-only potential ends in the bottom next to the start, which GradientPath only
+// takes for the start when it is told the potential is path-only
+TEST(JumpPoint, GradientPathNeedsPathOnly)
+{
+  const int nx = 20, ny = 20;
+  std::vector<unsigned char> costs(nx * ny, costmap_2d::FREE_SPACE);
+  reference_search::outlineMap(nx, ny, costs);
+
+  PotentialCalculator p_calc(nx, ny);
+  JumpPointExpansion jump_point(&p_calc, nx, ny);
+  std::vector<float> potential(nx * ny);
+  double start_x = 5.3, start_y = 10.6, goal_x = 15.2, goal_y = 10.4;
+  ASSERT_TRUE(jump_point.calculatePotentials(&costs[0], start_x, start_y, goal_x, goal_y, nx * ny * 2,
+                                             &potential[0]));
+
+  GradientPath gradient_path(&p_calc);
+  gradient_path.setSize(nx, ny);
+  std::vector<std::pair<float, float> > path;
+  EXPECT_FALSE(gradient_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path));
+
+  gradient_path.setPathOnly(true);
+  path.clear();
+  ASSERT_TRUE(gradient_path.getPath(&potential[0], start_x, start_y, goal_x, goal_y, path));
+  checkPath(path, start_x, start_y, goal_x, goal_y);
+  EXPECT_FLOAT_EQ(start_x, path.back().first);
+  EXPECT_FLOAT_EQ(start_y, path.back().second);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Random costmaps and a plain 8-connected Dijkstra search over them, with the
+ * same step costs as the expanders' defaults, for checking the costs of the
+ * paths the expanders find.
+ */
+#ifndef GLOBAL_PLANNER_TEST_REFERENCE_SEARCH_H
+#define GLOBAL_PLANNER_TEST_REFERENCE_SEARCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <costmap_2d/cost_values.h>
+
+namespace reference_search
+{
+
+/**
+ * @brief The cost of stepping into cell n with the expanders' default lethal cost (253), neutral cost (50) and cost
+ * factor (3), unknown cells allowed; the lethal cost for cells that can't be entered
+ */
+inline float stepCost(const std::vector<unsigned char>& costs, int n)
+{
+  float c = costs[n];
+  if (c < 252 || c == costmap_2d::NO_INFORMATION)
+  {
+    c = c * 3 + 50;
+    return c >= 253 ? 252 : c;
+  }
+  return 253;
+}
+
+/**
+ * @brief The cost of the cheapest 8-connected path from start to goal, where diagonal steps cost sqrt(2) times as
+ * much and may not cut the corner of a cell that can't be entered, or -1 if there is none
+ */
+inline double pathCost(const std::vector<unsigned char>& costs, int nx, int ny, int start, int goal)
+{
+  typedef std::pair<double, int> Entry;
+  std::vector<double> distance(nx * ny, 1e30);
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+  distance[start] = 0;
+  queue.push(Entry(0, start));
+  while (!queue.empty())
+  {
+    Entry top = queue.top();
+    queue.pop();
+    int i = top.second;
+    if (top.first > distance[i])
+      continue;
+    if (i == goal)
+      return distance[i];
+    int x = i % nx, y = i / nx;
+    for (int dx = -1; dx <= 1; ++dx)
+      for (int dy = -1; dy <= 1; ++dy)
+      {
+        if ((dx == 0 && dy == 0) || x + dx < 0 || x + dx >= nx || y + dy < 0 || y + dy >= ny)
+          continue;
+        int n = i + dx + dy * nx;
+        double w = stepCost(costs, n);
+        if (w >= 253)
+          continue;
+        if (dx != 0 && dy != 0)
+        {
+          if (stepCost(costs, i + dx) >= 253 || stepCost(costs, i + dy * nx) >= 253)
+            continue;
+          w *= M_SQRT2;
+        }
+        if (distance[i] + w < distance[n])
+        {
+          distance[n] = distance[i] + w;
+          queue.push(Entry(distance[n], n));
+        }
+      }
+  }
+  return -1;
+}
+
+/** @brief Raise the costs around (cx, cy) to those of a round obstacle with an inflated rim */
+inline void addObstacle(int nx, int ny, int cx, int cy, int radius, int inflation, std::vector<unsigned char>& costs)
+{
+  for (int y = std::max(0, cy - radius - inflation); y <= std::min(ny - 1, cy + radius + inflation); ++y)
+    for (int x = std::max(0, cx - radius - inflation); x <= std::min(nx - 1, cx + radius + inflation); ++x)
+    {
+      double d = hypot(x - cx, y - cy);
+      unsigned char c;
+      if (d <= radius)
+        c = costmap_2d::LETHAL_OBSTACLE;
+      else if (d <= radius + inflation)
+        c = (unsigned char)(252 * exp(-(d - radius) / 2.0));
+      else
+        continue;
+      if (c > costs[x + y * nx])
+        costs[x + y * nx] = c;
+    }
+}
+
+/** @brief Outline the map with lethal cells like the planner does */
+inline void outlineMap(int nx, int ny, std::vector<unsigned char>& costs)
+{
+  for (int x = 0; x < nx; ++x)
+    costs[x] = costs[x + (ny - 1) * nx] = costmap_2d::LETHAL_OBSTACLE;
+  for (int y = 0; y < ny; ++y)
+    costs[y * nx] = costs[nx - 1 + y * nx] = costmap_2d::LETHAL_OBSTACLE;
+}
+
+/** @brief An outlined map of inflated round obstacles, unknown patches and thin walls */
+inline void randomMap(int nx, int ny, unsigned int seed, std::vector<unsigned char>& costs)
+{
+  srand(seed);
+  costs.assign(nx * ny, costmap_2d::FREE_SPACE);
+  int obstacles = rand() % 30;
+  for (int k = 0; k < obstacles; ++k)
+  {
+    int cx = rand() % nx, cy = rand() % ny, radius = rand() % 6, inflation = rand() % 6;
+    addObstacle(nx, ny, cx, cy, radius, inflation, costs);
+  }
+  int unknown = rand() % 3;
+  for (int k = 0; k < unknown; ++k)
+  {
+    int cx = rand() % nx, cy = rand() % ny;
+    for (int y = cy; y < std::min(ny, cy + 8); ++y)
+      for (int x = cx; x < std::min(nx, cx + 8); ++x)
+        if (costs[x + y * nx] == costmap_2d::FREE_SPACE)
+          costs[x + y * nx] = costmap_2d::NO_INFORMATION;
+  }
+  int walls = rand() % 4;
+  for (int k = 0; k < walls; ++k)
+  {
+    int cx = rand() % nx, cy = rand() % ny;
+    for (int x = std::max(0, cx - 15); x < std::min(nx, cx + 15); ++x)
+      costs[x + cy * nx] = costmap_2d::LETHAL_OBSTACLE;
+  }
+  outlineMap(nx, ny, costs);
+}
+
+/** @brief A random cell that can be entered */
+inline int randomCell(const std::vector<unsigned char>& costs)
+{
+  int n;
+  do
+    n = rand() % costs.size();
+  while (stepCost(costs, n) >= 253);
+  return n;
+}
+
+}  // namespace reference_search
+
+#endif  // GLOBAL_PLANNER_TEST_REFERENCE_SEARCH_H
@@ -470,7 +470,10 @@ namespace move_base {
   }
 
   bool MoveBase::makePlan(const geometry_msgs::PoseStamped& goal, std::vector<geometry_msgs::PoseStamped>& plan){
-    boost::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(*(planner_costmap_ros_->getCostmap()->getMutex()));
+    //planners reading costmap snapshots don't need the live costmap locked, all others do
+    costmap_2d::TimedCostmapLock lock(*(planner_costmap_ros_->getCostmap()->getMutex()),
+                                      planner_costmap_ros_->getReaderLockStatistics(),
+                                      !(planner_costmap_ros_->usesSnapshots() && planner_->usesCostmapSnapshots()));
 
     //make sure to set the plan to be empty initially
     plan.clear();
@@ -906,7 +909,9 @@ namespace move_base {
         }
         
         {
-         boost::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(*(controller_costmap_ros_->getCostmap()->getMutex()));
+         costmap_2d::TimedCostmapLock lock(*(controller_costmap_ros_->getCostmap()->getMutex()),
+                                           controller_costmap_ros_->getReaderLockStatistics(),
+                                           !(controller_costmap_ros_->usesSnapshots() && tc_->usesCostmapSnapshots()));
         
         if(tc_->computeVelocityCommands(cmd_vel)){
           ROS_DEBUG_NAMED( "move_base", "Got a valid command from the local planner: %.3lf, %.3lf, %.3lf",
@@ -80,6 +80,17 @@ namespace nav_core {
        */
       virtual void initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros) = 0;
 
+      /**
+       * @brief  Whether makePlan() only reads snapshots of the costmap (see
+       *         costmap_2d::Costmap2DROS::getSnapshot()) when the costmap publishes
+       *         them, so that callers need not lock the costmap around it
+       * @return False unless the planner overrides it
+       */
+      virtual bool usesCostmapSnapshots()
+      {
+        return false;
+      }
+
       /**
        * @brief  Virtual destructor for the interface
        */
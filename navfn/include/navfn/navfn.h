@@ -45,6 +45,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <vector>
 
 // cost defs
 #define COST_UNKNOWN_ROS 255		// 255 is unknown cost
@@ -74,10 +75,14 @@
 // potential defs
 #define POT_HIGH 1.0e10		// unassigned cell potential
 
-// priority buffers
+// priority buffers, initial size; they grow when a wavefront does not fit
 #define PRIORITYBUFSIZE 10000
 
 
+namespace costmap_2d {
+  class ThreadPool;
+};
+
 namespace navfn {
   /**
     Navigation function call.
@@ -142,6 +147,18 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       bool calcNavFnDijkstra(bool atStart = false);	/**< calculates the full navigation function */
 
+      /**
+       * @brief Calculates the full navigation function by fast sweeping on several threads, see propNavFnSweep()
+       * @return True if a plan is found, false otherwise
+       */
+      bool calcNavFnSweep();	/**< calculates the full navigation function in parallel */
+
+      /**
+       * @brief  Sets the number of threads calcNavFnSweep() sweeps on
+       * @param threads The number of threads, including the calling one; 0 for one per core
+       */
+      void setSweepThreads(int threads);
+
       /**
        * @brief  Accessor for the x-coordinates of a path
        * @return The x-coordinates of a path
@@ -172,10 +189,20 @@ positions at about 1/2 cell resolution; else returns 0.
       bool    *pending;		/**< pending cells during propagation */
       int nobs;			/**< number of obstacle cells */
 
+      /** storage for the cell arrays, kept while the map fits in it */
+      char *arena;		/**< one block holding costarr, potarr, pending, gradx and grady */
+      int arenaCells;		/**< number of cells the arena has room for */
+
       /** block priority buffers */
       int *pb1, *pb2, *pb3;		/**< storage buffers for priority blocks */
       int *curP, *nextP, *overP;	/**< priority buffer block ptrs */
       int curPe, nextPe, overPe; /**< end points of arrays */
+      int pbSize;			/**< size of each priority buffer */
+
+      /**
+       * @brief  Doubles the size of the priority buffers, keeping the cells in them
+       */
+      void growPriorityBufs();
 
       /** block priority thresholds */
       float curT;			/**< current threshold */
@@ -233,6 +260,28 @@ positions at about 1/2 cell resolution; else returns 0.
        */
       bool propNavFnAstar(int cycles); /**< returns true if start point found */
 
+      /**
+       * @brief  Run propagation for <cycles> rounds, or until the potential stops changing, by sweeping tiles of the map on several threads.
+       *
+       * The potential of every cell reached is the fixed point of the update of updateCell(), so some cells come out
+       * lower than with propNavFnDijkstra(), and a few slightly higher. On one thread it is about twice as slow as
+       * propNavFnDijkstra() over the whole map, so it only pays off with several cores.
+       * @param cycles The maximum number of rounds to run for
+       * @return true if the potential stopped changing
+       */
+      bool propNavFnSweep(int cycles);
+
+      /** parallel sweeping */
+      costmap_2d::ThreadPool *sweepPool;	/**< threads the tiles are swept on */
+      int sweepThreads;		/**< number of threads sweeping, 0 for one per core until the pool is made */
+      int sweepTile;		/**< width and height of the tiles, in cells */
+      int sweepTilesX, sweepTilesY;	/**< number of tiles across and down the map */
+      std::vector<bool> sweepActive;	/**< tiles that need sweeping */
+      std::vector<unsigned char> sweepBorders;	/**< borders of each tile along which a cell got lower */
+      std::vector<int> sweepList;	/**< tiles being swept at the same time */
+      void sweepTileCells(unsigned int i);	/**< sweeps the <i>th tile of sweepList until it stops changing */
+      bool sweepTileOnce(int t, int dx, int dy);	/**< sweeps tile <t> once in direction <dx>,<dy>, true if it changed */
+
       /** gradient and paths */
       float *gradx, *grady;		/**< gradient arrays, size of potential array */
       float *pathx, *pathy;		/**< path points, as subpixel cell coordinates */
@@ -90,6 +90,14 @@ namespace navfn {
        */
       void initialize(std::string name, costmap_2d::Costmap2D* costmap, std::string global_frame);
 
+      /**
+       * @brief  Whether makePlan() plans on snapshots of the costmap, which it does when the
+       *         costmap passed to initialize() publishes them
+       */
+      bool usesCostmapSnapshots(){
+        return costmap_ros_ != NULL;
+      }
+
       /**
        * @brief Given a goal pose in the world, compute a plan
        * @param start The start pose 
@@ -162,7 +170,7 @@ namespace navfn {
       /**
        * @brief Store a copy of the current costmap in \a costmap.  Called by makePlan.
        */
-      costmap_2d::Costmap2D* costmap_;
+      const costmap_2d::Costmap2D* costmap_;
       boost::shared_ptr<NavFn> planner_;
       ros::Publisher plan_pub_;
       ros::Publisher potarr_pub_;
@@ -178,6 +186,19 @@ namespace navfn {
 
       void mapToWorld(double mx, double my, double& wx, double& wy);
       void clearRobotCell(const geometry_msgs::PoseStamped& global_pose, unsigned int mx, unsigned int my);
+
+      /**
+       * @brief  When planning on snapshots, point costmap_ at the latest one
+       */
+      void refreshSnapshot();
+
+      costmap_2d::Costmap2DROS* costmap_ros_; ///< @brief Only set when planning on snapshots of the costmap
+      /**
+       * @brief The snapshot costmap_ points to when planning on snapshots
+       */
+      boost::shared_ptr<const costmap_2d::Costmap2D> snapshot_;
+
+      bool use_fast_sweeping_; ///< @brief Compute potentials with NavFn::calcNavFnSweep instead of calcNavFnDijkstra
       double planner_window_x_, planner_window_y_, default_tolerance_;
       boost::mutex mutex_;
       ros::ServiceServer make_plan_srv_;
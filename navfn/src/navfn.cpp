@@ -44,7 +44,10 @@
 
 
 #include <navfn/navfn.h>
+#include <costmap_2d/thread_pool.h>
 #include <ros/console.h>
+#include <boost/bind.hpp>
+#include <algorithm>
 
 namespace navfn {
 
@@ -114,12 +117,15 @@ namespace navfn {
     potarr = NULL;
     pending = NULL;
     gradx = grady = NULL;
+    arena = NULL;
+    arenaCells = 0;
     setNavArr(xs,ys);
 
     // priority buffers
     pb1 = new int[PRIORITYBUFSIZE];
     pb2 = new int[PRIORITYBUFSIZE];
     pb3 = new int[PRIORITYBUFSIZE];
+    pbSize = PRIORITYBUFSIZE;
 
     // for Dijkstra (breadth-first), set to COST_NEUTRAL
     // for A* (best-first), set to COST_NEUTRAL
@@ -137,21 +143,19 @@ namespace navfn {
     npathbuf = npath = 0;
     pathx = pathy = NULL;
     pathStep = 0.5;
+
+    // sweeping, the thread pool is made on first use
+    sweepPool = NULL;
+    sweepThreads = 0;
+    sweepTile = 64;
+    sweepTilesX = sweepTilesY = 0;
   }
 
 
   NavFn::~NavFn()
   {
-    if(costarr)
-      delete[] costarr;
-    if(potarr)
-      delete[] potarr;
-    if(pending)
-      delete[] pending;
-    if(gradx)
-      delete[] gradx;
-    if(grady)
-      delete[] grady;
+    if(arena)
+      delete[] arena;
     if(pathx)
       delete[] pathx;
     if(pathy)
@@ -162,6 +166,7 @@ namespace navfn {
       delete[] pb2;
     if(pb3)
       delete[] pb3;
+    delete sweepPool;
   }
 
 
@@ -189,6 +194,13 @@ namespace navfn {
   // Set/Reset map size
   //
 
+  // bytes for <n> elements of <size> bytes, rounded up so that each array in the arena starts on a cache line
+  static size_t
+    arenaBytes(int n, size_t size)
+    {
+      return (n*size + 63) & ~(size_t)63;
+    }
+
   void
     NavFn::setNavArr(int xs, int ys)
     {
@@ -198,25 +210,25 @@ namespace navfn {
       ny = ys;
       ns = nx*ny;
 
-      if(costarr)
-        delete[] costarr;
-      if(potarr)
-        delete[] potarr;
-      if(pending)
-        delete[] pending;
-
-      if(gradx)
-        delete[] gradx;
-      if(grady)
-        delete[] grady;
+      // the arena is only reallocated when the map outgrows it, planning again on a map of the same size or a
+      // smaller one reuses it
+      size_t floats = arenaBytes(ns, sizeof(float));
+      size_t costs = arenaBytes(ns, sizeof(COSTTYPE));
+      if (ns > arenaCells)
+      {
+        if(arena)
+          delete[] arena;
+        arena = new char[3*floats + costs + arenaBytes(ns, sizeof(bool))];
+        arenaCells = ns;
+      }
 
-      costarr = new COSTTYPE[ns]; // cost array, 2d config space
+      potarr = (float *)arena;	// navigation potential array
+      gradx = (float *)(arena + floats);
+      grady = (float *)(arena + 2*floats);
+      costarr = (COSTTYPE *)(arena + 3*floats); // cost array, 2d config space
       memset(costarr, 0, ns*sizeof(COSTTYPE));
-      potarr = new float[ns];	// navigation potential array
-      pending = new bool[ns];
+      pending = (bool *)(arena + 3*floats + costs);
       memset(pending, 0, ns*sizeof(bool));
-      gradx = new float[ns];
-      grady = new float[ns];
     }
 
 
@@ -224,63 +236,61 @@ namespace navfn {
   // set up cost array, usually from ROS
   //
 
+  // This transforms the incoming cost values:
+  // COST_OBS                 -> COST_OBS (incoming "lethal obstacle")
+  // COST_OBS_ROS             -> COST_OBS (incoming "inscribed inflated obstacle")
+  // values in range 0 to 252 -> values from COST_NEUTRAL to COST_OBS_ROS.
+  static COSTTYPE
+    translateCost(int v, bool allow_unknown)
+    {
+      if (v < COST_OBS_ROS)
+      {
+        v = COST_NEUTRAL+COST_FACTOR*v;
+        if (v >= COST_OBS)
+          v = COST_OBS-1;
+        return v;
+      }
+      else if(v == COST_UNKNOWN_ROS && allow_unknown)
+        return COST_OBS-1;
+      return COST_OBS;
+    }
+
+  // translation through a table of the values 0 to 255, which leaves the loops over the map without branches
+  // when COSTTYPE is unsigned char
+  static inline COSTTYPE
+    translateCost(const COSTTYPE *table, int v, bool allow_unknown)
+    {
+      if (v >= 0 && v < 256)
+        return table[v];
+      return translateCost(v, allow_unknown);
+    }
+
   void
     NavFn::setCostmap(const COSTTYPE *cmap, bool isROS, bool allow_unknown)
     {
+      if (!isROS)
+        allow_unknown = true;
+      COSTTYPE table[256];
+      for (int v=0; v<256; v++)
+        table[v] = translateCost(v, allow_unknown);
+
       COSTTYPE *cm = costarr;
       if (isROS)			// ROS-type cost array
       {
-        for (int i=0; i<ny; i++)
-        {
-          int k=i*nx;
-          for (int j=0; j<nx; j++, k++, cmap++, cm++)
-          {
-            // This transforms the incoming cost values:
-            // COST_OBS                 -> COST_OBS (incoming "lethal obstacle")
-            // COST_OBS_ROS             -> COST_OBS (incoming "inscribed inflated obstacle")
-            // values in range 0 to 252 -> values from COST_NEUTRAL to COST_OBS_ROS.
-            *cm = COST_OBS;
-            int v = *cmap;
-            if (v < COST_OBS_ROS)
-            {
-              v = COST_NEUTRAL+COST_FACTOR*v;
-              if (v >= COST_OBS)
-                v = COST_OBS-1;
-              *cm = v;
-            }
-            else if(v == COST_UNKNOWN_ROS && allow_unknown)
-            {
-              v = COST_OBS-1;
-              *cm = v;
-            }
-          }
-        }
+        for (int k=0; k<ns; k++)
+          cm[k] = translateCost(table, cmap[k], allow_unknown);
       }
 
       else				// not a ROS map, just a PGM
       {
-        for (int i=0; i<ny; i++)
+        for (int i=0; i<ny; i++, cmap+=nx, cm+=nx)
         {
-          int k=i*nx;
-          for (int j=0; j<nx; j++, k++, cmap++, cm++)
-          {
-            *cm = COST_OBS;
-            if (i<7 || i > ny-8 || j<7 || j > nx-8)
-              continue;	// don't do borders
-            int v = *cmap;
-            if (v < COST_OBS_ROS)
-            {
-              v = COST_NEUTRAL+COST_FACTOR*v;
-              if (v >= COST_OBS)
-                v = COST_OBS-1;
-              *cm = v;
-            }
-            else if(v == COST_UNKNOWN_ROS)
-            {
-              v = COST_OBS-1;
-              *cm = v;
-            }
-          }
+          for (int j=0; j<nx; j++)
+            cm[j] = COST_OBS;
+          if (i<7 || i > ny-8)
+            continue;	// don't do borders
+          for (int j=7; j<=nx-8; j++)
+            cm[j] = translateCost(table, cmap[j], allow_unknown);
         }
 
       }
@@ -311,6 +321,43 @@ namespace navfn {
     }
 
 
+  bool
+    NavFn::calcNavFnSweep()
+    {
+      setupNavFn(true);
+
+      // calculate the nav fn and path
+      propNavFnSweep(std::max(nx*ny/20,nx+ny));
+
+      // path
+      int len = calcPath(nx*ny/2);
+
+      if (len > 0)			// found plan
+      {
+        ROS_DEBUG("[NavFn] Path found, %d steps\n", len);
+        return true;
+      }
+      else
+      {
+        ROS_DEBUG("[NavFn] No path found\n");
+        return false;
+      }
+    }
+
+
+  void
+    NavFn::setSweepThreads(int threads)
+    {
+      if (threads <= 0)
+        threads = boost::thread::hardware_concurrency();
+      if (sweepPool && sweepThreads == threads)
+        return;
+      delete sweepPool;
+      sweepPool = new costmap_2d::ThreadPool(std::max(threads, 1));
+      sweepThreads = threads;
+    }
+
+
   //
   // calculate navigation function, given a costmap, goal, and start
   //
@@ -347,16 +394,39 @@ namespace navfn {
   float *NavFn::getPathY() { return pathy; }
   int    NavFn::getPathLen() { return npath; }
 
-  // inserting onto the priority blocks
+  // inserting onto the priority blocks, which grow instead of dropping cells
 #define push_cur(n)  { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && curPe<PRIORITYBUFSIZE) \
-  { curP[curPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (curPe==pbSize) growPriorityBufs(); \
+    curP[curPe++]=n; pending[n]=true; }}
 #define push_next(n) { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && nextPe<PRIORITYBUFSIZE) \
-  { nextP[nextPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (nextPe==pbSize) growPriorityBufs(); \
+    nextP[nextPe++]=n; pending[n]=true; }}
 #define push_over(n) { if (n>=0 && n<ns && !pending[n] && \
-    costarr[n]<COST_OBS && overPe<PRIORITYBUFSIZE) \
-  { overP[overPe++]=n; pending[n]=true; }}
+    costarr[n]<COST_OBS) \
+  { if (overPe==pbSize) growPriorityBufs(); \
+    overP[overPe++]=n; pending[n]=true; }}
+
+
+  void
+    NavFn::growPriorityBufs()
+    {
+      ROS_DEBUG("[NavFn] Growing priority buffers to %d cells\n", 2*pbSize);
+      int **bufs[3] = { &pb1, &pb2, &pb3 };
+      for (int b=0; b<3; b++)
+      {
+        int *old = *bufs[b];
+        int *pb = new int[2*pbSize];
+        memcpy(pb, old, pbSize*sizeof(int));
+        if (curP == old) curP = pb;
+        if (nextP == old) nextP = pb;
+        if (overP == old) overP = pb;
+        delete[] old;
+        *bufs[b] = pb;
+      }
+      pbSize *= 2;
+    }
 
 
   // Set up navigation potential arrays for new propagation
@@ -436,6 +506,31 @@ namespace navfn {
 
 #define INVSQRT2 0.707106781
 
+  // Planar-wave potential of a cell with traversability factor <hf>, from the
+  //   lowest of its up and down neighbors <ta> and the lowest of its left and
+  //   right neighbors <tc>; shared by the wavefront and the sweeping updates
+  static inline float
+    planarWave(float ta, float tc, float hf)
+    {
+      float dc = tc-ta;		// relative cost between ta,tc
+      if (dc < 0) 		// ta is lowest
+      {
+        dc = -dc;
+        ta = tc;
+      }
+
+      if (dc >= hf)		// if too large, use ta-only update
+        return ta+hf;
+
+      // two-neighbor interpolation update
+      // use quadratic approximation
+      // might speed this up through table lookup, but still have to 
+      //   do the divide
+      float d = dc/hf;
+      float v = -0.2301*d*d + 0.5307*d + 0.7040;
+      return ta + hf*v;
+    }
+
   inline void
     NavFn::updateCell(int n)
     {
@@ -457,27 +552,8 @@ namespace navfn {
       // do planar wave update
       if (costarr[n] < COST_OBS)	// don't propagate into obstacles
       {
-        float hf = (float)costarr[n]; // traversability factor
-        float dc = tc-ta;		// relative cost between ta,tc
-        if (dc < 0) 		// ta is lowest
-        {
-          dc = -dc;
-          ta = tc;
-        }
-
         // calculate new potential
-        float pot;
-        if (dc >= hf)		// if too large, use ta-only update
-          pot = ta+hf;
-        else			// two-neighbor interpolation update
-        {
-          // use quadratic approximation
-          // might speed this up through table lookup, but still have to 
-          //   do the divide
-          float d = dc/hf;
-          float v = -0.2301*d*d + 0.5307*d + 0.7040;
-          pot = ta + hf*v;
-        }
+        float pot = planarWave(ta, tc, (float)costarr[n]);
 
         //      ROS_INFO("[Update] new pot: %d\n", costarr[n]);
 
@@ -542,27 +618,8 @@ namespace navfn {
       // do planar wave update
       if (costarr[n] < COST_OBS)	// don't propagate into obstacles
       {
-        float hf = (float)costarr[n]; // traversability factor
-        float dc = tc-ta;		// relative cost between ta,tc
-        if (dc < 0) 		// ta is lowest
-        {
-          dc = -dc;
-          ta = tc;
-        }
-
         // calculate new potential
-        float pot;
-        if (dc >= hf)		// if too large, use ta-only update
-          pot = ta+hf;
-        else			// two-neighbor interpolation update
-        {
-          // use quadratic approximation
-          // might speed this up through table lookup, but still have to 
-          //   do the divide
-          float d = dc/hf;
-          float v = -0.2301*d*d + 0.5307*d + 0.7040;
-          pot = ta + hf*v;
-        }
+        float pot = planarWave(ta, tc, (float)costarr[n]);
 
         //ROS_INFO("[Update] new pot: %d\n", costarr[n]);
 
@@ -638,11 +695,9 @@ namespace navfn {
         while (i-- > 0)		
           pending[*(pb++)] = false;
 
-        // process current priority buffer
-        pb = curP; 
-        i = curPe;
-        while (i-- > 0)		
-          updateCell(*pb++);
+        // process current priority buffer, by index since updating a cell can grow the buffers
+        for (i=0; i<curPe; i++)
+          updateCell(curP[i]);
 
         if (displayInt > 0 &&  (cycle % displayInt) == 0)
           displayFn(this);
@@ -679,6 +734,150 @@ namespace navfn {
     }
 
 
+  //
+  // parallel propagation function
+  // fast sweeping, the map is cut into square tiles of <sweepTile> cells,
+  //   and each tile is swept row by row in all four diagonal directions
+  //   with the same planar-wave update as updateCell(), until a sweep in
+  //   every direction leaves it unchanged
+  // a tile is swept again when a cell along its border with a neighbor tile
+  //   got lower in that neighbor
+  // tiles are colored like a checkerboard, all the tiles of one color that
+  //   need sweeping are swept at the same time on the threads of sweepPool;
+  //   they never share a cell, nor a border cell that the other one reads
+  // runs for a specified number of rounds of both colors,
+  //   or until no tile needs sweeping
+  // the result is the fixed point of the update over the whole map, which
+  //   the priority blocks of propNavFnDijkstra() stop short of in places
+  //
+
+  // borders of a sweeping tile
+#define SWEEP_LEFT 1
+#define SWEEP_RIGHT 2
+#define SWEEP_UP 4
+#define SWEEP_DOWN 8
+
+  bool
+    NavFn::propNavFnSweep(int cycles)
+    {
+      if (!sweepPool)
+        setSweepThreads(sweepThreads);
+
+      sweepTilesX = (nx + sweepTile - 1)/sweepTile;
+      sweepTilesY = (ny + sweepTile - 1)/sweepTile;
+      int ntiles = sweepTilesX*sweepTilesY;
+      sweepActive.assign(ntiles, false);
+      sweepBorders.assign(ntiles, 0);
+
+      // start from the tile of the goal
+      sweepActive[goal[1]/sweepTile*sweepTilesX + goal[0]/sweepTile] = true;
+
+      int nt = 0;			// number of tiles swept
+      int cycle = 0;		// which round we're on
+      for (; cycle < cycles; cycle++)
+      {
+        bool swept = false;
+        for (int color = 0; color < 2; color++)
+        {
+          sweepList.clear();
+          for (int t = 0; t < ntiles; t++)
+            if (sweepActive[t] && (t%sweepTilesX + t/sweepTilesX)%2 == color)
+            {
+              sweepList.push_back(t);
+              sweepActive[t] = false;
+            }
+          if (sweepList.empty())
+            continue;
+          swept = true;
+          nt += sweepList.size();
+          sweepPool->run(sweepList.size(), boost::bind(&NavFn::sweepTileCells, this, _1));
+
+          // wake up the neighbors across the borders that changed
+          for (unsigned int i = 0; i < sweepList.size(); i++)
+          {
+            int t = sweepList[i];
+            int tx = t%sweepTilesX, ty = t/sweepTilesX;
+            unsigned char b = sweepBorders[t];
+            if ((b & SWEEP_LEFT) && tx > 0) sweepActive[t-1] = true;
+            if ((b & SWEEP_RIGHT) && tx < sweepTilesX-1) sweepActive[t+1] = true;
+            if ((b & SWEEP_UP) && ty > 0) sweepActive[t-sweepTilesX] = true;
+            if ((b & SWEEP_DOWN) && ty < sweepTilesY-1) sweepActive[t+sweepTilesX] = true;
+          }
+        }
+        if (!swept)
+          break;
+      }
+
+      ROS_DEBUG("[NavFn] Used %d rounds, %d tiles swept, %d threads\n", cycle, nt, sweepPool->getNumThreads());
+
+      if (cycle < cycles) return true; // finished up here
+      else return false;
+    }
+
+
+  // sweep the <i>th tile of the current color until it stops changing
+
+  void
+    NavFn::sweepTileCells(unsigned int i)
+    {
+      static const int dirs[4][2] = { { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+      int t = sweepList[i];
+      sweepBorders[t] = 0;
+      for (int d = 0, unchanged = 0; unchanged < 4; d = (d+1)%4)
+      {
+        if (sweepTileOnce(t, dirs[d][0], dirs[d][1]))
+          unchanged = 0;
+        else
+          unchanged++;
+      }
+    }
+
+
+  // one sweep over tile <t> in direction <dx>,<dy>, returns true if a cell got lower
+
+  bool
+    NavFn::sweepTileOnce(int t, int dx, int dy)
+    {
+      int x0 = t%sweepTilesX*sweepTile, y0 = t/sweepTilesX*sweepTile;
+      int xn = std::min(x0+sweepTile, nx) - 1, yn = std::min(y0+sweepTile, ny) - 1;
+
+      // the update reads all four neighbors, the outer bounds are obstacles anyway
+      int ux0 = std::max(x0, 1), uy0 = std::max(y0, 1);
+      int uxn = std::min(xn, nx-2), uyn = std::min(yn, ny-2);
+
+      unsigned char borders = 0;
+      bool changed = false;
+      for (int j = 0; j <= uyn-uy0; j++)
+      {
+        int y = dy > 0 ? uy0+j : uyn-j;
+        for (int i = 0; i <= uxn-ux0; i++)
+        {
+          int x = dx > 0 ? ux0+i : uxn-i;
+          int n = x + y*nx;
+          if (costarr[n] >= COST_OBS)	// don't propagate into obstacles
+            continue;
+
+          float ta, tc;
+          float l = potarr[n-1], r = potarr[n+1], u = potarr[n-nx], d = potarr[n+nx];
+          if (l<r) tc=l; else tc=r;
+          if (u<d) ta=u; else ta=d;
+          float pot = planarWave(ta, tc, (float)costarr[n]);
+          if (pot >= potarr[n])
+            continue;
+
+          potarr[n] = pot;
+          changed = true;
+          if (x == x0) borders |= SWEEP_LEFT;
+          if (x == xn) borders |= SWEEP_RIGHT;
+          if (y == y0) borders |= SWEEP_UP;
+          if (y == yn) borders |= SWEEP_DOWN;
+        }
+      }
+      sweepBorders[t] |= borders;
+      return changed;
+    }
+
+
   //
   // main propagation function
   // A* method, best-first
@@ -720,11 +919,9 @@ namespace navfn {
         while (i-- > 0)		
           pending[*(pb++)] = false;
 
-        // process current priority buffer
-        pb = curP; 
-        i = curPe;
-        while (i-- > 0)		
-          updateCellAstar(*pb++);
+        // process current priority buffer, by index since updating a cell can grow the buffers
+        for (i=0; i<curPe; i++)
+          updateCellAstar(curP[i]);
 
         if (displayInt > 0 &&  (cycle % displayInt) == 0)
           displayFn(this);
@@ -46,16 +46,16 @@ PLUGINLIB_EXPORT_CLASS(navfn::NavfnROS, nav_core::BaseGlobalPlanner)
 namespace navfn {
 
   NavfnROS::NavfnROS() 
-    : costmap_(NULL),  planner_(), initialized_(false), allow_unknown_(true) {}
+    : costmap_(NULL),  planner_(), initialized_(false), allow_unknown_(true), costmap_ros_(NULL), use_fast_sweeping_(false) {}
 
   NavfnROS::NavfnROS(std::string name, costmap_2d::Costmap2DROS* costmap_ros)
-    : costmap_(NULL),  planner_(), initialized_(false), allow_unknown_(true) {
+    : costmap_(NULL),  planner_(), initialized_(false), allow_unknown_(true), costmap_ros_(NULL), use_fast_sweeping_(false) {
       //initialize the planner
       initialize(name, costmap_ros);
   }
 
   NavfnROS::NavfnROS(std::string name, costmap_2d::Costmap2D* costmap, std::string global_frame)
-    : costmap_(NULL),  planner_(), initialized_(false), allow_unknown_(true) {
+    : costmap_(NULL),  planner_(), initialized_(false), allow_unknown_(true), costmap_ros_(NULL), use_fast_sweeping_(false) {
       //initialize the planner
       initialize(name, costmap, global_frame);
   }
@@ -81,6 +81,15 @@ namespace navfn {
       private_nh.param("planner_window_y", planner_window_y_, 0.0);
       private_nh.param("default_tolerance", default_tolerance_, 0.0);
 
+      //sweeping fills the potential of the whole map on several threads, even when planning stops at the robot.
+      //On a single core it is slower than dijkstra, see NavFn::propNavFnSweep.
+      private_nh.param("use_fast_sweeping", use_fast_sweeping_, false);
+      if(use_fast_sweeping_){
+        int sweep_threads;
+        private_nh.param("sweep_threads", sweep_threads, 0);
+        planner_->setSweepThreads(sweep_threads);
+      }
+
       make_plan_srv_ =  private_nh.advertiseService("make_plan", &NavfnROS::makePlanService, this);
 
       initialized_ = true;
@@ -90,9 +99,33 @@ namespace navfn {
   }
 
   void NavfnROS::initialize(std::string name, costmap_2d::Costmap2DROS* costmap_ros){
+    if(costmap_ros->usesSnapshots()){
+      //plan on the latest snapshot, which is picked up before each plan, instead of the live costmap. Until
+      //the first one is published, plan on a copy of the live costmap that nobody else reads.
+      costmap_ros_ = costmap_ros;
+      boost::shared_ptr<costmap_2d::Costmap2D> copy;
+      {
+        boost::unique_lock<costmap_2d::Costmap2D::mutex_t> lock(*(costmap_ros->getCostmap()->getMutex()));
+        copy.reset(new costmap_2d::Costmap2D(*(costmap_ros->getCostmap())));
+      }
+      snapshot_ = copy;
+      initialize(name, copy.get(), costmap_ros->getGlobalFrameID());
+      return;
+    }
     initialize(name, costmap_ros->getCostmap(), costmap_ros->getGlobalFrameID());
   }
 
+  void NavfnROS::refreshSnapshot(){
+    if(!costmap_ros_)
+      return;
+
+    boost::shared_ptr<const costmap_2d::Costmap2D> snapshot = costmap_ros_->getSnapshot();
+    if(snapshot){
+      snapshot_ = snapshot;
+      costmap_ = snapshot.get();
+    }
+  }
+
   bool NavfnROS::validPointPotential(const geometry_msgs::Point& world_point){
     return validPointPotential(world_point, default_tolerance_);
   }
@@ -144,6 +177,8 @@ namespace navfn {
       return false;
     }
 
+    refreshSnapshot();
+
     //make sure to resize the underlying array that Navfn uses
     planner_->setNavArr(costmap_->getSizeInCellsX(), costmap_->getSizeInCellsY());
     planner_->setCostmap(costmap_->getCharMap(), true, allow_unknown_);
@@ -163,6 +198,8 @@ namespace navfn {
     planner_->setStart(map_start);
     planner_->setGoal(map_goal);
 
+    if(use_fast_sweeping_)
+      return planner_->calcNavFnSweep();
     return planner_->calcNavFnDijkstra();
   }
 
@@ -172,8 +209,9 @@ namespace navfn {
       return;
     }
 
-    //set the associated costs in the cost map to be free
-    costmap_->setCost(mx, my, costmap_2d::FREE_SPACE);
+    //set the associated cost to be free in the planner's own copy of the costs, since the costmap may be
+    //shared with other readers
+    planner_->costarr[my * planner_->nx + mx] = COST_NEUTRAL;  //what setCostmap makes of FREE_SPACE
   }
 
   bool NavfnROS::makePlanService(nav_msgs::GetPlan::Request& req, nav_msgs::GetPlan::Response& resp){
@@ -203,6 +241,8 @@ namespace navfn {
       return false;
     }
 
+    refreshSnapshot();
+
     //clear the plan, just in case
     plan.clear();
 
@@ -230,13 +270,13 @@ namespace navfn {
       return false;
     }
 
-    //clear the starting cell within the costmap because we know it can't be an obstacle
-    clearRobotCell(start, mx, my);
-
     //make sure to resize the underlying array that Navfn uses
     planner_->setNavArr(costmap_->getSizeInCellsX(), costmap_->getSizeInCellsY());
     planner_->setCostmap(costmap_->getCharMap(), true, allow_unknown_);
 
+    //clear the starting cell within the costmap because we know it can't be an obstacle
+    clearRobotCell(start, mx, my);
+
     int map_start[2];
     map_start[0] = mx;
     map_start[1] = my;
@@ -261,7 +301,10 @@ namespace navfn {
     planner_->setGoal(map_start);
 
     //bool success = planner_->calcNavFnAstar();
-    planner_->calcNavFnDijkstra(true);
+    if(use_fast_sweeping_)
+      planner_->calcNavFnSweep();
+    else
+      planner_->calcNavFnDijkstra(true);
 
     double resolution = costmap_->getResolution();
     geometry_msgs::PoseStamped p, best_pose;
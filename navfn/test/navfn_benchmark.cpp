@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Benchmark of NavFn on a costmap saved as a binary PGM holding the raw
+ * costs (test/willow_costmap.pgm by default), read with the loader of the
+ * tests, or on open space. The map is repeated tiles x tiles times to get
+ * site sized maps. Every plan goes through setNavArr(), setCostmap() and
+ * calcNavFnDijkstra() between random free cells like NavfnROS::makePlan,
+ * and each step is timed on its own. One full propagation from the middle
+ * of the map then reports how much of it the wavefront reached, and how far
+ * the priority buffers had to grow. On open space a few thousand cells
+ * across, fixed size buffers used to drop cells there.
+ *
+ * Usage: rosrun navfn navfn_benchmark [costmap.pgm|open] [tiles] [plans]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <ros/package.h>
+#include <navfn/navfn.h>
+#include <navfn/read_pgm_costmap.h>
+
+int main(int argc, char** argv)
+{
+  std::string filename = argc > 1 ? argv[1] : ros::package::getPath(ROS_PACKAGE_NAME) + "/test/willow_costmap.pgm";
+  int tiles = argc > 2 ? atoi(argv[2]) : 1;
+  int plans = argc > 3 ? atoi(argv[3]) : 20;
+
+  int tx, ty;
+  COSTTYPE* tile;
+  if (filename == "open")
+  {
+    tx = ty = 1000;
+    tile = (COSTTYPE*)calloc(tx * ty, sizeof(COSTTYPE));
+  }
+  else
+  {
+    tile = readPGM(filename.c_str(), &tx, &ty, true);
+    if (tile == NULL)
+      return 1;
+  }
+
+  int nx = tx * tiles, ny = ty * tiles;
+  std::vector<COSTTYPE> costs(nx * ny);
+  for (int y = 0; y < ny; ++y)
+    for (int x = 0; x < nx; ++x)
+      costs[x + y * nx] = tile[x % tx + (y % ty) * tx];
+  free(tile);
+
+  printf("map: %d x %d cells, %d plans\n", nx, ny, plans);
+
+  navfn::NavFn nav(nx, ny);
+  double arrays_time = 0.0, costmap_time = 0.0, plan_time = 0.0;
+  int found = 0, first_goal = -1;
+  srand(7);
+  for (int n = 0; n < plans; ++n)
+  {
+    ros::WallTime begin = ros::WallTime::now();
+    nav.setNavArr(nx, ny);
+    arrays_time += (ros::WallTime::now() - begin).toSec();
+
+    begin = ros::WallTime::now();
+    nav.setCostmap(&costs[0], true, true);
+    costmap_time += (ros::WallTime::now() - begin).toSec();
+
+    int goal[2], start[2];
+    do
+    {
+      goal[0] = rand() % nx;
+      goal[1] = rand() % ny;
+    }
+    while (nav.costarr[goal[0] + goal[1] * nx] >= COST_OBS);
+    do
+    {
+      start[0] = rand() % nx;
+      start[1] = rand() % ny;
+    }
+    while (nav.costarr[start[0] + start[1] * nx] >= COST_OBS);
+    if (first_goal < 0)
+      first_goal = goal[0] + goal[1] * nx;
+    nav.setGoal(goal);
+    nav.setStart(start);
+
+    begin = ros::WallTime::now();
+    if (nav.calcNavFnDijkstra(true))
+      found++;
+    plan_time += (ros::WallTime::now() - begin).toSec();
+  }
+
+  printf("setNavArr:          %8.2f ms/plan\n", 1e3 * arrays_time / plans);
+  printf("setCostmap:         %8.2f ms/plan\n", 1e3 * costmap_time / plans);
+  printf("calcNavFnDijkstra:  %8.2f ms/plan, %d of %d found\n", 1e3 * plan_time / plans, found, plans);
+
+  // the whole map, from its middle where the wavefront gets the longest
+  int goal[2] = { nx / 2, ny / 2 };
+  if (nav.costarr[goal[0] + goal[1] * nx] >= COST_OBS)
+  {
+    goal[0] = first_goal % nx;
+    goal[1] = first_goal / nx;
+  }
+  nav.setGoal(goal);
+  nav.setStart(goal);
+  ros::WallTime begin = ros::WallTime::now();
+  nav.setupNavFn(true);
+  nav.propNavFnDijkstra(nx * ny, false);
+  double full_time = (ros::WallTime::now() - begin).toSec();
+  int reached = 0, free_cells = 0;
+  for (int i = 0; i < nx * ny; ++i)
+  {
+    if (nav.costarr[i] >= COST_OBS)
+      continue;
+    free_cells++;
+    if (nav.potarr[i] < POT_HIGH)
+      reached++;
+  }
+  printf("full propagation:   %8.2f ms, %d of %d free cells reached, priority buffers of %d cells\n",
+         1e3 * full_time, reached, free_cells, nav.pbSize);
+
+  return 0;
+}
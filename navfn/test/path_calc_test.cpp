@@ -27,7 +27,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <cstdlib>
 #include <string>
+#include <vector>
 #include <ros/package.h>
 #include <gtest/gtest.h>
 #include <navfn/navfn.h>
@@ -153,6 +156,161 @@ TEST(PathCalc, easy_nav_should_always_work)
   EXPECT_TRUE( nav->calcNavFnDijkstra( true ));
 }
 
+TEST(PathCalc, open_space_reaches_every_cell)
+{
+  // the wavefront around a goal in the middle of open space this big is wider than the initial priority buffers
+  int size = 3000;
+  std::vector<COSTTYPE> cmap( size * size, 0 );
+  navfn::NavFn nav( size, size );
+  nav.setCostmap( &cmap[0] );
+
+  int goal[2] = { size / 2, size / 2 };
+  nav.setGoal( goal );
+  nav.setStart( goal );
+  nav.setupNavFn( true );
+  nav.propNavFnDijkstra( size * size, false );
+
+  int unreached = 0;
+  for( int i = 0; i < size * size; i++ )
+  {
+    if( nav.costarr[ i ] < COST_OBS && nav.potarr[ i ] >= POT_HIGH )
+    {
+      unreached++;
+    }
+  }
+  EXPECT_EQ( 0, unreached );
+  EXPECT_GT( nav.pbSize, PRIORITYBUFSIZE );
+}
+
+// A map of random costs with scattered obstacles, and a goal in free space
+void make_random_nav( navfn::NavFn& nav, unsigned int seed )
+{
+  srand( seed );
+  int nx = nav.nx, ny = nav.ny;
+  for( int i = 0; i < nx * ny; i++ )
+  {
+    nav.costarr[ i ] = COST_NEUTRAL + rand() % ( seed % 2 ? 1 : 150 );
+  }
+  for( int k = 0; k < nx * ny / 200; k++ )
+  {
+    int x = rand() % nx, y = rand() % ny;
+    int w = 1 + rand() % 8, h = 1 + rand() % 3;
+    if( rand() % 2 )
+    {
+      std::swap( w, h );
+    }
+    for( int j = y; j < y + h && j < ny; j++ )
+    {
+      for( int i = x; i < x + w && i < nx; i++ )
+      {
+        nav.costarr[ j * nx + i ] = COST_OBS;
+      }
+    }
+  }
+
+  int goal[2];
+  do
+  {
+    goal[0] = 1 + rand() % ( nx - 2 );
+    goal[1] = 1 + rand() % ( ny - 2 );
+  }
+  while( nav.costarr[ goal[1] * nx + goal[0] ] >= COST_OBS );
+  nav.setGoal( goal );
+  nav.setStart( goal );
+}
+
+// How much higher a swept potential may come out than the wavefront's
+static const float SWEEP_HIGHER_TOLERANCE = 2.0;
+// How much lower, relative to the wavefront's potential; sweeping reaches the fixed point of the update that the
+// priority blocks stop short of, which makes most cells lower, far cells by up to about 7%
+static const float SWEEP_LOWER_TOLERANCE = 0.1;
+
+TEST(PathCalc, sweep_matches_dijkstra)
+{
+  int cells = 0, lower = 0, higher = 0;
+  for( unsigned int seed = 0; seed < 100; seed++ )
+  {
+    int nx = 60 + seed * 7 % 100, ny = 50 + seed * 13 % 100;
+    navfn::NavFn nav( nx, ny );
+    make_random_nav( nav, seed );
+
+    nav.setupNavFn( true );
+    ASSERT_TRUE( nav.propNavFnDijkstra( nx * ny, false ));
+    std::vector<float> expected( nav.potarr, nav.potarr + nx * ny );
+
+    nav.setSweepThreads( 1 + seed % 4 );
+    nav.setupNavFn( true );
+    ASSERT_TRUE( nav.propNavFnSweep( nx * ny ));
+
+    for( int i = 0; i < nx * ny; i++ )
+    {
+      // the same cells are reached
+      ASSERT_EQ( expected[ i ] < POT_HIGH, nav.potarr[ i ] < POT_HIGH ) << "seed " << seed << " cell " << i;
+      if( expected[ i ] >= POT_HIGH )
+      {
+        continue;
+      }
+      EXPECT_LE( nav.potarr[ i ], expected[ i ] + SWEEP_HIGHER_TOLERANCE ) << "seed " << seed << " cell " << i;
+      EXPECT_GE( nav.potarr[ i ], expected[ i ] * ( 1 - SWEEP_LOWER_TOLERANCE )) << "seed " << seed << " cell " << i;
+      cells++;
+      if( nav.potarr[ i ] < expected[ i ] )
+      {
+        lower++;
+      }
+      else if( nav.potarr[ i ] > expected[ i ] )
+      {
+        higher++;
+      }
+    }
+  }
+
+  // both ways of coming out different are exercised
+  EXPECT_GT( lower, cells / 2 );
+  EXPECT_GT( higher, 0 );
+}
+
+TEST(PathCalc, sweep_same_on_any_number_of_threads)
+{
+  int nx = 250, ny = 230;
+  navfn::NavFn nav( nx, ny );
+  make_random_nav( nav, 7 );
+  nav.sweepTile = 16;
+
+  nav.setSweepThreads( 1 );
+  nav.setupNavFn( true );
+  nav.propNavFnSweep( nx * ny );
+  std::vector<float> expected( nav.potarr, nav.potarr + nx * ny );
+
+  nav.setSweepThreads( 4 );
+  nav.setupNavFn( true );
+  nav.propNavFnSweep( nx * ny );
+  for( int i = 0; i < nx * ny; i++ )
+  {
+    ASSERT_EQ( expected[ i ], nav.potarr[ i ] ) << "cell " << i;
+  }
+}
+
+TEST(PathCalc, sweep_finds_plan)
+{
+  int nx = 200, ny = 150;
+  navfn::NavFn nav( nx, ny );
+  make_random_nav( nav, 3 );
+  int start[2] = { nav.goal[0], nav.goal[1] };
+  srand( 4 );
+  do
+  {
+    start[0] = 1 + rand() % ( nx - 2 );
+    start[1] = 1 + rand() % ( ny - 2 );
+  }
+  while( nav.costarr[ start[1] * nx + start[0] ] >= COST_OBS );
+  nav.setStart( start );
+
+  bool dijkstra = nav.calcNavFnDijkstra();
+  EXPECT_EQ( dijkstra, nav.calcNavFnSweep() );
+  EXPECT_TRUE( nav.calcNavFnSweep() );
+  EXPECT_GT( nav.getPathLen(), 0 );
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
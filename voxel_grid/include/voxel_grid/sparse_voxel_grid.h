@@ -0,0 +1,490 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#ifndef VOXEL_GRID_SPARSE_VOXEL_GRID_H
+#define VOXEL_GRID_SPARSE_VOXEL_GRID_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+#include <voxel_grid/voxel_grid.h>
+
+namespace voxel_grid
+{
+
+/**
+ * @class SparseVoxelGrid
+ * @brief A 3D grid with up to 64 voxels per column that only allocates
+ *        memory for the parts of the map which have been observed.
+ *
+ * Columns are stored in square tiles of TILE_SIZE x TILE_SIZE cells. A tile
+ * is allocated the first time one of its voxels is marked or cleared, every
+ * voxel of a tile that was never touched is unknown. The interface matches
+ * VoxelGrid's, and lines are traced with the same 3D Bresenham walk, so both
+ * grids mark and clear exactly the same voxels.
+ */
+class SparseVoxelGrid
+{
+public:
+  static const unsigned int MAX_SIZE_Z = 64;
+  static const unsigned int TILE_BITS = 4;
+  static const unsigned int TILE_SIZE = 1 << TILE_BITS;
+
+  /**
+   * @brief  Constructor for a sparse voxel grid
+   * @param size_x The x size of the grid
+   * @param size_y The y size of the grid
+   * @param size_z The z size of the grid, only sizes <= 64 are supported
+   */
+  SparseVoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+
+  ~SparseVoxelGrid();
+
+  /**
+   * @brief  Resizes the grid, all voxels become unknown
+   * @param size_x The x size of the grid
+   * @param size_y The y size of the grid
+   * @param size_z The z size of the grid, only sizes <= 64 are supported
+   */
+  void resize(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+
+  /**
+   * @brief  Makes every voxel unknown. The tiles are kept for reuse rather than freed.
+   */
+  void reset();
+
+  inline void markVoxel(unsigned int x, unsigned int y, unsigned int z)
+  {
+    if (x >= size_x_ || y >= size_y_ || z >= size_z_)
+    {
+      ROS_DEBUG("Error, voxel out of bounds.\n");
+      return;
+    }
+    Tile* tile = getTile(x, y);
+    unsigned int col = columnIndex(x, y);
+    tile->marked[col] |= (uint64_t)1 << z;
+    tile->unknown[col] &= ~((uint64_t)1 << z);
+  }
+
+  inline bool markVoxelInMap(unsigned int x, unsigned int y, unsigned int z, unsigned int marked_threshold)
+  {
+    if (x >= size_x_ || y >= size_y_ || z >= size_z_)
+    {
+      ROS_DEBUG("Error, voxel out of bounds.\n");
+      return false;
+    }
+    Tile* tile = getTile(x, y);
+    unsigned int col = columnIndex(x, y);
+    tile->marked[col] |= (uint64_t)1 << z;
+    tile->unknown[col] &= ~((uint64_t)1 << z);
+
+    //make sure the number of bits in each is below our thesholds
+    return !bitsBelowThreshold(tile->marked[col], marked_threshold);
+  }
+
+  inline void clearVoxel(unsigned int x, unsigned int y, unsigned int z)
+  {
+    if (x >= size_x_ || y >= size_y_ || z >= size_z_)
+    {
+      ROS_DEBUG("Error, voxel out of bounds.\n");
+      return;
+    }
+    Tile* tile = getTile(x, y);
+    unsigned int col = columnIndex(x, y);
+    tile->marked[col] &= ~((uint64_t)1 << z);
+    tile->unknown[col] &= ~((uint64_t)1 << z);
+  }
+
+  /**
+   * @brief  Makes every voxel of a column free
+   * @param index The index of the column, y * size_x + x as in VoxelGrid
+   */
+  inline void clearVoxelColumn(unsigned int index)
+  {
+    ROS_ASSERT(index < size_x_ * size_y_);
+    unsigned int x = index % size_x_, y = index / size_x_;
+    Tile* tile = getTile(x, y);
+    unsigned int col = columnIndex(x, y);
+    tile->marked[col] = 0;
+    tile->unknown[col] = 0;
+  }
+
+  static inline unsigned int numBits(uint64_t n)
+  {
+    unsigned int bit_count;
+    for (bit_count = 0; n; ++bit_count)
+    {
+      n &= n - 1; //clear the least significant bit set
+    }
+    return bit_count;
+  }
+
+  static inline bool bitsBelowThreshold(uint64_t n, unsigned int bit_threshold)
+  {
+    unsigned int bit_count;
+    for (bit_count = 0; n;)
+    {
+      ++bit_count;
+      if (bit_count > bit_threshold)
+      {
+        return false;
+      }
+      n &= n - 1; //clear the least significant bit set
+    }
+    return true;
+  }
+
+  void markVoxelLine(double x0, double y0, double z0, double x1, double y1, double z1, unsigned int max_length = UINT_MAX);
+  void clearVoxelLine(double x0, double y0, double z0, double x1, double y1, double z1, unsigned int max_length = UINT_MAX);
+  void clearVoxelLineInMap(double x0, double y0, double z0, double x1, double y1, double z1, unsigned char *map_2d,
+                           unsigned int unknown_threshold, unsigned int mark_threshold,
+                           unsigned char free_cost = 0, unsigned char unknown_cost = 255, unsigned int max_length = UINT_MAX);
+
+  /**
+   * @brief  Same as VoxelGrid::clearVoxelLinesInMap(). Without parallel_for
+   *         the lines are cleared one after the other. With it, the groups of
+   *         lines are traced into windows of their own, and the windows are
+   *         applied to the tiles on the calling thread, since that may
+   *         allocate tiles.
+   */
+  void clearVoxelLinesInMap(double x0, double y0, double z0, const std::vector<GridPoint>& ends,
+                            unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+                            unsigned char free_cost = 0, unsigned char unknown_cost = 255,
+                            unsigned int max_length = UINT_MAX, const ParallelFor& parallel_for = ParallelFor());
+
+  VoxelStatus getVoxel(unsigned int x, unsigned int y, unsigned int z) const;
+
+  //Are there any obstacles at that (x, y) location in the grid?
+  VoxelStatus getVoxelColumn(unsigned int x, unsigned int y,
+                             unsigned int unknown_threshold = 0, unsigned int marked_threshold = 0) const;
+
+  /**
+   * @brief  Moves the contents of the grid for a new origin, like Costmap2D::updateOrigin
+   * @param cell_ox The x cell of the current grid that becomes the new (0, 0)
+   * @param cell_oy The y cell of the current grid that becomes the new (0, 0)
+   *
+   * Columns that move out of the grid are dropped and the ones that move in are unknown.
+   */
+  void updateOrigin(int cell_ox, int cell_oy);
+
+  /**
+   * @brief  Writes the grid in VoxelGrid's format of one uint32_t per column,
+   *         for publishing. Only the lowest 16 voxels of each column fit.
+   * @param data An array of sizeX() * sizeY() elements
+   */
+  void getPackedData(uint32_t* data) const;
+
+  /**
+   * @brief  The number of bytes used by the tiles and the tile index
+   */
+  size_t getMemoryUsage() const;
+
+  unsigned int numAllocatedTiles() const
+  {
+    return allocated_tiles_;
+  }
+
+  unsigned int sizeX() const
+  {
+    return size_x_;
+  }
+
+  unsigned int sizeY() const
+  {
+    return size_y_;
+  }
+
+  unsigned int sizeZ() const
+  {
+    return size_z_;
+  }
+
+  /**
+   * @brief  Calls at(x, y, z) for every voxel on the line, using the same
+   *         3D Bresenham walk as VoxelGrid::raytraceLine
+   */
+  template <class ActionType>
+  inline void raytraceLine(
+    ActionType& at, double x0, double y0, double z0,
+    double x1, double y1, double z1, unsigned int max_length = UINT_MAX)
+  {
+    int dx = int(x1) - int(x0);
+    int dy = int(y1) - int(y0);
+    int dz = int(z1) - int(z0);
+
+    unsigned int abs_dx = abs(dx);
+    unsigned int abs_dy = abs(dy);
+    unsigned int abs_dz = abs(dz);
+
+    int x = int(x0), y = int(y0), z = int(z0);
+
+    //we need to chose how much to scale our dominant dimension, based on the maximum length of the line
+    double dist = sqrt((x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1) + (z0 - z1) * (z0 - z1));
+    double scale = std::min(1.0,  max_length / dist);
+
+    //is x dominant
+    if (abs_dx >= std::max(abs_dy, abs_dz))
+    {
+      bresenham3D(at, x, y, z, x, y, z, abs_dx, abs_dy, abs_dz, sign(dx), sign(dy), sign(dz),
+                  (unsigned int)(scale * abs_dx));
+      return;
+    }
+
+    //y is dominant
+    if (abs_dy >= abs_dz)
+    {
+      bresenham3D(at, x, y, z, y, x, z, abs_dy, abs_dx, abs_dz, sign(dy), sign(dx), sign(dz),
+                  (unsigned int)(scale * abs_dy));
+      return;
+    }
+
+    //otherwise, z is dominant
+    bresenham3D(at, x, y, z, z, x, y, abs_dz, abs_dx, abs_dy, sign(dz), sign(dx), sign(dy),
+                (unsigned int)(scale * abs_dz));
+  }
+
+private:
+  //the walk itself, a is the dominant axis and b and c follow it
+  template <class ActionType>
+  inline void bresenham3D(
+    ActionType& at, int& x, int& y, int& z, int& a, int& b, int& c,
+    unsigned int abs_da, unsigned int abs_db, unsigned int abs_dc,
+    int step_a, int step_b, int step_c, unsigned int max_length)
+  {
+    int error_b = abs_da / 2;
+    int error_c = abs_da / 2;
+    unsigned int end = std::min(max_length, abs_da);
+    for (unsigned int i = 0; i < end; ++i)
+    {
+      at(x, y, z);
+      a += step_a;
+      error_b += abs_db;
+      error_c += abs_dc;
+      if ((unsigned int)error_b >= abs_da)
+      {
+        b += step_b;
+        error_b -= abs_da;
+      }
+      if ((unsigned int)error_c >= abs_da)
+      {
+        c += step_c;
+        error_c -= abs_da;
+      }
+    }
+    at(x, y, z);
+  }
+
+  static inline int sign(int i)
+  {
+    return i > 0 ? 1 : -1;
+  }
+
+  /**
+   * A group of lines traced on its own thread, like VoxelGrid::LineGroup
+   */
+  struct LineGroup
+  {
+    unsigned int begin, end; //range of line_order_
+    unsigned int min_x, min_y, width;
+    std::vector<uint64_t> cleared; //bits cleared in each column of the window, all zero between calls
+    std::vector<unsigned int> columns; //the columns of the window with bits in cleared
+  };
+
+  /**
+   * @brief  Traces one group of the lines sorted by clearVoxelLinesInMap()
+   *         into the cleared bits of its window, without touching the tiles
+   */
+  void traceLineGroup(unsigned int group, double x0, double y0, double z0, const std::vector<GridPoint>* ends,
+                      unsigned int max_length);
+
+  struct Tile
+  {
+    uint64_t marked[TILE_SIZE * TILE_SIZE];
+    uint64_t unknown[TILE_SIZE * TILE_SIZE];
+  };
+
+  static inline unsigned int columnIndex(unsigned int x, unsigned int y)
+  {
+    return ((y & (TILE_SIZE - 1)) << TILE_BITS) | (x & (TILE_SIZE - 1));
+  }
+
+  inline unsigned int tileIndex(unsigned int x, unsigned int y) const
+  {
+    return (y >> TILE_BITS) * tiles_x_ + (x >> TILE_BITS);
+  }
+
+  /**
+   * @brief  The tile holding column (x, y), allocated if needed
+   */
+  inline Tile* getTile(unsigned int x, unsigned int y)
+  {
+    Tile*& tile = tiles_[tileIndex(x, y)];
+    if (tile == NULL)
+      tile = allocateTile();
+    return tile;
+  }
+
+  /**
+   * @brief  The tile holding column (x, y), or NULL if it was never touched
+   */
+  inline const Tile* findTile(unsigned int x, unsigned int y) const
+  {
+    return tiles_[tileIndex(x, y)];
+  }
+
+  /**
+   * @brief  Take a tile from the pool, or allocate one, with every voxel unknown
+   */
+  Tile* allocateTile();
+
+  /**
+   * @brief  Return every tile to the pool
+   */
+  void releaseTiles();
+
+  void freeTiles();
+
+  // the tiles are owned by the grid, copying is not supported
+  SparseVoxelGrid(const SparseVoxelGrid&);
+  SparseVoxelGrid& operator=(const SparseVoxelGrid&);
+
+  class MarkVoxel
+  {
+  public:
+    MarkVoxel(SparseVoxelGrid& grid): grid_(grid) {}
+    inline void operator()(unsigned int x, unsigned int y, unsigned int z)
+    {
+      grid_.markVoxel(x, y, z);
+    }
+  private:
+    SparseVoxelGrid& grid_;
+  };
+
+  class ClearVoxel
+  {
+  public:
+    ClearVoxel(SparseVoxelGrid& grid): grid_(grid) {}
+    inline void operator()(unsigned int x, unsigned int y, unsigned int z)
+    {
+      grid_.clearVoxel(x, y, z);
+    }
+  private:
+    SparseVoxelGrid& grid_;
+  };
+
+  /**
+   * Collects the bits to clear in the window of a LineGroup
+   */
+  class ClearVoxelWindow
+  {
+  public:
+    ClearVoxelWindow(LineGroup& group): group_(group) {}
+    inline void operator()(unsigned int x, unsigned int y, unsigned int z)
+    {
+      unsigned int column = (y - group_.min_y) * group_.width + x - group_.min_x;
+      if (!group_.cleared[column])
+        group_.columns.push_back(column);
+      group_.cleared[column] |= (uint64_t)1 << z;
+    }
+  private:
+    LineGroup& group_;
+  };
+
+  class ClearVoxelInMap
+  {
+  public:
+    ClearVoxelInMap(
+      SparseVoxelGrid& grid, unsigned char *costmap,
+      unsigned int unknown_clear_threshold, unsigned int marked_clear_threshold,
+      unsigned char free_cost = 0, unsigned char unknown_cost = 255): grid_(grid), costmap_(costmap),
+      unknown_clear_threshold_(unknown_clear_threshold), marked_clear_threshold_(marked_clear_threshold),
+      free_cost_(free_cost), unknown_cost_(unknown_cost), tile_index_(UINT_MAX), tile_(NULL)
+    {
+    }
+
+    inline void operator()(unsigned int x, unsigned int y, unsigned int z)
+    {
+      //consecutive voxels of a line are mostly in the same tile
+      unsigned int tile_index = grid_.tileIndex(x, y);
+      if (tile_index != tile_index_)
+      {
+        tile_index_ = tile_index;
+        tile_ = grid_.getTile(x, y);
+      }
+      unsigned int col = columnIndex(x, y);
+      uint64_t marked = tile_->marked[col] &= ~((uint64_t)1 << z);
+      uint64_t unknown = tile_->unknown[col] &= ~((uint64_t)1 << z);
+
+      //make sure the number of bits in each is below our thesholds
+      if (bitsBelowThreshold(marked, marked_clear_threshold_))
+      {
+        if (bitsBelowThreshold(unknown, unknown_clear_threshold_))
+        {
+          costmap_[y * grid_.size_x_ + x] = free_cost_;
+        }
+        else
+        {
+          costmap_[y * grid_.size_x_ + x] = unknown_cost_;
+        }
+      }
+    }
+  private:
+    SparseVoxelGrid& grid_;
+    unsigned char *costmap_;
+    unsigned int unknown_clear_threshold_, marked_clear_threshold_;
+    unsigned char free_cost_, unknown_cost_;
+    unsigned int tile_index_;
+    Tile* tile_;
+  };
+
+  unsigned int size_x_, size_y_, size_z_;
+  unsigned int tiles_x_, tiles_y_;
+  uint64_t unknown_column_;  ///< @brief The value of a column which was never observed
+  std::vector<Tile*> tiles_;
+  std::vector<Tile*> free_tiles_;
+  unsigned int allocated_tiles_;
+
+  // scratch space of clearVoxelLinesInMap(), kept between calls
+  std::vector<unsigned int> line_bin_, line_order_;
+  std::vector<LineGroup> line_groups_;
+  std::vector<unsigned int> touched_columns_;
+};
+
+}  // namespace voxel_grid
+
+#endif  // VOXEL_GRID_SPARSE_VOXEL_GRID_H
@@ -44,6 +44,8 @@
 #include <math.h>
 #include <limits.h>
 #include <algorithm>
+#include <vector>
+#include <boost/function.hpp>
 #include <ros/console.h>
 #include <ros/assert.h>
 
@@ -62,6 +64,34 @@ enum VoxelStatus {
   MARKED = 2,
 };
 
+/**
+ * @brief A point in grid coordinates
+ */
+struct GridPoint
+{
+  GridPoint() : x(0.0), y(0.0), z(0.0) {}
+  GridPoint(double x, double y, double z) : x(x), y(y), z(z) {}
+  double x, y, z;
+};
+
+/**
+ * @brief Runs task(i) for every i in [0, num_tasks), possibly in parallel,
+ *        and returns when all of them are done.
+ */
+typedef boost::function<void(unsigned int num_tasks, const boost::function<void(unsigned int)>& task)> ParallelFor;
+
+/**
+ * @brief  Sorts the lines from (x0, y0, z0) to each of the end points by their
+ *         direction in the x-y plane, so that consecutive lines cover a narrow sector
+ * @param order Set to the indices of the end points in sorted order, followed by
+ *              those outside a grid of the given size
+ * @param bins Scratch space
+ * @return The number of end points inside the grid
+ */
+unsigned int sortLinesByDirection(double x0, double y0, double z0, const std::vector<GridPoint>& ends,
+                                  unsigned int size_x, unsigned int size_y, unsigned int size_z,
+                                  std::vector<unsigned int>& order, std::vector<unsigned int>& bins);
+
 class VoxelGrid
 {
 public:
@@ -211,6 +241,22 @@ public:
                            unsigned int unknown_threshold, unsigned int mark_threshold,
                            unsigned char free_cost = 0, unsigned char unknown_cost = 255, unsigned int max_length = UINT_MAX);
 
+  /**
+   * @brief  Clears the lines from (x0, y0, z0) to each of the end points, with
+   *         the same result as calling clearVoxelLineInMap() for each of them.
+   *
+   * The lines are sorted by direction and split into groups of neighbouring
+   * lines, which are traced independently. The columns of map_2d are only
+   * updated once all the lines are traced, so there is no per-voxel
+   * threshold check.
+   * @param ends The end points of the lines, those outside the grid are skipped
+   * @param parallel_for If set, used to trace the groups in parallel
+   */
+  void clearVoxelLinesInMap(double x0, double y0, double z0, const std::vector<GridPoint>& ends,
+                            unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold,
+                            unsigned char free_cost = 0, unsigned char unknown_cost = 255,
+                            unsigned int max_length = UINT_MAX, const ParallelFor& parallel_for = ParallelFor());
+
   VoxelStatus getVoxel(unsigned int x, unsigned int y, unsigned int z);
 
   //Are there any obstacles at that (x, y) location in the grid?
@@ -227,6 +273,19 @@ public:
   inline void raytraceLine(
     ActionType at, double x0, double y0, double z0,
     double x1, double y1, double z1, unsigned int max_length = UINT_MAX)
+  {
+    raytraceLine(at, x0, y0, z0, x1, y1, z1, max_length, size_x_);
+  }
+
+private:
+  /**
+   * @brief  raytraceLine() on an array with rows of row_size columns, which
+   *         can be a window of the grid rather than the whole of it
+   */
+  template <class ActionType>
+  inline void raytraceLine(
+    ActionType at, double x0, double y0, double z0,
+    double x1, double y1, double z1, unsigned int max_length, unsigned int row_size)
   {
     int dx = int(x1) - int(x0);
     int dy = int(y1) - int(y0);
@@ -237,11 +296,11 @@ public:
     unsigned int abs_dz = abs(dz);
 
     int offset_dx = sign(dx);
-    int offset_dy = sign(dy) * size_x_;
+    int offset_dy = sign(dy) * row_size;
     int offset_dz = sign(dz);
 
     unsigned int z_mask = ((1 << 16) | 1) << (unsigned int)z0;
-    unsigned int offset = (unsigned int)y0 * size_x_ + (unsigned int)x0;
+    unsigned int offset = (unsigned int)y0 * row_size + (unsigned int)x0;
 
     GridOffset grid_off(offset);
     ZOffset z_off(z_mask);
@@ -277,7 +336,6 @@ public:
     bresenham3D(at, z_off, grid_off, grid_off, abs_dz, abs_dx, abs_dy, error_x, error_y, offset_dz, offset_dx, offset_dy, offset, z_mask, (unsigned int)(scale * abs_dz));
   }
 
-private:
   //the real work is done here... 3D bresenham implementation
   template <class ActionType, class OffA, class OffB, class OffC>
   inline void bresenham3D(
@@ -317,10 +375,36 @@ private:
     return x > y ? x : y;
   }
 
+  /**
+   * @brief  Traces one group of the lines sorted by clearVoxelLinesInMap()
+   *         into the cleared bits of its window, without touching data_
+   */
+  void traceLineGroup(unsigned int group, double x0, double y0, double z0, const std::vector<GridPoint>* ends,
+                      unsigned int max_length);
+
   unsigned int size_x_, size_y_, size_z_;
   uint32_t *data_;
   unsigned char *costmap;
 
+  /**
+   * A group of lines traced on its own thread. The lines cover a narrow
+   * sector, so the bits they clear are collected for a small window of the
+   * grid and applied to data_ once all the groups are done.
+   */
+  struct LineGroup
+  {
+    unsigned int begin, end; //range of line_order_
+    unsigned int min_x, min_y, width;
+    std::vector<uint32_t> cleared; //bits cleared in each column of the window, all zero between calls
+    std::vector<unsigned int> columns; //the columns of the window with bits in cleared
+  };
+
+  // scratch space of clearVoxelLinesInMap(), kept between calls
+  std::vector<unsigned int> line_bin_, line_order_;
+  std::vector<LineGroup> line_groups_;
+  std::vector<unsigned char> column_touched_;
+  std::vector<unsigned int> touched_columns_;
+
   //Aren't functors so much fun... used to recreate the Bresenham macro Eric wrote in the original version, but in "proper" c++
   class MarkVoxel
   {
@@ -401,6 +485,60 @@ private:
     unsigned char free_cost_, unknown_cost_;
   };
 
+  /**
+   * Clears voxels and records each column the first time it is touched, so
+   * the 2D map can be updated afterwards
+   */
+  class ClearVoxelBatch
+  {
+  public:
+    ClearVoxelBatch(uint32_t* data, unsigned char* touched, std::vector<unsigned int>& columns) :
+      data_(data), touched_(touched), columns_(columns), last_offset_(UINT_MAX)
+    {
+    }
+
+    inline void operator()(unsigned int offset, unsigned int z_mask)
+    {
+      data_[offset] &= ~(z_mask); //clear unknown and clear cell
+
+      //consecutive voxels of a line are often in the same column
+      if (offset == last_offset_)
+        return;
+      last_offset_ = offset;
+      if (touched_[offset])
+        return;
+      touched_[offset] = 1;
+      columns_.push_back(offset);
+    }
+  private:
+    uint32_t* data_;
+    unsigned char* touched_;
+    std::vector<unsigned int>& columns_;
+    unsigned int last_offset_;
+  };
+
+  /**
+   * Collects the bits to clear in the window of a LineGroup
+   */
+  class ClearVoxelWindow
+  {
+  public:
+    ClearVoxelWindow(uint32_t* cleared, std::vector<unsigned int>& columns) :
+      cleared_(cleared), columns_(columns)
+    {
+    }
+
+    inline void operator()(unsigned int offset, unsigned int z_mask)
+    {
+      if (!cleared_[offset])
+        columns_.push_back(offset);
+      cleared_[offset] |= z_mask;
+    }
+  private:
+    uint32_t* cleared_;
+    std::vector<unsigned int>& columns_;
+  };
+
   class GridOffset
   {
   public:
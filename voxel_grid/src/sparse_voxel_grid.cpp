@@ -0,0 +1,418 @@
+/*********************************************************************
+ *
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the copyright holder nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+#include <voxel_grid/sparse_voxel_grid.h>
+#include <string.h>
+#include <boost/bind.hpp>
+
+namespace voxel_grid
+{
+
+SparseVoxelGrid::SparseVoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z) :
+    size_x_(0), size_y_(0), size_z_(0), tiles_x_(0), tiles_y_(0), unknown_column_(0), allocated_tiles_(0)
+{
+  resize(size_x, size_y, size_z);
+}
+
+SparseVoxelGrid::~SparseVoxelGrid()
+{
+  freeTiles();
+}
+
+void SparseVoxelGrid::resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+{
+  if (size_z > MAX_SIZE_Z)
+  {
+    ROS_INFO("Error, this implementation can only support up to %u z values (%u)", MAX_SIZE_Z, size_z);
+    size_z = MAX_SIZE_Z;
+  }
+
+  //if we're not actually changing the size, we can just reset things
+  if (size_x == size_x_ && size_y == size_y_ && size_z == size_z_)
+  {
+    reset();
+    return;
+  }
+
+  // the tiles are initialized for the old height, so don't keep them around
+  freeTiles();
+
+  size_x_ = size_x;
+  size_y_ = size_y;
+  size_z_ = size_z;
+  tiles_x_ = (size_x_ + TILE_SIZE - 1) >> TILE_BITS;
+  tiles_y_ = (size_y_ + TILE_SIZE - 1) >> TILE_BITS;
+  unknown_column_ = size_z_ >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << size_z_) - 1;
+  tiles_.assign(tiles_x_ * tiles_y_, NULL);
+}
+
+void SparseVoxelGrid::reset()
+{
+  releaseTiles();
+}
+
+SparseVoxelGrid::Tile* SparseVoxelGrid::allocateTile()
+{
+  Tile* tile;
+  if (free_tiles_.empty())
+  {
+    tile = new Tile;
+  }
+  else
+  {
+    tile = free_tiles_.back();
+    free_tiles_.pop_back();
+  }
+
+  memset(tile->marked, 0, sizeof(tile->marked));
+  std::fill(tile->unknown, tile->unknown + TILE_SIZE * TILE_SIZE, unknown_column_);
+  ++allocated_tiles_;
+  return tile;
+}
+
+void SparseVoxelGrid::releaseTiles()
+{
+  for (unsigned int i = 0; i < tiles_.size(); ++i)
+  {
+    if (tiles_[i] != NULL)
+    {
+      free_tiles_.push_back(tiles_[i]);
+      tiles_[i] = NULL;
+    }
+  }
+  allocated_tiles_ = 0;
+}
+
+void SparseVoxelGrid::freeTiles()
+{
+  releaseTiles();
+  for (unsigned int i = 0; i < free_tiles_.size(); ++i)
+  {
+    delete free_tiles_[i];
+  }
+  free_tiles_.clear();
+}
+
+void SparseVoxelGrid::markVoxelLine(double x0, double y0, double z0, double x1, double y1, double z1,
+                                    unsigned int max_length)
+{
+  if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1 >= size_x_ || y1 >= size_y_ || z1 >= size_z_)
+  {
+    ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+              x0, y0, z0, x1, y1, z1, size_x_, size_y_, size_z_);
+    return;
+  }
+
+  MarkVoxel mv(*this);
+  raytraceLine(mv, x0, y0, z0, x1, y1, z1, max_length);
+}
+
+void SparseVoxelGrid::clearVoxelLine(double x0, double y0, double z0, double x1, double y1, double z1,
+                                     unsigned int max_length)
+{
+  if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1 >= size_x_ || y1 >= size_y_ || z1 >= size_z_)
+  {
+    ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+              x0, y0, z0, x1, y1, z1, size_x_, size_y_, size_z_);
+    return;
+  }
+
+  ClearVoxel cv(*this);
+  raytraceLine(cv, x0, y0, z0, x1, y1, z1, max_length);
+}
+
+void SparseVoxelGrid::clearVoxelLineInMap(double x0, double y0, double z0, double x1, double y1, double z1,
+                                          unsigned char *map_2d, unsigned int unknown_threshold,
+                                          unsigned int mark_threshold, unsigned char free_cost,
+                                          unsigned char unknown_cost, unsigned int max_length)
+{
+  if (map_2d == NULL)
+  {
+    clearVoxelLine(x0, y0, z0, x1, y1, z1, max_length);
+    return;
+  }
+
+  if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_ || x1 >= size_x_ || y1 >= size_y_ || z1 >= size_z_)
+  {
+    ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)",
+              x0, y0, z0, x1, y1, z1, size_x_, size_y_, size_z_);
+    return;
+  }
+
+  ClearVoxelInMap cvm(*this, map_2d, unknown_threshold, mark_threshold, free_cost, unknown_cost);
+  raytraceLine(cvm, x0, y0, z0, x1, y1, z1, max_length);
+}
+
+void SparseVoxelGrid::clearVoxelLinesInMap(double x0, double y0, double z0, const std::vector<GridPoint>& ends,
+                                           unsigned char *map_2d, unsigned int unknown_threshold,
+                                           unsigned int mark_threshold, unsigned char free_cost,
+                                           unsigned char unknown_cost, unsigned int max_length,
+                                           const ParallelFor& parallel_for)
+{
+  if (!parallel_for || map_2d == NULL)
+  {
+    for (unsigned int i = 0; i < ends.size(); ++i)
+    {
+      clearVoxelLineInMap(x0, y0, z0, ends[i].x, ends[i].y, ends[i].z, map_2d, unknown_threshold, mark_threshold,
+                          free_cost, unknown_cost, max_length);
+    }
+    return;
+  }
+
+  if (x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_)
+  {
+    ROS_DEBUG("Error, line start point out of bounds. (%.2f, %.2f, %.2f),  size: (%d, %d, %d)", x0, y0, z0,
+              size_x_, size_y_, size_z_);
+    return;
+  }
+
+  unsigned int num_lines = sortLinesByDirection(x0, y0, z0, ends, size_x_, size_y_, size_z_, line_order_, line_bin_);
+  unsigned int num_groups = std::max(1u, std::min(16u, num_lines));
+  line_groups_.resize(num_groups);
+  for (unsigned int g = 0; g < num_groups; ++g)
+  {
+    line_groups_[g].begin = (unsigned long)num_lines * g / num_groups;
+    line_groups_[g].end = (unsigned long)num_lines * (g + 1) / num_groups;
+  }
+
+  parallel_for(num_groups, boost::bind(&SparseVoxelGrid::traceLineGroup, this, _1, x0, y0, z0, &ends, max_length));
+
+  //the groups may share columns, so their windows are applied to the tiles one after the other
+  touched_columns_.clear();
+  for (unsigned int g = 0; g < num_groups; ++g)
+  {
+    LineGroup& group = line_groups_[g];
+    for (unsigned int i = 0; i < group.columns.size(); ++i)
+    {
+      unsigned int column = group.columns[i];
+      unsigned int wy = column / group.width;
+      unsigned int x = group.min_x + column - wy * group.width, y = group.min_y + wy;
+      Tile* tile = getTile(x, y);
+      unsigned int col = columnIndex(x, y);
+      tile->marked[col] &= ~group.cleared[column];
+      tile->unknown[col] &= ~group.cleared[column];
+      group.cleared[column] = 0;
+      touched_columns_.push_back(y * size_x_ + x);
+    }
+  }
+  std::sort(touched_columns_.begin(), touched_columns_.end());
+  touched_columns_.erase(std::unique(touched_columns_.begin(), touched_columns_.end()), touched_columns_.end());
+
+  //clearing only removes bits, so checking each touched column once at the end gives the same map as
+  //checking it after every voxel
+  for (unsigned int i = 0; i < touched_columns_.size(); ++i)
+  {
+    unsigned int offset = touched_columns_[i];
+    unsigned int x = offset % size_x_, y = offset / size_x_;
+    const Tile* tile = findTile(x, y);
+    unsigned int col = columnIndex(x, y);
+    if (bitsBelowThreshold(tile->marked[col], mark_threshold))
+    {
+      if (bitsBelowThreshold(tile->unknown[col], unknown_threshold))
+        map_2d[offset] = free_cost;
+      else
+        map_2d[offset] = unknown_cost;
+    }
+  }
+}
+
+void SparseVoxelGrid::traceLineGroup(unsigned int group_index, double x0, double y0, double z0,
+                                     const std::vector<GridPoint>* ends, unsigned int max_length)
+{
+  LineGroup& group = line_groups_[group_index];
+  group.columns.clear();
+
+  //the lines stay within the bounding box of their end points, which is the window of the group
+  unsigned int min_x = (unsigned int)x0, max_x = min_x, min_y = (unsigned int)y0, max_y = min_y;
+  for (unsigned int i = group.begin; i < group.end; ++i)
+  {
+    const GridPoint& end = (*ends)[line_order_[i]];
+    min_x = std::min(min_x, (unsigned int)end.x);
+    max_x = std::max(max_x, (unsigned int)end.x);
+    min_y = std::min(min_y, (unsigned int)end.y);
+    max_y = std::max(max_y, (unsigned int)end.y);
+  }
+  group.min_x = min_x;
+  group.min_y = min_y;
+  group.width = max_x - min_x + 1;
+  unsigned int window_size = group.width * (max_y - min_y + 1);
+  if (group.cleared.size() < window_size)
+    group.cleared.resize(window_size, 0);
+
+  ClearVoxelWindow cvw(group);
+  for (unsigned int i = group.begin; i < group.end; ++i)
+  {
+    const GridPoint& end = (*ends)[line_order_[i]];
+    raytraceLine(cvw, x0, y0, z0, end.x, end.y, end.z, max_length);
+  }
+}
+
+VoxelStatus SparseVoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z) const
+{
+  if (x >= size_x_ || y >= size_y_ || z >= size_z_)
+  {
+    ROS_DEBUG("Error, voxel out of bounds. (%d, %d, %d)\n", x, y, z);
+    return UNKNOWN;
+  }
+
+  const Tile* tile = findTile(x, y);
+  if (tile == NULL)
+    return UNKNOWN;
+
+  uint64_t mask = (uint64_t)1 << z;
+  unsigned int col = columnIndex(x, y);
+  if (tile->marked[col] & mask)
+    return MARKED;
+  if (tile->unknown[col] & mask)
+    return UNKNOWN;
+  return FREE;
+}
+
+VoxelStatus SparseVoxelGrid::getVoxelColumn(unsigned int x, unsigned int y, unsigned int unknown_threshold,
+                                            unsigned int marked_threshold) const
+{
+  if (x >= size_x_ || y >= size_y_)
+  {
+    ROS_DEBUG("Error, voxel out of bounds. (%d, %d)\n", x, y);
+    return UNKNOWN;
+  }
+
+  uint64_t marked = 0, unknown = unknown_column_;
+  const Tile* tile = findTile(x, y);
+  if (tile != NULL)
+  {
+    unsigned int col = columnIndex(x, y);
+    marked = tile->marked[col];
+    unknown = tile->unknown[col];
+  }
+
+  //check if the number of marked bits qualifies the col as marked
+  if (!bitsBelowThreshold(marked, marked_threshold))
+    return MARKED;
+
+  //check if the number of unkown bits qualifies the col as unknown
+  if (!bitsBelowThreshold(unknown, unknown_threshold))
+    return UNKNOWN;
+
+  return FREE;
+}
+
+void SparseVoxelGrid::updateOrigin(int cell_ox, int cell_oy)
+{
+  std::vector<Tile*> old_tiles(tiles_.size(), NULL);
+  old_tiles.swap(tiles_);
+  allocated_tiles_ = 0;
+
+  // whole tiles can simply be moved when the shift is a multiple of the tile size
+  bool aligned = cell_ox % (int)TILE_SIZE == 0 && cell_oy % (int)TILE_SIZE == 0;
+  int tile_ox = cell_ox / (int)TILE_SIZE, tile_oy = cell_oy / (int)TILE_SIZE;
+
+  for (unsigned int ty = 0; ty < tiles_y_; ++ty)
+  {
+    for (unsigned int tx = 0; tx < tiles_x_; ++tx)
+    {
+      Tile* tile = old_tiles[ty * tiles_x_ + tx];
+      if (tile == NULL)
+        continue;
+
+      if (aligned)
+      {
+        int new_tx = (int)tx - tile_ox, new_ty = (int)ty - tile_oy;
+        if (new_tx >= 0 && new_ty >= 0 && new_tx < (int)tiles_x_ && new_ty < (int)tiles_y_)
+        {
+          tiles_[new_ty * tiles_x_ + new_tx] = tile;
+          ++allocated_tiles_;
+        }
+        else
+        {
+          free_tiles_.push_back(tile);
+        }
+        continue;
+      }
+
+      for (unsigned int cy = 0; cy < TILE_SIZE; ++cy)
+      {
+        int y = (int)((ty << TILE_BITS) + cy), new_y = y - cell_oy;
+        if (y >= (int)size_y_ || new_y < 0 || new_y >= (int)size_y_)
+          continue;
+
+        for (unsigned int cx = 0; cx < TILE_SIZE; ++cx)
+        {
+          int x = (int)((tx << TILE_BITS) + cx), new_x = x - cell_ox;
+          if (x >= (int)size_x_ || new_x < 0 || new_x >= (int)size_x_)
+            continue;
+
+          unsigned int col = (cy << TILE_BITS) | cx;
+          Tile* dest = getTile(new_x, new_y);
+          unsigned int dest_col = columnIndex(new_x, new_y);
+          dest->marked[dest_col] = tile->marked[col];
+          dest->unknown[dest_col] = tile->unknown[col];
+        }
+      }
+
+      // every column of this tile has been copied, so it can be reused as a destination
+      free_tiles_.push_back(tile);
+    }
+  }
+}
+
+void SparseVoxelGrid::getPackedData(uint32_t* data) const
+{
+  // VoxelGrid keeps the marked bits in the upper half of each column and the
+  // marked or unknown bits in the lower half
+  uint32_t unknown_col = ~((uint32_t)0) >> 16;
+  for (unsigned int y = 0; y < size_y_; ++y)
+  {
+    for (unsigned int x = 0; x < size_x_; ++x)
+    {
+      const Tile* tile = findTile(x, y);
+      if (tile == NULL)
+      {
+        *data++ = unknown_col;
+        continue;
+      }
+      unsigned int col = columnIndex(x, y);
+      uint32_t marked = tile->marked[col] & 0xffff;
+      uint32_t unknown = tile->unknown[col] & 0xffff;
+      *data++ = (marked << 16) | marked | unknown;
+    }
+  }
+}
+
+size_t SparseVoxelGrid::getMemoryUsage() const
+{
+  return (allocated_tiles_ + free_tiles_.size()) * sizeof(Tile) + tiles_.capacity() * sizeof(Tile*);
+}
+
+}  // namespace voxel_grid
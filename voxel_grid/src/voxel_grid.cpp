@@ -40,8 +40,49 @@
 #endif
 
 #include <ros/console.h>
+#include <boost/bind.hpp>
 
 namespace voxel_grid {
+  unsigned int sortLinesByDirection(double x0, double y0, double z0, const std::vector<GridPoint>& ends,
+      unsigned int size_x, unsigned int size_y, unsigned int size_z,
+      std::vector<unsigned int>& order, std::vector<unsigned int>& bins){
+    //a counting sort on a pseudo angle in [0, 4)
+    const unsigned int num_bins = 256;
+    unsigned int bin_count[num_bins + 1];
+    memset(bin_count, 0, sizeof(bin_count));
+    bins.resize(ends.size());
+    for(unsigned int i = 0; i < ends.size(); ++i){
+      const GridPoint& end = ends[i];
+      if(end.x >= size_x || end.y >= size_y || end.z >= size_z){
+        ROS_DEBUG("Error, line endpoint out of bounds. (%.2f, %.2f, %.2f) to (%.2f, %.2f, %.2f),  size: (%d, %d, %d)", x0, y0, z0,
+            end.x, end.y, end.z, size_x, size_y, size_z);
+        bins[i] = num_bins;
+        ++bin_count[num_bins];
+        continue;
+      }
+      double dx = end.x - x0, dy = end.y - y0;
+      double d = fabs(dx) + fabs(dy);
+      double angle = d > 0.0 ? dy / d : 0.0;
+      angle = dx >= 0.0 ? (angle < 0.0 ? 4.0 + angle : angle) : 2.0 - angle;
+      bins[i] = std::min(num_bins - 1, (unsigned int)(angle * (num_bins / 4)));
+      ++bin_count[bins[i]];
+    }
+
+    //turn the counts into the start of each bin, and the bins into the sorted order of the lines
+    unsigned int bin_start[num_bins + 1];
+    unsigned int start = 0;
+    for(unsigned int b = 0; b <= num_bins; ++b){
+      bin_start[b] = start;
+      start += bin_count[b];
+    }
+    order.resize(ends.size());
+    for(unsigned int i = 0; i < ends.size(); ++i)
+      order[bin_start[bins[i]]++] = i;
+
+    //the lines out of bounds are sorted last
+    return ends.size() - bin_count[num_bins];
+  }
+
   VoxelGrid::VoxelGrid(unsigned int size_x, unsigned int size_y, unsigned int size_z)
   {
     size_x_ = size_x; 
@@ -143,6 +184,108 @@ namespace voxel_grid {
     raytraceLine(cvm, x0, y0, z0, x1, y1, z1, max_length);
   }
 
+  void VoxelGrid::clearVoxelLinesInMap(double x0, double y0, double z0, const std::vector<GridPoint>& ends,
+      unsigned char *map_2d, unsigned int unknown_threshold, unsigned int mark_threshold, unsigned char free_cost,
+      unsigned char unknown_cost, unsigned int max_length, const ParallelFor& parallel_for){
+    if(map_2d == NULL){
+      for(unsigned int i = 0; i < ends.size(); ++i)
+        clearVoxelLine(x0, y0, z0, ends[i].x, ends[i].y, ends[i].z, max_length);
+      return;
+    }
+
+    if(x0 >= size_x_ || y0 >= size_y_ || z0 >= size_z_){
+      ROS_DEBUG("Error, line start point out of bounds. (%.2f, %.2f, %.2f),  size: (%d, %d, %d)", x0, y0, z0,
+          size_x_, size_y_, size_z_);
+      return;
+    }
+
+    //sort the lines by direction, so that the lines of a group cover a narrow sector and mostly share columns
+    unsigned int num_lines = sortLinesByDirection(x0, y0, z0, ends, size_x_, size_y_, size_z_, line_order_, line_bin_);
+    if(column_touched_.size() != size_x_ * size_y_)
+      column_touched_.assign(size_x_ * size_y_, 0);
+    touched_columns_.clear();
+
+    if(!parallel_for){
+      ClearVoxelBatch cvb(data_, &column_touched_[0], touched_columns_);
+      for(unsigned int i = 0; i < num_lines; ++i){
+        const GridPoint& end = ends[line_order_[i]];
+        raytraceLine(cvb, x0, y0, z0, end.x, end.y, end.z, max_length);
+      }
+    }
+    else{
+      unsigned int num_groups = std::max(1u, std::min(16u, num_lines));
+      line_groups_.resize(num_groups);
+      for(unsigned int g = 0; g < num_groups; ++g){
+        line_groups_[g].begin = (unsigned long)num_lines * g / num_groups;
+        line_groups_[g].end = (unsigned long)num_lines * (g + 1) / num_groups;
+      }
+
+      parallel_for(num_groups, boost::bind(&VoxelGrid::traceLineGroup, this, _1, x0, y0, z0, &ends, max_length));
+
+      //the groups may share columns, so their windows are applied to the grid one after the other
+      for(unsigned int g = 0; g < num_groups; ++g){
+        LineGroup& group = line_groups_[g];
+        for(unsigned int i = 0; i < group.columns.size(); ++i){
+          unsigned int column = group.columns[i];
+          unsigned int wy = column / group.width;
+          unsigned int offset = (group.min_y + wy) * size_x_ + group.min_x + column - wy * group.width;
+          data_[offset] &= ~group.cleared[column];
+          group.cleared[column] = 0;
+          if(!column_touched_[offset]){
+            column_touched_[offset] = 1;
+            touched_columns_.push_back(offset);
+          }
+        }
+      }
+    }
+
+    //now that the lines are traced, update each touched column of the map once
+    for(unsigned int i = 0; i < touched_columns_.size(); ++i){
+      unsigned int offset = touched_columns_[i];
+      column_touched_[offset] = 0;
+
+      uint32_t col = data_[offset];
+      unsigned int unknown_bits = uint16_t(col>>16) ^ uint16_t(col);
+      unsigned int marked_bits = col>>16;
+
+      //make sure the number of bits in each is below our thesholds
+      if(bitsBelowThreshold(marked_bits, mark_threshold)){
+        if(bitsBelowThreshold(unknown_bits, unknown_threshold))
+          map_2d[offset] = free_cost;
+        else
+          map_2d[offset] = unknown_cost;
+      }
+    }
+  }
+
+  void VoxelGrid::traceLineGroup(unsigned int group_index, double x0, double y0, double z0,
+      const std::vector<GridPoint>* ends, unsigned int max_length){
+    LineGroup& group = line_groups_[group_index];
+    group.columns.clear();
+
+    //the lines stay within the bounding box of their end points, which is the window of the group
+    unsigned int min_x = (unsigned int)x0, max_x = min_x, min_y = (unsigned int)y0, max_y = min_y;
+    for(unsigned int i = group.begin; i < group.end; ++i){
+      const GridPoint& end = (*ends)[line_order_[i]];
+      min_x = std::min(min_x, (unsigned int)end.x);
+      max_x = std::max(max_x, (unsigned int)end.x);
+      min_y = std::min(min_y, (unsigned int)end.y);
+      max_y = std::max(max_y, (unsigned int)end.y);
+    }
+    group.min_x = min_x;
+    group.min_y = min_y;
+    group.width = max_x - min_x + 1;
+    unsigned int window_size = group.width * (max_y - min_y + 1);
+    if(group.cleared.size() < window_size)
+      group.cleared.resize(window_size, 0);
+
+    ClearVoxelWindow cvw(&group.cleared[0], group.columns);
+    for(unsigned int i = group.begin; i < group.end; ++i){
+      const GridPoint& end = (*ends)[line_order_[i]];
+      raytraceLine(cvw, x0 - min_x, y0 - min_y, z0, end.x - min_x, end.y - min_y, end.z, max_length, group.width);
+    }
+  }
+
   VoxelStatus VoxelGrid::getVoxel(unsigned int x, unsigned int y, unsigned int z)
   {
     if(x >= size_x_ || y >= size_y_ || z >= size_z_){
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2020, Open Source Robotics Foundation, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Benchmark of the dense VoxelGrid against the SparseVoxelGrid: memory use
+ * and raytracing throughput for a depth camera in a large rolling window.
+ * The rays cover a 60 degree field of view in front of a sensor in the
+ * middle of the grid, like the clearing of a VoxelLayer observation. The
+ * dense grid is also run with the batched clearing, serially and threaded.
+ *
+ * Usage: rosrun voxel_grid voxel_grid_benchmark [size_cells] [range_cells] [num_rays] [iterations] [threads]
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <ros/time.h>
+#include <voxel_grid/voxel_grid.h>
+#include <voxel_grid/sparse_voxel_grid.h>
+
+struct Ray
+{
+  double x0, y0, z0, x1, y1, z1;
+};
+
+std::vector<Ray> makeRays(unsigned int size, unsigned int size_z, double range, unsigned int num_rays)
+{
+  std::vector<Ray> rays(num_rays);
+  unsigned int rows = std::max(1u, (unsigned int)sqrt(num_rays * 0.75));
+  for (unsigned int i = 0; i < num_rays; ++i)
+  {
+    double yaw = -M_PI / 6 + (M_PI / 3) * (i % (num_rays / rows)) / (num_rays / rows);
+    double pitch = -M_PI / 8 + (M_PI / 4) * (i / (num_rays / rows)) / rows;
+    Ray& ray = rays[i];
+    ray.x0 = size / 2 + 0.5;
+    ray.y0 = size / 2 + 0.5;
+    ray.z0 = size_z / 2 + 0.5;
+    ray.x1 = ray.x0 + range * cos(pitch) * cos(yaw);
+    ray.y1 = ray.y0 + range * cos(pitch) * sin(yaw);
+    ray.z1 = std::min(std::max(ray.z0 + range * sin(pitch), 0.0), size_z - 0.01);
+  }
+  return rays;
+}
+
+template <class Grid>
+double clearRays(Grid& grid, const std::vector<Ray>& rays, std::vector<unsigned char>& costmap, int iterations)
+{
+  ros::WallTime start = ros::WallTime::now();
+  for (int it = 0; it < iterations; ++it)
+  {
+    for (unsigned int i = 0; i < rays.size(); ++i)
+    {
+      const Ray& r = rays[i];
+      grid.clearVoxelLineInMap(r.x0, r.y0, r.z0, r.x1, r.y1, r.z1, &costmap[0], 0, 0, 0, 255);
+    }
+  }
+  return (ros::WallTime::now() - start).toSec() / iterations;
+}
+
+template <class Grid>
+double clearRaysBatch(Grid& grid, const std::vector<Ray>& rays, std::vector<unsigned char>& costmap, int iterations,
+                      const voxel_grid::ParallelFor& parallel_for)
+{
+  std::vector<voxel_grid::GridPoint> ends(rays.size());
+  for (unsigned int i = 0; i < rays.size(); ++i)
+    ends[i] = voxel_grid::GridPoint(rays[i].x1, rays[i].y1, rays[i].z1);
+
+  ros::WallTime start = ros::WallTime::now();
+  for (int it = 0; it < iterations; ++it)
+  {
+    grid.clearVoxelLinesInMap(rays[0].x0, rays[0].y0, rays[0].z0, ends, &costmap[0], 0, 0, 0, 255, UINT_MAX,
+                              parallel_for);
+  }
+  return (ros::WallTime::now() - start).toSec() / iterations;
+}
+
+void runTasks(unsigned int num_tasks, const boost::function<void(unsigned int)>* task, unsigned int thread,
+              unsigned int num_threads)
+{
+  for (unsigned int i = thread; i < num_tasks; i += num_threads)
+    (*task)(i);
+}
+
+// starting the threads for every observation is included in the timings
+void threadedParallelFor(unsigned int num_threads, unsigned int num_tasks,
+                         const boost::function<void(unsigned int)>& task)
+{
+  boost::thread_group threads;
+  for (unsigned int t = 1; t < num_threads; ++t)
+    threads.create_thread(boost::bind(&runTasks, num_tasks, &task, t, num_threads));
+  runTasks(num_tasks, &task, 0, num_threads);
+  threads.join_all();
+}
+
+int main(int argc, char** argv)
+{
+  unsigned int size = argc > 1 ? atoi(argv[1]) : 2000;
+  double range = argc > 2 ? atof(argv[2]) : 100.0;
+  unsigned int num_rays = argc > 3 ? atoi(argv[3]) : 300000;
+  int iterations = argc > 4 ? atoi(argv[4]) : 5;
+  unsigned int threads = argc > 5 ? atoi(argv[5]) : 4;
+
+  std::vector<unsigned char> costmap(size * size, 255);
+  printf("grid: %u x %u columns, %u rays of %.0f cells\n", size, size, num_rays, range);
+
+  voxel_grid::VoxelGrid dense(size, size, 16);
+  std::vector<Ray> rays = makeRays(size, 16, range, num_rays);
+  double dense_time = clearRays(dense, rays, costmap, iterations);
+  printf("dense,   16 z: %8.2f ms/observation, %8.2f MB\n", 1e3 * dense_time,
+         size * size * sizeof(uint32_t) / 1e6);
+
+  voxel_grid::VoxelGrid batch(size, size, 16);
+  double batch_time = clearRaysBatch(batch, rays, costmap, iterations, voxel_grid::ParallelFor());
+  printf("dense batch, 1 thread:  %8.2f ms/observation\n", 1e3 * batch_time);
+
+  voxel_grid::VoxelGrid threaded(size, size, 16);
+  double threaded_time = clearRaysBatch(threaded, rays, costmap, iterations,
+                                        boost::bind(&threadedParallelFor, threads, _1, _2));
+  printf("dense batch, %u threads: %8.2f ms/observation\n", threads, 1e3 * threaded_time);
+
+  unsigned int heights[] = { 16, 64 };
+  for (unsigned int h = 0; h < 2; ++h)
+  {
+    voxel_grid::SparseVoxelGrid sparse(size, size, heights[h]);
+    rays = makeRays(size, heights[h], range, num_rays);
+    double sparse_time = clearRays(sparse, rays, costmap, iterations);
+    printf("sparse,  %u z: %8.2f ms/observation, %8.2f MB (%u tiles)\n", heights[h], 1e3 * sparse_time,
+           sparse.getMemoryUsage() / 1e6, sparse.numAllocatedTiles());
+  }
+
+  return 0;
+}
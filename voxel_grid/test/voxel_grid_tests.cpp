@@ -35,7 +35,9 @@
 * Author: Eitan Marder-Eppstein
 *********************************************************************/
 #include <voxel_grid/voxel_grid.h>
+#include <voxel_grid/sparse_voxel_grid.h>
 #include <gtest/gtest.h>
+#include <vector>
 
 TEST(voxel_grid, basicMarkingAndClearing){
   int size_x = 50, size_y = 10, size_z = 16;
@@ -140,6 +142,182 @@ TEST(voxel_grid, basicMarkingAndClearing){
      */
 }
 
+//runs the tasks backwards, to check that the result doesn't depend on the order
+void reverseParallelFor(unsigned int num_tasks, const boost::function<void(unsigned int)>& task){
+  for(unsigned int i = num_tasks; i > 0; --i){
+    task(i - 1);
+  }
+}
+
+TEST(voxel_grid, batchClearingMatchesLines){
+  unsigned int size_x = 80, size_y = 60, size_z = 10;
+  voxel_grid::VoxelGrid lines(size_x, size_y, size_z), batch(size_x, size_y, size_z), parallel(size_x, size_y, size_z);
+
+  srand(3);
+  for(int i = 0; i < 800; ++i){
+    unsigned int x = rand() % size_x, y = rand() % size_y, z = rand() % size_z;
+    lines.markVoxel(x, y, z);
+    batch.markVoxel(x, y, z);
+    parallel.markVoxel(x, y, z);
+  }
+
+  std::vector<unsigned char> lines_map(size_x * size_y, 100), batch_map(size_x * size_y, 100),
+                             parallel_map(size_x * size_y, 100);
+  for(int observation = 0; observation < 5; ++observation){
+    double x0 = (rand() % (size_x * 10)) / 10.0, y0 = (rand() % (size_y * 10)) / 10.0, z0 = (rand() % (size_z * 10)) / 10.0;
+    std::vector<voxel_grid::GridPoint> ends;
+    for(int i = 0; i < 1000; ++i){
+      //some of the end points are out of bounds and must be skipped
+      ends.push_back(voxel_grid::GridPoint((rand() % (size_x * 11)) / 10.0, (rand() % (size_y * 11)) / 10.0,
+                                           (rand() % (size_z * 10)) / 10.0));
+    }
+
+    unsigned int max_length = observation % 2 ? 25 : UINT_MAX;
+    for(unsigned int i = 0; i < ends.size(); ++i){
+      lines.clearVoxelLineInMap(x0, y0, z0, ends[i].x, ends[i].y, ends[i].z, &lines_map[0], 6, 1, 0, 255, max_length);
+    }
+    batch.clearVoxelLinesInMap(x0, y0, z0, ends, &batch_map[0], 6, 1, 0, 255, max_length);
+    parallel.clearVoxelLinesInMap(x0, y0, z0, ends, &parallel_map[0], 6, 1, 0, 255, max_length, reverseParallelFor);
+
+    ASSERT_TRUE(lines_map == batch_map);
+    ASSERT_TRUE(lines_map == parallel_map);
+    ASSERT_EQ(0, memcmp(lines.getData(), batch.getData(), size_x * size_y * sizeof(uint32_t)));
+    ASSERT_EQ(0, memcmp(lines.getData(), parallel.getData(), size_x * size_y * sizeof(uint32_t)));
+  }
+}
+
+TEST(voxel_grid, sparseMatchesDense){
+  unsigned int size_x = 70, size_y = 40, size_z = 16;
+  voxel_grid::VoxelGrid vg(size_x, size_y, size_z);
+  voxel_grid::SparseVoxelGrid svg(size_x, size_y, size_z);
+  std::vector<unsigned char> dense_map(size_x * size_y, 100), sparse_map(size_x * size_y, 100);
+
+  srand(7);
+  for(int i = 0; i < 500; ++i){
+    unsigned int x = rand() % size_x, y = rand() % size_y, z = rand() % size_z;
+    ASSERT_EQ(vg.markVoxelInMap(x, y, z, 1), svg.markVoxelInMap(x, y, z, 1));
+  }
+
+  //VoxelLayer pads the unknown threshold for the unused bits of the dense columns, none are unused here
+  for(int i = 0; i < 2000; ++i){
+    double x0 = (rand() % (size_x * 10)) / 10.0, y0 = (rand() % (size_y * 10)) / 10.0, z0 = (rand() % (size_z * 10)) / 10.0;
+    double x1 = (rand() % (size_x * 10)) / 10.0, y1 = (rand() % (size_y * 10)) / 10.0, z1 = (rand() % (size_z * 10)) / 10.0;
+    unsigned int max_length = i % 3 == 0 ? 10 : UINT_MAX;
+    vg.clearVoxelLineInMap(x0, y0, z0, x1, y1, z1, &dense_map[0], 8, 1, 0, 255, max_length);
+    svg.clearVoxelLineInMap(x0, y0, z0, x1, y1, z1, &sparse_map[0], 8, 1, 0, 255, max_length);
+  }
+
+  ASSERT_TRUE(dense_map == sparse_map);
+  for(unsigned int i = 0; i < size_x; ++i){
+    for(unsigned int j = 0; j < size_y; ++j){
+      ASSERT_EQ(vg.getVoxelColumn(i, j, 4, 1), svg.getVoxelColumn(i, j, 4, 1));
+      for(unsigned int k = 0; k < size_z; ++k){
+        ASSERT_EQ(vg.getVoxel(i, j, k), svg.getVoxel(i, j, k));
+      }
+    }
+  }
+
+  std::vector<uint32_t> packed(size_x * size_y);
+  svg.getPackedData(&packed[0]);
+  ASSERT_EQ(0, memcmp(&packed[0], vg.getData(), packed.size() * sizeof(uint32_t)));
+}
+
+TEST(voxel_grid, sparseParallelClearingMatchesLines){
+  unsigned int size_x = 80, size_y = 60, size_z = 40;
+  voxel_grid::SparseVoxelGrid lines(size_x, size_y, size_z), parallel(size_x, size_y, size_z);
+
+  srand(5);
+  for(int i = 0; i < 3000; ++i){
+    unsigned int x = rand() % size_x, y = rand() % size_y, z = rand() % size_z;
+    lines.markVoxel(x, y, z);
+    parallel.markVoxel(x, y, z);
+  }
+
+  std::vector<unsigned char> lines_map(size_x * size_y, 100), parallel_map(size_x * size_y, 100);
+  for(int observation = 0; observation < 5; ++observation){
+    double x0 = (rand() % (size_x * 10)) / 10.0, y0 = (rand() % (size_y * 10)) / 10.0, z0 = (rand() % (size_z * 10)) / 10.0;
+    std::vector<voxel_grid::GridPoint> ends;
+    for(int i = 0; i < 1000; ++i){
+      //some of the end points are out of bounds and must be skipped
+      ends.push_back(voxel_grid::GridPoint((rand() % (size_x * 11)) / 10.0, (rand() % (size_y * 11)) / 10.0,
+                                           (rand() % (size_z * 10)) / 10.0));
+    }
+
+    unsigned int max_length = observation % 2 ? 25 : UINT_MAX;
+    for(unsigned int i = 0; i < ends.size(); ++i){
+      lines.clearVoxelLineInMap(x0, y0, z0, ends[i].x, ends[i].y, ends[i].z, &lines_map[0], 20, 1, 0, 255, max_length);
+    }
+    parallel.clearVoxelLinesInMap(x0, y0, z0, ends, &parallel_map[0], 20, 1, 0, 255, max_length, reverseParallelFor);
+
+    ASSERT_TRUE(lines_map == parallel_map);
+    ASSERT_EQ(lines.numAllocatedTiles(), parallel.numAllocatedTiles());
+    for(unsigned int i = 0; i < size_x; ++i){
+      for(unsigned int j = 0; j < size_y; ++j){
+        for(unsigned int k = 0; k < size_z; ++k){
+          ASSERT_EQ(lines.getVoxel(i, j, k), parallel.getVoxel(i, j, k));
+        }
+      }
+    }
+  }
+}
+
+TEST(voxel_grid, sparseTallColumns){
+  voxel_grid::SparseVoxelGrid svg(10, 10, 60);
+  ASSERT_EQ(60u, svg.sizeZ());
+
+  svg.markVoxelLine(2, 2, 0, 2, 2, 59);
+  for(unsigned int k = 0; k < 60; ++k){
+    ASSERT_EQ(voxel_grid::MARKED, svg.getVoxel(2, 2, k));
+  }
+  ASSERT_EQ(voxel_grid::MARKED, svg.getVoxelColumn(2, 2, 0, 59));
+  ASSERT_EQ(voxel_grid::FREE, svg.getVoxelColumn(2, 2, 0, 60));
+
+  //an untouched column has all 60 voxels unknown
+  ASSERT_EQ(voxel_grid::UNKNOWN, svg.getVoxelColumn(5, 5, 59, 0));
+  ASSERT_EQ(voxel_grid::FREE, svg.getVoxelColumn(5, 5, 60, 0));
+
+  svg.clearVoxelLine(2, 2, 59, 2, 2, 30);
+  ASSERT_EQ(voxel_grid::MARKED, svg.getVoxel(2, 2, 29));
+  ASSERT_EQ(voxel_grid::FREE, svg.getVoxel(2, 2, 30));
+  ASSERT_EQ(voxel_grid::FREE, svg.getVoxel(2, 2, 59));
+}
+
+TEST(voxel_grid, sparseAllocatesObservedTiles){
+  voxel_grid::SparseVoxelGrid svg(1000, 1000, 32);
+  ASSERT_EQ(0u, svg.numAllocatedTiles());
+
+  svg.markVoxel(500, 500, 3);
+  ASSERT_EQ(1u, svg.numAllocatedTiles());
+
+  //a line clears every tile it crosses
+  svg.clearVoxelLine(0, 0, 0, 999, 0, 0);
+  ASSERT_EQ(1u + (1000 + voxel_grid::SparseVoxelGrid::TILE_SIZE - 1) / voxel_grid::SparseVoxelGrid::TILE_SIZE,
+            svg.numAllocatedTiles());
+
+  svg.reset();
+  ASSERT_EQ(0u, svg.numAllocatedTiles());
+  ASSERT_EQ(voxel_grid::UNKNOWN, svg.getVoxel(500, 500, 3));
+}
+
+TEST(voxel_grid, sparseUpdateOrigin){
+  //shifts by multiples of the tile size move whole tiles, the others copy columns
+  for(int shift = -16; shift <= 16; shift += 4){
+    voxel_grid::SparseVoxelGrid svg(40, 40, 8);
+    svg.markVoxel(20, 20, 2);
+    svg.clearVoxel(21, 20, 2);
+
+    svg.updateOrigin(shift, shift);
+
+    int x = 20 - shift, y = 20 - shift;
+    ASSERT_EQ(voxel_grid::MARKED, svg.getVoxel(x, y, 2)) << "shift " << shift;
+    ASSERT_EQ(voxel_grid::FREE, svg.getVoxel(x + 1, y, 2)) << "shift " << shift;
+    ASSERT_EQ(voxel_grid::UNKNOWN, svg.getVoxel(x, y, 3)) << "shift " << shift;
+    if(shift != 0){
+      ASSERT_EQ(voxel_grid::UNKNOWN, svg.getVoxel(20, 20, 2)) << "shift " << shift;
+    }
+  }
+}
+
 int main(int argc, char** argv){
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();